@@ -0,0 +1,130 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    struct AppConfig {
+        /**
+         * Headless mode skips GLFW, the surface and the swap chain entirely. Frames are rendered into a ring of
+         * device local images and paced by the in flight fences instead of vkQueuePresentKHR, so we can run on render
+         * nodes without a display (or on a software ICD like lavapipe).
+         */
+        bool headless = false;
+
+        // Number of frames to render before exiting, 0 means run until the window is closed.
+        uint32_t frame_count = 0;
+
+        uint32_t width  = 800;
+        uint32_t height = 600;
+
+        // Size of the offscreen image ring in headless mode, clamped to at least the number of frames in flight.
+        uint32_t offscreen_image_count = 3;
+
+        // Number of objects drawn every frame, each one is its own draw call with its own uniforms.
+        uint32_t object_count = 1;
+
+        /**
+         * 0 draws the quad from Vertex.h, anything else generates that many procedural meshes of triangles_per_mesh
+         * triangles each. Object i draws mesh i % mesh_count.
+         */
+        uint32_t mesh_count         = 0;
+        uint32_t triangles_per_mesh = 2;
+
+        // Objects whose transform is recomputed every frame, the rest keep the one they started with.
+        uint32_t uniform_update_count = UINT32_MAX;
+
+        // Threads recording the draws, 0 means one per hardware thread.
+        uint32_t worker_count = 0;
+
+        // Where the driver's pipeline cache is loaded from and saved to, empty disables the on-disk cache.
+        std::string pipeline_cache_path = "pipeline_cache.bin";
+
+        /**
+         * Built with ENABLE_SHADERC and without an asset pack, the GLSL in the shader directory is compiled at startup
+         * instead of loading the .spv files, with every shader_defines entry ("NAME" or "NAME=VALUE") defined. The
+         * SPIR-V is cached under shader_cache_path keyed by the source, so only edited shaders get compiled again.
+         * hot_reload watches the sources and rebuilds the pipelines using whatever changed while running.
+         */
+        std::string shader_cache_path = "shader_cache";
+        std::vector<std::string> shader_defines;
+        bool hot_reload = false;
+
+        // Asset pack built by vk-pack. Shaders and meshes come from it instead of loose files when set.
+        std::string asset_pack_path;
+
+        // OBJ or glTF model to draw instead of the pack's meshes, imported at startup.
+        std::string model_path;
+
+        // Reorders the imported model's triangles and vertices for the post-transform cache, overdraw and fetch.
+        bool optimize_meshes = true;
+
+        /**
+         * GPU vertex layout. "float" splits Vertex into a position and a colour stream, "compact" does the same but
+         * quantizes it to half the size and "interleaved" uploads Vertex as is.
+         */
+        std::string vertex_format = "float";
+
+        // Fills the depth buffer from the position stream alone first, so the colour pass shades every pixel once.
+        bool depth_prepass = false;
+
+        /**
+         * Draws every object of the same mesh with one instanced draw. Transforms come from an instance rate vertex
+         * binding instead of a uniform slot per object, so recording no longer depends on the object count.
+         */
+        bool instancing = false;
+
+        /**
+         * Culls against the view frustum in a compute shader which writes the draws of the visible objects, the CPU
+         * only records two indirect draws no matter how many objects there are. Uses the instanced shaders and takes
+         * precedence over instancing.
+         */
+        bool gpu_culling = false;
+
+        /**
+         * Culls the objects against the view frustum on the workers before recording, only the visible ones get drawn.
+         * Only the per object path uses it, instancing and GPU culling turn it off.
+         */
+        bool cpu_culling = false;
+
+        /**
+         * Culls with a BVH over the objects' boxes instead of testing every object, implies cpu_culling. Moving objects
+         * get refit into it every frame, so it pays off when most of them stay put.
+         */
+        bool bvh_culling = false;
+
+        /**
+         * Gives every per object draw a descriptor set of its own, allocated and written while recording, instead of
+         * the frame's one set with a dynamic offset. Slower on purpose, it measures what descriptor churn costs.
+         */
+        bool per_draw_sets = false;
+
+        /**
+         * Draws the per object path out of one bindless set from VK_EXT_descriptor_indexing. Draws pick this frame's
+         * transforms with a push constant instead of binding a set each, so the objects of a mesh a worker records
+         * become one instanced draw. Only the per object path uses it, instancing and GPU culling turn it off.
+         */
+        bool bindless = false;
+
+        /**
+         * KTX2 or DDS textures streamed in under texture_budget_mb of device memory, object i uses texture i % count.
+         * Nothing samples them yet, every object drawn asks for the mip its size on screen needs.
+         */
+        std::vector<std::string> texture_paths;
+        uint32_t texture_budget_mb = 256;
+
+        // Records CPU zones and GPU timestamps, only does anything when built with ENABLE_PROFILER.
+        bool profile = false;
+
+        // Where to write the Chrome trace JSON at exit, empty writes none. Setting it turns profiling on.
+        std::string trace_path;
+
+        // Prints the allocator, uploader, pipeline cache and profiler stats on exit.
+        bool print_stats = true;
+    };
+}
+
+#endif
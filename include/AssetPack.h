@@ -0,0 +1,145 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include "MappedFile.h"
+#include "Vertex.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    enum class AssetType : uint32_t {
+        Blob,
+        Shader,
+        Mesh
+    };
+
+    /**
+     * On disk layout, little endian. The header sits at the start of the file, followed by the blobs (each aligned to
+     * BLOB_ALIGNMENT), the table of contents and the names. Everything is read straight out of the mapping, nothing
+     * gets parsed or copied on open.
+     */
+    struct AssetPackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entry_count;
+
+        // Number of slots in the table, a power of two at least twice entry_count.
+        uint32_t table_size;
+        uint64_t table_offset;
+        uint64_t names_offset;
+        uint64_t file_size;
+    };
+
+    /**
+     * One slot of the open addressed table, slots are found by name_hash & (table_size - 1) and linear probing. A
+     * name_hash of 0 marks an empty slot, real hashes are never 0.
+     */
+    struct AssetEntry {
+        uint64_t name_hash;
+        uint64_t offset;
+        uint64_t size;
+        uint32_t name_offset;
+        uint32_t name_length;
+        AssetType type;
+        uint32_t reserved;
+    };
+
+    /**
+     * Mesh blobs start with this, the offsets are relative to the start of the blob. Vertices use the layout of Vertex,
+     * indices are 2 or 4 bytes each.
+     */
+    struct MeshAssetHeader {
+        uint32_t vertex_count;
+        uint32_t index_count;
+        uint32_t vertex_stride;
+        uint32_t index_size;
+        uint64_t vertex_offset;
+        uint64_t index_offset;
+    };
+
+    struct AssetView {
+        const void* data = nullptr;
+        uint64_t size    = 0;
+    };
+
+    struct MeshView {
+        const Vertex* vertices = nullptr;
+        const void* indices    = nullptr;
+        uint32_t vertex_count  = 0;
+        uint32_t index_count   = 0;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+    };
+
+    /**
+     * A read only pack mapped into memory for as long as the object lives. Views handed out point into the mapping, so
+     * mesh data can be copied straight into staging memory and SPIR-V handed to vkCreateShaderModule as is. Opening a
+     * pack only checks the header, the cost of touching an asset is the page faults of reading it.
+     */
+    class AssetPack {
+
+        public:
+            static constexpr char MAGIC[4]           = { 'V', 'K', 'A', 'P' };
+            static constexpr uint32_t VERSION        = 2;
+            static constexpr uint64_t BLOB_ALIGNMENT = 64;
+
+            explicit AssetPack(const std::string& path);
+            ~AssetPack();
+
+            AssetPack(const AssetPack&) = delete;
+            AssetPack& operator=(const AssetPack&) = delete;
+
+            // nullptr when there's no asset with that name.
+            const AssetEntry* find(const std::string& name) const;
+
+            AssetView get(const AssetEntry& entry) const;
+            AssetView get(const std::string& name) const;
+
+            MeshView get_mesh(const AssetEntry& entry) const;
+            MeshView get_mesh(const std::string& name) const;
+
+            std::string get_name(const AssetEntry& entry) const;
+
+            // Every asset of the given type, sorted by name.
+            std::vector<const AssetEntry*> get_entries(AssetType type) const;
+
+            uint32_t get_entry_count() const { return header->entry_count; }
+
+        private:
+            MappedFile file;
+            const char* data;
+            uint64_t size;
+            const AssetPackHeader* header;
+            const AssetEntry* table;
+    };
+
+    /**
+     * Builds a pack in memory and writes it out in one go, used by the vk-pack tool.
+     */
+    class AssetPackWriter {
+
+        public:
+            void add(const std::string& name, AssetType type, const void* data, size_t size);
+            void add_file(const std::string& name, AssetType type, const std::string& file_path);
+            void add_mesh(const std::string& name, const Vertex* vertices, uint32_t vertex_count,
+                const void* indices, uint32_t index_count, VkIndexType index_type);
+
+            void write(const std::string& path) const;
+
+            uint32_t get_asset_count() const { return static_cast<uint32_t>(assets.size()); }
+
+        private:
+            struct PendingAsset {
+                std::string name;
+                AssetType type;
+                std::vector<char> data;
+            };
+
+            std::vector<PendingAsset> assets;
+    };
+
+    uint64_t hash_asset_name(const char* name, size_t length);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef BINDLESS_HEAP_H
+#define BINDLESS_HEAP_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * Hands out the integer handles 0 to capacity - 1. A freed handle isn't reused straight away, draws recorded before
+     * the free may still be in flight and index with it, so it waits until reclaim() is told that every frame up to
+     * retire_frame is done. Same bookkeeping as the retired swap chains. Not thread safe.
+     */
+    class HandleAllocator {
+
+        public:
+            explicit HandleAllocator(uint32_t capacity);
+
+            // Throws once every handle is taken.
+            uint32_t allocate();
+            void free(uint32_t handle, uint64_t retire_frame);
+            void reclaim(uint64_t completed_frames);
+
+            uint32_t get_capacity() const { return capacity; }
+            uint32_t get_used() const { return next - static_cast<uint32_t>(free_handles.size()); }
+
+        private:
+            struct RetiredHandle {
+                uint32_t handle;
+                uint64_t retire_frame;
+            };
+
+            uint32_t capacity;
+
+            // Handles from next on have never been handed out, the ones below it are either taken or in free_handles.
+            uint32_t next = 0;
+            std::vector<uint32_t> free_handles;
+            std::deque<RetiredHandle> retired;
+    };
+
+    /**
+     * One descriptor set holding an array of storage buffers and an array of sampled images, from
+     * VK_EXT_descriptor_indexing. Resources are added once and referred to by their handle, their index in the array,
+     * which shaders get through push constants or instance data. The set gets bound once per cmd buffer instead of a
+     * set per draw, so draws that only differed by what they had bound can become one.
+     *
+     * Both bindings are update after bind and partially bound: adding a resource writes its descriptor even while the
+     * set is bound in cmd buffers that haven't finished, and the slots nobody uses never have to be valid. The layout
+     * lives here rather than in the DescriptorLayoutCache since the binding flags hang off its pNext.
+     */
+    class BindlessHeap {
+
+        public:
+            static const uint32_t BUFFER_BINDING = 0;
+            static const uint32_t IMAGE_BINDING  = 1;
+
+            // How big the arrays get unless the device's update after bind limits are lower.
+            static const uint32_t DEFAULT_BUFFER_COUNT = 4096;
+            static const uint32_t DEFAULT_IMAGE_COUNT  = 4096;
+
+            BindlessHeap(VkDevice device, uint32_t buffer_count, uint32_t image_count);
+            ~BindlessHeap();
+
+            BindlessHeap(const BindlessHeap&) = delete;
+            BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+            uint32_t add_buffer(const VkDescriptorBufferInfo& buffer_info);
+            uint32_t add_image(VkImageView image_view, VkImageLayout image_layout);
+
+            /**
+             * The handle comes back once retire_frame frames are done, frame_number + 1 while recording a frame that
+             * still uses it. The descriptor is left as it was, nothing recorded afterwards may index with the handle.
+             */
+            void remove_buffer(uint32_t handle, uint64_t retire_frame);
+            void remove_image(uint32_t handle, uint64_t retire_frame);
+            void reclaim(uint64_t completed_frames);
+
+            VkDescriptorSetLayout get_layout() const { return layout; }
+            const std::vector<VkDescriptorSetLayoutBinding>& get_bindings() const { return bindings; }
+            VkDescriptorSet get_set() const { return set; }
+            const HandleAllocator& get_buffers() const { return buffers; }
+            const HandleAllocator& get_images() const { return images; }
+
+        private:
+            VkDevice device;
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            VkDescriptorSetLayout layout;
+            VkDescriptorPool pool;
+            VkDescriptorSet set;
+
+            HandleAllocator buffers;
+            HandleAllocator images;
+    };
+}
+
+#endif
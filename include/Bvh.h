@@ -0,0 +1,91 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "Frustum.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Flattened depth first: a node's first child is the next node and skip is the node after its whole subtree, which
+     * is also where its second child starts. Walking the array in order while jumping to skip whenever a subtree gets
+     * accepted or rejected visits the tree without a stack. The objects under a node are contiguous in the index array,
+     * from first_object up to the first_object of the node at skip. 32 bytes, two per cache line.
+     */
+    struct BvhNode {
+        glm::vec3 min;
+        uint32_t first_object;
+        glm::vec3 max;
+        uint32_t skip;
+    };
+
+    /**
+     * Bounding volume hierarchy over object boxes, for culling and picking without touching every object. Built top
+     * down with the surface area heuristic over binned centroids. Objects that move get their new boxes refit into
+     * the existing tree, which keeps it valid but lets it get looser, so rebuild() once in a while if everything moves.
+     */
+    class Bvh {
+
+        public:
+            static const uint32_t INVALID_OBJECT = UINT32_MAX;
+
+            // Nodes with this many objects or fewer are never split.
+            static const uint32_t MAX_LEAF_SIZE = 4;
+
+            // Centroid bins the split search tries per node.
+            static const uint32_t BIN_COUNT = 12;
+
+            /**
+             * Takes the boxes of every object and builds the tree over them, replacing whatever was there.
+             */
+            void build(const std::vector<glm::vec3>& min, const std::vector<glm::vec3>& max);
+            void rebuild();
+
+            /**
+             * Only takes effect on refit(), which walks back up from the leaves of the objects that changed and stops
+             * at any node whose box came out the same.
+             */
+            void set_bounds(uint32_t object, const glm::vec3& min, const glm::vec3& max);
+            void refit();
+
+            /**
+             * Appends every object whose box isn't entirely outside the frustum. Subtrees entirely inside are taken as
+             * is without testing what's in them.
+             */
+            void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+            /**
+             * Closest object whose box the ray hits within max_distance, INVALID_OBJECT if none. direction doesn't have
+             * to be normalized, distance is in units of it.
+             */
+            uint32_t pick(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+                float& distance) const;
+
+            const std::vector<BvhNode>& get_nodes() const { return nodes; }
+            uint32_t get_object_count() const { return static_cast<uint32_t>(object_min.size()); }
+            uint32_t get_depth() const { return depth; }
+
+        private:
+            std::vector<BvhNode> nodes;
+            std::vector<uint32_t> indices;
+            std::vector<glm::vec3> object_min;
+            std::vector<glm::vec3> object_max;
+            std::vector<glm::vec3> centroids;
+            uint32_t depth = 0;
+
+            // For refit, the leaf every object ended up in and the parent of every node.
+            std::vector<uint32_t> object_leaves;
+            std::vector<uint32_t> parents;
+            std::vector<char> dirty;
+            bool any_dirty = false;
+
+            void build_node(uint32_t parent, uint32_t begin, uint32_t end, uint32_t level);
+            uint32_t get_end_object(uint32_t node) const;
+            bool is_leaf(uint32_t node) const { return nodes[node].skip == node + 1; }
+            void append_objects(uint32_t node, std::vector<uint32_t>& visible) const;
+    };
+}
+
+#endif
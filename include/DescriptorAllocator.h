@@ -0,0 +1,136 @@
+#ifndef DESCRIPTOR_ALLOCATOR_H
+#define DESCRIPTOR_ALLOCATOR_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * Set layouts keyed by a PipelineHasher hash of their flags and bindings, so asking for the same bindings twice
+     * hands back the same VkDescriptorSetLayout. Bindings are hashed in binding order, so the order they're listed in
+     * doesn't matter. Pipeline layouts are cached the same way by their set layouts and push constant ranges, which
+     * is what lets two pipelines with identical layouts share one. Like the pipeline cache, every entry keeps the
+     * hashed bindings or ranges and a hit has to match them, a collision gets its own layout. The cache owns both and
+     * destroys them with itself.
+     */
+    class DescriptorLayoutCache {
+
+        public:
+            explicit DescriptorLayoutCache(VkDevice device);
+            ~DescriptorLayoutCache();
+
+            DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+            DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+            VkDescriptorSetLayout get(const VkDescriptorSetLayoutCreateInfo& info);
+            VkPipelineLayout get(const VkPipelineLayoutCreateInfo& info);
+
+            size_t get_size() const { return layouts.size(); }
+            size_t get_pipeline_layout_count() const { return pipeline_layouts.size(); }
+            uint64_t get_hits() const { return hits; }
+
+        private:
+            template <typename T>
+            struct Entry {
+                T layout;
+                std::vector<unsigned char> state;
+            };
+
+            VkDevice device;
+            std::unordered_multimap<uint64_t, Entry<VkDescriptorSetLayout>> layouts;
+            std::unordered_multimap<uint64_t, Entry<VkPipelineLayout>> pipeline_layouts;
+            uint64_t hits = 0;
+    };
+
+    // Descriptors of one type every pool gets per set it can hold.
+    struct DescriptorPoolRatio {
+        VkDescriptorType type;
+        float per_set;
+    };
+
+    struct DescriptorStats {
+        uint64_t sets_allocated = 0;
+        uint64_t pools_created  = 0;
+        uint64_t resets         = 0;
+    };
+
+    /**
+     * Hands out sets from a list of pools. When the current pool runs out the next one is used, and when there's no
+     * next one a new pool twice the size of the last gets created, up to MAX_POOL_SETS sets. reset() resets every pool
+     * with vkResetDescriptorPool and starts over from the first, the pools themselves are kept, so once the first few
+     * frames have grown the list nothing gets created anymore.
+     *
+     * Not thread safe, same as the pools underneath. Give every thread its own, like the cmd pools.
+     */
+    class DescriptorAllocator {
+
+        public:
+            static constexpr uint32_t DEFAULT_POOL_SETS = 64;
+            static constexpr uint32_t MAX_POOL_SETS     = 4096;
+
+            DescriptorAllocator(VkDevice device, const std::vector<DescriptorPoolRatio>& ratios,
+                uint32_t first_pool_sets = DEFAULT_POOL_SETS);
+            ~DescriptorAllocator();
+
+            DescriptorAllocator(const DescriptorAllocator&) = delete;
+            DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+            VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+            /**
+             * Every set allocated so far becomes invalid. Only call this once nothing that uses them is pending.
+             */
+            void reset();
+
+            const DescriptorStats& get_stats() const { return stats; }
+
+        private:
+            VkDevice device;
+            std::vector<DescriptorPoolRatio> ratios;
+            uint32_t next_pool_sets;
+
+            // Pools and how many sets each one holds, sets are allocated from pools[current] on.
+            std::vector<VkDescriptorPool> pools;
+            std::vector<uint32_t> pool_sets;
+            size_t current        = 0;
+            uint32_t current_sets = 0;
+            DescriptorStats stats;
+
+            void create_pool();
+    };
+
+    /**
+     * Writes every binding of a set in one call from an array of VkDescriptorBufferInfo, one per descriptor in binding
+     * order. With VK_KHR_descriptor_update_template the driver reads the array through a VkDescriptorUpdateTemplate
+     * built once up front, otherwise the same array is turned into vkUpdateDescriptorSets writes. Only buffer bindings
+     * are supported. update() can be called from several threads for different sets.
+     */
+    class DescriptorTemplate {
+
+        public:
+            DescriptorTemplate(VkDevice device, VkDescriptorSetLayout layout, const VkDescriptorSetLayoutCreateInfo& info,
+                bool use_template);
+            ~DescriptorTemplate();
+
+            DescriptorTemplate(const DescriptorTemplate&) = delete;
+            DescriptorTemplate& operator=(const DescriptorTemplate&) = delete;
+
+            void update(VkDescriptorSet set, const VkDescriptorBufferInfo* buffer_infos) const;
+
+            uint32_t get_descriptor_count() const { return descriptor_count; }
+
+        private:
+            VkDevice device;
+            VkDescriptorUpdateTemplateKHR update_template = VK_NULL_HANDLE;
+            std::vector<VkDescriptorUpdateTemplateEntryKHR> entries;
+            uint32_t descriptor_count = 0;
+
+            PFN_vkDestroyDescriptorUpdateTemplateKHR destroy_template = nullptr;
+            PFN_vkUpdateDescriptorSetWithTemplateKHR update_with_template = nullptr;
+    };
+}
+
+#endif
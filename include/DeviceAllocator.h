@@ -0,0 +1,136 @@
+#ifndef DEVICE_ALLOCATOR_H
+#define DEVICE_ALLOCATOR_H
+
+#include "TlsfAllocator.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * Buffers and linear images are "linear" resources, optimal tiled images are not. Vulkan requires linear and non
+     * linear resources that share a page of bufferImageGranularity to be kept apart, so unless the granularity is 1 we
+     * just never mix them in the same block.
+     */
+    enum class ResourceKind {
+        Linear,
+        Optimal
+    };
+
+    struct Allocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset   = 0;
+        VkDeviceSize size     = 0;
+
+        // Non null when the memory is host visible, blocks are mapped once for their whole lifetime.
+        void* mapped = nullptr;
+
+        uint32_t memory_type = 0;
+        uint32_t block       = UINT32_MAX;
+        uint32_t node        = TlsfAllocator::INVALID_NODE;
+    };
+
+    /**
+     * The only part of the allocator that talks to the device. Everything else is plain bookkeeping so the allocator
+     * can be driven by a fake backend on the CPU.
+     */
+    class DeviceMemoryBackend {
+
+        public:
+            virtual ~DeviceMemoryBackend() = default;
+            virtual VkResult allocate(uint32_t memory_type, VkDeviceSize size, VkDeviceMemory& memory) = 0;
+            virtual void free(VkDeviceMemory memory) = 0;
+            virtual void* map(VkDeviceMemory memory) = 0;
+            virtual void unmap(VkDeviceMemory memory) = 0;
+    };
+
+    class VulkanMemoryBackend : public DeviceMemoryBackend {
+
+        public:
+            explicit VulkanMemoryBackend(VkDevice device);
+            VkResult allocate(uint32_t memory_type, VkDeviceSize size, VkDeviceMemory& memory) override;
+            void free(VkDeviceMemory memory) override;
+            void* map(VkDeviceMemory memory) override;
+            void unmap(VkDeviceMemory memory) override;
+
+        private:
+            VkDevice device;
+    };
+
+    struct HeapStats {
+        uint32_t block_count      = 0;
+        uint32_t allocation_count = 0;
+        VkDeviceSize reserved     = 0; // Bytes we got from vkAllocateMemory
+        VkDeviceSize used         = 0; // Bytes handed out to resources
+        VkDeviceSize largest_free = 0;
+
+        /**
+         * 0 means all the free space is one contiguous range, close to 1 means it's scattered in tiny pieces.
+         */
+        float fragmentation() const;
+    };
+
+    struct AllocatorStats {
+        std::vector<HeapStats> heaps;
+        uint32_t device_allocation_count = 0; // Live VkDeviceMemory objects
+        uint64_t total_allocations       = 0; // Sub allocations made over the allocator's lifetime
+    };
+
+    /**
+     * Sub allocates resources out of large per memory type blocks instead of calling vkAllocateMemory for every buffer,
+     * which both costs a lot and runs into maxMemoryAllocationCount. Each block keeps its free ranges in a TLSF
+     * allocator. Requests larger than half a block get a dedicated block of their own.
+     */
+    class DeviceAllocator {
+
+        public:
+            static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+            DeviceAllocator(DeviceMemoryBackend* backend, const VkPhysicalDeviceMemoryProperties& memory_properties,
+                VkDeviceSize buffer_image_granularity, VkDeviceSize block_size = DEFAULT_BLOCK_SIZE);
+            ~DeviceAllocator();
+
+            DeviceAllocator(const DeviceAllocator&) = delete;
+            DeviceAllocator& operator=(const DeviceAllocator&) = delete;
+
+            uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags props) const;
+            const VkPhysicalDeviceMemoryProperties& get_memory_properties() const { return memory_properties; }
+
+            Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags props,
+                ResourceKind kind);
+            void free(Allocation& allocation);
+
+            AllocatorStats get_stats() const;
+            void print_stats(std::ostream& out) const;
+
+        private:
+            struct Block {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                void* mapped          = nullptr;
+                uint32_t memory_type  = 0;
+                ResourceKind kind     = ResourceKind::Linear;
+                bool dedicated        = false;
+                std::unique_ptr<TlsfAllocator> ranges;
+            };
+
+            DeviceMemoryBackend* backend;
+            VkPhysicalDeviceMemoryProperties memory_properties;
+            VkDeviceSize buffer_image_granularity;
+            VkDeviceSize block_size;
+
+            // Indexed by Allocation::block, destroyed blocks leave a hole which gets reused.
+            std::vector<Block> blocks;
+            std::vector<uint32_t> free_block_slots;
+            uint64_t total_allocations = 0;
+
+            VkDeviceSize get_block_size(uint32_t memory_type) const;
+            uint32_t create_block(uint32_t memory_type, ResourceKind kind, VkDeviceSize size, bool dedicated);
+            void destroy_block(uint32_t block);
+            bool try_allocate(uint32_t block, VkDeviceSize size, VkDeviceSize alignment, Allocation& allocation);
+    };
+}
+
+#endif
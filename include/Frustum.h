@@ -0,0 +1,92 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <algorithm>
+#include <glm/glm.hpp>
+
+namespace vulkan_rendering {
+
+    /**
+     * Six planes pointing inwards, xyz is the normal and w the distance, normalized so a dot product gives the signed
+     * distance in world units. Order is left, right, bottom, top, near, far.
+     */
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        /**
+         * Gribb/Hartmann plane extraction from a projection * view matrix. Vulkan clip space has z in [0, 1], so the
+         * near plane is the third row on its own rather than w + z like in GL.
+         */
+        static Frustum from_matrix(const glm::mat4& view_proj) {
+            auto row = [&](int i) {
+                return glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+            };
+
+            Frustum frustum;
+            frustum.planes[0] = row(3) + row(0);
+            frustum.planes[1] = row(3) - row(0);
+            frustum.planes[2] = row(3) + row(1);
+            frustum.planes[3] = row(3) - row(1);
+            frustum.planes[4] = row(2);
+            frustum.planes[5] = row(3) - row(2);
+
+            for (glm::vec4& plane : frustum.planes) {
+                plane /= glm::length(glm::vec3(plane));
+            }
+            return frustum;
+        }
+
+        bool intersects_sphere(const glm::vec3& centre, float radius) const {
+            for (const glm::vec4& plane : planes) {
+                if (glm::dot(glm::vec3(plane), centre) + plane.w <= -radius) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        enum Containment { OUTSIDE, INTERSECTS, INSIDE };
+
+        /**
+         * Tests the corner furthest along each plane's normal, if that one's behind a plane the whole box is. The box
+         * is only INSIDE when the nearest corner is in front of every plane.
+         */
+        Containment classify_box(const glm::vec3& min, const glm::vec3& max) const {
+            Containment result = INSIDE;
+            for (const glm::vec4& plane : planes) {
+                glm::vec3 furthest(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+                    plane.z >= 0.0f ? max.z : min.z);
+                glm::vec3 nearest(plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y,
+                    plane.z >= 0.0f ? min.z : max.z);
+
+                if (glm::dot(glm::vec3(plane), furthest) + plane.w < 0.0f) {
+                    return OUTSIDE;
+                }
+                if (glm::dot(glm::vec3(plane), nearest) + plane.w < 0.0f) {
+                    result = INTERSECTS;
+                }
+            }
+            return result;
+        }
+    };
+
+    /**
+     * Box around a box moved by model, Arvo's method: every output axis adds up whichever end of each input axis lands
+     * lower (or higher) once scaled by the matrix. It can only grow, rotating by 45 degrees and back doesn't shrink it.
+     */
+    inline void transform_box(const glm::mat4& model, const glm::vec3& min, const glm::vec3& max, glm::vec3& out_min,
+        glm::vec3& out_max) {
+        out_min = glm::vec3(model[3]);
+        out_max = out_min;
+        for (int column = 0; column < 3; column++) {
+            for (int row = 0; row < 3; row++) {
+                float a = model[column][row] * min[column];
+                float b = model[column][row] * max[column];
+                out_min[row] += std::min(a, b);
+                out_max[row] += std::max(a, b);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include "Frustum.h"
+#include "WorkerPool.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * CPU side visibility. Every object has a world space sphere and box, stored as structure of arrays with one array
+     * per component, so a plane gets tested against a whole SIMD register of objects with a few multiplies and adds.
+     * The sphere goes first since it's cheaper, the box only gets tested for what the sphere let through.
+     *
+     * The instruction set is picked at compile time: AVX2 when the compiler targets it (ENABLE_AVX2), SSE2 on any other
+     * x86-64 build and scalar code everywhere else or when allow_simd is false.
+     */
+    class FrustumCuller {
+
+        public:
+            // Objects handed out to a worker at a time, a multiple of every SIMD width so a batch never straddles two.
+            static const uint32_t CHUNK_SIZE = 1024;
+
+            explicit FrustumCuller(bool allow_simd = true);
+
+            /**
+             * New objects start out never visible until their bounds get set.
+             */
+            void resize(uint32_t count);
+            uint32_t get_count() const { return count; }
+
+            void set_bounds(uint32_t object, const glm::vec4& sphere, const glm::vec3& min, const glm::vec3& max);
+
+            /**
+             * Moves bounds given in the object's own space to world space. The box is the box around the transformed
+             * one, so it can only grow. Different objects can be set from different threads, just not during cull().
+             */
+            void set_transformed(uint32_t object, const glm::mat4& model, const glm::vec4& sphere,
+                const glm::vec3& min, const glm::vec3& max);
+
+            /**
+             * Replaces visible with the index of every object that's at least partly inside the frustum, in ascending
+             * order, and returns how many there are. The chunks are split between the workers, each one appends to its
+             * own list and the lists get concatenated in worker order.
+             */
+            uint32_t cull(const Frustum& frustum, WorkerPool& pool, std::vector<uint32_t>& visible);
+
+            // "avx2", "sse2" or "scalar".
+            const char* get_simd_name() const;
+
+        private:
+            bool allow_simd;
+            uint32_t count = 0;
+
+            // Padded to a multiple of 8 with spheres of negative infinite radius, so the SIMD loops never need a tail.
+            std::vector<float> centre_x;
+            std::vector<float> centre_y;
+            std::vector<float> centre_z;
+            std::vector<float> radius;
+            std::vector<float> min_x;
+            std::vector<float> min_y;
+            std::vector<float> min_z;
+            std::vector<float> max_x;
+            std::vector<float> max_y;
+            std::vector<float> max_z;
+
+            std::vector<std::vector<uint32_t>> worker_visible;
+
+            void cull_range(const Frustum& frustum, uint32_t begin, uint32_t end, std::vector<uint32_t>& visible) const;
+    };
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <string>
+
+namespace vulkan_rendering {
+
+    /**
+     * A whole file mapped read only for as long as the object lives, mmap on POSIX and MapViewOfFile on Windows. Pages
+     * only get read from disk once they're touched.
+     */
+    class MappedFile {
+
+        public:
+            explicit MappedFile(const std::string& path);
+            ~MappedFile();
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* get_data() const { return data; }
+            uint64_t get_size() const { return size; }
+            const std::string& get_path() const { return path; }
+
+        private:
+            std::string path;
+            const char* data = nullptr;
+            uint64_t size    = 0;
+
+#ifdef _WIN32
+            void* file_handle    = nullptr;
+            void* mapping_handle = nullptr;
+#endif
+
+            void unmap();
+    };
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include "Vertex.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * One mesh in the exact layout it gets uploaded in. Vertices are deduplicated and the indices are 16 bit whenever
+     * the mesh has at most 65536 vertices, 32 bit otherwise. index_data holds index_count indices of index_type.
+     */
+    struct ImportedMesh {
+        std::string name;
+        std::vector<Vertex> vertices;
+        std::vector<uint8_t> index_data;
+        uint32_t index_count   = 0;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT16;
+    };
+
+    struct ImportStats {
+        uint64_t corner_count   = 0; // Triangle corners in the file, i.e. the vertex count without deduplication.
+        uint64_t vertex_count   = 0;
+        uint64_t triangle_count = 0;
+        double parse_seconds    = 0.0;
+        double build_seconds    = 0.0;
+
+        void print(std::ostream& stream) const;
+    };
+
+    /**
+     * Imports a .obj or a .gltf file (with its .bin buffers), picked by the extension. Parsing and mesh building are
+     * split across worker_count threads, 0 picks one per hardware thread.
+     *
+     * An OBJ file becomes a single mesh named after the file. Every glTF primitive becomes its own mesh, named
+     * file/mesh or file/mesh_primitive when a mesh has several primitives. Node transforms aren't applied. Colours come
+     * from COLOR_0 when there is one, else from the normal, else white.
+     */
+    std::vector<ImportedMesh> import_meshes(const std::string& path, uint32_t worker_count = 0,
+        ImportStats* stats = nullptr);
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "MeshImporter.h"
+#include "Vertex.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Result of replaying an index buffer through a FIFO post-transform cache. ACMR is the average number of vertex
+     * shader invocations per triangle (0.5 is the best a regular grid can do, 3 means no reuse at all) and ATVR the
+     * invocations per unique vertex (1 is ideal).
+     */
+    struct VertexCacheStats {
+        uint64_t triangle_count = 0;
+        uint64_t vertex_count   = 0;
+        uint64_t miss_count     = 0;
+
+        double get_acmr() const { return triangle_count == 0 ? 0.0 : miss_count / static_cast<double>(triangle_count); }
+        double get_atvr() const { return vertex_count == 0 ? 0.0 : miss_count / static_cast<double>(vertex_count); }
+
+        void add(const VertexCacheStats& other);
+    };
+
+    struct MeshOptimizeStats {
+        VertexCacheStats before;
+        VertexCacheStats after;
+        double seconds = 0.0;
+
+        void print(std::ostream& stream) const;
+    };
+
+    /**
+     * 16 entries is a fair stand in for current desktop GPUs. Only the relative change matters when comparing orders.
+     */
+    VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+        uint32_t cache_size = 16);
+
+    /**
+     * Forsyth's linear speed reordering: triangles are emitted greedily by a score that favours vertices that are
+     * already in a simulated LRU cache and vertices with few triangles left. Every index where the greedy search ran
+     * dry and had to restart somewhere cold is appended to cluster_starts, optimize_overdraw uses those as its hard
+     * cluster boundaries.
+     */
+    void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+        std::vector<uint32_t>* cluster_starts = nullptr);
+
+    /**
+     * Splits the cache optimized order into clusters, as small as they can get while their ACMR stays within
+     * threshold of what the whole order achieves, then draws the clusters facing away from the mesh's centre first.
+     * Those are the ones most likely to occlude the rest, so less gets shaded twice.
+     */
+    void optimize_overdraw(uint32_t* indices, uint32_t index_count, const Vertex* vertices,
+        const std::vector<uint32_t>& cluster_starts, float threshold = 1.05f);
+
+    /**
+     * Reorders the vertices into the order the indices first touch them and rewrites the indices to match, so vertex
+     * fetch streams through memory. Vertices nothing references are dropped, the new vertex count is returned.
+     */
+    uint32_t optimize_vertex_fetch(Vertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count);
+
+    /**
+     * All three passes on one mesh, in place. The index width gets picked again afterwards since unreferenced vertices
+     * are gone.
+     */
+    void optimize_mesh(ImportedMesh& mesh, MeshOptimizeStats* stats = nullptr);
+
+    /**
+     * Meshes are independent, so they're optimized in parallel on worker_count threads.
+     */
+    void optimize_meshes(std::vector<ImportedMesh>& meshes, uint32_t worker_count = 0,
+        MeshOptimizeStats* stats = nullptr);
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * FNV-1a over everything that makes two pipelines different. Structs are hashed field by field (or as raw arrays
+     * when they're made of nothing but 32 bit members) so padding, pNext chains and handles that don't affect the
+     * compiled pipeline never end up in the key.
+     *
+     * With keep_state every hashed byte is kept as well, so a cache can tell two states that hash the same apart.
+     */
+    class PipelineHasher {
+
+        public:
+            explicit PipelineHasher(bool keep_state = false) : keep_state(keep_state) {}
+
+            void add(const void* data, size_t size);
+
+            template <typename T>
+            void add(const T& value) {
+                add(&value, sizeof(T));
+            }
+
+            void add_shader(VkShaderStageFlagBits stage, const char* entry_point, const void* code, size_t size);
+
+            /**
+             * Only hashes what render pass compatibility depends on: formats and sample counts of the attachments and
+             * how the subpasses reference them. Load/store ops and layouts are ignored, so a pipeline created against
+             * the old render pass can be reused with a recreated one.
+             */
+            void add_render_pass(const VkRenderPassCreateInfo& info);
+
+            /**
+             * Hashes the fixed function state, the layout and the subpass. The shader modules and the render pass
+             * handle are skipped, use add_shader and add_render_pass for those.
+             */
+            void add_pipeline_state(const VkGraphicsPipelineCreateInfo& info);
+
+            uint64_t get() const { return hash; }
+            const std::vector<unsigned char>& get_state() const { return state; }
+
+        private:
+            uint64_t hash = 14695981039346656037ull;
+            bool keep_state;
+            std::vector<unsigned char> state;
+    };
+
+    struct PipelineCacheStats {
+        uint64_t hits   = 0;
+        uint64_t misses = 0;
+
+        // Total time spent in vkCreateGraphicsPipelines and vkCreateComputePipelines.
+        double creation_seconds = 0.0;
+
+        // Size of the driver cache read from disk, 0 if there was none or it was made by another device/driver.
+        size_t loaded_bytes = 0;
+        bool disk_cache_rejected = false;
+    };
+
+    /**
+     * Two levels of caching. The VkPipelineCache lets the driver skip shader compilation it has already done, it's
+     * loaded from disk on startup and written back with save(). On top of that every pipeline we create is kept in a
+     * map keyed by its PipelineHasher hash, so asking for the same state twice hands back the same VkPipeline without
+     * touching the driver at all. The hash alone isn't trusted: every entry keeps the state it was hashed from (the
+     * hasher needs keep_state), and a hit only counts when that matches too, so two states that collide both get their
+     * own pipeline. The cache owns the pipelines and destroys them with itself, or once they're retired and the frames
+     * that may still bind them are done.
+     */
+    class PipelineCache {
+
+        public:
+            PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& path);
+            ~PipelineCache();
+
+            PipelineCache(const PipelineCache&) = delete;
+            PipelineCache& operator=(const PipelineCache&) = delete;
+
+            /**
+             * Returns VK_NULL_HANDLE on a miss. Hits and misses are counted here.
+             */
+            VkPipeline find(const PipelineHasher& key);
+            VkPipeline create(const PipelineHasher& key, const VkGraphicsPipelineCreateInfo& info);
+            VkPipeline create(const PipelineHasher& key, const VkComputePipelineCreateInfo& info);
+
+            /**
+             * Takes a pipeline that was replaced (e.g. by a shader reload) out of the cache, so asking for its state
+             * again creates a new one. Frames before retire_frame may still bind it, so it's destroyed once reclaim()
+             * is told that every one of them is done.
+             */
+            void retire(VkPipeline pipeline, uint64_t retire_frame);
+            void reclaim(uint64_t completed_frames);
+
+            /**
+             * Writes the driver's cache data to the path given on construction. Does nothing without a path.
+             */
+            void save() const;
+
+            VkPipelineCache get_handle() const { return cache; }
+            const PipelineCacheStats& get_stats() const { return stats; }
+            void print_stats(std::ostream& out) const;
+
+        private:
+            struct Entry {
+                VkPipeline pipeline;
+                double creation_seconds;
+                std::vector<unsigned char> state;
+            };
+
+            struct RetiredPipeline {
+                VkPipeline pipeline;
+                uint64_t retire_frame;
+            };
+
+            VkDevice device;
+            VkPhysicalDeviceProperties properties;
+            std::string path;
+            VkPipelineCache cache;
+
+            std::unordered_multimap<uint64_t, Entry> pipelines;
+            std::deque<RetiredPipeline> retired;
+            PipelineCacheStats stats;
+
+            bool is_compatible(const std::vector<char>& data) const;
+            void add_entry(const PipelineHasher& key, VkPipeline pipeline,
+                std::chrono::high_resolution_clock::time_point start);
+    };
+}
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/**
+ * Build with ENABLE_PROFILER undefined and the zones compile away entirely, is_enabled() becomes a constant false so the
+ * GPU timestamps drop out as dead code as well. Only the frame times (one clock read per frame) are always collected.
+ */
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(profiler, name) \
+    vulkan_rendering::ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(profiler, name)
+#else
+#define PROFILE_ZONE(profiler, name)
+#endif
+
+namespace vulkan_rendering {
+
+    struct TimeSummary {
+        uint64_t count = 0;
+        double mean    = 0.0;
+        double p50     = 0.0;
+        double p95     = 0.0;
+        double p99     = 0.0;
+        double max     = 0.0;
+    };
+
+    /**
+     * Nearest rank percentiles, the values don't need to be sorted.
+     */
+    TimeSummary summarize(std::vector<double> values);
+
+    /**
+     * A finished zone. The name has to outlive the profiler, so only pass string literals.
+     */
+    struct ZoneEvent {
+        const char* name;
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    /**
+     * Collects CPU zones, GPU zones and frame times. Every thread that records zones gets its own fixed size ring of
+     * events. Only that thread ever writes to it, so recording a zone is two clock reads and a store with no locks;
+     * the only lock is taken once per thread to register its ring. When a ring wraps the oldest events are dropped.
+     */
+    class Profiler {
+
+        public:
+            static constexpr uint32_t EVENTS_PER_THREAD = 32 * 1024;
+
+            explicit Profiler(bool enabled = false);
+
+            Profiler(const Profiler&) = delete;
+            Profiler& operator=(const Profiler&) = delete;
+
+#ifdef ENABLE_PROFILER
+            bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+#else
+            constexpr bool is_enabled() const { return false; }
+#endif
+            void set_enabled(bool enabled) { this->enabled.store(enabled, std::memory_order_relaxed); }
+
+            // Names the calling thread in the trace, threads that never call this show up as "thread N".
+            void set_thread_name(const std::string& name);
+
+            uint64_t now_ns() const;
+            void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+            /**
+             * Marks the end of a frame, the CPU frame time is the time between two calls.
+             */
+            void end_frame();
+
+            // Called by GpuProfiler once a frame's timestamps are resolved.
+            void record_gpu(const char* name, uint64_t start_ns, uint64_t duration_ns);
+            void record_gpu_frame(double milliseconds);
+
+            TimeSummary get_cpu_frame_summary() const { return summarize(cpu_frame_ms); }
+            TimeSummary get_gpu_frame_summary() const { return summarize(gpu_frame_ms); }
+            const std::vector<double>& get_cpu_frame_times() const { return cpu_frame_ms; }
+            const std::vector<double>& get_gpu_frame_times() const { return gpu_frame_ms; }
+
+            /**
+             * Frame time percentiles plus the average time per frame of every zone. Reads the other threads' rings, so
+             * only call it while they're idle.
+             */
+            void print_summary(std::ostream& out);
+
+            /**
+             * Writes every event still in the rings as chrome://tracing / Perfetto JSON. Same caveat as print_summary.
+             */
+            void write_chrome_trace(const std::string& path);
+
+        private:
+            struct ThreadEvents {
+                std::thread::id thread_id;
+                uint32_t thread_index;
+                std::string name;
+                std::vector<ZoneEvent> events;
+                std::atomic<uint64_t> head;
+            };
+
+            std::atomic<bool> enabled;
+            uint64_t instance_id;
+            std::chrono::steady_clock::time_point epoch;
+
+            std::mutex threads_mutex;
+            std::vector<std::unique_ptr<ThreadEvents>> threads;
+
+            // GPU zones are only ever added from the thread that resolves the queries, so a plain ring does.
+            std::vector<ZoneEvent> gpu_events;
+            uint64_t gpu_event_count = 0;
+
+            bool frame_started     = false;
+            uint64_t last_frame_ns = 0;
+            std::vector<double> cpu_frame_ms;
+            std::vector<double> gpu_frame_ms;
+
+            ThreadEvents* get_thread_events();
+            std::vector<ZoneEvent> collect(const ThreadEvents& thread) const;
+    };
+
+    /**
+     * RAII zone, use it through PROFILE_ZONE so it disappears when the profiler is compiled out.
+     */
+    class ProfileZone {
+
+        public:
+            ProfileZone(Profiler& profiler, const char* name) : profiler(profiler), name(name),
+                active(profiler.is_enabled()) {
+                if (active) {
+                    start_ns = profiler.now_ns();
+                }
+            }
+
+            ProfileZone(Profiler* profiler, const char* name) : ProfileZone(*profiler, name) {}
+
+            ~ProfileZone() {
+                if (active) {
+                    profiler.record(name, start_ns, profiler.now_ns());
+                }
+            }
+
+            ProfileZone(const ProfileZone&) = delete;
+            ProfileZone& operator=(const ProfileZone&) = delete;
+
+        private:
+            Profiler& profiler;
+            const char* name;
+            bool active;
+            uint64_t start_ns = 0;
+    };
+
+    /**
+     * Timestamp queries around regions of a frame's cmd buffer. Every frame in flight has its own query pool, the
+     * results are read back the next time that frame slot comes around (its fence has signaled by then), so reading
+     * them never stalls. Vulkan 1.0 has no way to line the GPU clock up with the CPU one, so GPU zones are placed on the
+     * trace relative to when the frame started recording.
+     */
+    class GpuProfiler {
+
+        public:
+            static constexpr uint32_t MAX_ZONES = 32;
+
+            /**
+             * timestamp_valid_bits comes from the queue family the cmd buffers are submitted to, 0 means the queue
+             * doesn't support timestamps and every call becomes a no-op.
+             */
+            GpuProfiler(VkDevice device, Profiler* profiler, float timestamp_period, uint32_t timestamp_valid_bits,
+                uint32_t frame_count);
+            ~GpuProfiler();
+
+            GpuProfiler(const GpuProfiler&) = delete;
+            GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+            /**
+             * Resolves what the frame slot recorded last time and resets its queries. Has to be recorded outside of a
+             * render pass, before any zone of the frame.
+             */
+            void begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame);
+
+            uint32_t begin_zone(VkCommandBuffer cmd_buffer, const char* name);
+            void end_zone(VkCommandBuffer cmd_buffer, uint32_t zone);
+
+        private:
+            struct Zone {
+                const char* name;
+                uint32_t begin_query;
+                uint32_t end_query;
+            };
+
+            struct FrameQueries {
+                VkQueryPool pool = VK_NULL_HANDLE;
+                std::vector<Zone> zones;
+                uint32_t query_count  = 0;
+                uint64_t cpu_start_ns = 0;
+                bool active           = false;
+            };
+
+            VkDevice device;
+            Profiler* profiler;
+            double timestamp_period;
+            uint64_t timestamp_mask;
+            std::vector<FrameQueries> frames;
+            uint32_t current_frame = 0;
+
+            void resolve(FrameQueries& frame);
+    };
+}
+
+#endif
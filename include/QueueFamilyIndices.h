@@ -9,6 +9,9 @@ namespace vulkan_rendering {
         std::optional<uint32_t> graphics_family;
         std::optional<uint32_t> present_family;
 
+        // Only set when the device has a transfer capable family that's separate from graphics.
+        std::optional<uint32_t> transfer_family;
+
         bool is_complete() {
             return graphics_family.has_value();
         }
@@ -0,0 +1,313 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "DeviceAllocator.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * How a pass uses a resource. Each usage stands for the stages, accesses and, for images, the layout it needs, and
+     * for whether the pass reads what was there, writes over it, or both. Attachments are written from scratch (cleared
+     * or fully drawn over), the Load ones are for render passes that load what was there and draw on top.
+     */
+    enum class ResourceUsage {
+        None,
+        ColorAttachment,
+        ColorAttachmentLoad,
+        DepthAttachment,
+        DepthAttachmentLoad,
+        DepthRead,
+        FragmentSampled,
+        ComputeSampled,
+        ComputeRead,
+        ComputeWrite,
+        ComputeReadWrite,
+        IndirectRead,
+        VertexRead,
+        TransferSrc,
+        TransferDst,
+        HostRead,
+        Present
+    };
+
+    /**
+     * What an imported resource waits on when the graph starts. The default waits on nothing and has no contents worth
+     * keeping, an acquired swap chain image waits on COLOR_ATTACHMENT_OUTPUT, the stage its semaphore is waited at.
+     */
+    struct ResourceState {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access        = 0;
+        VkImageLayout layout        = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct ImageDesc {
+        VkFormat format               = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent             = {};
+        uint32_t mip_levels           = 1;
+        uint32_t array_layers         = 1;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    /**
+     * The only part of the graph that talks to the device, so graphs can be compiled and executed against a fake
+     * backend on the CPU. Same idea as DeviceMemoryBackend.
+     */
+    class RenderGraphBackend {
+
+        public:
+            virtual ~RenderGraphBackend() = default;
+
+            // The image is created without memory, the graph places it in one of its heaps and binds it.
+            virtual VkImage create_image(const VkImageCreateInfo& info, VkMemoryRequirements& requirements) = 0;
+            virtual VkImageView create_image_view(const VkImageViewCreateInfo& info) = 0;
+            virtual void destroy_image(VkImage image, VkImageView view) = 0;
+
+            virtual Allocation allocate(const VkMemoryRequirements& requirements) = 0;
+            virtual void free(Allocation& allocation) = 0;
+            virtual void bind_image(VkImage image, const Allocation& heap, VkDeviceSize offset) = 0;
+
+            virtual void pipeline_barrier(VkCommandBuffer cmd_buffer, VkPipelineStageFlags src_stages,
+                VkPipelineStageFlags dst_stages, const std::vector<VkBufferMemoryBarrier>& buffer_barriers,
+                const std::vector<VkImageMemoryBarrier>& image_barriers) = 0;
+    };
+
+    // Heaps are device local memory from the allocator, each one its own dedicated or sub allocated range.
+    class VulkanRenderGraphBackend : public RenderGraphBackend {
+
+        public:
+            VulkanRenderGraphBackend(VkDevice device, DeviceAllocator* allocator);
+
+            VkImage create_image(const VkImageCreateInfo& info, VkMemoryRequirements& requirements) override;
+            VkImageView create_image_view(const VkImageViewCreateInfo& info) override;
+            void destroy_image(VkImage image, VkImageView view) override;
+
+            Allocation allocate(const VkMemoryRequirements& requirements) override;
+            void free(Allocation& allocation) override;
+            void bind_image(VkImage image, const Allocation& heap, VkDeviceSize offset) override;
+
+            void pipeline_barrier(VkCommandBuffer cmd_buffer, VkPipelineStageFlags src_stages,
+                VkPipelineStageFlags dst_stages, const std::vector<VkBufferMemoryBarrier>& buffer_barriers,
+                const std::vector<VkImageMemoryBarrier>& image_barriers) override;
+
+        private:
+            VkDevice device;
+            DeviceAllocator* allocator;
+    };
+
+    struct RenderGraphStats {
+        uint32_t pass_count    = 0;
+        uint32_t culled_passes = 0;
+
+        // Per execute. barriers counts the image and buffer barriers, barrier_calls the vkCmdPipelineBarrier they
+        // were batched into.
+        uint32_t barriers      = 0;
+        uint32_t barrier_calls = 0;
+
+        uint32_t transient_images    = 0;
+        uint32_t heap_count          = 0;
+        VkDeviceSize transient_bytes = 0; // What the transient images would take with memory of their own
+        VkDeviceSize heap_bytes      = 0; // What they take aliased
+
+        uint64_t compiles = 0;
+    };
+
+    /**
+     * A frame as a list of passes, each declaring the resources it uses and how. Compiling it:
+     *
+     * - culls every pass whose results nobody uses. Results count when they're read by a pass that isn't culled, end
+     * up in an imported resource with a final usage, or come from a pass with side effects.
+     * - gives the transient images memory. Images whose lifetimes (first to last pass that uses them) don't overlap
+     * share memory, each one is placed at the lowest offset of a heap that's free for its whole lifetime.
+     * - works out every barrier: layout transitions, writes made visible to later reads and writes held back until
+     * earlier reads and writes are done. The first use of a transient image also waits on whatever used its memory
+     * last, in this frame or the one before.
+     * - batches the barriers. Each barrier goes right before the pass that needs it, all of a pass's barriers go in
+     * one vkCmdPipelineBarrier, and a barrier moves to an earlier call between its producer and that pass when both
+     * wait on the same stages, so nothing ends up waiting on more than it would have.
+     *
+     * Passes run in the order they're added, which has to be an order that works: a pass reads what the passes before
+     * it wrote. Compiling is keyed by a hash of the declarations, so declaring the same graph again and compiling it
+     * only costs the hash. Images and buffers that come from outside are set before every execute, they aren't part of
+     * the key. Not thread safe.
+     */
+    class RenderGraph {
+
+        public:
+            static constexpr uint32_t INVALID_RESOURCE = UINT32_MAX;
+
+            explicit RenderGraph(RenderGraphBackend* backend);
+            ~RenderGraph();
+
+            RenderGraph(const RenderGraph&) = delete;
+            RenderGraph& operator=(const RenderGraph&) = delete;
+
+            // Drops the declarations, the compiled graph stays until compile() sees a different one.
+            void reset();
+
+            uint32_t create_image(const std::string& name, const ImageDesc& desc);
+
+            /**
+             * final_usage is where the resource has to be once the graph is done, e.g. Present for a swap chain image.
+             * None means nothing after the graph cares about its contents, so passes that only write it get culled.
+             */
+            uint32_t import_image(const std::string& name, const ImageDesc& desc, const ResourceState& initial,
+                ResourceUsage final_usage);
+            uint32_t import_buffer(const std::string& name, const ResourceState& initial, ResourceUsage final_usage);
+
+            uint32_t add_pass(const std::string& name, std::function<void(VkCommandBuffer)> execute);
+
+            // A pass may use a resource more than once, e.g. as indirect commands and as vertices, as long as the
+            // layouts agree.
+            void use(uint32_t pass, uint32_t resource, ResourceUsage usage);
+
+            // Never culled, e.g. a readback the host looks at without the graph knowing.
+            void set_side_effects(uint32_t pass);
+
+            /**
+             * Throws if a pass uses a resource in a way it can't be used, or reads a transient image nothing wrote.
+             * Transient images of the graph compiled before are destroyed once reclaim() is told that every frame up
+             * to retire_frame is done, frame_number + 1 while frames recorded with them may still be in flight.
+             */
+            void compile(uint64_t retire_frame);
+            void reclaim(uint64_t completed_frames);
+
+            void set_image(uint32_t resource, VkImage image);
+            void set_buffer(uint32_t resource, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+
+            // Records the barriers and the passes that weren't culled, in order.
+            void execute(VkCommandBuffer cmd_buffer);
+
+            VkImage get_image(uint32_t resource) const;
+            VkImageView get_image_view(uint32_t resource) const;
+            bool is_culled(uint32_t pass) const;
+
+            const RenderGraphStats& get_stats() const { return stats; }
+            void print_stats(std::ostream& out) const;
+
+        private:
+            struct PassUse {
+                uint32_t resource;
+                ResourceUsage usage;
+            };
+
+            struct Pass {
+                std::string name;
+                std::function<void(VkCommandBuffer)> execute;
+                std::vector<PassUse> uses;
+                bool side_effects = false;
+            };
+
+            struct Resource {
+                std::string name;
+                bool image    = false;
+                bool imported = false;
+                ImageDesc desc;
+                ResourceState initial;
+                ResourceUsage final_usage = ResourceUsage::None;
+            };
+
+            // Where a resource is bound, set per execute for imported ones. Buffers use offset and size.
+            struct Binding {
+                VkImage image       = VK_NULL_HANDLE;
+                VkImageView view    = VK_NULL_HANDLE;
+                VkBuffer buffer     = VK_NULL_HANDLE;
+                VkDeviceSize offset = 0;
+                VkDeviceSize size   = 0;
+                bool owned          = false; // A transient image the graph created
+            };
+
+            // Every use of one resource in one pass, merged.
+            struct Access {
+                uint32_t resource;
+                VkPipelineStageFlags stages;
+                VkAccessFlags access;
+                VkImageLayout layout;
+                VkImageUsageFlags image_usage;
+                bool reads;
+                bool writes;
+            };
+
+            // Positions are indices into order, the first and last pass that uses a transient image.
+            struct Lifetime {
+                uint32_t first                    = UINT32_MAX;
+                uint32_t last                     = 0;
+                VkPipelineStageFlags last_stages  = 0;
+                VkAccessFlags last_access         = 0;
+                VkImageUsageFlags usage           = 0;
+                VkMemoryRequirements requirements = {};
+                uint32_t heap                     = UINT32_MAX;
+                VkDeviceSize offset               = 0;
+            };
+
+            struct Barrier {
+                uint32_t resource;
+                VkPipelineStageFlags src_stages;
+                VkPipelineStageFlags dst_stages;
+                VkAccessFlags src_access;
+                VkAccessFlags dst_access;
+                VkImageLayout old_layout;
+                VkImageLayout new_layout;
+
+                // The positions it can be recorded before, order.size() is after the last pass.
+                uint32_t earliest;
+                uint32_t latest;
+            };
+
+            struct BarrierBatch {
+                uint32_t position;
+                VkPipelineStageFlags src_stages = 0;
+                VkPipelineStageFlags dst_stages = 0;
+                std::vector<Barrier> barriers;
+            };
+
+            // Transient images and heaps of a graph that got compiled over, see compile().
+            struct RetiredMemory {
+                std::vector<Binding> images;
+                std::vector<Allocation> heaps;
+                uint64_t retire_frame;
+            };
+
+            RenderGraphBackend* backend;
+            std::vector<Pass> passes;
+            std::vector<Resource> resources;
+
+            uint64_t compiled_key = 0;
+            bool compiled         = false;
+
+            // The compiled graph. bindings and lifetimes are indexed by resource, accesses and culled by pass.
+            std::vector<Binding> bindings;
+            std::vector<Lifetime> lifetimes;
+            std::vector<std::vector<Access>> accesses;
+            std::vector<char> culled;
+
+            // The passes that weren't culled in the order they run, and the barriers recorded between them.
+            std::vector<uint32_t> order;
+            std::vector<BarrierBatch> batches;
+            std::vector<Allocation> heaps;
+            std::deque<RetiredMemory> retired;
+            RenderGraphStats stats;
+
+            // Reused by every execute.
+            std::vector<VkBufferMemoryBarrier> buffer_barriers;
+            std::vector<VkImageMemoryBarrier> image_barriers;
+
+            uint64_t get_key() const;
+            void merge_accesses();
+            void cull_passes();
+            void find_lifetimes();
+            void retire(uint64_t retire_frame);
+            void place_images();
+            void place_barriers();
+            void batch_barriers(std::vector<Barrier>& pending);
+            void record_batch(VkCommandBuffer cmd_buffer, const BarrierBatch& batch);
+    };
+}
+
+#endif
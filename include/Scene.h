@@ -0,0 +1,89 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "Vertex.h"
+#include <cstdint>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Where one mesh lives in the scene's shared vertex and index buffers. Indices are relative to the mesh's first
+     * vertex and get vertex_offset added by vkCmdDrawIndexed, that way 16 bit indices still work with many meshes.
+     * first_index counts in the mesh's own index type.
+     */
+    struct MeshRange {
+        uint32_t first_index;
+        uint32_t index_count;
+        int32_t vertex_offset;
+        VkIndexType index_type;
+    };
+
+    /**
+     * A mesh's bounds in its own space. The sphere's xyz is the centre and w the radius, the box is the one the sphere
+     * is centred on.
+     */
+    struct MeshBounds {
+        glm::vec4 sphere;
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct SceneGeometry {
+        std::vector<Vertex> vertices;
+        std::vector<uint16_t> indices;
+        std::vector<MeshRange> meshes;
+
+        uint32_t get_triangle_count(uint32_t mesh) const { return meshes[mesh].index_count / 3; }
+    };
+
+    /**
+     * The single quad from Vertex.h.
+     */
+    SceneGeometry make_quad_scene();
+
+    /**
+     * mesh_count grids of triangles_per_mesh triangles each. Every mesh gets its own jittered vertices and colours, but
+     * the same arguments always produce the same geometry so benchmark runs stay comparable.
+     */
+    SceneGeometry make_procedural_scene(uint32_t mesh_count, uint32_t triangles_per_mesh);
+
+    struct GeometrySource {
+        const void* data;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    /**
+     * Lays meshes out back to back in one vertex and one index buffer without copying them. Only pointers are kept, so
+     * whatever owns the data has to outlive the upload. Every mesh's indices start 4 byte aligned, that way 16 and 32
+     * bit meshes can share the index buffer.
+     */
+    class SceneLayout {
+
+        public:
+            void add_mesh(const Vertex* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count,
+                VkIndexType index_type);
+            void add_scene(const SceneGeometry& scene);
+
+            const std::vector<MeshRange>& get_meshes() const { return meshes; }
+            const std::vector<GeometrySource>& get_vertex_sources() const { return vertex_sources; }
+            const std::vector<GeometrySource>& get_index_sources() const { return index_sources; }
+            VkDeviceSize get_vertex_bytes() const { return vertex_bytes; }
+            VkDeviceSize get_index_bytes() const { return index_bytes; }
+
+            uint32_t get_triangle_count(uint32_t mesh) const { return meshes[mesh].index_count / 3; }
+
+            const std::vector<MeshBounds>& get_bounds() const { return bounds; }
+
+        private:
+            std::vector<MeshRange> meshes;
+            std::vector<MeshBounds> bounds;
+            std::vector<GeometrySource> vertex_sources;
+            std::vector<GeometrySource> index_sources;
+            VkDeviceSize vertex_bytes = 0;
+            VkDeviceSize index_bytes  = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include "AssetPack.h"
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    struct ShaderCompilerStats {
+        uint64_t compiled   = 0;
+        uint64_t cache_hits = 0;
+
+        // Time spent in shaderc, cache hits don't add to it.
+        double compile_seconds = 0.0;
+    };
+
+    /**
+     * Compiles the GLSL in source_dir to SPIR-V at runtime with shaderc. The stage comes from the extension (.vert,
+     * .frag or .comp). #include "file" is resolved relative to the including file and #include <file> relative to
+     * source_dir, both are expanded here before shaderc sees the source, and every shader compiled gets the defines
+     * given on construction, "NAME" or "NAME=VALUE".
+     *
+     * The SPIR-V is cached in cache_dir under a hash of the expanded source, the stage and the defines, so a warm start
+     * only reads and hashes the sources. Built without ENABLE_SHADERC, is_available() is false and a cache miss throws.
+     */
+    class ShaderCompiler {
+
+        public:
+            ShaderCompiler(const std::string& source_dir, const std::string& cache_dir,
+                const std::vector<std::string>& defines);
+            ~ShaderCompiler();
+
+            ShaderCompiler(const ShaderCompiler&) = delete;
+            ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+            static bool is_available();
+
+            /**
+             * name is relative to source_dir. The SPIR-V goes into storage and the view points at it. Throws with the
+             * compiler's messages if the shader doesn't compile, their #line source numbers index the files listed.
+             */
+            AssetView compile(const std::string& name, std::vector<char>& storage);
+
+            /**
+             * The shaders compiled so far that are, or include, any of the files. Files are matched by their lexically
+             * normal path, the same way includes are resolved.
+             */
+            std::vector<std::string> get_dependents(const std::vector<std::string>& files) const;
+
+            // Every directory a compiled shader read a file from, for the ShaderWatcher.
+            std::vector<std::string> get_directories() const;
+
+            const ShaderCompilerStats& get_stats() const { return stats; }
+            void print_stats(std::ostream& out) const;
+
+        private:
+            static constexpr uint32_t MAX_INCLUDE_DEPTH = 32;
+
+            // Bump when anything that changes the output without changing the key does, e.g. the compile options.
+            static constexpr uint32_t CACHE_VERSION = 1;
+
+            std::string source_dir;
+            std::string cache_dir;
+            std::vector<std::string> defines;
+
+            // The files each shader was expanded from, the shader itself first.
+            std::unordered_map<std::string, std::vector<std::string>> dependencies;
+            ShaderCompilerStats stats;
+
+            // shaderc_compiler_t, kept opaque so shaderc's header isn't needed to include this one.
+            void* compiler = nullptr;
+
+            void expand(const std::string& path, std::vector<std::string>& files, std::string& source,
+                uint32_t depth) const;
+            bool read_cache(uint64_t key, std::vector<char>& storage) const;
+            void write_cache(uint64_t key, const std::vector<char>& spirv) const;
+            void run_compiler(const std::string& name, const std::string& source, const std::vector<std::string>& files,
+                std::vector<char>& storage);
+    };
+
+    /**
+     * Reports the files written or moved into the watched directories with inotify, without blocking. Editors that
+     * save by renaming a temporary file over the original show up too. Only Linux has it, everywhere else poll() never
+     * reports anything.
+     */
+    class ShaderWatcher {
+
+        public:
+            ShaderWatcher();
+            ~ShaderWatcher();
+
+            ShaderWatcher(const ShaderWatcher&) = delete;
+            ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+            // Watching the same directory twice does nothing.
+            void watch(const std::string& directory);
+
+            // Paths of the files that changed since the last poll, each one once.
+            std::vector<std::string> poll();
+
+        private:
+            int fd = -1;
+            std::unordered_map<int, std::string> directories;
+    };
+}
+
+#endif
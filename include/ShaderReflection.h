@@ -0,0 +1,109 @@
+#ifndef SHADER_REFLECTION_H
+#define SHADER_REFLECTION_H
+
+#include "AssetPack.h"
+#include "VertexLayout.h"
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    struct ReflectedBinding {
+        uint32_t set;
+
+        // descriptorCount is 0 for a runtime array, the CPU side decides how big it gets.
+        VkDescriptorSetLayoutBinding binding;
+    };
+
+    // A matrix or array input takes a location per column or element, each gets its own entry.
+    struct ReflectedInput {
+        uint32_t location;
+        VkFormat format;
+    };
+
+    /**
+     * The CPU side of a pipeline layout: the bindings of every set the app writes and binds, and the push constant
+     * ranges it pushes. PipelineReflection checks shaders against it.
+     */
+    struct ShaderInterface {
+        std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+        std::vector<VkPushConstantRange> push_constants;
+    };
+
+    /**
+     * Reads what a SPIR-V module declares straight from its words: the stage of its first entry point, the descriptors
+     * it reads with their set and binding, the size of its push constant block and the locations and formats of its
+     * vertex inputs. Dynamic buffers can't be told apart from plain ones in SPIR-V, they come out as the plain type.
+     * Throws if the module isn't SPIR-V or uses a type it can't describe.
+     */
+    class ShaderReflection {
+
+        public:
+            explicit ShaderReflection(const AssetView& code);
+
+            VkShaderStageFlagBits get_stage() const { return stage; }
+            const std::vector<ReflectedBinding>& get_bindings() const { return bindings; }
+
+            // Size 0 when the module has no push constant block.
+            const VkPushConstantRange& get_push_constants() const { return push_constants; }
+
+            // Only vertex shaders have any, sorted by location.
+            const std::vector<ReflectedInput>& get_inputs() const { return inputs; }
+
+        private:
+            VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+            std::vector<ReflectedBinding> bindings;
+            VkPushConstantRange push_constants = {};
+            std::vector<ReflectedInput> inputs;
+    };
+
+    /**
+     * What every stage of a pipeline reads, merged. A binding read by several stages gets all of them in its stage
+     * flags, and add() throws when two stages disagree about a binding's type or count.
+     *
+     * The layouts themselves are still up to the CPU side, which knows what it writes and which buffers it binds with
+     * a dynamic offset. check() makes sure a ShaderInterface has everything the shaders read, and narrow_stages() trims
+     * its stage flags down to the stages that actually read each binding.
+     */
+    class PipelineReflection {
+
+        public:
+            void add(const ShaderReflection& shader);
+
+            uint32_t get_set_count() const;
+
+            // Sorted by binding.
+            std::vector<VkDescriptorSetLayoutBinding> get_bindings(uint32_t set) const;
+
+            // Empty or a single range over every stage's push constants.
+            std::vector<VkPushConstantRange> get_push_constant_ranges() const;
+
+            const std::vector<ReflectedInput>& get_inputs() const { return inputs; }
+
+            /**
+             * Throws with the first mismatch: a set or binding the interface doesn't have, a descriptor type or
+             * count that doesn't fit, a stage missing from a binding's or push constant range's stage flags, or push
+             * constants the ranges don't cover.
+             */
+            void check(const ShaderInterface& shader_interface) const;
+
+            /**
+             * Throws unless every input location has an attribute, with a format of the same numeric type (float,
+             * signed or unsigned). The component counts may differ, missing components read as 0 (and w as 1).
+             */
+            void check_vertex_input(const VertexInput& input) const;
+
+            // Each binding of the set a shader reads gets just the stages that read it, the others are left alone.
+            void narrow_stages(uint32_t set, std::vector<VkDescriptorSetLayoutBinding>& bindings) const;
+
+        private:
+            std::vector<ReflectedBinding> bindings;
+            std::vector<VkPushConstantRange> push_constants;
+            std::vector<ReflectedInput> inputs;
+
+            const VkDescriptorSetLayoutBinding* find(uint32_t set, uint32_t binding) const;
+    };
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vulkan_rendering {
+
+    /**
+     * The handful of vector ops the SIMD kernels need. The instruction set is picked at compile time: AVX2 when the
+     * compiler targets it (ENABLE_AVX2), SSE2 on any other x86-64 build and none at all everywhere else, in which case
+     * SIMD_AVX2 and SIMD_SSE2 are both left undefined and only ScalarSimd exists.
+     */
+#if defined(SIMD_AVX2)
+    struct Simd {
+        typedef __m256 Float;
+        static const uint32_t WIDTH = 8;
+
+        static Float load(const float* data) { return _mm256_loadu_ps(data); }
+        static void store(float* data, Float a) { _mm256_storeu_ps(data, a); }
+        static Float set(float value) { return _mm256_set1_ps(value); }
+        static Float zero() { return _mm256_setzero_ps(); }
+        static Float all() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+        static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Float greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static Float greater_equal(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static Float both(Float a, Float b) { return _mm256_and_ps(a, b); }
+        static uint32_t mask(Float a) { return static_cast<uint32_t>(_mm256_movemask_ps(a)); }
+    };
+#elif defined(SIMD_SSE2)
+    struct Simd {
+        typedef __m128 Float;
+        static const uint32_t WIDTH = 4;
+
+        static Float load(const float* data) { return _mm_loadu_ps(data); }
+        static void store(float* data, Float a) { _mm_storeu_ps(data, a); }
+        static Float set(float value) { return _mm_set1_ps(value); }
+        static Float zero() { return _mm_setzero_ps(); }
+        static Float all() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Float greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+        static Float greater_equal(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static Float both(Float a, Float b) { return _mm_and_ps(a, b); }
+        static uint32_t mask(Float a) { return static_cast<uint32_t>(_mm_movemask_ps(a)); }
+    };
+#endif
+
+    /**
+     * Same interface with a single lane, for kernels written as templates over the ops. Does the same arithmetic in the
+     * same order, so the scalar fallback gives exactly what the vector version does.
+     */
+    struct ScalarSimd {
+        typedef float Float;
+        static const uint32_t WIDTH = 1;
+
+        static Float load(const float* data) { return *data; }
+        static void store(float* data, Float a) { *data = a; }
+        static Float set(float value) { return value; }
+        static Float zero() { return 0.0f; }
+        static Float add(Float a, Float b) { return a + b; }
+        static Float sub(Float a, Float b) { return a - b; }
+        static Float mul(Float a, Float b) { return a * b; }
+    };
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef STAGING_UPLOADER_H
+#define STAGING_UPLOADER_H
+
+#include "DeviceAllocator.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    struct UploadStats {
+        uint64_t bytes_uploaded = 0;
+        uint64_t copy_count     = 0;
+        uint64_t batch_count    = 0;
+
+        // Time the CPU spent blocked waiting for ring space or for a batch to finish.
+        double stall_seconds = 0.0;
+
+        // Wall time during which at least one batch was in flight.
+        double busy_seconds = 0.0;
+
+        double throughput_mb_per_second() const {
+            return busy_seconds > 0.0 ? (bytes_uploaded / (1024.0 * 1024.0)) / busy_seconds : 0.0;
+        }
+    };
+
+    /**
+     * Owns one persistently mapped staging buffer that's used as a ring. Uploads are memcpy'd into the ring straight
+     * away and the copy is queued. flush() records every queued copy into a single cmd buffer, submits it and hands back
+     * a ticket, the fence of that batch tells us when its part of the ring can be reused. Nothing waits for the queue to
+     * go idle, the CPU only blocks when the ring is full or a caller explicitly waits on a ticket.
+     */
+    class StagingUploader {
+
+        public:
+            static constexpr VkDeviceSize DEFAULT_RING_SIZE = 16ull * 1024 * 1024;
+
+            StagingUploader(VkDevice device, DeviceAllocator* allocator, uint32_t queue_family, VkQueue queue,
+                VkDeviceSize ring_size = DEFAULT_RING_SIZE);
+            ~StagingUploader();
+
+            StagingUploader(const StagingUploader&) = delete;
+            StagingUploader& operator=(const StagingUploader&) = delete;
+
+            /**
+             * Copies size bytes from data into the ring and queues a copy into dst. Returns the ticket of the batch the
+             * copy will be part of. Uploads larger than the ring are split up and may flush on their own.
+             */
+            uint64_t upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+            /**
+             * Same for one whole mip of an image, data holds its rows of blocks row_pitch bytes apart. The mip's old
+             * contents are discarded and it ends up in SHADER_READ_ONLY_OPTIMAL once the ticket is complete. Mips
+             * larger than half the ring are split into bands of block rows.
+             */
+            uint64_t upload_image(VkImage dst, uint32_t mip, uint32_t width, uint32_t height, uint32_t block_height,
+                VkDeviceSize row_pitch, const void* data);
+
+            /**
+             * Submits everything queued so far as one batch. Returns the ticket of the last batch submitted.
+             */
+            uint64_t flush();
+
+            bool is_complete(uint64_t ticket);
+            void wait(uint64_t ticket);
+            void wait_idle();
+
+            const UploadStats& get_stats() const { return stats; }
+            void print_stats(std::ostream& out) const;
+
+        private:
+            typedef std::chrono::high_resolution_clock clock;
+
+            static constexpr uint32_t BATCH_COUNT        = 8;
+            static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+            struct PendingCopy {
+                VkBuffer dst;
+                VkBufferCopy region;
+            };
+
+            // first is set on a mip's first band, the one that may drop its old contents.
+            struct PendingImageCopy {
+                VkImage dst;
+                VkBufferImageCopy region;
+                bool first;
+            };
+
+            struct Batch {
+                VkCommandBuffer cmd_buffer = VK_NULL_HANDLE;
+                VkFence fence              = VK_NULL_HANDLE;
+                uint64_t ticket            = 0;
+                VkDeviceSize ring_end      = 0;
+                clock::time_point submit_time;
+            };
+
+            VkDevice device;
+            DeviceAllocator* allocator;
+            VkQueue queue;
+            VkCommandPool command_pool;
+
+            VkBuffer ring_buffer;
+            Allocation ring_allocation;
+            VkDeviceSize ring_size;
+            VkDeviceSize ring_head = 0;
+            VkDeviceSize ring_tail = 0;
+
+            std::vector<PendingCopy> pending_copies;
+            std::vector<PendingImageCopy> pending_image_copies;
+            std::vector<Batch> batches;
+            std::deque<uint32_t> in_flight;
+            std::vector<uint32_t> idle_batches;
+
+            uint64_t next_ticket      = 1;
+            uint64_t completed_ticket = 0;
+            clock::time_point last_completion;
+
+            UploadStats stats;
+
+            bool ring_empty() const;
+            bool try_reserve(VkDeviceSize size, VkDeviceSize& offset);
+            VkDeviceSize reserve(VkDeviceSize size);
+            void retire_completed();
+            void retire_oldest();
+            void retire(uint32_t batch);
+            void record_image_copies(VkCommandBuffer cmd_buffer);
+    };
+}
+
+#endif
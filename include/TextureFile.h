@@ -0,0 +1,126 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * How a format packs its texels. Block compressed formats store 4x4 texel blocks, everything else is a 1x1 block of
+     * one texel. A size of 0 means the format isn't supported.
+     */
+    struct FormatBlock {
+        uint32_t width;
+        uint32_t height;
+        uint32_t size;
+    };
+
+    FormatBlock get_format_block(VkFormat format);
+
+    // On disk layout of the start of a KTX2 file, little endian. The level index follows right after.
+    struct Ktx2Header {
+        char identifier[12];
+        uint32_t vk_format;
+        uint32_t type_size;
+        uint32_t pixel_width;
+        uint32_t pixel_height;
+        uint32_t pixel_depth;
+        uint32_t layer_count;
+        uint32_t face_count;
+        uint32_t level_count;
+        uint32_t supercompression_scheme;
+        uint32_t dfd_byte_offset;
+        uint32_t dfd_byte_length;
+        uint32_t kvd_byte_offset;
+        uint32_t kvd_byte_length;
+        uint64_t sgd_byte_offset;
+        uint64_t sgd_byte_length;
+    };
+
+    struct Ktx2Level {
+        uint64_t byte_offset;
+        uint64_t byte_length;
+        uint64_t uncompressed_byte_length;
+    };
+
+    // DDS_HEADER with its DDS_PIXELFORMAT, right after the "DDS " magic.
+    struct DdsHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitch_or_linear_size;
+        uint32_t depth;
+        uint32_t mip_map_count;
+        uint32_t reserved1[11];
+        uint32_t format_size;
+        uint32_t format_flags;
+        uint32_t four_cc;
+        uint32_t rgb_bit_count;
+        uint32_t r_mask;
+        uint32_t g_mask;
+        uint32_t b_mask;
+        uint32_t a_mask;
+        uint32_t caps;
+        uint32_t caps2;
+        uint32_t caps3;
+        uint32_t caps4;
+        uint32_t reserved2;
+    };
+
+    // DDS_HEADER_DXT10, follows DdsHeader when its four_cc is "DX10".
+    struct DdsHeaderDx10 {
+        uint32_t dxgi_format;
+        uint32_t resource_dimension;
+        uint32_t misc_flag;
+        uint32_t array_size;
+        uint32_t misc_flags2;
+    };
+
+    struct TextureLevel {
+        const char* data;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+
+        // Bytes per row of blocks, the level is rows of these one after the other.
+        uint64_t row_pitch;
+    };
+
+    /**
+     * A 2D texture with its precomputed mips, read from a KTX2 or DDS file (picked by the magic, not the extension). The
+     * file stays mapped and the levels point into it, so streaming a mip in is a memcpy from the mapping into staging
+     * memory. Level 0 is the full size one. Only what can be copied to an image as is gets accepted: no cube maps,
+     * arrays or volumes and no KTX2 supercompression, anything else throws.
+     */
+    class TextureFile {
+
+        public:
+            explicit TextureFile(const std::string& path);
+
+            TextureFile(const TextureFile&) = delete;
+            TextureFile& operator=(const TextureFile&) = delete;
+
+            VkFormat get_format() const { return format; }
+            uint32_t get_width() const { return levels[0].width; }
+            uint32_t get_height() const { return levels[0].height; }
+            uint32_t get_mip_count() const { return static_cast<uint32_t>(levels.size()); }
+            const TextureLevel& get_level(uint32_t mip) const { return levels[mip]; }
+            const std::string& get_path() const { return file.get_path(); }
+
+        private:
+            MappedFile file;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            std::vector<TextureLevel> levels;
+
+            void parse_ktx2();
+            void parse_dds();
+            void add_level(uint64_t offset, uint64_t size, uint32_t width, uint32_t height);
+    };
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "BindlessHeap.h"
+#include "DeviceAllocator.h"
+#include "StagingUploader.h"
+#include "TextureFile.h"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    struct TextureStats {
+        // Bytes of every live texture image against the budget, peak_bytes is the most there ever were.
+        VkDeviceSize resident_bytes = 0;
+        VkDeviceSize peak_bytes     = 0;
+        VkDeviceSize budget_bytes   = 0;
+
+        uint64_t uploaded_levels = 0;
+        uint64_t uploaded_bytes  = 0;
+
+        // Levels a growing texture took over from its previous image on the GPU instead of reading them again.
+        uint64_t copied_levels = 0;
+
+        // Textures that lost their detail image to make room, and how many levels they lost with it.
+        uint64_t evictions      = 0;
+        uint64_t evicted_levels = 0;
+
+        // From load() to the mip tail being drawable and to level 0 being resident for the first time.
+        uint64_t tail_loads       = 0;
+        double tail_seconds_total = 0.0;
+        double tail_seconds_max   = 0.0;
+        uint64_t full_loads       = 0;
+        double full_seconds_total = 0.0;
+        double full_seconds_max   = 0.0;
+    };
+
+    /**
+     * Streams textures from KTX2 and DDS files into device local images under a budget. Every texture is two images:
+     * its mip tail, the levels of TAIL_SIZE and smaller, which is uploaded at load and stays until we quit, and a
+     * detail image holding every level from the finest one streamed in so far down. The view handed out is the detail
+     * image's when there is one, otherwise the tail's.
+     *
+     * Vulkan 1.0 can't free part of an image, so a texture grows by creating a new detail image one level finer than
+     * the last. Only that new level is read from the mapped file and goes through the uploader, the coarser ones are
+     * already on the GPU and get copied over from the current image with vkCmdCopyImage. That copy changes the layout
+     * of an image earlier frames may still be sampling, so it's recorded into the frame's cmd buffer by record() rather
+     * than on the uploader's queue. The new image is swapped in once its ticket is complete and the frame holding its
+     * copy is done. When a new image doesn't fit the budget, the textures that weren't requested this frame lose their
+     * detail image in least recently used order and fall back to their tail. Replaced and evicted images are destroyed
+     * once the frames that may still sample them are done.
+     *
+     * Not thread safe, request(), update() and record() are meant to be called from the thread recording the frame.
+     */
+    class TextureStreamer {
+
+        public:
+            // Levels whose larger side is at most this many texels make up the always resident mip tail.
+            static const uint32_t TAIL_SIZE = 64;
+
+            // Bytes of new levels update() starts uploading per call, at least one image always goes.
+            static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 8ull * 1024 * 1024;
+
+            static const uint32_t NO_HANDLE = UINT32_MAX;
+
+            /**
+             * The images are shared concurrently between queue_families when there's more than one, the uploader may
+             * submit on a different family than the one that samples them. With a bindless heap every texture's view
+             * gets a handle in it, which moves whenever the view does.
+             */
+            TextureStreamer(VkPhysicalDevice physical_device, VkDevice device, DeviceAllocator* allocator,
+                StagingUploader* uploader, const std::vector<uint32_t>& queue_families, VkDeviceSize budget,
+                BindlessHeap* bindless_heap = nullptr, VkDeviceSize upload_budget = DEFAULT_UPLOAD_BUDGET);
+            ~TextureStreamer();
+
+            TextureStreamer(const TextureStreamer&) = delete;
+            TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+            // Maps the file and starts uploading its mip tail. Throws if the device can't sample its format.
+            uint32_t load(const std::string& path);
+
+            // The texture gets drawn this frame and wants mip and everything below it, the finest request wins.
+            void request(uint32_t texture, uint32_t mip, uint64_t frame);
+
+            /**
+             * Call once per frame before recording it. Destroys the images every frame up to completed_frames was done
+             * with, swaps in the uploads that finished and starts the next ones for what was requested this frame.
+             */
+            void update(uint64_t frame, uint64_t completed_frames);
+
+            /**
+             * Records the copies of the levels the images update() started already have, on the graphics queue
+             * before anything samples the textures. Call once per frame after update(), outside of a render pass.
+             */
+            void record(VkCommandBuffer cmd_buffer, uint64_t frame);
+
+            uint32_t get_texture_count() const { return static_cast<uint32_t>(textures.size()); }
+            const TextureFile& get_file(uint32_t texture) const { return *textures[texture].file; }
+
+            // VK_NULL_HANDLE (and NO_HANDLE) until the mip tail is uploaded.
+            VkImageView get_view(uint32_t texture) const;
+            uint32_t get_handle(uint32_t texture) const { return textures[texture].handle; }
+
+            // The finest level the view has, in the file's levels.
+            uint32_t get_resident_mip(uint32_t texture) const;
+
+            const TextureStats& get_stats() const { return stats; }
+            void print_stats(std::ostream& out) const;
+
+        private:
+            typedef std::chrono::high_resolution_clock clock;
+
+            // Levels first_mip to the file's last, image mip 0 is the file's first_mip.
+            struct TextureImage {
+                VkImage image    = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                Allocation allocation;
+                uint32_t first_mip = 0;
+            };
+
+            struct Texture {
+                std::unique_ptr<TextureFile> file;
+                TextureImage tail;
+                TextureImage detail;
+                TextureImage pending;
+                uint64_t tail_ticket    = 0;
+                uint64_t pending_ticket = 0;
+                bool tail_ready         = false;
+                uint32_t handle         = NO_HANDLE;
+
+                // The frame whose cmd buffer copies the pending image's coarser levels, UINT64_MAX until recorded.
+                uint64_t pending_copy_frame = UINT64_MAX;
+
+                // Finest mip requested in last_used, the frame it was last requested in.
+                uint32_t requested_mip = UINT32_MAX;
+                uint64_t last_used     = UINT64_MAX;
+
+                clock::time_point load_time;
+                bool reached_full = false;
+            };
+
+            struct RetiredImage {
+                TextureImage image;
+                uint64_t retire_frame;
+            };
+
+            VkPhysicalDevice physical_device;
+            VkDevice device;
+            DeviceAllocator* allocator;
+            StagingUploader* uploader;
+            std::vector<uint32_t> queue_families;
+            BindlessHeap* bindless_heap;
+            VkDeviceSize upload_budget;
+
+            std::vector<Texture> textures;
+            std::deque<RetiredImage> retired;
+
+            // Textures whose pending image still needs its coarser levels copied by record().
+            std::vector<uint32_t> queued_copies;
+            TextureStats stats;
+
+            TextureImage create_image(const TextureFile& file, uint32_t first_mip);
+            void bind_image(TextureImage& image, VkFormat format, const VkMemoryRequirements& mem_requirements);
+            uint64_t upload(const TextureFile& file, const TextureImage& image, uint32_t last_mip);
+            void destroy_image(TextureImage& image);
+            void retire(TextureImage& image, uint64_t frame);
+            void update_view(Texture& texture, uint64_t frame);
+            void complete_uploads(uint64_t frame, uint64_t completed_frames);
+            bool make_room(VkDeviceSize size, uint64_t frame);
+            uint32_t get_current_mip(const Texture& texture) const;
+    };
+}
+
+#endif
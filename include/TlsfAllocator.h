@@ -0,0 +1,86 @@
+#ifndef TLSF_ALLOCATOR_H
+#define TLSF_ALLOCATOR_H
+
+#include <cstdint>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Two Level Segregated Fit offset allocator. It doesn't own any memory, it just hands out [offset, offset + size)
+     * ranges within a fixed size region, so the same logic works for VkDeviceMemory blocks, staging rings or anything
+     * else we want to carve up. Allocation and free are O(1): free ranges are bucketed into a first level (power of two)
+     * and a second level (linear subdivision of that power of two) and two bitmaps tell us which buckets are non empty.
+     */
+    class TlsfAllocator {
+
+        public:
+            static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+            struct Range {
+                uint64_t offset = 0;
+                uint64_t size   = 0;
+                uint32_t node   = INVALID_NODE;
+            };
+
+            explicit TlsfAllocator(uint64_t capacity);
+
+            /**
+             * Returns false if there's no free range large enough. The alignment has to be a power of two.
+             */
+            bool allocate(uint64_t size, uint64_t alignment, Range& range);
+
+            /**
+             * Hands out the whole region as one range at offset 0, returns false unless nothing is allocated.
+             * allocate() can't do that, it searches for the size plus the worst case padding rounded up to the next
+             * bucket, which never fits in a region of exactly that size.
+             */
+            bool allocate_all(Range& range);
+
+            void free(uint32_t node);
+
+            uint64_t get_capacity() const { return capacity; }
+            uint64_t get_free_size() const { return free_size; }
+            uint64_t get_largest_free_range() const;
+            uint32_t get_allocation_count() const { return allocation_count; }
+            uint32_t get_free_range_count() const { return free_range_count; }
+            bool is_empty() const { return allocation_count == 0; }
+
+        private:
+            static constexpr uint32_t SL_LOG2  = 5;
+            static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+            static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+            struct Node {
+                uint64_t offset        = 0;
+                uint64_t size          = 0;
+                uint32_t prev_physical = INVALID_NODE;
+                uint32_t next_physical = INVALID_NODE;
+                uint32_t prev_free     = INVALID_NODE;
+                uint32_t next_free     = INVALID_NODE;
+                bool is_free           = false;
+            };
+
+            uint64_t capacity;
+            uint64_t free_size;
+            uint32_t allocation_count = 0;
+            uint32_t free_range_count = 0;
+
+            uint64_t fl_bitmap = 0;
+            uint32_t sl_bitmap[FL_COUNT] = {};
+            uint32_t free_lists[FL_COUNT][SL_COUNT];
+
+            std::vector<Node> nodes;
+            std::vector<uint32_t> recycled_nodes;
+
+            static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+            uint32_t find_free_node(uint64_t size) const;
+            uint32_t create_node(uint64_t offset, uint64_t size);
+            void release_node(uint32_t node);
+            void insert_free(uint32_t node);
+            void remove_free(uint32_t node);
+            uint32_t split(uint32_t node, uint64_t size);
+    };
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include "WorkerPool.h"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Parented transforms. Every node has a local position, rotation and scale relative to its parent and a world
+     * matrix that update() derives from them. Locals are stored as structure of arrays with one array per component,
+     * so a SIMD register's worth of nodes gets turned into matrices at once.
+     *
+     * Nodes are kept sorted by depth, and within a depth by parent, so parents always come before their children and
+     * the children of a run of neighbouring nodes are a run of neighbours themselves. update() goes one depth at a time,
+     * the runs of a depth are independent and get split between the workers, and the runs of the next depth are the
+     * children of the ones that just changed. Subtrees where nothing changed never get looked at, and a frame where
+     * nothing changed at all costs nothing.
+     *
+     * Handles are what add_node returns and stay the same when nodes get sorted. Like FrustumCuller the kernel is AVX2,
+     * SSE2 or scalar at compile time, or scalar when allow_simd is false.
+     */
+    class TransformHierarchy {
+
+        public:
+            static const uint32_t NO_PARENT = UINT32_MAX;
+
+            // Nodes handed out to a worker at a time, depths with fewer nodes to update than this stay on one thread.
+            static const uint32_t BATCH_SIZE = 1024;
+
+            explicit TransformHierarchy(bool allow_simd = true);
+
+            /**
+             * parent has to be a node that already exists, or NO_PARENT for a root, so there's no way to make a cycle.
+             * Adding nodes resorts the whole hierarchy on the next update(), build it up front.
+             */
+            uint32_t add_node(uint32_t parent, const glm::vec3& position = glm::vec3(0.0f),
+                const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+            // Only take effect on update(), not thread safe.
+            void set_position(uint32_t node, const glm::vec3& position);
+            void set_rotation(uint32_t node, const glm::quat& rotation);
+            void set_scale(uint32_t node, const glm::vec3& scale);
+
+            /**
+             * Recomputes the world matrix of every node that changed since the last update and of everything below
+             * them, returns how many that was.
+             */
+            uint32_t update(WorkerPool& pool);
+
+            // As of the last update(). Matrices of nodes with the same parent added one after the other are contiguous.
+            const glm::mat4& get_world(uint32_t node) const { return world[slots[node]]; }
+
+            uint32_t get_node_count() const { return static_cast<uint32_t>(slots.size()); }
+            uint32_t get_depth() const { return static_cast<uint32_t>(depth_begin.size()); }
+
+            // "avx2", "sse2" or "scalar".
+            const char* get_simd_name() const;
+
+        private:
+            struct Range {
+                uint32_t begin;
+                uint32_t end;
+            };
+
+            bool allow_simd;
+            bool sorted = true;
+
+            // Everything below is indexed by slot, the node's place in depth order, except slots which maps handles to
+            // slots. The locals are padded to a multiple of 8 so a SIMD batch never reads past the end.
+            std::vector<float> position_x;
+            std::vector<float> position_y;
+            std::vector<float> position_z;
+            std::vector<float> rotation_x;
+            std::vector<float> rotation_y;
+            std::vector<float> rotation_z;
+            std::vector<float> rotation_w;
+            std::vector<float> scale_x;
+            std::vector<float> scale_y;
+            std::vector<float> scale_z;
+            std::vector<glm::mat4> world;
+
+            std::vector<uint32_t> parents;
+            std::vector<uint32_t> depths;
+            std::vector<uint32_t> child_begin;
+            std::vector<uint32_t> child_end;
+            std::vector<uint32_t> handles;
+            std::vector<uint32_t> slots;
+
+            // The slot every depth starts at.
+            std::vector<uint32_t> depth_begin;
+
+            std::vector<char> dirty;
+            std::vector<uint32_t> dirty_slots;
+            std::vector<std::vector<Range>> pending;
+            std::vector<Range> batches;
+
+            void sort_nodes();
+            void mark_dirty(uint32_t slot);
+            void update_ranges(std::vector<Range>& ranges, WorkerPool& pool);
+
+            template <typename Ops>
+            void update_slots(uint32_t begin, uint32_t end);
+    };
+}
+
+#endif
@@ -2,12 +2,38 @@
 #define TRIANGLE_APP_H
 #define GLFW_INCLUDE_VULKAN
 
+#include "AppConfig.h"
+#include "AssetPack.h"
+#include "BindlessHeap.h"
+#include "Bvh.h"
+#include "DescriptorAllocator.h"
+#include "DeviceAllocator.h"
 #include "ExtensionValidation.h"
+#include "Frustum.h"
+#include "FrustumCuller.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
 #include "QueueFamilyIndices.h"
+#include "RenderGraph.h"
+#include "Scene.h"
+#include "ShaderCompiler.h"
+#include "ShaderReflection.h"
+#include "StagingUploader.h"
 #include "SwapChainSupportDetails.h"
+#include "TextureStreamer.h"
+#include "TransformHierarchy.h"
+#include "UniformBufferObject.h"
+#include "UniformRing.h"
+#include "VertexLayout.h"
+#include "WorkerPool.h"
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -18,13 +44,20 @@ namespace vulkan_rendering {
         public:
             bool frame_buffer_resized_flag = false;
 
-            TriangleApp();
+            TriangleApp(const AppConfig& config = AppConfig());
             void run();
+            void on_frame_buffer_resized();
+
+            // What the last run() drew and measured, vk-bench reports these.
+            const Profiler& get_profiler() const { return *profiler; }
+            const std::string& get_device_name() const { return device_name; }
+            uint64_t get_culled_frames() const { return culling_stats.frames; }
+            double get_visible_per_frame() const;
+            uint32_t get_draws_per_frame() const;
+            uint64_t get_triangles_per_frame() const;
 
         private:
             // Constants
-            const int WIDTH  = 800;
-            const int HEIGHT = 600;
             const std::vector<const char*> validation_layers = { "VK_LAYER_KHRONOS_validation" };
             const std::vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
             const int max_frames_per_flight = 2;
@@ -35,6 +68,8 @@ namespace vulkan_rendering {
             const bool enable_validation_layers = true;
 #endif
 
+            AppConfig config;
+
             // Ext validation
             ExtensionValidation ext_validation;
 
@@ -44,47 +79,281 @@ namespace vulkan_rendering {
             VkDebugUtilsMessengerEXT debug_messenger;
             VkPhysicalDevice physical_device = VK_NULL_HANDLE;
             VkDevice device;
+            std::unique_ptr<VulkanMemoryBackend> memory_backend;
+            std::unique_ptr<DeviceAllocator> allocator;
+            std::unique_ptr<StagingUploader> uploader;
+            uint64_t geometry_upload_ticket = 0;
+            QueueFamilyIndices queue_families;
             VkQueue graphics_queue;
+            VkQueue transfer_queue;
             VkSurfaceKHR surface;
             VkQueue present_queue;
-            VkSwapchainKHR swap_chain;
+            VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
             std::vector<VkImage> swap_chain_images;
             VkFormat swap_chain_image_format;
             VkExtent2D swap_chain_extent;
             std::vector<VkImageView> swap_chain_image_views;
             VkDescriptorSetLayout descriptor_set_layout; // newly added
             VkPipelineLayout pipeline_layout;
+
+            // What the app binds and pushes, every graphics pipeline's shaders get checked against it.
+            ShaderInterface graphics_interface;
             VkRenderPass render_pass;
+            // What pipeline compatibility depends on, see PipelineHasher::add_render_pass.
+            std::vector<unsigned char> render_pass_state;
+            std::unique_ptr<PipelineCache> pipeline_cache;
+
+            // Only when GLSL gets compiled at runtime, see create_shader_compiler. The watcher is --hot-reload's.
+            std::unique_ptr<ShaderCompiler> shader_compiler;
+            std::unique_ptr<ShaderWatcher> shader_watcher;
             VkPipeline graphics_pipeline;
+            VkPipeline depth_pipeline = VK_NULL_HANDLE;
             std::vector<VkFramebuffer> swap_chain_frame_buffers;
-            VkCommandPool command_pool;
-            std::vector<VkCommandBuffer> command_buffers;
+
+            // Only with --depth-prepass, the depth buffer itself belongs to the render graph.
+            VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+            // Which shaders the mode we run in draws with, depth is the prepass's.
+            struct GraphicsShaders {
+                const char* vertex;
+                const char* depth;
+                const char* fragment;
+            };
+
+            /**
+             * Swap chain objects replaced by a resize. Frames submitted before the resize may still render into them, so
+             * they're destroyed once every frame before retire_frame has finished.
+             */
+            struct RetiredSwapChain {
+                VkSwapchainKHR swap_chain;
+                std::vector<VkImageView> image_views;
+                std::vector<VkFramebuffer> frame_buffers;
+                uint64_t retire_frame;
+            };
+            std::deque<RetiredSwapChain> retired_swap_chains;
+
+            // Resize to present latency, from the first resize event to the first frame presented afterwards.
+            std::chrono::high_resolution_clock::time_point resize_start;
+            bool resize_pending         = false;
+            uint32_t resize_count       = 0;
+            double resize_total_seconds = 0.0;
+            double resize_max_seconds   = 0.0;
+
+            /**
+             * Cmd pools and buffers of one frame in flight. Each worker records into its own pool, so no two threads ever
+             * touch the same pool. With the depth prepass every worker also records its draws into a depth secondary,
+             * all of those are executed before any of the colour ones. With --per-draw-sets every worker allocates its
+             * sets from its own descriptors, which get reset with its pool.
+             */
+            struct FrameCommands {
+                VkCommandPool primary_pool;
+                VkCommandBuffer primary;
+                std::vector<VkCommandPool> worker_pools;
+                std::vector<VkCommandBuffer> secondaries;
+                std::vector<VkCommandBuffer> depth_secondaries;
+                std::vector<std::unique_ptr<DescriptorAllocator>> worker_descriptors;
+            };
+            std::vector<FrameCommands> frame_commands;
+            std::unique_ptr<WorkerPool> worker_pool;
+            double recording_seconds = 0.0;
+
+            std::unique_ptr<Profiler> profiler;
+            std::unique_ptr<GpuProfiler> gpu_profiler;
+
+            /**
+             * Where this frame's per object uniforms live in the ring. Object i is written at mapped + i * stride and
+             * bound with the dynamic offset base + i * stride.
+             */
+            struct ObjectUniforms {
+                UniformBufferObject camera;
+                float time;
+                char* mapped;
+                uint32_t base;
+                VkDeviceSize stride;
+
+                // Instanced path only, this frame's slice of instance_ring holding every dynamic instance.
+                char* instances;
+                VkDeviceSize instance_offset;
+
+                // Bindless path only, this frame's region of bindless_ring. Instance i of the frame reads transform i.
+                char* transforms;
+            };
+
+            /**
+             * The frame as a render graph, see create_render_graph. The swap chain image and with --gpu-culling this
+             * frame's regions of the culling buffers are imported and set every frame, the depth buffer is one of the
+             * graph's transient images. The passes record from graph_frame, which record_command_buffer fills in
+             * right before it executes the graph.
+             */
+            struct GraphFrame {
+                uint32_t img_index;
+                const ObjectUniforms* uniforms;
+                std::vector<VkCommandBuffer> secondaries;
+            };
+
+            std::unique_ptr<RenderGraphBackend> render_graph_backend;
+            std::unique_ptr<RenderGraph> render_graph;
+            uint32_t color_target    = RenderGraph::INVALID_RESOURCE;
+            uint32_t depth_target    = RenderGraph::INVALID_RESOURCE;
+            uint32_t culling_target  = RenderGraph::INVALID_RESOURCE;
+            uint32_t readback_target = RenderGraph::INVALID_RESOURCE;
+            GraphFrame graph_frame;
+
+            /**
+             * Every object that draws the same mesh, drawn by the instanced path with up to two vkCmdDrawIndexed: one
+             * for the objects below uniform_update_count, whose transforms are written to instance_ring every frame,
+             * and one for the rest, whose transforms were uploaded to instance_buffer once. first is counted in
+             * instances within either buffer.
+             */
+            struct InstanceBatch {
+                uint32_t mesh;
+                uint32_t dynamic_first;
+                uint32_t dynamic_count;
+                uint32_t static_first;
+                uint32_t static_count;
+            };
 
             std::vector<VkSemaphore> img_available_semaphores;
             std::vector<VkSemaphore> render_finished_semaphores;
             std::vector<VkFence> flight_fences;
             size_t current_frame = 0;
             VkBuffer vertex_buffer;
-            VkDeviceMemory vertex_buffer_memory;
+            Allocation vertex_buffer_allocation;
+
+            // Where each of vertex_format's streams starts in the vertex buffer, stream i is bound at binding i.
+            std::vector<VkDeviceSize> vertex_stream_offsets;
             VkBuffer index_buffer;
-            VkDeviceMemory index_buffer_memory;
-            VkDescriptorPool descriptor_pool;
+            Allocation index_buffer_allocation;
+            SceneLayout scene;
+            const VertexFormat* vertex_format = nullptr;
+
+            // Whichever of these the scene came from, SceneLayout only points into them.
+            SceneGeometry generated_scene;
+            std::vector<ImportedMesh> imported_meshes;
+
+            // Set with --assets, meshes loaded from it are uploaded straight out of the mapping.
+            std::unique_ptr<AssetPack> asset_pack;
+
+            // Node 0 is the whole grid, object i is node i + 1. transform_updates sums the nodes recomputed every frame.
+            std::unique_ptr<TransformHierarchy> transforms;
+            uint64_t transform_updates = 0;
+
+            /**
+             * --cpu-culling, visible_objects holds the objects that passed this frame's cull. They're in ascending order
+             * from the culler, --bvh-culling uses the BVH instead and leaves them in tree order.
+             */
+            std::unique_ptr<FrustumCuller> culler;
+            std::unique_ptr<Bvh> bvh;
+            std::vector<uint32_t> visible_objects;
+
+            // --instancing, see InstanceBatch. dynamic_instance_objects[i] is the object of dynamic instance i.
+            std::vector<InstanceBatch> instance_batches;
+            std::vector<uint32_t> dynamic_instance_objects;
+            VkBuffer instance_buffer = VK_NULL_HANDLE;
+            Allocation instance_buffer_allocation;
+            std::unique_ptr<UniformRing> instance_ring;
+
+            /**
+             * --gpu-culling, see record_culling. cull.comp appends a draw for every visible object to one of two lists
+             * since meshes with 16 and 32 bit indices can't share an indirect draw. Every frame in flight has its own
+             * region of culling_output with the two counts, the commands and the transforms the draws read. Offsets are
+             * within a region and aligned to minStorageBufferOffsetAlignment.
+             */
+            struct CullingLayout {
+                VkDeviceSize counts;
+                VkDeviceSize commands;
+                VkDeviceSize instances;
+                VkDeviceSize frame_size;
+            };
+
+            // Visible and culled objects summed over every frame culled so far, on the GPU or with --cpu-culling.
+            struct CullingStats {
+                uint64_t frames  = 0;
+                uint64_t visible = 0;
+                uint64_t culled  = 0;
+            };
+
+            // Bindings of cull.comp's set, only the dynamic transforms move within their buffer from frame to frame.
+            static const uint32_t CULLING_BINDING_COUNT   = 7;
+            static const uint32_t CULLING_DYNAMIC_BINDING = 3;
+
+            CullingLayout culling_layout;
+            CullingStats culling_stats;
+            uint32_t culling_list_first[2] = {};
+            uint32_t culling_list_size[2]  = {};
+            VkBuffer culling_mesh_buffer;
+            Allocation culling_mesh_allocation;
+            VkBuffer culling_object_buffer;
+            Allocation culling_object_allocation;
+            VkBuffer culling_transform_buffer;
+            Allocation culling_transform_allocation;
+            VkBuffer culling_output;
+            Allocation culling_output_allocation;
+            VkBuffer culling_readback;
+            Allocation culling_readback_allocation;
+            std::vector<char> culling_readback_pending;
+            std::unique_ptr<UniformRing> culling_ring;
+            VkDescriptorSetLayout culling_set_layout;
+            VkPipelineLayout culling_pipeline_layout;
+            ShaderInterface culling_interface;
+            VkPipeline culling_pipeline = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> culling_sets;
+
+            // Only set when the device has VK_KHR_draw_indirect_count, otherwise every slot gets drawn and culled ones
+            // are left zeroed.
+            PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = nullptr;
+            std::string device_name;
+
+            /**
+             * Layouts are cached by their bindings, the sets that live until we quit come from descriptor_allocator and
+             * every layout has a template its sets get written with. descriptor_update_templates is set when the device
+             * has VK_KHR_descriptor_update_template, without it the templates write with vkUpdateDescriptorSets.
+             */
+            std::unique_ptr<DescriptorLayoutCache> layout_cache;
+            std::unique_ptr<DescriptorAllocator> descriptor_allocator;
+            std::unique_ptr<DescriptorTemplate> uniform_template;
+            std::unique_ptr<DescriptorTemplate> culling_template;
+            bool descriptor_update_templates = false;
+            std::vector<VkDescriptorSet> descriptor_sets;
+
+            /**
+             * --bindless, see record_bindless. Every frame in flight has a region of bindless_ring for the transforms
+             * its draws read, added to the heap once as bindless_transforms[frame]. The heap's sizes are clamped to the
+             * device's update after bind limits by create_logical_device, bindless_draws sums the colour pass draws.
+             */
+            std::unique_ptr<BindlessHeap> bindless_heap;
+            std::unique_ptr<UniformRing> bindless_ring;
+            std::vector<uint32_t> bindless_transforms;
+            uint32_t bindless_buffer_count = BindlessHeap::DEFAULT_BUFFER_COUNT;
+            uint32_t bindless_image_count  = BindlessHeap::DEFAULT_IMAGE_COUNT;
+            uint64_t bindless_draws        = 0;
+
+            // --texture, see stream_textures.
+            std::unique_ptr<TextureStreamer> texture_streamer;
+
+            /**
+             * In headless mode the swap_chain_images are images we own, so we need to hold onto their memory too.
+             */
+            std::vector<Allocation> offscreen_images_allocations;
+            uint64_t frame_number = 0;
 
             /**
-             * The whole point of this is to support what happens if we have multiple frames in flight. While we can use 
-             * use a staging buffer, we're going to be updating the buffer every frame. So the approach is to store
-             * multiple buffers at the same time. If we had one buffer, we dont want to change the buffer while another 
-             * frame is still reading it, so we "queue" up these frames.
+             * The whole point of this is to support what happens if we have multiple frames in flight. We're going to be
+             * updating the uniforms every frame, and we dont want to change them while another frame is still reading
+             * them, so the ring keeps a separate region for every frame in flight.
              */
-            std::vector<VkBuffer> uniform_buffers;
-            std::vector<VkDeviceMemory> uniform_buffers_memory;
+            std::unique_ptr<UniformRing> uniform_ring;
 
             // Functions
+            void load_scene();
             void init_window();
             void init_vulkan();
             void main_loop();
+            void print_stats(double seconds);
             void cleanup();
             void cleanup_swap_chain();
+            void destroy_retired_swap_chains(uint64_t completed_frames);
+            void cleanup_offscreen_images();
 
             // Vulkan
             void create_instance();
@@ -100,39 +369,86 @@ namespace vulkan_rendering {
             bool is_device_suitable(VkPhysicalDevice device);
             QueueFamilyIndices find_queue_families(VkPhysicalDevice device);
             void create_logical_device();
+            void create_allocator();
+            void create_pipeline_cache();
+            void create_shader_compiler();
+            void create_uploader();
+            void create_textures();
+            void create_gpu_profiler();
             void create_surface();
+            std::vector<const char*> get_device_extensions();
             bool check_device_extension_support(VkPhysicalDevice device);
             SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device);
             VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
             VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes);
             VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
             void create_swap_chain();
+            void create_offscreen_images();
             void create_image_views();
+            VkFormat choose_depth_format();
+            void create_render_graph();
             void create_graphics_pipeline();
-            VkShaderModule create_shader_module(const std::vector<char>& code);
+            GraphicsShaders get_graphics_shaders() const;
+            VkPipeline create_pipeline(const char* vertex_shader, const char* fragment_shader, uint32_t stream_mask,
+                const VkPipelineDepthStencilStateCreateInfo* depth_stencil);
+            void create_pipeline_layout();
+            void create_culling_pipeline();
+            void reload_shaders();
+            AssetView load_shader(const std::string& name, std::vector<char>& storage);
+            PipelineReflection reflect_shaders(const std::vector<const char*>& names);
+            VkShaderModule create_shader_module(const AssetView& code);
             void create_render_pass();
             void create_frame_buffers();
-            void create_command_pool();
+            void create_command_pools();
             void create_command_buffers();
+            void record_command_buffer(uint32_t img_index);
+            void record_forward_pass(VkCommandBuffer cmd_buffer);
+            void begin_secondary(VkCommandBuffer cmd_buffer, uint32_t img_index, bool depth_pass);
+            void record_objects(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+                const ObjectUniforms& uniforms, bool depth_pass, DescriptorAllocator* descriptors);
+            uint32_t record_bindless(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+                const ObjectUniforms& uniforms, bool depth_pass);
+            void write_instances(const ObjectUniforms& uniforms);
+            void record_instances(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+                const ObjectUniforms& uniforms, bool depth_pass);
+            void record_culling_clear(VkCommandBuffer cmd_buffer);
+            void record_culling(VkCommandBuffer cmd_buffer, const ObjectUniforms& uniforms);
+            void record_culling_readback(VkCommandBuffer cmd_buffer);
+            void record_indirect(VkCommandBuffer cmd_buffer, uint32_t img_index, const ObjectUniforms& uniforms,
+                bool depth_pass);
+            void read_culling_stats();
 
             // Let the drawing begin!
             void draw_frame();
+            void draw_offscreen_frame();
             void create_sync_objects();
             void recreate_swap_chain();
+            void create_geometry_buffers();
             void create_vertex_buffer();
-            uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags props);
+            void create_geometry_buffer(const std::vector<GeometrySource>& sources, VkDeviceSize size,
+                VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& allocation);
 
             void create_buffer(VkDeviceSize size, VkBufferUsageFlags flags, VkMemoryPropertyFlags props, 
-                VkBuffer& buffer, VkDeviceMemory& buffer_mem);
-            void copy_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+                VkBuffer& buffer, Allocation& allocation);
+            void destroy_buffer(VkBuffer buffer, Allocation& allocation);
 
             void create_index_buffer();
+            void create_instance_buffers();
+            void create_culling_buffers();
             void create_descriptor_set_layout();
+            void create_culling_set_layout();
             void create_uniform_buffers();
-            void update_uniform_buffer(uint32_t current_img);
+            void create_culler();
+            void cull_objects(const ObjectUniforms& uniforms);
+            void stream_textures(const ObjectUniforms& uniforms);
+            ObjectUniforms update_uniform_buffer();
+            void create_transforms();
+            void update_transforms(float time);
+            const glm::mat4& get_object_transform(uint32_t object) const { return transforms->get_world(object + 1); }
 
             void create_descriptor_pool();
             void create_descriptor_sets();
+            void create_culling_sets();
     };
 }
 
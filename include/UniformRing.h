@@ -0,0 +1,80 @@
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include "DeviceAllocator.h"
+#include <cstdint>
+#include <iostream>
+#include <vulkan/vulkan.h>
+
+namespace vulkan_rendering {
+
+    /**
+     * One host coherent uniform buffer split into a region per frame in flight. The buffer stays mapped for its whole
+     * life, so writing uniforms is a bump allocation plus a memcpy. push() hands back the offset within the current
+     * frame's region which is meant to be passed as the dynamic offset of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+     * binding, that way one descriptor set per frame covers every object drawn in it. With VERTEX_BUFFER usage the same
+     * ring holds per frame instance data, the offsets are then bound with vkCmdBindVertexBuffers instead.
+     */
+    class UniformRing {
+
+        public:
+            static constexpr VkDeviceSize DEFAULT_FRAME_SIZE = 1024 * 1024;
+
+            UniformRing(VkDevice device, DeviceAllocator* allocator, VkDeviceSize min_alignment, uint32_t frame_count,
+                VkDeviceSize frame_size = DEFAULT_FRAME_SIZE,
+                VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+            ~UniformRing();
+
+            UniformRing(const UniformRing&) = delete;
+            UniformRing& operator=(const UniformRing&) = delete;
+
+            /**
+             * Rewinds the region of the given frame. Only call this once the fence of that frame has signaled, the GPU
+             * may still be reading from it otherwise.
+             */
+            void begin_frame(uint32_t frame);
+
+            /**
+             * Copies size bytes into the current frame's region and returns the dynamic offset to bind it with.
+             */
+            uint32_t push(const void* data, VkDeviceSize size);
+
+            template <typename T>
+            uint32_t push(const T& data) {
+                return push(&data, sizeof(T));
+            }
+
+            /**
+             * Reserves count elements of size bytes each, every one of them at an aligned offset. Returns the dynamic
+             * offset of the first element and points mapped at its memory, element i lives at i * get_stride(size).
+             * Meant for filling the uniforms from several threads at once, push() isn't thread safe.
+             */
+            uint32_t reserve(VkDeviceSize size, uint32_t count, char*& mapped);
+
+            VkDeviceSize get_stride(VkDeviceSize size) const { return (size + alignment - 1) / alignment * alignment; }
+
+            VkBuffer get_buffer() const { return buffer; }
+            VkDeviceSize get_frame_offset(uint32_t frame) const { return frame * frame_size; }
+            VkDeviceSize get_frame_size() const { return frame_size; }
+
+            void print_stats(std::ostream& out) const;
+
+        private:
+            VkDevice device;
+            DeviceAllocator* allocator;
+            VkBuffer buffer;
+            Allocation allocation;
+
+            VkDeviceSize alignment;
+            VkDeviceSize frame_size;
+            uint32_t frame_count;
+
+            uint32_t current_frame = 0;
+            VkDeviceSize head      = 0;
+
+            uint64_t push_count     = 0;
+            VkDeviceSize peak_usage = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "Vertex.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * How an attribute is stored in the vertex buffer. Everything but Octahedral16 is decoded by the vertex fetch, so
+     * the shader still declares plain floats. Octahedral16 packs a unit vector into two SNORM16s, the shader gets those
+     * as a vec2 and has to undo the mapping itself (see decode_octahedral in VertexLayout.cpp).
+     */
+    enum class AttributeFormat {
+        Float32x2,
+        Float32x3,
+        Float32x4,
+        Float16x2,
+        Float16x4,
+        Snorm16x2,
+        Snorm16x4,
+        Octahedral16,
+        Unorm8x4,
+        Unorm10x3_2
+    };
+
+    constexpr uint32_t get_format_size(AttributeFormat format) {
+        switch (format) {
+            case AttributeFormat::Float32x2: return 8;
+            case AttributeFormat::Float32x3: return 12;
+            case AttributeFormat::Float32x4: return 16;
+            case AttributeFormat::Float16x4: return 8;
+            case AttributeFormat::Snorm16x4: return 8;
+            default: return 4;
+        }
+    }
+
+    VkFormat get_vk_format(AttributeFormat format);
+
+    uint16_t float_to_half(float value);
+    float half_to_float(uint16_t value);
+
+    /**
+     * Missing components are filled with 0, except the fourth which is 1 so positions get w = 1 and colours are opaque.
+     * decode_attribute always writes 4 floats.
+     */
+    void encode_attribute(AttributeFormat format, const float* values, uint32_t component_count, uint8_t* out);
+    void decode_attribute(AttributeFormat format, const uint8_t* in, float* values);
+
+    template <typename T>
+    struct MemberTraits;
+
+    template <typename Source, typename Field>
+    struct MemberTraits<Field Source::*> {
+        typedef Source source_type;
+        typedef Field field_type;
+    };
+
+    /**
+     * One attribute: the shader location it's bound to, the member of the CPU side vertex it's read from and how it's
+     * stored on the GPU. E.g. VertexAttribute<0, &Vertex::pos, AttributeFormat::Float16x4>.
+     */
+    template <uint32_t Location, auto Member, AttributeFormat Format>
+    struct VertexAttribute {
+        typedef typename MemberTraits<decltype(Member)>::source_type source_type;
+        typedef typename MemberTraits<decltype(Member)>::field_type field_type;
+
+        static_assert(sizeof(field_type) % sizeof(float) == 0 && sizeof(field_type) <= 4 * sizeof(float),
+            "Vertex attributes have to be read from float vectors");
+
+        static constexpr uint32_t location        = Location;
+        static constexpr AttributeFormat format   = Format;
+        static constexpr uint32_t size            = get_format_size(Format);
+        static constexpr uint32_t component_count = sizeof(field_type) / sizeof(float);
+
+        static void encode(const source_type& vertex, uint8_t* out) {
+            float values[4];
+            memcpy(values, &(vertex.*Member), sizeof(field_type));
+            encode_attribute(Format, values, component_count, out);
+        }
+
+        static void decode(const uint8_t* in, source_type& vertex) {
+            float values[4];
+            decode_attribute(Format, in, values);
+            memcpy(&(vertex.*Member), values, sizeof(field_type));
+        }
+    };
+
+    template <uint32_t... Sizes>
+    constexpr std::array<uint32_t, sizeof...(Sizes)> get_attribute_offsets() {
+        std::array<uint32_t, sizeof...(Sizes)> offsets = {};
+        uint32_t sizes[] = { Sizes... };
+        uint32_t offset  = 0;
+        for (size_t i = 0; i < sizeof...(Sizes); i++) {
+            offsets[i] = offset;
+            offset += sizes[i];
+        }
+        return offsets;
+    }
+
+    /**
+     * A vertex buffer layout declared once as a list of VertexAttributes, the Vulkan descriptions and the CPU encoder
+     * are generated from it. Attributes are packed back to back in declaration order, every format is a multiple of 4
+     * bytes so they stay aligned. The shaders declare their inputs themselves, pipeline creation checks them against
+     * the attribute descriptions (see PipelineReflection::check_vertex_input).
+     *
+     * The binding description tells Vulkan the stride between vertices and whether the data moves to the next entry
+     * for every vertex (the default) or every instance. Each attribute description says which binding the attribute
+     * comes from, the location directive of the shader input it feeds and its format and offset within the vertex.
+     */
+    template <typename... Attributes>
+    class VertexLayout {
+
+        public:
+            typedef typename std::tuple_element<0, std::tuple<Attributes...>>::type::source_type source_type;
+
+            static constexpr uint32_t attribute_count = sizeof...(Attributes);
+            static constexpr uint32_t stride          = (Attributes::size + ...);
+            static constexpr std::array<uint32_t, sizeof...(Attributes)> offsets =
+                get_attribute_offsets<Attributes::size...>();
+
+            static VkVertexInputBindingDescription get_binding_description(uint32_t binding = 0,
+                VkVertexInputRate input_rate = VK_VERTEX_INPUT_RATE_VERTEX) {
+
+                VkVertexInputBindingDescription description = {};
+                description.binding                         = binding;
+                description.stride                          = stride;
+                description.inputRate                       = input_rate;
+                return description;
+            }
+
+            static std::array<VkVertexInputAttributeDescription, attribute_count> get_attribute_descriptions(
+                uint32_t binding = 0) {
+
+                std::array<VkVertexInputAttributeDescription, attribute_count> descriptions = {};
+                uint32_t locations[]      = { Attributes::location... };
+                AttributeFormat formats[] = { Attributes::format... };
+
+                for (uint32_t i = 0; i < attribute_count; i++) {
+                    descriptions[i].binding  = binding;
+                    descriptions[i].location = locations[i];
+                    descriptions[i].format   = get_vk_format(formats[i]);
+                    descriptions[i].offset   = offsets[i];
+                }
+                return descriptions;
+            }
+
+            static void encode(const source_type* vertices, uint32_t count, uint8_t* out) {
+                for (uint32_t i = 0; i < count; i++, out += stride) {
+                    encode_vertex(vertices[i], out, std::index_sequence_for<Attributes...>());
+                }
+            }
+
+            static void decode(const uint8_t* in, uint32_t count, source_type* vertices) {
+                for (uint32_t i = 0; i < count; i++, in += stride) {
+                    decode_vertex(in, vertices[i], std::index_sequence_for<Attributes...>());
+                }
+            }
+
+        private:
+            template <size_t... I>
+            static void encode_vertex(const source_type& vertex, uint8_t* out, std::index_sequence<I...>) {
+                (Attributes::encode(vertex, out + offsets[I]), ...);
+            }
+
+            template <size_t... I>
+            static void decode_vertex(const uint8_t* in, source_type& vertex, std::index_sequence<I...>) {
+                (Attributes::decode(in + offsets[I], vertex), ...);
+            }
+    };
+
+    /**
+     * The layouts the app's formats are built from, see get_vertex_format. FloatVertexLayout matches Vertex byte for
+     * byte, so the interleaved format gets uploaded as is. The others are single attribute streams: full float or
+     * half float positions (w = 1), full float or 8 bit colours.
+     */
+    typedef VertexLayout<
+        VertexAttribute<0, &Vertex::pos, AttributeFormat::Float32x3>,
+        VertexAttribute<1, &Vertex::colour, AttributeFormat::Float32x3>> FloatVertexLayout;
+
+    typedef VertexLayout<VertexAttribute<0, &Vertex::pos, AttributeFormat::Float32x3>> FloatPositionLayout;
+    typedef VertexLayout<VertexAttribute<1, &Vertex::colour, AttributeFormat::Float32x3>> FloatColourLayout;
+    typedef VertexLayout<VertexAttribute<0, &Vertex::pos, AttributeFormat::Float16x4>> CompactPositionLayout;
+    typedef VertexLayout<VertexAttribute<1, &Vertex::colour, AttributeFormat::Unorm8x4>> CompactColourLayout;
+
+    static_assert(FloatVertexLayout::stride == sizeof(Vertex) && FloatVertexLayout::offsets[1] == sizeof(glm::vec3),
+        "FloatVertexLayout has to match Vertex");
+    static_assert(CompactPositionLayout::stride + CompactColourLayout::stride == sizeof(Vertex) / 2,
+        "The compact streams should be half the size of Vertex");
+
+    /**
+     * Per instance data of the instanced path, read from its own binding at instance rate. The columns are the model
+     * matrix, so a glm::mat4 gets copied straight in. A mat4 input takes a location per column, 2 to 5 here.
+     */
+    struct InstanceData {
+        glm::vec4 column_0;
+        glm::vec4 column_1;
+        glm::vec4 column_2;
+        glm::vec4 column_3;
+    };
+
+    typedef VertexLayout<
+        VertexAttribute<2, &InstanceData::column_0, AttributeFormat::Float32x4>,
+        VertexAttribute<3, &InstanceData::column_1, AttributeFormat::Float32x4>,
+        VertexAttribute<4, &InstanceData::column_2, AttributeFormat::Float32x4>,
+        VertexAttribute<5, &InstanceData::column_3, AttributeFormat::Float32x4>> InstanceLayout;
+
+    static_assert(InstanceLayout::stride == sizeof(InstanceData) && sizeof(InstanceData) == sizeof(glm::mat4),
+        "InstanceLayout has to match glm::mat4");
+
+    struct QuantizationError {
+        float position = 0.0f;
+        float colour   = 0.0f;
+    };
+
+    /**
+     * One vertex buffer binding of a runtime format, stream i is bound at binding i. Each stream is stored as its own
+     * array in the vertex buffer, so a pass that only reads some of them only pulls those through the cache.
+     */
+    struct VertexStream {
+        uint32_t stride;
+        VkVertexInputBindingDescription binding;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        void (*encode)(const Vertex* vertices, uint32_t count, uint8_t* out);
+        void (*decode)(const uint8_t* in, uint32_t count, Vertex* vertices);
+    };
+
+    /**
+     * Stream masks, bit i picks stream i. Every format keeps the position in stream 0, so depth only passes ask for
+     * POSITION_STREAM and get by with the smallest stream.
+     */
+    const uint32_t POSITION_STREAM = 1u << 0;
+    const uint32_t ALL_STREAMS     = ~0u;
+
+    /**
+     * The bindings and attributes a pipeline sees, only the streams it asked for.
+     */
+    struct VertexInput {
+        std::vector<VkVertexInputBindingDescription> bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+    };
+
+    /**
+     * A set of streams picked at runtime. Only the pipelines and the upload need to know which one is in use.
+     */
+    struct VertexFormat {
+        const char* name;
+        bool matches_vertex;
+        std::vector<VertexStream> streams;
+
+        // Bytes per vertex over all streams.
+        uint32_t get_stride() const;
+
+        VertexInput get_vertex_input(uint32_t stream_mask) const;
+
+        /**
+         * Largest per component difference after a round trip through every stream.
+         */
+        QuantizationError measure_error(const Vertex* vertices, uint32_t count) const;
+    };
+
+    template <typename Layout>
+    VertexStream make_vertex_stream(uint32_t binding) {
+        static_assert(std::is_same<typename Layout::source_type, Vertex>::value, "Runtime formats encode Vertex");
+
+        auto attributes = Layout::get_attribute_descriptions(binding);
+
+        VertexStream stream;
+        stream.stride  = Layout::stride;
+        stream.binding = Layout::get_binding_description(binding);
+        stream.attributes.assign(attributes.begin(), attributes.end());
+        stream.encode  = &Layout::encode;
+        stream.decode  = &Layout::decode;
+        return stream;
+    }
+
+    /**
+     * The first layout becomes stream 0 and has to hold the position.
+     */
+    template <typename... Layouts>
+    VertexFormat make_vertex_format(const char* name) {
+        VertexFormat format;
+        format.name           = name;
+        format.matches_vertex = sizeof...(Layouts) == 1 && (std::is_same<Layouts, FloatVertexLayout>::value && ...);
+        (format.streams.push_back(make_vertex_stream<Layouts>(static_cast<uint32_t>(format.streams.size()))), ...);
+        return format;
+    }
+
+    /**
+     * "float" (separate position and colour streams), "compact" (the same, quantized) or "interleaved" (one stream
+     * that's just Vertex), throws for anything else.
+     */
+    const VertexFormat& get_vertex_format(const std::string& name);
+}
+
+#endif
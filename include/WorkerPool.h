@@ -0,0 +1,59 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vulkan_rendering {
+
+    /**
+     * Fixed set of threads that are kept alive for the whole run, spinning threads up every frame costs more than the
+     * work we'd hand them. Every task gets a stable worker index in [0, get_worker_count()), so per thread resources
+     * (e.g. cmd pools) can be indexed by it without any locking. The calling thread is always worker 0.
+     */
+    class WorkerPool {
+
+        public:
+            typedef std::function<void(uint32_t worker, uint32_t begin, uint32_t end)> RangeTask;
+
+            /**
+             * 0 picks one worker per hardware thread.
+             */
+            explicit WorkerPool(uint32_t worker_count = 0);
+            ~WorkerPool();
+
+            WorkerPool(const WorkerPool&) = delete;
+            WorkerPool& operator=(const WorkerPool&) = delete;
+
+            uint32_t get_worker_count() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+            /**
+             * Splits [0, count) into one contiguous range per worker and blocks until every range is done. Ranges are
+             * empty when there are fewer items than workers. The first exception thrown by a task is rethrown here.
+             */
+            void parallel_for(uint32_t count, const RangeTask& task);
+
+        private:
+            std::vector<std::thread> threads;
+            std::mutex mutex;
+            std::condition_variable start_condition;
+            std::condition_variable done_condition;
+
+            const RangeTask* task = nullptr;
+            uint32_t count        = 0;
+            uint64_t generation   = 0;
+            uint32_t pending      = 0;
+            bool stopping         = false;
+            std::exception_ptr error;
+
+            void run(uint32_t worker);
+            void execute(uint32_t worker);
+    };
+}
+
+#endif
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Bindless path, see BindlessHeap. Every storage buffer in the heap is in one array and the push constants pick this
+// frame's transforms out of it. A draw covers a run of objects, gl_InstanceIndex starts at the run's firstInstance.
+
+layout(set = 0, binding = 0) readonly buffer Transforms {
+    mat4 models[];
+} buffers[];
+
+layout(push_constant) uniform Bindless {
+    mat4 view_proj;
+    uint transforms;
+} bindless;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+
+// The depth prepass has to come out with exactly the same depth, see bindless_depth.vert.
+invariant gl_Position;
+
+void main() {
+    mat4 model  = buffers[bindless.transforms].models[gl_InstanceIndex];
+    gl_Position = bindless.view_proj * model * vec4(inPosition, 0.0, 1.0);
+    fragColor   = inColor;
+}
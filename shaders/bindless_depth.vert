@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Depth prepass of the bindless path, see depth.vert. gl_Position has to match bindless.vert exactly, so both declare
+// it invariant.
+
+layout(set = 0, binding = 0) readonly buffer Transforms {
+    mat4 models[];
+} buffers[];
+
+layout(push_constant) uniform Bindless {
+    mat4 view_proj;
+    uint transforms;
+} bindless;
+
+layout(location = 0) in vec2 inPosition;
+
+invariant gl_Position;
+
+void main() {
+    mat4 model  = buffers[bindless.transforms].models[gl_InstanceIndex];
+    gl_Position = bindless.view_proj * model * vec4(inPosition, 0.0, 1.0);
+}
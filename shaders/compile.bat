@@ -1,3 +1,17 @@
-C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V shader.vert
-C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V shader.frag
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 shader.vert -o vert.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 vert.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 shader.frag -o frag.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 frag.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 depth.vert -o depth.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 depth.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 instanced.vert -o instanced.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 instanced.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 instanced_depth.vert -o instanced_depth.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 instanced_depth.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 cull.comp -o cull.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 cull.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 bindless.vert -o bindless.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 bindless.spv
+C:/VulkanSDK/1.1.101.0/Bin32/glslangValidator.exe -V --target-env vulkan1.0 bindless_depth.vert -o bindless_depth.spv
+C:/VulkanSDK/1.1.101.0/Bin32/spirv-val.exe --target-env vulkan1.0 bindless_depth.spv
 pause
@@ -2,5 +2,17 @@
 
 vulkan_sdk=$VULKAN_SDK
 
-$vulkan_sdk/bin/glslangValidator -V shader.vert
-$vulkan_sdk/bin/glslangValidator -V shader.frag
+# Same as add_shader in CMakeLists.txt: built for Vulkan 1.0 and validated, a shader spirv-val rejects stops the script.
+compile() {
+    $vulkan_sdk/bin/glslangValidator -V --target-env vulkan1.0 $1 -o $2 || exit 1
+    $vulkan_sdk/bin/spirv-val --target-env vulkan1.0 $2 || { rm -f $2; exit 1; }
+}
+
+compile shader.vert vert.spv
+compile shader.frag frag.spv
+compile depth.vert depth.spv
+compile instanced.vert instanced.spv
+compile instanced_depth.vert instanced_depth.spv
+compile cull.comp cull.spv
+compile bindless.vert bindless.spv
+compile bindless_depth.vert bindless_depth.spv
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth prepass, only the position stream is bound. gl_Position has to come out exactly like it does in shader.vert
+// since the colour pass tests for equal depth. Both declare it invariant, without that GLSL doesn't promise the same
+// result from two separately compiled shaders even when the expressions are the same.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inPosition;
+
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Instanced path, every instance reads its model matrix from the instance rate binding. Only the camera comes from the
+// uniform buffer, its model is unused.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in mat4 inModel;
+
+layout(location = 0) out vec3 fragColor;
+
+// The depth prepass has to come out with exactly the same depth, see instanced_depth.vert.
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 0.0, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth prepass of the instanced path, see depth.vert. gl_Position has to match instanced.vert exactly, so both declare
+// it invariant.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 2) in mat4 inModel;
+
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 0.0, 1.0);
+}
@@ -1,12 +1,23 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Per object path, every draw binds its own object's uniforms with a dynamic offset.
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
+// The depth prepass has to come out with exactly the same depth, see depth.vert.
+invariant gl_Position;
+
 void main() {
-    gl_Position = vec4(inPosition, 0.0, 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
     fragColor = inColor;
 }
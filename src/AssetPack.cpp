@@ -0,0 +1,266 @@
+#include "../include/AssetPack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    static_assert(sizeof(AssetPackHeader) == 40, "AssetPackHeader is part of the file format");
+    static_assert(sizeof(AssetEntry) == 40, "AssetEntry is part of the file format");
+    static_assert(sizeof(MeshAssetHeader) == 32, "MeshAssetHeader is part of the file format");
+
+    uint64_t hash_asset_name(const char* name, size_t length) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(name[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash != 0 ? hash : 1;
+    }
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    AssetPack::AssetPack(const std::string& path) : file(path), data(file.get_data()), size(file.get_size()) {
+        header = reinterpret_cast<const AssetPackHeader*>(data);
+        bool table_fits = size >= sizeof(AssetPackHeader) && header->table_size > 0 &&
+            (header->table_size & (header->table_size - 1)) == 0 &&
+            header->table_offset + static_cast<uint64_t>(header->table_size) * sizeof(AssetEntry) <= size &&
+            header->names_offset <= size;
+
+        if (size < sizeof(AssetPackHeader) || memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header->version != VERSION || header->file_size != size || !table_fits) {
+            throw std::runtime_error("Asset pack is corrupt or from another version! " + path);
+        }
+
+        table = reinterpret_cast<const AssetEntry*>(data + header->table_offset);
+    }
+
+    const AssetEntry* AssetPack::find(const std::string& name) const {
+        uint64_t hash = hash_asset_name(name.data(), name.size());
+        uint32_t mask = header->table_size - 1;
+
+        // The writer keeps the table at most half full, the probe limit only matters for a corrupt file.
+        for (uint32_t probe = 0; probe < header->table_size; probe++) {
+            const AssetEntry& entry = table[(static_cast<uint32_t>(hash) + probe) & mask];
+            if (entry.name_hash == 0) {
+                break;
+            }
+
+            if (entry.name_hash == hash && entry.name_length == name.size() &&
+                header->names_offset + entry.name_offset + entry.name_length <= size &&
+                memcmp(data + header->names_offset + entry.name_offset, name.data(), name.size()) == 0) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    AssetView AssetPack::get(const AssetEntry& entry) const {
+        if (entry.offset + entry.size > size) {
+            throw std::runtime_error("Asset points past the end of the pack! " + file.get_path());
+        }
+
+        AssetView view;
+        view.data = data + entry.offset;
+        view.size = entry.size;
+        return view;
+    }
+
+    AssetView AssetPack::get(const std::string& name) const {
+        const AssetEntry* entry = find(name);
+        if (entry == nullptr) {
+            throw std::runtime_error("Failed to find asset " + name + " in " + file.get_path());
+        }
+        return get(*entry);
+    }
+
+    MeshView AssetPack::get_mesh(const AssetEntry& entry) const {
+        AssetView blob = get(entry);
+        if (entry.type != AssetType::Mesh || blob.size < sizeof(MeshAssetHeader)) {
+            throw std::runtime_error("Asset is not a mesh! " + get_name(entry));
+        }
+
+        const char* bytes           = static_cast<const char*>(blob.data);
+        const MeshAssetHeader* mesh = reinterpret_cast<const MeshAssetHeader*>(bytes);
+        uint64_t vertex_bytes       = static_cast<uint64_t>(mesh->vertex_count) * mesh->vertex_stride;
+        uint64_t index_bytes        = static_cast<uint64_t>(mesh->index_count) * mesh->index_size;
+
+        bool index_size_valid = mesh->index_size == sizeof(uint16_t) || mesh->index_size == sizeof(uint32_t);
+        if (mesh->vertex_stride != sizeof(Vertex) || !index_size_valid ||
+            mesh->vertex_offset + vertex_bytes > blob.size || mesh->index_offset + index_bytes > blob.size) {
+            throw std::runtime_error("Mesh asset has an unexpected layout! " + get_name(entry));
+        }
+
+        MeshView view;
+        view.vertices     = reinterpret_cast<const Vertex*>(bytes + mesh->vertex_offset);
+        view.indices      = bytes + mesh->index_offset;
+        view.vertex_count = mesh->vertex_count;
+        view.index_count  = mesh->index_count;
+        view.index_type   = mesh->index_size == sizeof(uint32_t) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+        return view;
+    }
+
+    MeshView AssetPack::get_mesh(const std::string& name) const {
+        const AssetEntry* entry = find(name);
+        if (entry == nullptr) {
+            throw std::runtime_error("Failed to find mesh " + name + " in " + file.get_path());
+        }
+        return get_mesh(*entry);
+    }
+
+    std::string AssetPack::get_name(const AssetEntry& entry) const {
+        if (header->names_offset + entry.name_offset + entry.name_length > size) {
+            return std::string();
+        }
+        return std::string(data + header->names_offset + entry.name_offset, entry.name_length);
+    }
+
+    std::vector<const AssetEntry*> AssetPack::get_entries(AssetType type) const {
+        std::vector<const AssetEntry*> entries;
+        for (uint32_t i = 0; i < header->table_size; i++) {
+            if (table[i].name_hash != 0 && table[i].type == type) {
+                entries.push_back(&table[i]);
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [this](const AssetEntry* a, const AssetEntry* b) {
+            return get_name(*a) < get_name(*b);
+        });
+        return entries;
+    }
+
+    void AssetPackWriter::add(const std::string& name, AssetType type, const void* data, size_t size) {
+        for (const auto& asset : assets) {
+            if (asset.name == name) {
+                throw std::runtime_error("Asset " + name + " was added twice!");
+            }
+        }
+
+        PendingAsset asset;
+        asset.name = name;
+        asset.type = type;
+        asset.data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+        assets.push_back(std::move(asset));
+    }
+
+    void AssetPackWriter::add_file(const std::string& name, AssetType type, const std::string& file_path) {
+        std::ifstream file(file_path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open file! " + file_path);
+        }
+
+        std::vector<char> contents(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(contents.data(), contents.size());
+
+        if (type == AssetType::Shader && contents.size() % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("SPIR-V size isn't a multiple of 4 bytes! " + file_path);
+        }
+        add(name, type, contents.data(), contents.size());
+    }
+
+    void AssetPackWriter::add_mesh(const std::string& name, const Vertex* vertices, uint32_t vertex_count,
+        const void* indices, uint32_t index_count, VkIndexType index_type) {
+
+        uint32_t index_size = get_index_size(index_type);
+
+        MeshAssetHeader mesh = {};
+        mesh.vertex_count    = vertex_count;
+        mesh.index_count     = index_count;
+        mesh.vertex_stride   = sizeof(Vertex);
+        mesh.index_size      = index_size;
+        mesh.vertex_offset   = align_up(sizeof(MeshAssetHeader), 16);
+        mesh.index_offset    = align_up(mesh.vertex_offset + vertex_count * sizeof(Vertex), 16);
+
+        std::vector<char> blob(mesh.index_offset + static_cast<uint64_t>(index_count) * index_size, 0);
+        memcpy(blob.data(), &mesh, sizeof(mesh));
+        memcpy(blob.data() + mesh.vertex_offset, vertices, vertex_count * sizeof(Vertex));
+        memcpy(blob.data() + mesh.index_offset, indices, static_cast<size_t>(index_count) * index_size);
+
+        add(name, AssetType::Mesh, blob.data(), blob.size());
+    }
+
+    /**
+     * The blobs go first so their alignment only depends on their own sizes. The file is written to a temporary path
+     * and renamed over the old one, a running app that still has the old pack mapped keeps seeing the old contents.
+     */
+    void AssetPackWriter::write(const std::string& path) const {
+        uint32_t table_size = 16;
+        while (table_size < assets.size() * 2) {
+            table_size *= 2;
+        }
+
+        AssetPackHeader header = {};
+        memcpy(header.magic, AssetPack::MAGIC, sizeof(header.magic));
+        header.version     = AssetPack::VERSION;
+        header.entry_count = static_cast<uint32_t>(assets.size());
+        header.table_size  = table_size;
+
+        std::vector<AssetEntry> table(table_size);
+        memset(table.data(), 0, table.size() * sizeof(AssetEntry));
+        std::string names;
+
+        uint64_t offset = align_up(sizeof(AssetPackHeader), AssetPack::BLOB_ALIGNMENT);
+        std::vector<uint64_t> offsets;
+        for (const auto& asset : assets) {
+            offsets.push_back(offset);
+
+            AssetEntry entry  = {};
+            entry.name_hash   = hash_asset_name(asset.name.data(), asset.name.size());
+            entry.offset      = offset;
+            entry.size        = asset.data.size();
+            entry.name_offset = static_cast<uint32_t>(names.size());
+            entry.name_length = static_cast<uint32_t>(asset.name.size());
+            entry.type        = asset.type;
+
+            uint32_t slot = static_cast<uint32_t>(entry.name_hash) & (table_size - 1);
+            while (table[slot].name_hash != 0) {
+                slot = (slot + 1) & (table_size - 1);
+            }
+            table[slot] = entry;
+
+            names += asset.name;
+            offset = align_up(offset + asset.data.size(), AssetPack::BLOB_ALIGNMENT);
+        }
+
+        header.table_offset = offset;
+        header.names_offset = header.table_offset + table.size() * sizeof(AssetEntry);
+        header.file_size    = header.names_offset + names.size();
+
+        std::string temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open asset pack for writing! " + temp_path);
+            }
+
+            std::vector<char> padding(AssetPack::BLOB_ALIGNMENT, 0);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            uint64_t written = sizeof(header);
+
+            for (size_t i = 0; i < assets.size(); i++) {
+                file.write(padding.data(), offsets[i] - written);
+                file.write(assets[i].data.data(), assets[i].data.size());
+                written = offsets[i] + assets[i].data.size();
+            }
+
+            file.write(padding.data(), header.table_offset - written);
+            file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(AssetEntry));
+            file.write(names.data(), names.size());
+
+            if (!file.good()) {
+                throw std::runtime_error("Failed to write asset pack! " + temp_path);
+            }
+        }
+
+        std::remove(path.c_str());
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Failed to move asset pack into place! " + path);
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#include "../include/BindlessHeap.h"
+
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    HandleAllocator::HandleAllocator(uint32_t capacity) : capacity(capacity) {
+    }
+
+    /**
+     * Reuses the most recently reclaimed handle first, otherwise takes the lowest one never handed out. Handles stay as
+     * low as they can, which keeps the part of the array the driver has to look at small.
+     */
+    uint32_t HandleAllocator::allocate() {
+        if (!free_handles.empty()) {
+            uint32_t handle = free_handles.back();
+            free_handles.pop_back();
+            return handle;
+        }
+
+        if (next == capacity) {
+            throw std::runtime_error("Out of bindless handles!");
+        }
+        return next++;
+    }
+
+    void HandleAllocator::free(uint32_t handle, uint64_t retire_frame) {
+        retired.push_back({ handle, retire_frame });
+    }
+
+    void HandleAllocator::reclaim(uint64_t completed_frames) {
+        while (!retired.empty() && retired.front().retire_frame <= completed_frames) {
+            free_handles.push_back(retired.front().handle);
+            retired.pop_front();
+        }
+    }
+
+    BindlessHeap::BindlessHeap(VkDevice device, uint32_t buffer_count, uint32_t image_count) : device(device),
+        buffers(buffer_count), images(image_count) {
+
+        bindings.resize(2);
+        bindings[0].binding                      = BUFFER_BINDING;
+        bindings[0].descriptorType               = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[0].descriptorCount              = buffer_count;
+        bindings[0].stageFlags                   = VK_SHADER_STAGE_ALL;
+        bindings[1].binding                      = IMAGE_BINDING;
+        bindings[1].descriptorType               = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        bindings[1].descriptorCount              = image_count;
+        bindings[1].stageFlags                   = VK_SHADER_STAGE_ALL;
+
+        VkDescriptorBindingFlagsEXT binding_flags[2] = {
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT,
+        };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flags_info = {};
+        flags_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        flags_info.bindingCount  = 2;
+        flags_info.pBindingFlags = binding_flags;
+
+        VkDescriptorSetLayoutCreateInfo layout_info = {};
+        layout_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.pNext                           = &flags_info;
+        layout_info.flags                           = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+        layout_info.bindingCount                    = 2;
+        layout_info.pBindings                       = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create bindless descriptor set layout!");
+        }
+
+        VkDescriptorPoolSize pool_sizes[2] = {
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer_count },
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, image_count },
+        };
+
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+        pool_info.maxSets                    = 1;
+        pool_info.poolSizeCount              = 2;
+        pool_info.pPoolSizes                 = pool_sizes;
+
+        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create bindless descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool              = pool;
+        alloc_info.descriptorSetCount          = 1;
+        alloc_info.pSetLayouts                 = &layout;
+
+        if (vkAllocateDescriptorSets(device, &alloc_info, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate bindless descriptor set!");
+        }
+    }
+
+    BindlessHeap::~BindlessHeap() {
+        vkDestroyDescriptorPool(device, pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, layout, nullptr);
+    }
+
+    uint32_t BindlessHeap::add_buffer(const VkDescriptorBufferInfo& buffer_info) {
+        uint32_t handle = buffers.allocate();
+
+        VkWriteDescriptorSet write = {};
+        write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet               = set;
+        write.dstBinding           = BUFFER_BINDING;
+        write.dstArrayElement      = handle;
+        write.descriptorCount      = 1;
+        write.descriptorType       = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo          = &buffer_info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        return handle;
+    }
+
+    uint32_t BindlessHeap::add_image(VkImageView image_view, VkImageLayout image_layout) {
+        uint32_t handle = images.allocate();
+
+        VkDescriptorImageInfo image_info = {};
+        image_info.imageView             = image_view;
+        image_info.imageLayout           = image_layout;
+
+        VkWriteDescriptorSet write = {};
+        write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet               = set;
+        write.dstBinding           = IMAGE_BINDING;
+        write.dstArrayElement      = handle;
+        write.descriptorCount      = 1;
+        write.descriptorType       = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        write.pImageInfo           = &image_info;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+        return handle;
+    }
+
+    void BindlessHeap::remove_buffer(uint32_t handle, uint64_t retire_frame) {
+        buffers.free(handle, retire_frame);
+    }
+
+    void BindlessHeap::remove_image(uint32_t handle, uint64_t retire_frame) {
+        images.free(handle, retire_frame);
+    }
+
+    void BindlessHeap::reclaim(uint64_t completed_frames) {
+        buffers.reclaim(completed_frames);
+        images.reclaim(completed_frames);
+    }
+}
@@ -0,0 +1,316 @@
+#include "../include/Bvh.h"
+#include <algorithm>
+#include <limits>
+
+namespace vulkan_rendering {
+
+    // Past this depth nodes get split at the median, a few badly clustered objects can't blow the stack.
+    static const uint32_t MAX_SAH_DEPTH = 64;
+
+    static const uint32_t NO_PARENT = UINT32_MAX;
+
+    static float get_half_area(const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 extent = max - min;
+        return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+
+    /**
+     * Slab test, the distance along the ray where it enters the box or a negative one if it misses. A direction of 0 on
+     * an axis gives infinite slabs, which still compare the right way unless the origin lies exactly on a face.
+     */
+    static float intersect_box(const glm::vec3& origin, const glm::vec3& inverse_direction, const glm::vec3& min,
+        const glm::vec3& max) {
+        glm::vec3 t0     = (min - origin) * inverse_direction;
+        glm::vec3 t1     = (max - origin) * inverse_direction;
+        glm::vec3 near_t = glm::min(t0, t1);
+        glm::vec3 far_t  = glm::max(t0, t1);
+
+        float enter = std::max(std::max(near_t.x, near_t.y), std::max(near_t.z, 0.0f));
+        float exit  = std::min(std::min(far_t.x, far_t.y), far_t.z);
+        return enter <= exit ? enter : -1.0f;
+    }
+
+    void Bvh::build(const std::vector<glm::vec3>& min, const std::vector<glm::vec3>& max) {
+        object_min = min;
+        object_max = max;
+        rebuild();
+    }
+
+    void Bvh::rebuild() {
+        uint32_t object_count = get_object_count();
+
+        indices.resize(object_count);
+        centroids.resize(object_count);
+        object_leaves.resize(object_count);
+        for (uint32_t i = 0; i < object_count; i++) {
+            indices[i]   = i;
+            centroids[i] = (object_min[i] + object_max[i]) * 0.5f;
+        }
+
+        nodes.clear();
+        parents.clear();
+        nodes.reserve(2 * static_cast<size_t>(object_count));
+        parents.reserve(2 * static_cast<size_t>(object_count));
+        depth = 0;
+        if (object_count > 0) {
+            build_node(NO_PARENT, 0, object_count, 1);
+        }
+
+        dirty.assign(nodes.size(), 0);
+        any_dirty = false;
+    }
+
+    /**
+     * Appends the node, then its first subtree right behind it and its second one after that. The split is the one of
+     * the BIN_COUNT - 1 planes between the centroid bins along the widest axis with the lowest surface area cost.
+     */
+    void Bvh::build_node(uint32_t parent, uint32_t begin, uint32_t end, uint32_t level) {
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        parents.push_back(parent);
+        depth = std::max(depth, level);
+
+        glm::vec3 min(std::numeric_limits<float>::max());
+        glm::vec3 max(-std::numeric_limits<float>::max());
+        glm::vec3 centroid_min = min;
+        glm::vec3 centroid_max = max;
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t object = indices[i];
+            min             = glm::min(min, object_min[object]);
+            max             = glm::max(max, object_max[object]);
+            centroid_min    = glm::min(centroid_min, centroids[object]);
+            centroid_max    = glm::max(centroid_max, centroids[object]);
+        }
+
+        nodes[index].min          = min;
+        nodes[index].max          = max;
+        nodes[index].first_object = begin;
+
+        uint32_t count = end - begin;
+        if (count <= MAX_LEAF_SIZE) {
+            for (uint32_t i = begin; i < end; i++) {
+                object_leaves[indices[i]] = index;
+            }
+            nodes[index].skip = index + 1;
+            return;
+        }
+
+        glm::vec3 extent = centroid_max - centroid_min;
+        int axis         = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        uint32_t middle  = begin + count / 2;
+
+        if (extent[axis] > 0.0f && level < MAX_SAH_DEPTH) {
+            struct Bin {
+                glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+                glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+                uint32_t count = 0;
+            };
+
+            Bin bins[BIN_COUNT];
+            float scale = BIN_COUNT / extent[axis];
+            auto get_bin = [&](uint32_t object) {
+                uint32_t bin = static_cast<uint32_t>((centroids[object][axis] - centroid_min[axis]) * scale);
+                return std::min(bin, BIN_COUNT - 1);
+            };
+
+            for (uint32_t i = begin; i < end; i++) {
+                Bin& bin = bins[get_bin(indices[i])];
+                bin.min  = glm::min(bin.min, object_min[indices[i]]);
+                bin.max  = glm::max(bin.max, object_max[indices[i]]);
+                bin.count++;
+            }
+
+            // Sweep from the right first so the left sweep can price every plane as it goes.
+            float right_cost[BIN_COUNT];
+            Bin right;
+            for (uint32_t i = BIN_COUNT - 1; i > 0; i--) {
+                right.min   = glm::min(right.min, bins[i].min);
+                right.max   = glm::max(right.max, bins[i].max);
+                right.count += bins[i].count;
+                right_cost[i] = right.count > 0 ? get_half_area(right.min, right.max) * right.count : 0.0f;
+            }
+
+            float best_cost    = std::numeric_limits<float>::max();
+            uint32_t best_plane = 0;
+            Bin left;
+            for (uint32_t plane = 1; plane < BIN_COUNT; plane++) {
+                left.min   = glm::min(left.min, bins[plane - 1].min);
+                left.max   = glm::max(left.max, bins[plane - 1].max);
+                left.count += bins[plane - 1].count;
+
+                if (left.count == 0 || left.count == count) {
+                    continue;
+                }
+
+                float cost = get_half_area(left.min, left.max) * left.count + right_cost[plane];
+                if (cost < best_cost) {
+                    best_cost  = cost;
+                    best_plane = plane;
+                }
+            }
+
+            if (best_plane > 0) {
+                auto split = std::partition(indices.begin() + begin, indices.begin() + end, [&](uint32_t object) {
+                    return get_bin(object) < best_plane;
+                });
+                middle = static_cast<uint32_t>(split - indices.begin());
+            }
+        }
+
+        build_node(index, begin, middle, level + 1);
+        build_node(index, middle, end, level + 1);
+        nodes[index].skip = static_cast<uint32_t>(nodes.size());
+    }
+
+    void Bvh::set_bounds(uint32_t object, const glm::vec3& min, const glm::vec3& max) {
+        object_min[object] = min;
+        object_max[object] = max;
+        dirty[object_leaves[object]] = 1;
+        any_dirty = true;
+    }
+
+    /**
+     * Children always come after their parent, so one pass from the back sees every child before its parent. Only
+     * dirty nodes get recomputed and a node only dirties its parent when its box actually changed.
+     */
+    void Bvh::refit() {
+        if (!any_dirty) {
+            return;
+        }
+
+        for (uint32_t i = static_cast<uint32_t>(nodes.size()); i-- > 0;) {
+            if (!dirty[i]) {
+                continue;
+            }
+            dirty[i] = 0;
+
+            BvhNode& node = nodes[i];
+            glm::vec3 min;
+            glm::vec3 max;
+            if (is_leaf(i)) {
+                min = glm::vec3(std::numeric_limits<float>::max());
+                max = glm::vec3(-std::numeric_limits<float>::max());
+                for (uint32_t j = node.first_object; j < get_end_object(i); j++) {
+                    min = glm::min(min, object_min[indices[j]]);
+                    max = glm::max(max, object_max[indices[j]]);
+                }
+            } else {
+                const BvhNode& first  = nodes[i + 1];
+                const BvhNode& second = nodes[first.skip];
+                min = glm::min(first.min, second.min);
+                max = glm::max(first.max, second.max);
+            }
+
+            if (min != node.min || max != node.max) {
+                node.min = min;
+                node.max = max;
+                if (parents[i] != NO_PARENT) {
+                    dirty[parents[i]] = 1;
+                }
+            }
+        }
+
+        any_dirty = false;
+    }
+
+    uint32_t Bvh::get_end_object(uint32_t node) const {
+        uint32_t skip = nodes[node].skip;
+        return skip < nodes.size() ? nodes[skip].first_object : get_object_count();
+    }
+
+    void Bvh::append_objects(uint32_t node, std::vector<uint32_t>& visible) const {
+        visible.insert(visible.end(), indices.begin() + nodes[node].first_object,
+            indices.begin() + get_end_object(node));
+    }
+
+    void Bvh::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+        uint32_t i = 0;
+        while (i < nodes.size()) {
+            const BvhNode& node = nodes[i];
+            Frustum::Containment containment = frustum.classify_box(node.min, node.max);
+
+            if (containment == Frustum::INSIDE) {
+                append_objects(i, visible);
+            } else if (containment == Frustum::INTERSECTS && is_leaf(i)) {
+                for (uint32_t j = node.first_object; j < get_end_object(i); j++) {
+                    uint32_t object = indices[j];
+                    if (frustum.classify_box(object_min[object], object_max[object]) != Frustum::OUTSIDE) {
+                        visible.push_back(object);
+                    }
+                }
+            } else if (containment == Frustum::INTERSECTS) {
+                i++;
+                continue;
+            }
+
+            i = node.skip;
+        }
+    }
+
+    /**
+     * Nearest child first, so the first hits found are close ones and everything behind them gets skipped. The depth is
+     * bounded by MAX_SAH_DEPTH plus the median splits below it, which halve the objects every level, so the stack never
+     * holds more than one entry per level.
+     */
+    uint32_t Bvh::pick(const glm::vec3& origin, const glm::vec3& direction, float max_distance,
+        float& distance) const {
+        glm::vec3 inverse_direction = 1.0f / direction;
+        uint32_t hit                = INVALID_OBJECT;
+        distance                    = max_distance;
+
+        if (nodes.empty()) {
+            return hit;
+        }
+
+        struct Entry {
+            uint32_t node;
+            float enter;
+        };
+
+        Entry stack[MAX_SAH_DEPTH + 64];
+        uint32_t size = 0;
+
+        float root_enter = intersect_box(origin, inverse_direction, nodes[0].min, nodes[0].max);
+        if (root_enter >= 0.0f) {
+            stack[size++] = { 0, root_enter };
+        }
+
+        while (size > 0) {
+            Entry entry = stack[--size];
+            if (entry.enter > distance) {
+                continue;
+            }
+
+            const BvhNode& node = nodes[entry.node];
+            if (is_leaf(entry.node)) {
+                for (uint32_t j = node.first_object; j < get_end_object(entry.node); j++) {
+                    uint32_t object = indices[j];
+                    float t         = intersect_box(origin, inverse_direction, object_min[object], object_max[object]);
+                    if (t >= 0.0f && t <= distance) {
+                        distance = t;
+                        hit      = object;
+                    }
+                }
+                continue;
+            }
+
+            Entry first  = { entry.node + 1, 0.0f };
+            Entry second = { nodes[first.node].skip, 0.0f };
+            first.enter  = intersect_box(origin, inverse_direction, nodes[first.node].min, nodes[first.node].max);
+            second.enter = intersect_box(origin, inverse_direction, nodes[second.node].min, nodes[second.node].max);
+            if (first.enter >= 0.0f && second.enter >= 0.0f && second.enter < first.enter) {
+                std::swap(first, second);
+            }
+
+            // Pushed far then near, so the near one gets popped next.
+            if (second.enter >= 0.0f && second.enter <= distance) {
+                stack[size++] = second;
+            }
+            if (first.enter >= 0.0f && first.enter <= distance) {
+                stack[size++] = first;
+            }
+        }
+
+        return hit;
+    }
+}
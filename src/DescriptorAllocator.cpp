@@ -0,0 +1,265 @@
+#include "../include/DescriptorAllocator.h"
+#include "../include/PipelineCache.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    DescriptorLayoutCache::DescriptorLayoutCache(VkDevice device) : device(device) {
+    }
+
+    DescriptorLayoutCache::~DescriptorLayoutCache() {
+        for (const auto& entry : pipeline_layouts) {
+            vkDestroyPipelineLayout(device, entry.second.layout, nullptr);
+        }
+        for (const auto& entry : layouts) {
+            vkDestroyDescriptorSetLayout(device, entry.second.layout, nullptr);
+        }
+    }
+
+    template <typename T>
+    static T find_layout(const std::unordered_multimap<uint64_t, T>& entries, const PipelineHasher& hasher) {
+        auto range = entries.equal_range(hasher.get());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.state == hasher.get_state()) {
+                return it->second;
+            }
+        }
+        return T();
+    }
+
+    /**
+     * VkDescriptorSetLayoutBinding has a pointer in it, so it's hashed field by field. Immutable samplers are part of
+     * the layout, their handles go into the key after a flag saying they're there, so the kept bindings can't be read
+     * two ways.
+     */
+    VkDescriptorSetLayout DescriptorLayoutCache::get(const VkDescriptorSetLayoutCreateInfo& info) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(info.pBindings, info.pBindings + info.bindingCount);
+        std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+                return a.binding < b.binding;
+            });
+
+        PipelineHasher hasher(true);
+        hasher.add(info.flags);
+        hasher.add(info.bindingCount);
+        for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+            hasher.add(binding.binding);
+            hasher.add(binding.descriptorType);
+            hasher.add(binding.descriptorCount);
+            hasher.add(binding.stageFlags);
+            hasher.add(binding.pImmutableSamplers != nullptr);
+            if (binding.pImmutableSamplers != nullptr) {
+                hasher.add(binding.pImmutableSamplers, binding.descriptorCount * sizeof(VkSampler));
+            }
+        }
+
+        Entry<VkDescriptorSetLayout> entry = find_layout(layouts, hasher);
+        if (entry.layout != VK_NULL_HANDLE) {
+            hits++;
+            return entry.layout;
+        }
+
+        if (vkCreateDescriptorSetLayout(device, &info, nullptr, &entry.layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor set layout!");
+        }
+        entry.state = hasher.get_state();
+        layouts.emplace(hasher.get(), entry);
+        return entry.layout;
+    }
+
+    /**
+     * Set layouts from this cache are the same handle for the same bindings, so hashing the handles is enough.
+     */
+    VkPipelineLayout DescriptorLayoutCache::get(const VkPipelineLayoutCreateInfo& info) {
+        PipelineHasher hasher(true);
+        hasher.add(info.flags);
+        hasher.add(info.setLayoutCount);
+        hasher.add(info.pSetLayouts, info.setLayoutCount * sizeof(VkDescriptorSetLayout));
+        hasher.add(info.pushConstantRangeCount);
+        hasher.add(info.pPushConstantRanges, info.pushConstantRangeCount * sizeof(VkPushConstantRange));
+
+        Entry<VkPipelineLayout> entry = find_layout(pipeline_layouts, hasher);
+        if (entry.layout != VK_NULL_HANDLE) {
+            hits++;
+            return entry.layout;
+        }
+
+        if (vkCreatePipelineLayout(device, &info, nullptr, &entry.layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline layout!");
+        }
+        entry.state = hasher.get_state();
+        pipeline_layouts.emplace(hasher.get(), entry);
+        return entry.layout;
+    }
+
+    DescriptorAllocator::DescriptorAllocator(VkDevice device, const std::vector<DescriptorPoolRatio>& ratios,
+        uint32_t first_pool_sets) : device(device), ratios(ratios), next_pool_sets(first_pool_sets) {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator() {
+        for (VkDescriptorPool pool : pools) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+    }
+
+    /**
+     * Moves on to the next pool once the current one has handed out maxSets sets, without asking the driver. A pool
+     * can also run out of descriptors first, which it reports with VK_ERROR_OUT_OF_POOL_MEMORY, or with
+     * VK_ERROR_FRAGMENTED_POOL when it has the room but not in one piece. Either way the next pool gets a go.
+     */
+    VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorSetCount          = 1;
+        alloc_info.pSetLayouts                 = &layout;
+
+        while (true) {
+            if (current < pools.size() && current_sets == pool_sets[current]) {
+                current++;
+                current_sets = 0;
+            }
+
+            bool created = current == pools.size();
+            if (created) {
+                create_pool();
+            }
+
+            VkDescriptorSet set;
+            alloc_info.descriptorPool = pools[current];
+            VkResult result           = vkAllocateDescriptorSets(device, &alloc_info, &set);
+            if (result == VK_SUCCESS) {
+                current_sets++;
+                stats.sets_allocated++;
+                return set;
+            }
+
+            if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+                throw std::runtime_error("Failed to allocate descriptor set!");
+            }
+
+            // An empty pool that can't fit the set never will, the ratios don't cover the layout.
+            if (created) {
+                throw std::runtime_error("Descriptor set layout doesn't fit the pool ratios!");
+            }
+            current++;
+            current_sets = 0;
+        }
+    }
+
+    void DescriptorAllocator::reset() {
+        for (size_t i = 0; i < pools.size() && i <= current; i++) {
+            vkResetDescriptorPool(device, pools[i], 0);
+        }
+        current      = 0;
+        current_sets = 0;
+        stats.resets++;
+    }
+
+    void DescriptorAllocator::create_pool() {
+        std::vector<VkDescriptorPoolSize> pool_sizes;
+        for (const DescriptorPoolRatio& ratio : ratios) {
+            uint32_t count = static_cast<uint32_t>(ratio.per_set * next_pool_sets);
+            pool_sizes.push_back({ ratio.type, std::max(count, 1u) });
+        }
+
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.poolSizeCount              = static_cast<uint32_t>(pool_sizes.size());
+        pool_info.pPoolSizes                 = pool_sizes.data();
+        pool_info.maxSets                    = next_pool_sets;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor pool!");
+        }
+
+        pools.push_back(pool);
+        pool_sets.push_back(next_pool_sets);
+        stats.pools_created++;
+        next_pool_sets = std::min(next_pool_sets * 2, MAX_POOL_SETS);
+    }
+
+    /**
+     * One entry per binding, each reading its descriptorCount infos from where the previous binding's left off.
+     */
+    DescriptorTemplate::DescriptorTemplate(VkDevice device, VkDescriptorSetLayout layout,
+        const VkDescriptorSetLayoutCreateInfo& info, bool use_template) : device(device) {
+
+        for (uint32_t i = 0; i < info.bindingCount; i++) {
+            const VkDescriptorSetLayoutBinding& binding = info.pBindings[i];
+
+            VkDescriptorUpdateTemplateEntryKHR entry = {};
+            entry.dstBinding                         = binding.binding;
+            entry.dstArrayElement                    = 0;
+            entry.descriptorCount                    = binding.descriptorCount;
+            entry.descriptorType                     = binding.descriptorType;
+            entry.offset                             = descriptor_count * sizeof(VkDescriptorBufferInfo);
+            entry.stride                             = sizeof(VkDescriptorBufferInfo);
+            entries.push_back(entry);
+
+            descriptor_count += binding.descriptorCount;
+        }
+
+        if (!use_template) {
+            return;
+        }
+
+        auto create_template = (PFN_vkCreateDescriptorUpdateTemplateKHR) vkGetDeviceProcAddr(device,
+            "vkCreateDescriptorUpdateTemplateKHR");
+        destroy_template     = (PFN_vkDestroyDescriptorUpdateTemplateKHR) vkGetDeviceProcAddr(device,
+            "vkDestroyDescriptorUpdateTemplateKHR");
+        update_with_template = (PFN_vkUpdateDescriptorSetWithTemplateKHR) vkGetDeviceProcAddr(device,
+            "vkUpdateDescriptorSetWithTemplateKHR");
+        if (create_template == nullptr || destroy_template == nullptr || update_with_template == nullptr) {
+            throw std::runtime_error("Failed to load the descriptor update template functions!");
+        }
+
+        VkDescriptorUpdateTemplateCreateInfoKHR template_info = {};
+        template_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        template_info.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        template_info.pDescriptorUpdateEntries   = entries.data();
+        template_info.templateType               = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        template_info.descriptorSetLayout        = layout;
+
+        if (create_template(device, &template_info, nullptr, &update_template) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor update template!");
+        }
+    }
+
+    DescriptorTemplate::~DescriptorTemplate() {
+        if (update_template != VK_NULL_HANDLE) {
+            destroy_template(device, update_template, nullptr);
+        }
+    }
+
+    void DescriptorTemplate::update(VkDescriptorSet set, const VkDescriptorBufferInfo* buffer_infos) const {
+        if (update_template != VK_NULL_HANDLE) {
+            update_with_template(device, set, update_template, buffer_infos);
+            return;
+        }
+
+        VkWriteDescriptorSet writes[16];
+        uint32_t write_count = 0;
+        for (const VkDescriptorUpdateTemplateEntryKHR& entry : entries) {
+            VkWriteDescriptorSet& write = writes[write_count++];
+            write                       = {};
+            write.sType                 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet                = set;
+            write.dstBinding            = entry.dstBinding;
+            write.dstArrayElement       = entry.dstArrayElement;
+            write.descriptorCount       = entry.descriptorCount;
+            write.descriptorType        = entry.descriptorType;
+            write.pBufferInfo           = buffer_infos + entry.offset / sizeof(VkDescriptorBufferInfo);
+
+            if (write_count == 16) {
+                vkUpdateDescriptorSets(device, write_count, writes, 0, nullptr);
+                write_count = 0;
+            }
+        }
+
+        if (write_count > 0) {
+            vkUpdateDescriptorSets(device, write_count, writes, 0, nullptr);
+        }
+    }
+}
@@ -0,0 +1,274 @@
+#include "../include/DeviceAllocator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    VulkanMemoryBackend::VulkanMemoryBackend(VkDevice device) : device(device) {}
+
+    VkResult VulkanMemoryBackend::allocate(uint32_t memory_type, VkDeviceSize size, VkDeviceMemory& memory) {
+        VkMemoryAllocateInfo alloc_info = {};
+        alloc_info.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        alloc_info.allocationSize       = size;
+        alloc_info.memoryTypeIndex      = memory_type;
+
+        return vkAllocateMemory(device, &alloc_info, nullptr, &memory);
+    }
+
+    void VulkanMemoryBackend::free(VkDeviceMemory memory) {
+        vkFreeMemory(device, memory, nullptr);
+    }
+
+    void* VulkanMemoryBackend::map(VkDeviceMemory memory) {
+        void* data = nullptr;
+        if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to map device memory block!");
+        }
+        return data;
+    }
+
+    void VulkanMemoryBackend::unmap(VkDeviceMemory memory) {
+        vkUnmapMemory(device, memory);
+    }
+
+    float HeapStats::fragmentation() const {
+        VkDeviceSize free_bytes = reserved - used;
+        if (free_bytes == 0) {
+            return 0.0f;
+        }
+        return 1.0f - static_cast<float>(largest_free) / static_cast<float>(free_bytes);
+    }
+
+    /**
+     * The memory properties never change for a physical device, so we grab them once here instead of calling
+     * vkGetPhysicalDeviceMemoryProperties every time we look for a memory type.
+     */
+    DeviceAllocator::DeviceAllocator(DeviceMemoryBackend* backend,
+        const VkPhysicalDeviceMemoryProperties& memory_properties, VkDeviceSize buffer_image_granularity,
+        VkDeviceSize block_size) : backend(backend), memory_properties(memory_properties),
+        buffer_image_granularity(buffer_image_granularity), block_size(block_size) {}
+
+    DeviceAllocator::~DeviceAllocator() {
+        for (uint32_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].memory != VK_NULL_HANDLE) {
+                destroy_block(i);
+            }
+        }
+    }
+
+    uint32_t DeviceAllocator::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags props) const {
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+            if (type_filter & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & props) == props) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Failed to find suitable mem types!");
+    }
+
+    /**
+     * Small heaps (e.g. the 256MB device local + host visible heap on some discrete cards) shouldn't be eaten by a
+     * couple of blocks, so cap the block size to an eighth of the heap.
+     */
+    VkDeviceSize DeviceAllocator::get_block_size(uint32_t memory_type) const {
+        uint32_t heap_index = memory_properties.memoryTypes[memory_type].heapIndex;
+        VkDeviceSize heap_size = memory_properties.memoryHeaps[heap_index].size;
+        return std::max<VkDeviceSize>(std::min(block_size, heap_size / 8), 1);
+    }
+
+    uint32_t DeviceAllocator::create_block(uint32_t memory_type, ResourceKind kind, VkDeviceSize size,
+        bool dedicated) {
+
+        VkDeviceMemory memory;
+        if (backend->allocate(memory_type, size, memory) != VK_SUCCESS) {
+            return UINT32_MAX;
+        }
+
+        uint32_t index;
+        if (!free_block_slots.empty()) {
+            index = free_block_slots.back();
+            free_block_slots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(blocks.size());
+            blocks.emplace_back();
+        }
+
+        Block& block      = blocks[index];
+        block.memory      = memory;
+        block.memory_type = memory_type;
+        block.kind        = kind;
+        block.dedicated   = dedicated;
+        block.ranges      = std::unique_ptr<TlsfAllocator>(new TlsfAllocator(size));
+
+        // Map host visible blocks once and keep them mapped, mapping the same VkDeviceMemory twice isn't allowed and
+        // the block is shared by many resources anyway.
+        if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            block.mapped = backend->map(memory);
+        } else {
+            block.mapped = nullptr;
+        }
+
+        return index;
+    }
+
+    void DeviceAllocator::destroy_block(uint32_t index) {
+        Block& block = blocks[index];
+        if (block.mapped != nullptr) {
+            backend->unmap(block.memory);
+        }
+        backend->free(block.memory);
+
+        block = Block();
+        free_block_slots.push_back(index);
+    }
+
+    bool DeviceAllocator::try_allocate(uint32_t index, VkDeviceSize size, VkDeviceSize alignment,
+        Allocation& allocation) {
+
+        // Dedicated blocks are exactly as large as their resource and memory is aligned for anything at offset 0, so
+        // they're taken whole rather than searched.
+        Block& block = blocks[index];
+        TlsfAllocator::Range range;
+        bool found   = block.dedicated ? block.ranges->allocate_all(range) :
+            block.ranges->allocate(size, alignment, range);
+        if (!found) {
+            return false;
+        }
+
+        allocation.memory      = block.memory;
+        allocation.offset      = range.offset;
+        allocation.size        = range.size;
+        allocation.mapped      = block.mapped != nullptr ? static_cast<char*>(block.mapped) + range.offset : nullptr;
+        allocation.memory_type = block.memory_type;
+        allocation.block       = index;
+        allocation.node        = range.node;
+
+        total_allocations++;
+        return true;
+    }
+
+    /**
+     * Walk every memory type that fits the request (in the driver's preferred order) and try existing blocks first. If
+     * none of them have room we open a new block, and only fall back to the next memory type if the heap is out of
+     * memory.
+     */
+    Allocation DeviceAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags props,
+        ResourceKind kind) {
+
+        ResourceKind block_kind = buffer_image_granularity > 1 ? kind : ResourceKind::Linear;
+        VkDeviceSize alignment  = std::max<VkDeviceSize>(requirements.alignment, 1);
+        Allocation allocation;
+
+        for (uint32_t type = 0; type < memory_properties.memoryTypeCount; type++) {
+            if (!(requirements.memoryTypeBits & (1 << type)) ||
+                (memory_properties.memoryTypes[type].propertyFlags & props) != props) {
+                continue;
+            }
+
+            VkDeviceSize type_block_size = get_block_size(type);
+
+            if (requirements.size > type_block_size / 2) {
+                uint32_t block = create_block(type, block_kind, requirements.size, true);
+                if (block != UINT32_MAX) {
+                    if (try_allocate(block, requirements.size, alignment, allocation)) {
+                        return allocation;
+                    }
+                    destroy_block(block);
+                }
+                continue;
+            }
+
+            for (uint32_t i = 0; i < blocks.size(); i++) {
+                const Block& block = blocks[i];
+                if (block.memory == VK_NULL_HANDLE || block.dedicated || block.memory_type != type ||
+                    block.kind != block_kind) {
+                    continue;
+                }
+
+                if (try_allocate(i, requirements.size, alignment, allocation)) {
+                    return allocation;
+                }
+            }
+
+            uint32_t block = create_block(type, block_kind, type_block_size, false);
+            if (block != UINT32_MAX && try_allocate(block, requirements.size, alignment, allocation)) {
+                return allocation;
+            }
+        }
+
+        throw std::runtime_error("Failed to allocate device memory!");
+    }
+
+    /**
+     * Empty dedicated blocks are released straight away. For regular blocks we keep one empty block per memory type
+     * around so a free followed by an allocate doesn't bounce through vkFreeMemory/vkAllocateMemory.
+     */
+    void DeviceAllocator::free(Allocation& allocation) {
+        if (allocation.block == UINT32_MAX) {
+            return;
+        }
+
+        Block& block = blocks[allocation.block];
+        block.ranges->free(allocation.node);
+
+        if (block.ranges->is_empty()) {
+            bool release = block.dedicated;
+
+            for (uint32_t i = 0; i < blocks.size() && !release; i++) {
+                const Block& other = blocks[i];
+                if (i != allocation.block && other.memory != VK_NULL_HANDLE && !other.dedicated &&
+                    other.memory_type == block.memory_type && other.kind == block.kind && other.ranges->is_empty()) {
+                    release = true;
+                }
+            }
+
+            if (release) {
+                destroy_block(allocation.block);
+            }
+        }
+
+        allocation = Allocation();
+    }
+
+    AllocatorStats DeviceAllocator::get_stats() const {
+        AllocatorStats stats;
+        stats.heaps.resize(memory_properties.memoryHeapCount);
+        stats.total_allocations = total_allocations;
+
+        for (const auto& block : blocks) {
+            if (block.memory == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            HeapStats& heap = stats.heaps[memory_properties.memoryTypes[block.memory_type].heapIndex];
+            heap.block_count++;
+            heap.allocation_count += block.ranges->get_allocation_count();
+            heap.reserved         += block.ranges->get_capacity();
+            heap.used             += block.ranges->get_capacity() - block.ranges->get_free_size();
+            heap.largest_free      = std::max(heap.largest_free, block.ranges->get_largest_free_range());
+            stats.device_allocation_count++;
+        }
+
+        return stats;
+    }
+
+    void DeviceAllocator::print_stats(std::ostream& out) const {
+        AllocatorStats stats = get_stats();
+
+        out << "Device memory: " << stats.device_allocation_count << " blocks, " << stats.total_allocations <<
+            " allocations made" << std::endl;
+
+        for (size_t i = 0; i < stats.heaps.size(); i++) {
+            const HeapStats& heap = stats.heaps[i];
+            if (heap.block_count == 0) {
+                continue;
+            }
+
+            out << "\tHeap " << i << ": " << heap.block_count << " blocks, " << heap.allocation_count <<
+                " allocations, " << heap.used << "/" << heap.reserved << " bytes used, " << std::fixed <<
+                std::setprecision(2) << heap.fragmentation() * 100.0f << "% fragmented" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include "../include/FrustumCuller.h"
+#include "../include/Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vulkan_rendering {
+
+    static const uint32_t PADDING = 8;
+
+    /**
+     * The box corner furthest along each plane's normal. If even that one is behind the plane, so is the whole box.
+     */
+    struct PlaneCorners {
+        const float* x[6];
+        const float* y[6];
+        const float* z[6];
+    };
+
+    FrustumCuller::FrustumCuller(bool allow_simd) : allow_simd(allow_simd) {
+    }
+
+    void FrustumCuller::resize(uint32_t count) {
+        this->count   = count;
+        size_t padded = (static_cast<size_t>(count) + PADDING - 1) / PADDING * PADDING;
+
+        // Spheres of negative infinite radius fail the very first plane, so padding is never visible.
+        for (auto array : { &centre_x, &centre_y, &centre_z, &min_x, &min_y, &min_z, &max_x, &max_y, &max_z }) {
+            array->resize(padded, 0.0f);
+        }
+        radius.resize(padded, -std::numeric_limits<float>::infinity());
+        std::fill(radius.begin() + count, radius.end(), -std::numeric_limits<float>::infinity());
+    }
+
+    void FrustumCuller::set_bounds(uint32_t object, const glm::vec4& sphere, const glm::vec3& min,
+        const glm::vec3& max) {
+        centre_x[object] = sphere.x;
+        centre_y[object] = sphere.y;
+        centre_z[object] = sphere.z;
+        radius[object]   = sphere.w;
+        min_x[object]    = min.x;
+        min_y[object]    = min.y;
+        min_z[object]    = min.z;
+        max_x[object]    = max.x;
+        max_y[object]    = max.y;
+        max_z[object]    = max.z;
+    }
+
+    /**
+     * Same scale estimate cull.comp uses for the sphere, the longest axis. The box comes from transform_box.
+     */
+    void FrustumCuller::set_transformed(uint32_t object, const glm::mat4& model, const glm::vec4& sphere,
+        const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 centre = glm::vec3(model * glm::vec4(glm::vec3(sphere), 1.0f));
+        float scale      = std::sqrt(std::max(std::max(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+            glm::dot(glm::vec3(model[1]), glm::vec3(model[1]))), glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))));
+
+        glm::vec3 world_min;
+        glm::vec3 world_max;
+        transform_box(model, min, max, world_min, world_max);
+
+        set_bounds(object, glm::vec4(centre, sphere.w * scale), world_min, world_max);
+    }
+
+    uint32_t FrustumCuller::cull(const Frustum& frustum, WorkerPool& pool, std::vector<uint32_t>& visible) {
+        worker_visible.resize(pool.get_worker_count());
+
+        uint32_t padded      = static_cast<uint32_t>(radius.size());
+        uint32_t chunk_count = (padded + CHUNK_SIZE - 1) / CHUNK_SIZE;
+        pool.parallel_for(chunk_count, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+            std::vector<uint32_t>& list = worker_visible[worker];
+            list.clear();
+            if (begin < end) {
+                cull_range(frustum, begin * CHUNK_SIZE, std::min(end * CHUNK_SIZE, padded), list);
+            }
+        });
+
+        visible.clear();
+        for (const std::vector<uint32_t>& list : worker_visible) {
+            visible.insert(visible.end(), list.begin(), list.end());
+        }
+        return static_cast<uint32_t>(visible.size());
+    }
+
+    const char* FrustumCuller::get_simd_name() const {
+#if defined(SIMD_AVX2)
+        return allow_simd ? "avx2" : "scalar";
+#elif defined(SIMD_SSE2)
+        return allow_simd ? "sse2" : "scalar";
+#else
+        return "scalar";
+#endif
+    }
+
+    /**
+     * begin and end are multiples of PADDING. Visibility matches Frustum::intersects_sphere, plus the box test. The
+     * scalar loop adds in the same order the SIMD one does, so both give exactly the same results.
+     */
+    void FrustumCuller::cull_range(const Frustum& frustum, uint32_t begin, uint32_t end,
+        std::vector<uint32_t>& visible) const {
+
+        PlaneCorners corners;
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            corners.x[p] = plane.x >= 0.0f ? max_x.data() : min_x.data();
+            corners.y[p] = plane.y >= 0.0f ? max_y.data() : min_y.data();
+            corners.z[p] = plane.z >= 0.0f ? max_z.data() : min_z.data();
+        }
+
+        uint32_t i = begin;
+
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+        if (allow_simd) {
+            Simd::Float plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+            for (int p = 0; p < 6; p++) {
+                plane_x[p] = Simd::set(frustum.planes[p].x);
+                plane_y[p] = Simd::set(frustum.planes[p].y);
+                plane_z[p] = Simd::set(frustum.planes[p].z);
+                plane_w[p] = Simd::set(frustum.planes[p].w);
+            }
+
+            for (; i < end; i += Simd::WIDTH) {
+                Simd::Float x          = Simd::load(centre_x.data() + i);
+                Simd::Float y          = Simd::load(centre_y.data() + i);
+                Simd::Float z          = Simd::load(centre_z.data() + i);
+                Simd::Float neg_radius = Simd::sub(Simd::zero(), Simd::load(radius.data() + i));
+
+                Simd::Float inside = Simd::all();
+                for (int p = 0; p < 6; p++) {
+                    Simd::Float distance = Simd::add(Simd::add(Simd::mul(plane_x[p], x), Simd::mul(plane_y[p], y)),
+                        Simd::add(Simd::mul(plane_z[p], z), plane_w[p]));
+                    inside = Simd::both(inside, Simd::greater(distance, neg_radius));
+                }
+
+                if (Simd::mask(inside) == 0) {
+                    continue;
+                }
+
+                for (int p = 0; p < 6; p++) {
+                    Simd::Float distance = Simd::add(
+                        Simd::add(Simd::mul(plane_x[p], Simd::load(corners.x[p] + i)),
+                            Simd::mul(plane_y[p], Simd::load(corners.y[p] + i))),
+                        Simd::add(Simd::mul(plane_z[p], Simd::load(corners.z[p] + i)), plane_w[p]));
+                    inside = Simd::both(inside, Simd::greater_equal(distance, Simd::zero()));
+                }
+
+                uint32_t mask = Simd::mask(inside);
+                for (uint32_t lane = 0; mask != 0; lane++, mask >>= 1) {
+                    if (mask & 1) {
+                        visible.push_back(i + lane);
+                    }
+                }
+            }
+        }
+#endif
+
+        for (; i < end; i++) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                inside = (plane.x * centre_x[i] + plane.y * centre_y[i]) + (plane.z * centre_z[i] + plane.w) >
+                    -radius[i];
+            }
+
+            for (int p = 0; p < 6 && inside; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                inside = (plane.x * corners.x[p][i] + plane.y * corners.y[p][i]) +
+                    (plane.z * corners.z[p][i] + plane.w) >= 0.0f;
+            }
+
+            if (inside) {
+                visible.push_back(i);
+            }
+        }
+    }
+}
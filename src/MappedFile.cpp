@@ -0,0 +1,85 @@
+#include "../include/MappedFile.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vulkan_rendering {
+
+    MappedFile::MappedFile(const std::string& path) : path(path) {
+#ifdef _WIN32
+        file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_handle == INVALID_HANDLE_VALUE) {
+            file_handle = nullptr;
+            throw std::runtime_error("Failed to open file! " + path);
+        }
+
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file_handle, &file_size);
+        size = static_cast<uint64_t>(file_size.QuadPart);
+
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_handle != nullptr) {
+            data = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (data == nullptr) {
+            unmap();
+            throw std::runtime_error("Failed to map file! " + path);
+        }
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw std::runtime_error("Failed to open file! " + path);
+        }
+
+        struct stat file_stat;
+        if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(file);
+            throw std::runtime_error("Failed to read file! " + path);
+        }
+        size = static_cast<uint64_t>(file_stat.st_size);
+
+        // The mapping keeps its own reference to the file, so the descriptor isn't needed past this point.
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file! " + path);
+        }
+        data = static_cast<const char*>(mapping);
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+        unmap();
+    }
+
+    void MappedFile::unmap() {
+#ifdef _WIN32
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping_handle != nullptr) {
+            CloseHandle(mapping_handle);
+        }
+        if (file_handle != nullptr) {
+            CloseHandle(file_handle);
+        }
+        mapping_handle = nullptr;
+        file_handle    = nullptr;
+#else
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+    }
+}
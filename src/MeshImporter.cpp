@@ -0,0 +1,987 @@
+#include "../include/MeshImporter.h"
+#include "../include/MappedFile.h"
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace vulkan_rendering {
+
+    typedef std::chrono::steady_clock clock;
+
+    static const uint32_t NO_INDEX = UINT32_MAX;
+
+    static double seconds_since(clock::time_point start) {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    static bool ends_with(const std::string& value, const std::string& suffix) {
+        if (value.size() < suffix.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < suffix.size(); i++) {
+            char c = value[value.size() - suffix.size() + i];
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (c != suffix[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static std::string get_stem(const std::string& path) {
+        size_t separator = path.find_last_of("/\\");
+        std::string name = separator == std::string::npos ? path : path.substr(separator + 1);
+        size_t dot       = name.find_last_of('.');
+        return dot == std::string::npos ? name : name.substr(0, dot);
+    }
+
+    static glm::vec3 get_colour(const glm::vec3* normal) {
+        if (normal == nullptr) {
+            return glm::vec3(1.0f, 1.0f, 1.0f);
+        }
+        return glm::vec3(normal->x * 0.5f + 0.5f, normal->y * 0.5f + 0.5f, normal->z * 0.5f + 0.5f);
+    }
+
+    /**
+     * Indices are always written as 32 bit first since the vertex count is only known once every corner has been
+     * deduplicated. Small meshes get narrowed in place afterwards, which halves what has to be uploaded.
+     */
+    static void narrow_indices(ImportedMesh& mesh) {
+        if (mesh.vertices.size() > 65536) {
+            mesh.index_type = VK_INDEX_TYPE_UINT32;
+            return;
+        }
+
+        uint8_t* data = mesh.index_data.data();
+        for (uint32_t i = 0; i < mesh.index_count; i++) {
+            uint32_t index;
+            memcpy(&index, data + i * sizeof(uint32_t), sizeof(index));
+            uint16_t narrow = static_cast<uint16_t>(index);
+            memcpy(data + i * sizeof(uint16_t), &narrow, sizeof(narrow));
+        }
+
+        mesh.index_data.resize(mesh.index_count * sizeof(uint16_t));
+        mesh.index_data.shrink_to_fit();
+        mesh.index_type = VK_INDEX_TYPE_UINT16;
+    }
+
+    // OBJ
+
+    enum class ObjLine { Other, Position, Normal, Face };
+
+    struct ObjCorner {
+        uint32_t position;
+        uint32_t normal;
+    };
+
+    /**
+     * One slice of the file, cut at line boundaries. The first pass only counts v and vn lines so every chunk knows
+     * where its positions start in the shared arrays, the second pass parses straight into them.
+     */
+    struct ObjChunk {
+        const char* begin;
+        const char* end;
+        uint32_t position_count = 0;
+        uint32_t normal_count   = 0;
+        uint32_t first_position = 0;
+        uint32_t first_normal   = 0;
+        std::vector<ObjCorner> corners;
+    };
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static const char* skip_spaces(const char* p, const char* end) {
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    static ObjLine classify_line(const char*& p, const char* end) {
+        p = skip_spaces(p, end);
+        if (end - p < 2) {
+            return ObjLine::Other;
+        }
+
+        if (p[0] == 'v' && is_space(p[1])) {
+            p += 2;
+            return ObjLine::Position;
+        }
+        if (p[0] == 'f' && is_space(p[1])) {
+            p += 2;
+            return ObjLine::Face;
+        }
+        if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && is_space(p[2])) {
+            p += 3;
+            return ObjLine::Normal;
+        }
+        return ObjLine::Other;
+    }
+
+    /**
+     * strtod is locale dependent and by far the slowest part of a naive OBJ loader. Plain decimal numbers with an
+     * optional exponent are all OBJ exporters write.
+     */
+    static const char* parse_float(const char* p, const char* end, float& value) {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+            1e14, 1e15, 1e16, 1e17, 1e18};
+
+        p = skip_spaces(p, end);
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = *p == '-';
+            p++;
+        }
+
+        const char* digits_start = p;
+        uint64_t mantissa        = 0;
+        int32_t exponent         = 0;
+        int32_t digit_count      = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (digit_count < 18) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                digit_count += mantissa != 0 ? 1 : 0;
+            } else {
+                exponent++;
+            }
+        }
+
+        if (p < end && *p == '.') {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                if (digit_count < 18) {
+                    mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                    digit_count += mantissa != 0 ? 1 : 0;
+                    exponent--;
+                }
+            }
+        }
+
+        if (p == digits_start) {
+            throw std::runtime_error("Failed to parse a number in the OBJ file!");
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negative_exponent = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative_exponent = *p == '-';
+                p++;
+            }
+
+            int32_t written_exponent = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++) {
+                written_exponent = std::min(written_exponent * 10 + (*p - '0'), 1000);
+            }
+            exponent += negative_exponent ? -written_exponent : written_exponent;
+        }
+
+        double result = static_cast<double>(mantissa);
+        while (exponent > 0) {
+            int32_t step = std::min(exponent, 18);
+            result *= powers[step];
+            exponent -= step;
+        }
+        while (exponent < 0) {
+            int32_t step = std::min(-exponent, 18);
+            result /= powers[step];
+            exponent += step;
+        }
+
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    static const char* parse_int(const char* p, const char* end, int64_t& value) {
+        bool negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) {
+            p++;
+        }
+
+        value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+        }
+        value = negative ? -value : value;
+        return p;
+    }
+
+    /**
+     * OBJ indices are 1 based, negative ones count back from the last element defined before the face.
+     */
+    static uint32_t resolve_obj_index(int64_t index, uint32_t defined_count) {
+        if (index > 0) {
+            return static_cast<uint32_t>(index - 1);
+        }
+        if (index < 0 && -index <= defined_count) {
+            return static_cast<uint32_t>(defined_count + index);
+        }
+        throw std::runtime_error("OBJ face references a vertex that doesn't exist!");
+    }
+
+    static void count_obj_chunk(ObjChunk& chunk) {
+        for (const char* line = chunk.begin; line < chunk.end;) {
+            const char* line_end = static_cast<const char*>(memchr(line, '\n', chunk.end - line));
+            line_end             = line_end != nullptr ? line_end : chunk.end;
+
+            const char* p = line;
+            ObjLine type  = classify_line(p, line_end);
+            chunk.position_count += type == ObjLine::Position ? 1 : 0;
+            chunk.normal_count += type == ObjLine::Normal ? 1 : 0;
+            line = std::min(line_end + 1, chunk.end);
+        }
+    }
+
+    static void parse_obj_chunk(ObjChunk& chunk, glm::vec3* positions, glm::vec3* normals) {
+        uint32_t position_index = chunk.first_position;
+        uint32_t normal_index   = chunk.first_normal;
+        std::vector<ObjCorner> face;
+
+        for (const char* line = chunk.begin; line < chunk.end;) {
+            const char* line_end = static_cast<const char*>(memchr(line, '\n', chunk.end - line));
+            line_end             = line_end != nullptr ? line_end : chunk.end;
+
+            const char* p = line;
+            switch (classify_line(p, line_end)) {
+                case ObjLine::Position: {
+                    // Anything past xyz (w or a vertex colour) is ignored.
+                    glm::vec3& position = positions[position_index++];
+                    p = parse_float(p, line_end, position.x);
+                    p = parse_float(p, line_end, position.y);
+                    parse_float(p, line_end, position.z);
+                    break;
+                }
+                case ObjLine::Normal: {
+                    glm::vec3& normal = normals[normal_index++];
+                    p = parse_float(p, line_end, normal.x);
+                    p = parse_float(p, line_end, normal.y);
+                    parse_float(p, line_end, normal.z);
+                    break;
+                }
+                case ObjLine::Face: {
+                    // Corners are v, v/vt, v//vn or v/vt/vn, texture coordinates aren't used.
+                    face.clear();
+                    for (p = skip_spaces(p, line_end); p < line_end && *p != '#'; p = skip_spaces(p, line_end)) {
+                        int64_t position = 0;
+                        int64_t normal   = 0;
+                        p = parse_int(p, line_end, position);
+                        if (p < line_end && *p == '/') {
+                            int64_t texture_coordinate = 0;
+                            p = parse_int(p + 1, line_end, texture_coordinate);
+                            if (p < line_end && *p == '/') {
+                                p = parse_int(p + 1, line_end, normal);
+                            }
+                        }
+                        if (p < line_end && !is_space(*p)) {
+                            throw std::runtime_error("Failed to parse a face in the OBJ file!");
+                        }
+
+                        ObjCorner corner;
+                        corner.position = resolve_obj_index(position, position_index);
+                        corner.normal   = normal != 0 ? resolve_obj_index(normal, normal_index) : NO_INDEX;
+                        face.push_back(corner);
+                    }
+
+                    // Fan triangulation, fine for the convex polygons exporters write.
+                    for (size_t i = 2; i < face.size(); i++) {
+                        chunk.corners.push_back(face[0]);
+                        chunk.corners.push_back(face[i - 1]);
+                        chunk.corners.push_back(face[i]);
+                    }
+                    break;
+                }
+                case ObjLine::Other:
+                    break;
+            }
+            line = std::min(line_end + 1, chunk.end);
+        }
+    }
+
+    /**
+     * Vertices are deduplicated on their (position, normal) pair. The position index is a perfect hash, so the table
+     * is one bucket per position chaining the vertices that share it, which needs far less memory than hashing the
+     * pairs into an open addressed table sized for every corner. Chunks are freed as soon as they're consumed.
+     */
+    static ImportedMesh build_obj_mesh(std::vector<ObjChunk>& chunks, const std::vector<glm::vec3>& positions,
+        const std::vector<glm::vec3>& normals) {
+
+        uint64_t corner_count = 0;
+        for (const auto& chunk : chunks) {
+            corner_count += chunk.corners.size();
+        }
+        if (corner_count > UINT32_MAX) {
+            throw std::runtime_error("OBJ file has too many triangles!");
+        }
+
+        ImportedMesh mesh;
+        mesh.index_count = static_cast<uint32_t>(corner_count);
+        mesh.index_data.resize(corner_count * sizeof(uint32_t));
+        mesh.vertices.reserve(std::min<uint64_t>(positions.size(), corner_count));
+
+        std::vector<uint32_t> first_vertex(positions.size(), NO_INDEX);
+        std::vector<uint32_t> next_vertex;
+        std::vector<uint32_t> vertex_normal;
+        next_vertex.reserve(mesh.vertices.capacity());
+        vertex_normal.reserve(mesh.vertices.capacity());
+
+        uint8_t* index_data = mesh.index_data.data();
+        for (auto& chunk : chunks) {
+            for (const ObjCorner& corner : chunk.corners) {
+                bool normal_valid = corner.normal == NO_INDEX || corner.normal < normals.size();
+                if (corner.position >= positions.size() || !normal_valid) {
+                    throw std::runtime_error("OBJ face references a vertex that doesn't exist!");
+                }
+
+                uint32_t vertex = first_vertex[corner.position];
+                while (vertex != NO_INDEX && vertex_normal[vertex] != corner.normal) {
+                    vertex = next_vertex[vertex];
+                }
+
+                if (vertex == NO_INDEX) {
+                    vertex = static_cast<uint32_t>(mesh.vertices.size());
+
+                    Vertex new_vertex;
+                    new_vertex.pos    = positions[corner.position];
+                    new_vertex.colour = get_colour(corner.normal != NO_INDEX ? &normals[corner.normal] : nullptr);
+                    mesh.vertices.push_back(new_vertex);
+
+                    next_vertex.push_back(first_vertex[corner.position]);
+                    vertex_normal.push_back(corner.normal);
+                    first_vertex[corner.position] = vertex;
+                }
+
+                memcpy(index_data, &vertex, sizeof(vertex));
+                index_data += sizeof(vertex);
+            }
+            std::vector<ObjCorner>().swap(chunk.corners);
+        }
+
+        narrow_indices(mesh);
+        return mesh;
+    }
+
+    static std::vector<ImportedMesh> import_obj(const std::string& path, WorkerPool& pool, ImportStats& stats) {
+        auto start = clock::now();
+        MappedFile file(path);
+        const char* data = file.get_data();
+        uint64_t size    = file.get_size();
+
+        // Small files aren't worth waking the workers up for.
+        const uint64_t min_chunk_size = 1 << 20;
+        uint32_t chunk_count = static_cast<uint32_t>(std::max<uint64_t>(std::min<uint64_t>(pool.get_worker_count(),
+            size / min_chunk_size), 1));
+
+        std::vector<ObjChunk> chunks(chunk_count);
+        const char* chunk_begin = data;
+        for (uint32_t i = 0; i < chunk_count; i++) {
+            const char* chunk_end = data + size * (i + 1) / chunk_count;
+            if (i + 1 < chunk_count) {
+                const char* newline = static_cast<const char*>(memchr(chunk_end, '\n', data + size - chunk_end));
+                chunk_end           = newline != nullptr ? newline + 1 : data + size;
+            }
+
+            chunks[i].begin = chunk_begin;
+            chunks[i].end   = std::max(chunk_begin, chunk_end);
+            chunk_begin     = chunks[i].end;
+        }
+
+        pool.parallel_for(chunk_count, [&chunks](uint32_t, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                count_obj_chunk(chunks[i]);
+            }
+        });
+
+        uint64_t position_count = 0;
+        uint64_t normal_count   = 0;
+        for (auto& chunk : chunks) {
+            chunk.first_position = static_cast<uint32_t>(position_count);
+            chunk.first_normal   = static_cast<uint32_t>(normal_count);
+            position_count += chunk.position_count;
+            normal_count += chunk.normal_count;
+        }
+        if (position_count >= NO_INDEX || normal_count >= NO_INDEX) {
+            throw std::runtime_error("OBJ file has too many vertices! " + path);
+        }
+
+        std::vector<glm::vec3> positions(position_count);
+        std::vector<glm::vec3> normals(normal_count);
+        pool.parallel_for(chunk_count, [&](uint32_t, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                parse_obj_chunk(chunks[i], positions.data(), normals.data());
+            }
+        });
+        stats.parse_seconds += seconds_since(start);
+
+        start = clock::now();
+        std::vector<ImportedMesh> meshes;
+        meshes.push_back(build_obj_mesh(chunks, positions, normals));
+        meshes.back().name = get_stem(path);
+        stats.corner_count += meshes.back().index_count;
+        stats.build_seconds += seconds_since(start);
+        return meshes;
+    }
+
+    // glTF
+
+    /**
+     * Just enough JSON for a glTF document. Objects keep their members in file order, documents are small enough
+     * that a linear lookup doesn't matter next to the binary buffers.
+     */
+    struct JsonValue {
+        enum class Type { Null, Bool, Number, String, Array, Object };
+
+        Type type     = Type::Null;
+        bool boolean  = false;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> array;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue* find(const char* key) const {
+            for (const auto& member : members) {
+                if (member.first == key) {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+
+        uint32_t get_index(const char* key, uint32_t fallback) const {
+            const JsonValue* value = find(key);
+            return value != nullptr && value->type == Type::Number ? static_cast<uint32_t>(value->number) : fallback;
+        }
+
+        const JsonValue& get_element(const char* key, uint32_t index) const {
+            const JsonValue* value = find(key);
+            if (value == nullptr || value->type != Type::Array || index >= value->array.size()) {
+                throw std::runtime_error(std::string("glTF file references a missing element of ") + key + "!");
+            }
+            return value->array[index];
+        }
+    };
+
+    class JsonParser {
+
+        public:
+            JsonParser(const char* begin, const char* end) : p(begin), end(end) {}
+
+            JsonValue parse_document() {
+                JsonValue value = parse_value(0);
+                skip_whitespace();
+                if (p != end) {
+                    fail();
+                }
+                return value;
+            }
+
+        private:
+            const char* p;
+            const char* end;
+
+            void fail() const {
+                throw std::runtime_error("Failed to parse the glTF JSON!");
+            }
+
+            void skip_whitespace() {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+                    p++;
+                }
+            }
+
+            void expect(char c) {
+                skip_whitespace();
+                if (p >= end || *p != c) {
+                    fail();
+                }
+                p++;
+            }
+
+            bool consume(const char* literal) {
+                size_t length = strlen(literal);
+                if (static_cast<size_t>(end - p) < length || memcmp(p, literal, length) != 0) {
+                    return false;
+                }
+                p += length;
+                return true;
+            }
+
+            bool consume_separator() {
+                skip_whitespace();
+                if (p < end && *p == ',') {
+                    p++;
+                    return true;
+                }
+                return false;
+            }
+
+            JsonValue parse_value(uint32_t depth) {
+                if (depth > 64) {
+                    fail();
+                }
+
+                skip_whitespace();
+                if (p >= end) {
+                    fail();
+                }
+
+                JsonValue value;
+                if (*p == '{') {
+                    value.type = JsonValue::Type::Object;
+                    p++;
+                    skip_whitespace();
+                    if (p < end && *p == '}') {
+                        p++;
+                        return value;
+                    }
+                    while (true) {
+                        skip_whitespace();
+                        std::string key = parse_string();
+                        expect(':');
+                        value.members.emplace_back(std::move(key), parse_value(depth + 1));
+                        if (!consume_separator()) {
+                            break;
+                        }
+                    }
+                    expect('}');
+                } else if (*p == '[') {
+                    value.type = JsonValue::Type::Array;
+                    p++;
+                    skip_whitespace();
+                    if (p < end && *p == ']') {
+                        p++;
+                        return value;
+                    }
+                    while (true) {
+                        value.array.push_back(parse_value(depth + 1));
+                        if (!consume_separator()) {
+                            break;
+                        }
+                    }
+                    expect(']');
+                } else if (*p == '"') {
+                    value.type   = JsonValue::Type::String;
+                    value.string = parse_string();
+                } else if (consume("true")) {
+                    value.type    = JsonValue::Type::Bool;
+                    value.boolean = true;
+                } else if (consume("false")) {
+                    value.type = JsonValue::Type::Bool;
+                } else if (consume("null")) {
+                    value.type = JsonValue::Type::Null;
+                } else {
+                    // The buffer isn't null terminated, so the number is copied out before strtod sees it.
+                    const char* start = p;
+                    while (p < end && (strchr("+-.eE", *p) != nullptr || (*p >= '0' && *p <= '9'))) {
+                        p++;
+                    }
+                    std::string text(start, p);
+                    char* parsed_end = nullptr;
+                    value.type       = JsonValue::Type::Number;
+                    value.number     = strtod(text.c_str(), &parsed_end);
+                    if (text.empty() || parsed_end != text.c_str() + text.size()) {
+                        fail();
+                    }
+                }
+                return value;
+            }
+
+            static void append_utf8(std::string& text, uint32_t code_point) {
+                if (code_point < 0x80) {
+                    text += static_cast<char>(code_point);
+                } else if (code_point < 0x800) {
+                    text += static_cast<char>(0xc0 | (code_point >> 6));
+                    text += static_cast<char>(0x80 | (code_point & 0x3f));
+                } else {
+                    text += static_cast<char>(0xe0 | (code_point >> 12));
+                    text += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+                    text += static_cast<char>(0x80 | (code_point & 0x3f));
+                }
+            }
+
+            std::string parse_string() {
+                if (p >= end || *p != '"') {
+                    fail();
+                }
+
+                std::string text;
+                for (p++; p < end && *p != '"'; p++) {
+                    if (*p != '\\') {
+                        text += *p;
+                        continue;
+                    }
+
+                    if (++p >= end) {
+                        fail();
+                    }
+                    switch (*p) {
+                        case 'b': text += '\b'; break;
+                        case 'f': text += '\f'; break;
+                        case 'n': text += '\n'; break;
+                        case 'r': text += '\r'; break;
+                        case 't': text += '\t'; break;
+                        case 'u': {
+                            if (end - p < 5) {
+                                fail();
+                            }
+                            char hex[5] = {p[1], p[2], p[3], p[4], 0};
+                            append_utf8(text, static_cast<uint32_t>(strtoul(hex, nullptr, 16)));
+                            p += 4;
+                            break;
+                        }
+                        default: text += *p; break;
+                    }
+                }
+                expect('"');
+                return text;
+            }
+    };
+
+    struct GltfAccessor {
+        const char* data        = nullptr;
+        uint64_t stride         = 0;
+        uint32_t count          = 0;
+        uint32_t component_type = 0;
+        uint32_t components     = 0;
+    };
+
+    static const uint32_t GLTF_UNSIGNED_BYTE  = 5121;
+    static const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+    static const uint32_t GLTF_UNSIGNED_INT   = 5125;
+    static const uint32_t GLTF_FLOAT          = 5126;
+    static const uint32_t GLTF_TRIANGLES      = 4;
+
+    static uint32_t get_component_size(uint32_t component_type) {
+        switch (component_type) {
+            case GLTF_UNSIGNED_BYTE: return 1;
+            case GLTF_UNSIGNED_SHORT: return 2;
+            case GLTF_UNSIGNED_INT: return 4;
+            case GLTF_FLOAT: return 4;
+            default: throw std::runtime_error("glTF accessor has an unsupported component type!");
+        }
+    }
+
+    static uint32_t get_component_count(const std::string& type) {
+        if (type == "SCALAR") {
+            return 1;
+        }
+        if (type == "VEC2") {
+            return 2;
+        }
+        if (type == "VEC3") {
+            return 3;
+        }
+        if (type == "VEC4") {
+            return 4;
+        }
+        throw std::runtime_error("glTF accessor has an unsupported type! " + type);
+    }
+
+    static std::string decode_uri(const std::string& uri) {
+        std::string decoded;
+        for (size_t i = 0; i < uri.size(); i++) {
+            if (uri[i] == '%' && i + 2 < uri.size()) {
+                char hex[3] = {uri[i + 1], uri[i + 2], 0};
+                decoded += static_cast<char>(strtoul(hex, nullptr, 16));
+                i += 2;
+            } else {
+                decoded += uri[i];
+            }
+        }
+        return decoded;
+    }
+
+    /**
+     * Accessors read straight out of the mapped .bin files. Sparse accessors aren't supported.
+     */
+    static GltfAccessor get_accessor(const JsonValue& document, const std::vector<std::unique_ptr<MappedFile>>& buffers,
+        uint32_t index) {
+
+        const JsonValue& accessor = document.get_element("accessors", index);
+        if (accessor.find("sparse") != nullptr || accessor.find("bufferView") == nullptr) {
+            throw std::runtime_error("glTF sparse accessors aren't supported!");
+        }
+
+        const JsonValue* type = accessor.find("type");
+        GltfAccessor result;
+        result.count          = accessor.get_index("count", 0);
+        result.component_type = accessor.get_index("componentType", 0);
+        result.components     = get_component_count(type != nullptr ? type->string : std::string());
+
+        const JsonValue& view = document.get_element("bufferViews", accessor.get_index("bufferView", 0));
+        uint32_t buffer_index = view.get_index("buffer", 0);
+        if (buffer_index >= buffers.size()) {
+            throw std::runtime_error("glTF buffer view references a missing buffer!");
+        }
+
+        uint64_t element_size = static_cast<uint64_t>(get_component_size(result.component_type)) * result.components;
+        uint64_t view_offset  = view.get_index("byteOffset", 0);
+        uint64_t view_length  = view.get_index("byteLength", 0);
+        uint64_t offset       = accessor.get_index("byteOffset", 0);
+        result.stride         = view.get_index("byteStride", 0);
+        result.stride         = result.stride != 0 ? result.stride : element_size;
+
+        const MappedFile& buffer = *buffers[buffer_index];
+        uint64_t last_byte       = result.count == 0 ? 0 : offset + (result.count - 1) * result.stride + element_size;
+        if (view_offset + view_length > buffer.get_size() || last_byte > view_length) {
+            throw std::runtime_error("glTF accessor points past the end of its buffer! " + buffer.get_path());
+        }
+
+        result.data = buffer.get_data() + view_offset + offset;
+        return result;
+    }
+
+    static glm::vec3 read_vec3(const GltfAccessor& accessor, uint32_t index) {
+        glm::vec3 value;
+        memcpy(&value, accessor.data + index * accessor.stride, sizeof(value));
+        return value;
+    }
+
+    static glm::vec3 read_colour(const GltfAccessor& accessor, uint32_t index) {
+        const char* element = accessor.data + index * accessor.stride;
+        float channels[3];
+        for (uint32_t i = 0; i < 3; i++) {
+            if (accessor.component_type == GLTF_FLOAT) {
+                memcpy(&channels[i], element + i * sizeof(float), sizeof(float));
+            } else if (accessor.component_type == GLTF_UNSIGNED_SHORT) {
+                uint16_t channel;
+                memcpy(&channel, element + i * sizeof(uint16_t), sizeof(channel));
+                channels[i] = channel / 65535.0f;
+            } else {
+                channels[i] = static_cast<uint8_t>(element[i]) / 255.0f;
+            }
+        }
+        return glm::vec3(channels[0], channels[1], channels[2]);
+    }
+
+    static uint32_t read_index(const GltfAccessor& accessor, uint32_t index) {
+        const char* element = accessor.data + index * accessor.stride;
+        if (accessor.component_type == GLTF_UNSIGNED_BYTE) {
+            return static_cast<uint8_t>(*element);
+        }
+        if (accessor.component_type == GLTF_UNSIGNED_SHORT) {
+            uint16_t value;
+            memcpy(&value, element, sizeof(value));
+            return value;
+        }
+
+        uint32_t value;
+        memcpy(&value, element, sizeof(value));
+        return value;
+    }
+
+    static uint64_t hash_vertex(const Vertex& vertex) {
+        uint64_t hash = 14695981039346656037ull;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+        for (size_t i = 0; i < sizeof(Vertex); i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    struct GltfPrimitive {
+        std::string name;
+        const JsonValue* primitive;
+    };
+
+    /**
+     * Exporters often split vertices that end up identical once only position and colour are kept, so they're
+     * deduplicated on their contents with an open addressed table that is kept at most half full. Since the source
+     * indices get remapped anyway, the vertex count is known before the indices are written and they go straight out
+     * in the right width.
+     */
+    static ImportedMesh build_gltf_mesh(const JsonValue& document,
+        const std::vector<std::unique_ptr<MappedFile>>& buffers, const GltfPrimitive& source) {
+
+        const JsonValue* attributes = source.primitive->find("attributes");
+        if (attributes == nullptr || attributes->find("POSITION") == nullptr) {
+            throw std::runtime_error("glTF primitive has no positions! " + source.name);
+        }
+
+        GltfAccessor positions = get_accessor(document, buffers, attributes->get_index("POSITION", 0));
+        if (positions.component_type != GLTF_FLOAT || positions.components != 3) {
+            throw std::runtime_error("glTF positions have to be float vec3! " + source.name);
+        }
+
+        GltfAccessor normals;
+        GltfAccessor colours;
+        if (attributes->find("NORMAL") != nullptr) {
+            normals = get_accessor(document, buffers, attributes->get_index("NORMAL", 0));
+        }
+        if (attributes->find("COLOR_0") != nullptr) {
+            colours = get_accessor(document, buffers, attributes->get_index("COLOR_0", 0));
+        }
+
+        bool has_normals = normals.data != nullptr && normals.component_type == GLTF_FLOAT &&
+            normals.components == 3 && normals.count >= positions.count;
+        bool has_colours = colours.data != nullptr && colours.components >= 3 && colours.count >= positions.count &&
+            colours.component_type != GLTF_UNSIGNED_INT;
+
+        uint32_t table_size = 16;
+        while (table_size < static_cast<uint64_t>(positions.count) * 2) {
+            table_size *= 2;
+        }
+        std::vector<uint32_t> table(table_size, NO_INDEX);
+        std::vector<uint32_t> remap(positions.count);
+
+        ImportedMesh mesh;
+        mesh.name = source.name;
+        mesh.vertices.reserve(positions.count);
+
+        for (uint32_t i = 0; i < positions.count; i++) {
+            Vertex vertex;
+            vertex.pos = read_vec3(positions, i);
+            if (has_colours) {
+                vertex.colour = read_colour(colours, i);
+            } else if (has_normals) {
+                glm::vec3 normal = read_vec3(normals, i);
+                vertex.colour    = get_colour(&normal);
+            } else {
+                vertex.colour = get_colour(nullptr);
+            }
+
+            uint32_t slot = static_cast<uint32_t>(hash_vertex(vertex)) & (table_size - 1);
+            while (table[slot] != NO_INDEX && memcmp(&mesh.vertices[table[slot]], &vertex, sizeof(Vertex)) != 0) {
+                slot = (slot + 1) & (table_size - 1);
+            }
+
+            if (table[slot] == NO_INDEX) {
+                table[slot] = static_cast<uint32_t>(mesh.vertices.size());
+                mesh.vertices.push_back(vertex);
+            }
+            remap[i] = table[slot];
+        }
+        std::vector<uint32_t>().swap(table);
+        mesh.vertices.shrink_to_fit();
+
+        GltfAccessor indices;
+        bool indexed = source.primitive->find("indices") != nullptr;
+        if (indexed) {
+            indices = get_accessor(document, buffers, source.primitive->get_index("indices", 0));
+            if (indices.components != 1 || indices.component_type == GLTF_FLOAT) {
+                throw std::runtime_error("glTF indices have to be unsigned integers! " + source.name);
+            }
+        }
+
+        mesh.index_count = (indexed ? indices.count : positions.count) / 3 * 3;
+        mesh.index_type  = mesh.vertices.size() > 65536 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+        mesh.index_data.resize(static_cast<size_t>(mesh.index_count) * get_index_size(mesh.index_type));
+
+        uint8_t* index_data = mesh.index_data.data();
+        for (uint32_t i = 0; i < mesh.index_count; i++) {
+            uint32_t index = indexed ? read_index(indices, i) : i;
+            if (index >= positions.count) {
+                throw std::runtime_error("glTF index points past the last vertex! " + source.name);
+            }
+
+            uint32_t vertex = remap[index];
+            if (mesh.index_type == VK_INDEX_TYPE_UINT16) {
+                uint16_t narrow = static_cast<uint16_t>(vertex);
+                memcpy(index_data + i * sizeof(uint16_t), &narrow, sizeof(narrow));
+            } else {
+                memcpy(index_data + i * sizeof(uint32_t), &vertex, sizeof(vertex));
+            }
+        }
+        return mesh;
+    }
+
+    static std::vector<ImportedMesh> import_gltf(const std::string& path, WorkerPool& pool, ImportStats& stats) {
+        auto start = clock::now();
+        JsonValue document;
+        {
+            MappedFile file(path);
+            document = JsonParser(file.get_data(), file.get_data() + file.get_size()).parse_document();
+        }
+
+        size_t separator      = path.find_last_of("/\\");
+        std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+
+        std::vector<std::unique_ptr<MappedFile>> buffers;
+        const JsonValue* buffer_list = document.find("buffers");
+        for (size_t i = 0; buffer_list != nullptr && i < buffer_list->array.size(); i++) {
+            const JsonValue* uri = buffer_list->array[i].find("uri");
+            if (uri == nullptr || uri->string.compare(0, 5, "data:") == 0) {
+                throw std::runtime_error("Only glTF files with external .bin buffers are supported! " + path);
+            }
+            buffers.push_back(std::unique_ptr<MappedFile>(new MappedFile(directory + decode_uri(uri->string))));
+        }
+
+        std::string stem = get_stem(path);
+        std::vector<GltfPrimitive> primitives;
+        const JsonValue* mesh_list = document.find("meshes");
+        for (size_t i = 0; mesh_list != nullptr && i < mesh_list->array.size(); i++) {
+            const JsonValue& mesh           = mesh_list->array[i];
+            const JsonValue* name           = mesh.find("name");
+            const JsonValue* primitive_list = mesh.find("primitives");
+            std::string mesh_name           = stem + "/" + (name != nullptr && !name->string.empty() ? name->string :
+                std::to_string(i));
+
+            for (size_t j = 0; primitive_list != nullptr && j < primitive_list->array.size(); j++) {
+                const JsonValue& primitive = primitive_list->array[j];
+                if (primitive.get_index("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES) {
+                    continue;
+                }
+
+                GltfPrimitive source;
+                source.name      = primitive_list->array.size() > 1 ? mesh_name + "_" + std::to_string(j) : mesh_name;
+                source.primitive = &primitive;
+                primitives.push_back(source);
+            }
+        }
+        stats.parse_seconds += seconds_since(start);
+
+        start = clock::now();
+        std::vector<ImportedMesh> meshes(primitives.size());
+        pool.parallel_for(static_cast<uint32_t>(primitives.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                meshes[i] = build_gltf_mesh(document, buffers, primitives[i]);
+            }
+        });
+
+        for (const auto& mesh : meshes) {
+            stats.corner_count += mesh.index_count;
+        }
+        stats.build_seconds += seconds_since(start);
+        return meshes;
+    }
+
+    void ImportStats::print(std::ostream& stream) const {
+        stream << "Imported " << triangle_count << " triangles, " << vertex_count << " vertices (" << corner_count <<
+            " before deduplication) in " << (parse_seconds + build_seconds) * 1000.0 << " ms (parse " <<
+            parse_seconds * 1000.0 << " ms, build " << build_seconds * 1000.0 << " ms)" << std::endl;
+    }
+
+    std::vector<ImportedMesh> import_meshes(const std::string& path, uint32_t worker_count, ImportStats* stats) {
+        ImportStats local_stats;
+        ImportStats& import_stats = stats != nullptr ? *stats : local_stats;
+        WorkerPool pool(worker_count);
+
+        std::vector<ImportedMesh> meshes;
+        if (ends_with(path, ".obj")) {
+            meshes = import_obj(path, pool, import_stats);
+        } else if (ends_with(path, ".gltf")) {
+            meshes = import_gltf(path, pool, import_stats);
+        } else {
+            throw std::runtime_error("Unsupported mesh format! " + path);
+        }
+
+        for (const auto& mesh : meshes) {
+            import_stats.vertex_count += mesh.vertices.size();
+            import_stats.triangle_count += mesh.index_count / 3;
+        }
+        if (import_stats.triangle_count == 0) {
+            throw std::runtime_error("Model has no triangles! " + path);
+        }
+        return meshes;
+    }
+}
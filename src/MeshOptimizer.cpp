@@ -0,0 +1,425 @@
+#include "../include/MeshOptimizer.h"
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace vulkan_rendering {
+
+    static const uint32_t NO_INDEX = UINT32_MAX;
+
+    void VertexCacheStats::add(const VertexCacheStats& other) {
+        triangle_count += other.triangle_count;
+        vertex_count += other.vertex_count;
+        miss_count += other.miss_count;
+    }
+
+    void MeshOptimizeStats::print(std::ostream& stream) const {
+        stream << "Optimized meshes in " << seconds * 1000.0 << " ms: ACMR " << before.get_acmr() << " -> " <<
+            after.get_acmr() << ", ATVR " << before.get_atvr() << " -> " << after.get_atvr() << std::endl;
+    }
+
+    /**
+     * A vertex is in the cache when fewer than cache_size misses happened since it was last loaded, that way the FIFO
+     * never has to be stored explicitly.
+     */
+    VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+        uint32_t cache_size) {
+
+        VertexCacheStats stats;
+        stats.triangle_count = index_count / 3;
+
+        std::vector<uint64_t> loaded_at(vertex_count, 0);
+        uint64_t clock = cache_size + 1;
+        for (uint32_t i = 0; i < index_count; i++) {
+            uint32_t vertex = indices[i];
+            if (clock - loaded_at[vertex] > cache_size) {
+                stats.vertex_count += loaded_at[vertex] == 0 ? 1 : 0;
+                loaded_at[vertex] = clock++;
+                stats.miss_count++;
+            }
+        }
+        return stats;
+    }
+
+    // Forsyth's constants, the scoring assumes an LRU cache of this many entries.
+    static const uint32_t SCORE_CACHE_SIZE = 32;
+    static const uint32_t MAX_VALENCE      = 32;
+
+    struct ScoreTables {
+        float cache[SCORE_CACHE_SIZE + 1];
+        float valence[MAX_VALENCE + 1];
+
+        ScoreTables() {
+            // Slot 0 is "not in the cache". The last triangle's vertices get a fixed score so the next one doesn't
+            // prefer one of its three vertices over another.
+            cache[0] = 0.0f;
+            for (uint32_t i = 0; i < SCORE_CACHE_SIZE; i++) {
+                cache[i + 1] = i < 3 ? 0.75f : std::pow(1.0f - (i - 3) / static_cast<float>(SCORE_CACHE_SIZE - 3),
+                    1.5f);
+            }
+
+            valence[0] = 0.0f;
+            for (uint32_t i = 1; i <= MAX_VALENCE; i++) {
+                valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+            }
+        }
+
+        float get_score(int32_t cache_position, uint32_t live_triangles) const {
+            if (live_triangles == 0) {
+                return -1.0f;
+            }
+            return cache[cache_position + 1] + valence[std::min(live_triangles, MAX_VALENCE)];
+        }
+    };
+
+    void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count,
+        std::vector<uint32_t>* cluster_starts) {
+
+        static const ScoreTables scores;
+        uint32_t triangle_count = index_count / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // Per vertex list of the triangles still waiting to be emitted, built with a counting pass.
+        std::vector<uint32_t> live(vertex_count, 0);
+        for (uint32_t i = 0; i < triangle_count * 3; i++) {
+            live[indices[i]]++;
+        }
+
+        std::vector<uint32_t> first_triangle(vertex_count + 1, 0);
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            first_triangle[v + 1] = first_triangle[v] + live[v];
+        }
+
+        std::vector<uint32_t> adjacency(triangle_count * 3);
+        std::vector<uint32_t> fill(first_triangle.begin(), first_triangle.end() - 1);
+        for (uint32_t i = 0; i < triangle_count * 3; i++) {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+        std::vector<uint32_t>().swap(fill);
+
+        std::vector<int32_t> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+        for (uint32_t v = 0; v < vertex_count; v++) {
+            vertex_score[v] = scores.get_score(-1, live[v]);
+        }
+
+        std::vector<float> triangle_score(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (uint32_t t = 0; t < triangle_count; t++) {
+            triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] +
+                vertex_score[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint32_t> output(triangle_count * 3);
+        uint32_t cache[SCORE_CACHE_SIZE + 3];
+        uint32_t next_cache[SCORE_CACHE_SIZE + 3];
+        uint32_t cache_count = 0;
+        uint32_t cursor      = 0;
+        uint32_t best        = NO_INDEX;
+
+        for (uint32_t written = 0; written < triangle_count; written++) {
+            if (best == NO_INDEX) {
+                // Nothing in the cache touches a live triangle, start again from the next one in input order.
+                while (emitted[cursor]) {
+                    cursor++;
+                }
+                best = cursor;
+                if (cluster_starts != nullptr) {
+                    cluster_starts->push_back(written * 3);
+                }
+            }
+
+            const uint32_t* triangle = indices + best * 3;
+            memcpy(&output[written * 3], triangle, sizeof(uint32_t) * 3);
+            emitted[best] = true;
+
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t vertex = triangle[k];
+                uint32_t* list  = &adjacency[first_triangle[vertex]];
+                for (uint32_t j = 0; j < live[vertex]; j++) {
+                    if (list[j] == best) {
+                        std::swap(list[j], list[live[vertex] - 1]);
+                        break;
+                    }
+                }
+                live[vertex]--;
+            }
+
+            // The triangle's vertices move to the front, everything else shifts back and may fall out.
+            uint32_t next_count = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                next_cache[next_count++] = triangle[k];
+            }
+            for (uint32_t i = 0; i < cache_count; i++) {
+                uint32_t vertex = cache[i];
+                if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                    next_cache[next_count++] = vertex;
+                }
+            }
+
+            for (uint32_t i = 0; i < next_count; i++) {
+                uint32_t vertex        = next_cache[i];
+                cache_position[vertex] = i < SCORE_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+
+                float score = scores.get_score(cache_position[vertex], live[vertex]);
+                float delta = score - vertex_score[vertex];
+                vertex_score[vertex] = score;
+
+                const uint32_t* list = &adjacency[first_triangle[vertex]];
+                for (uint32_t j = 0; j < live[vertex]; j++) {
+                    triangle_score[list[j]] += delta;
+                }
+            }
+
+            cache_count = std::min(next_count, SCORE_CACHE_SIZE);
+            memcpy(cache, next_cache, cache_count * sizeof(uint32_t));
+
+            best             = NO_INDEX;
+            float best_score = -1.0f;
+            for (uint32_t i = 0; i < cache_count; i++) {
+                uint32_t vertex      = cache[i];
+                const uint32_t* list = &adjacency[first_triangle[vertex]];
+                for (uint32_t j = 0; j < live[vertex]; j++) {
+                    if (triangle_score[list[j]] > best_score) {
+                        best_score = triangle_score[list[j]];
+                        best       = list[j];
+                    }
+                }
+            }
+        }
+
+        memcpy(indices, output.data(), output.size() * sizeof(uint32_t));
+    }
+
+    struct OverdrawCluster {
+        uint32_t first_index;
+        uint32_t index_count;
+        float sort_key;
+    };
+
+    /**
+     * Same FIFO model as analyze_vertex_cache, but the stamps are shared between calls. Bumping the clock past the
+     * cache size is what empties the cache, that's much cheaper than clearing the stamps for every cluster.
+     */
+    struct CacheReplay {
+        static const uint32_t CACHE_SIZE = 16;
+
+        std::vector<uint64_t> loaded_at;
+        uint64_t clock = 0;
+
+        explicit CacheReplay(uint32_t vertex_count) : loaded_at(vertex_count, 0) {}
+
+        void flush() {
+            clock += CACHE_SIZE + 1;
+        }
+
+        uint32_t replay_triangle(const uint32_t* triangle) {
+            uint32_t misses = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                if (clock - loaded_at[triangle[k]] > CACHE_SIZE) {
+                    loaded_at[triangle[k]] = clock++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+    };
+
+    /**
+     * Soft boundaries go wherever a cluster replayed from a cold cache gets within threshold of the ACMR of the hard
+     * cluster it's in, splitting there costs at most that much vertex reuse.
+     */
+    static void split_cluster(const uint32_t* indices, uint32_t begin, uint32_t end, float threshold,
+        CacheReplay& replay, std::vector<uint32_t>& starts) {
+
+        uint64_t misses = 0;
+        replay.flush();
+        for (uint32_t i = begin; i < end; i += 3) {
+            misses += replay.replay_triangle(indices + i);
+        }
+        double target = threshold * misses / ((end - begin) / 3);
+
+        starts.push_back(begin);
+        uint64_t cluster_misses    = 0;
+        uint64_t cluster_triangles = 0;
+        replay.flush();
+
+        for (uint32_t i = begin; i < end; i += 3) {
+            cluster_misses += replay.replay_triangle(indices + i);
+            cluster_triangles++;
+
+            if (i + 3 < end && cluster_misses <= target * cluster_triangles) {
+                starts.push_back(i + 3);
+                cluster_misses    = 0;
+                cluster_triangles = 0;
+                replay.flush();
+            }
+        }
+    }
+
+    void optimize_overdraw(uint32_t* indices, uint32_t index_count, const Vertex* vertices,
+        const std::vector<uint32_t>& cluster_starts, float threshold) {
+
+        index_count = index_count / 3 * 3;
+        if (index_count == 0) {
+            return;
+        }
+
+        uint32_t vertex_count = 0;
+        for (uint32_t i = 0; i < index_count; i++) {
+            vertex_count = std::max(vertex_count, indices[i] + 1);
+        }
+
+        CacheReplay replay(vertex_count);
+        std::vector<uint32_t> starts;
+        for (size_t i = 0; i < cluster_starts.size(); i++) {
+            uint32_t begin = cluster_starts[i];
+            uint32_t end   = i + 1 < cluster_starts.size() ? cluster_starts[i + 1] : index_count;
+            split_cluster(indices, begin, end, threshold, replay, starts);
+        }
+        if (starts.empty() || starts[0] != 0) {
+            starts.insert(starts.begin(), 0);
+        }
+
+        glm::vec3 mesh_centre(0.0f);
+        for (uint32_t i = 0; i < index_count; i++) {
+            mesh_centre += vertices[indices[i]].pos;
+        }
+        mesh_centre = mesh_centre / static_cast<float>(index_count);
+
+        // The key is how far the cluster's area weighted centroid sits out along its average normal.
+        std::vector<OverdrawCluster> clusters(starts.size());
+        for (size_t i = 0; i < starts.size(); i++) {
+            OverdrawCluster& cluster = clusters[i];
+            cluster.first_index      = starts[i];
+            cluster.index_count      = (i + 1 < starts.size() ? starts[i + 1] : index_count) - starts[i];
+            cluster.sort_key         = 0.0f;
+
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            for (uint32_t j = cluster.first_index; j < cluster.first_index + cluster.index_count; j += 3) {
+                const glm::vec3& a = vertices[indices[j]].pos;
+                const glm::vec3& b = vertices[indices[j + 1]].pos;
+                const glm::vec3& c = vertices[indices[j + 2]].pos;
+
+                glm::vec3 face  = glm::cross(b - a, c - a);
+                float face_area = glm::length(face);
+                centroid += (a + b + c) * (face_area / 3.0f);
+                normal += face;
+                area += face_area;
+            }
+
+            float normal_length = glm::length(normal);
+            if (area > 0.0f && normal_length > 0.0f) {
+                cluster.sort_key = glm::dot(centroid / area - mesh_centre, normal) / normal_length;
+            }
+        }
+
+        std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster& a, const OverdrawCluster& b) {
+            return a.sort_key > b.sort_key;
+        });
+
+        std::vector<uint32_t> output;
+        output.reserve(index_count);
+        for (const auto& cluster : clusters) {
+            output.insert(output.end(), indices + cluster.first_index,
+                indices + cluster.first_index + cluster.index_count);
+        }
+        memcpy(indices, output.data(), index_count * sizeof(uint32_t));
+    }
+
+    uint32_t optimize_vertex_fetch(Vertex* vertices, uint32_t vertex_count, uint32_t* indices, uint32_t index_count) {
+        std::vector<uint32_t> remap(vertex_count, NO_INDEX);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertex_count);
+
+        for (uint32_t i = 0; i < index_count; i++) {
+            uint32_t& new_index = remap[indices[i]];
+            if (new_index == NO_INDEX) {
+                new_index = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[indices[i]]);
+            }
+            indices[i] = new_index;
+        }
+
+        std::copy(reordered.begin(), reordered.end(), vertices);
+        return static_cast<uint32_t>(reordered.size());
+    }
+
+    void optimize_mesh(ImportedMesh& mesh, MeshOptimizeStats* stats) {
+        auto start            = std::chrono::steady_clock::now();
+        uint32_t index_count  = mesh.index_count / 3 * 3;
+        uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+        uint32_t index_size   = get_index_size(mesh.index_type);
+
+        std::vector<uint32_t> indices(index_count);
+        for (uint32_t i = 0; i < index_count; i++) {
+            if (index_size == sizeof(uint16_t)) {
+                uint16_t index;
+                memcpy(&index, mesh.index_data.data() + i * sizeof(uint16_t), sizeof(index));
+                indices[i] = index;
+            } else {
+                memcpy(&indices[i], mesh.index_data.data() + i * sizeof(uint32_t), sizeof(uint32_t));
+            }
+        }
+
+        MeshOptimizeStats mesh_stats;
+        mesh_stats.before = analyze_vertex_cache(indices.data(), index_count, vertex_count);
+
+        std::vector<uint32_t> cluster_starts;
+        optimize_vertex_cache(indices.data(), index_count, vertex_count, &cluster_starts);
+        optimize_overdraw(indices.data(), index_count, mesh.vertices.data(), cluster_starts);
+        vertex_count = optimize_vertex_fetch(mesh.vertices.data(), vertex_count, indices.data(), index_count);
+        mesh.vertices.resize(vertex_count);
+
+        mesh_stats.after = analyze_vertex_cache(indices.data(), index_count, vertex_count);
+
+        mesh.index_count = index_count;
+        mesh.index_type  = vertex_count > 65536 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+        mesh.index_data.resize(static_cast<size_t>(index_count) * get_index_size(mesh.index_type));
+        for (uint32_t i = 0; i < index_count; i++) {
+            if (mesh.index_type == VK_INDEX_TYPE_UINT16) {
+                uint16_t index = static_cast<uint16_t>(indices[i]);
+                memcpy(mesh.index_data.data() + i * sizeof(uint16_t), &index, sizeof(index));
+            } else {
+                memcpy(mesh.index_data.data() + i * sizeof(uint32_t), &indices[i], sizeof(uint32_t));
+            }
+        }
+        mesh.index_data.shrink_to_fit();
+
+        if (stats != nullptr) {
+            mesh_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            *stats             = mesh_stats;
+        }
+    }
+
+    void optimize_meshes(std::vector<ImportedMesh>& meshes, uint32_t worker_count, MeshOptimizeStats* stats) {
+        auto start = std::chrono::steady_clock::now();
+        MeshOptimizeStats total;
+        std::mutex mutex;
+
+        WorkerPool pool(worker_count);
+        pool.parallel_for(static_cast<uint32_t>(meshes.size()), [&](uint32_t, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                MeshOptimizeStats mesh_stats;
+                optimize_mesh(meshes[i], &mesh_stats);
+
+                std::lock_guard<std::mutex> lock(mutex);
+                total.before.add(mesh_stats.before);
+                total.after.add(mesh_stats.after);
+            }
+        });
+
+        if (stats != nullptr) {
+            total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            *stats        = total;
+        }
+    }
+}
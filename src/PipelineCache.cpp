@@ -0,0 +1,344 @@
+#include "../include/PipelineCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace vulkan_rendering {
+
+    void PipelineHasher::add(const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        if (keep_state) {
+            state.insert(state.end(), bytes, bytes + size);
+        }
+    }
+
+    void PipelineHasher::add_shader(VkShaderStageFlagBits stage, const char* entry_point, const void* code,
+        size_t size) {
+
+        add(stage);
+        add(entry_point, strlen(entry_point));
+        add(size);
+        add(code, size);
+    }
+
+    void PipelineHasher::add_render_pass(const VkRenderPassCreateInfo& info) {
+        add(info.flags);
+
+        add(info.attachmentCount);
+        for (uint32_t i = 0; i < info.attachmentCount; i++) {
+            add(info.pAttachments[i].format);
+            add(info.pAttachments[i].samples);
+        }
+
+        // Only the attachment indices of the references matter for compatibility, their layouts don't.
+        auto add_references = [this](uint32_t count, const VkAttachmentReference* references) {
+            add(count);
+            for (uint32_t i = 0; references != nullptr && i < count; i++) {
+                add(references[i].attachment);
+            }
+        };
+
+        add(info.subpassCount);
+        for (uint32_t i = 0; i < info.subpassCount; i++) {
+            const VkSubpassDescription& subpass = info.pSubpasses[i];
+            add(subpass.flags);
+            add(subpass.pipelineBindPoint);
+            add_references(subpass.inputAttachmentCount, subpass.pInputAttachments);
+            add_references(subpass.colorAttachmentCount, subpass.pColorAttachments);
+            add_references(subpass.pResolveAttachments != nullptr ? subpass.colorAttachmentCount : 0,
+                subpass.pResolveAttachments);
+            add_references(subpass.pDepthStencilAttachment != nullptr ? 1 : 0, subpass.pDepthStencilAttachment);
+        }
+
+        // VkSubpassDependency is made of 32 bit members only, so there's no padding to worry about.
+        add(info.dependencyCount);
+        if (info.dependencyCount > 0) {
+            add(info.pDependencies, sizeof(VkSubpassDependency) * info.dependencyCount);
+        }
+    }
+
+    void PipelineHasher::add_pipeline_state(const VkGraphicsPipelineCreateInfo& info) {
+        add(info.flags);
+
+        const VkPipelineVertexInputStateCreateInfo* vertex_input = info.pVertexInputState;
+        add(vertex_input->vertexBindingDescriptionCount);
+        add(vertex_input->pVertexBindingDescriptions,
+            sizeof(VkVertexInputBindingDescription) * vertex_input->vertexBindingDescriptionCount);
+        add(vertex_input->vertexAttributeDescriptionCount);
+        add(vertex_input->pVertexAttributeDescriptions,
+            sizeof(VkVertexInputAttributeDescription) * vertex_input->vertexAttributeDescriptionCount);
+
+        add(info.pInputAssemblyState->topology);
+        add(info.pInputAssemblyState->primitiveRestartEnable);
+
+        if (info.pTessellationState != nullptr) {
+            add(info.pTessellationState->patchControlPoints);
+        }
+
+        /**
+         * Viewports and scissors that are dynamic state come in as nullptr, only baked ones are part of the key (and a
+         * swap chain with a different extent means a different pipeline).
+         */
+        if (info.pViewportState != nullptr) {
+            add(info.pViewportState->viewportCount);
+            add(info.pViewportState->scissorCount);
+            if (info.pViewportState->pViewports != nullptr) {
+                add(info.pViewportState->pViewports, sizeof(VkViewport) * info.pViewportState->viewportCount);
+            }
+            if (info.pViewportState->pScissors != nullptr) {
+                add(info.pViewportState->pScissors, sizeof(VkRect2D) * info.pViewportState->scissorCount);
+            }
+        }
+
+        const VkPipelineRasterizationStateCreateInfo* rasterizer = info.pRasterizationState;
+        add(rasterizer->depthClampEnable);
+        add(rasterizer->rasterizerDiscardEnable);
+        add(rasterizer->polygonMode);
+        add(rasterizer->cullMode);
+        add(rasterizer->frontFace);
+        add(rasterizer->depthBiasEnable);
+        add(rasterizer->depthBiasConstantFactor);
+        add(rasterizer->depthBiasClamp);
+        add(rasterizer->depthBiasSlopeFactor);
+        add(rasterizer->lineWidth);
+
+        if (info.pMultisampleState != nullptr) {
+            const VkPipelineMultisampleStateCreateInfo* multi_sampling = info.pMultisampleState;
+            add(multi_sampling->rasterizationSamples);
+            add(multi_sampling->sampleShadingEnable);
+            add(multi_sampling->minSampleShading);
+            add(multi_sampling->alphaToCoverageEnable);
+            add(multi_sampling->alphaToOneEnable);
+            if (multi_sampling->pSampleMask != nullptr) {
+                uint32_t mask_count = (multi_sampling->rasterizationSamples + 31) / 32;
+                add(multi_sampling->pSampleMask, sizeof(VkSampleMask) * mask_count);
+            }
+        }
+
+        if (info.pDepthStencilState != nullptr) {
+            const VkPipelineDepthStencilStateCreateInfo* depth_stencil = info.pDepthStencilState;
+            add(depth_stencil->depthTestEnable);
+            add(depth_stencil->depthWriteEnable);
+            add(depth_stencil->depthCompareOp);
+            add(depth_stencil->depthBoundsTestEnable);
+            add(depth_stencil->stencilTestEnable);
+            add(depth_stencil->front);
+            add(depth_stencil->back);
+            add(depth_stencil->minDepthBounds);
+            add(depth_stencil->maxDepthBounds);
+        }
+
+        if (info.pColorBlendState != nullptr) {
+            const VkPipelineColorBlendStateCreateInfo* color_blending = info.pColorBlendState;
+            add(color_blending->logicOpEnable);
+            add(color_blending->logicOp);
+            add(color_blending->attachmentCount);
+            add(color_blending->pAttachments,
+                sizeof(VkPipelineColorBlendAttachmentState) * color_blending->attachmentCount);
+            add(color_blending->blendConstants);
+        }
+
+        if (info.pDynamicState != nullptr) {
+            add(info.pDynamicState->dynamicStateCount);
+            add(info.pDynamicState->pDynamicStates, sizeof(VkDynamicState) * info.pDynamicState->dynamicStateCount);
+        }
+
+        add(info.layout);
+        add(info.subpass);
+    }
+
+    /**
+     * A cache file written by another GPU or driver version is useless (and feeding it to some drivers has crashed
+     * them in the past), so we validate the header ourselves before handing the data over.
+     */
+    PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties,
+        const std::string& path) : device(device), properties(properties), path(path) {
+
+        std::vector<char> data;
+        if (!path.empty()) {
+            std::ifstream file(path, std::ios::ate | std::ios::binary);
+            if (file.is_open()) {
+                data.resize((size_t)file.tellg());
+                file.seekg(0);
+                file.read(data.data(), data.size());
+            }
+        }
+
+        if (!data.empty() && !is_compatible(data)) {
+            stats.disk_cache_rejected = true;
+            data.clear();
+        }
+
+        VkPipelineCacheCreateInfo cache_info = {};
+        cache_info.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cache_info.initialDataSize           = data.size();
+        cache_info.pInitialData              = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(device, &cache_info, nullptr, &cache) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create pipeline cache!");
+        }
+
+        stats.loaded_bytes = data.size();
+    }
+
+    PipelineCache::~PipelineCache() {
+        for (auto& pair : pipelines) {
+            vkDestroyPipeline(device, pair.second.pipeline, nullptr);
+        }
+        reclaim(std::numeric_limits<uint64_t>::max());
+
+        vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    /**
+     * The header is laid out as: header length, header version, vendor id, device id and the pipeline cache UUID. The
+     * UUID changes whenever the driver's compiler does, so it covers the driver version as well.
+     */
+    bool PipelineCache::is_compatible(const std::vector<char>& data) const {
+        const size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+        if (data.size() < header_size) {
+            return false;
+        }
+
+        uint32_t header[4];
+        memcpy(header, data.data(), sizeof(header));
+
+        return header[0] >= header_size && header[0] <= data.size() &&
+            header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header[2] == properties.vendorID &&
+            header[3] == properties.deviceID &&
+            memcmp(data.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    VkPipeline PipelineCache::find(const PipelineHasher& key) {
+        if (key.get_state().empty()) {
+            throw std::runtime_error("Pipeline cache keys need keep_state!");
+        }
+
+        auto range = pipelines.equal_range(key.get());
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.state == key.get_state()) {
+                stats.hits++;
+                return it->second.pipeline;
+            }
+        }
+
+        stats.misses++;
+        return VK_NULL_HANDLE;
+    }
+
+    VkPipeline PipelineCache::create(const PipelineHasher& key, const VkGraphicsPipelineCreateInfo& info) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(device, cache, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create graphics pipeline");
+        }
+
+        add_entry(key, pipeline, start);
+        return pipeline;
+    }
+
+    VkPipeline PipelineCache::create(const PipelineHasher& key, const VkComputePipelineCreateInfo& info) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        VkPipeline pipeline;
+        if (vkCreateComputePipelines(device, cache, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline");
+        }
+
+        add_entry(key, pipeline, start);
+        return pipeline;
+    }
+
+    void PipelineCache::add_entry(const PipelineHasher& key, VkPipeline pipeline,
+        std::chrono::high_resolution_clock::time_point start) {
+
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        stats.creation_seconds += seconds;
+
+        Entry entry;
+        entry.pipeline         = pipeline;
+        entry.creation_seconds = seconds;
+        entry.state            = key.get_state();
+        pipelines.emplace(key.get(), std::move(entry));
+    }
+
+    void PipelineCache::retire(VkPipeline pipeline, uint64_t retire_frame) {
+        for (auto it = pipelines.begin(); it != pipelines.end(); ++it) {
+            if (it->second.pipeline == pipeline) {
+                pipelines.erase(it);
+                retired.push_back({ pipeline, retire_frame });
+                return;
+            }
+        }
+    }
+
+    void PipelineCache::reclaim(uint64_t completed_frames) {
+        while (!retired.empty() && retired.front().retire_frame <= completed_frames) {
+            vkDestroyPipeline(device, retired.front().pipeline, nullptr);
+            retired.pop_front();
+        }
+    }
+
+    /**
+     * Written to a temporary file first and then renamed, so a crash halfway through never leaves a truncated cache
+     * behind for the next run.
+     */
+    void PipelineCache::save() const {
+        if (path.empty()) {
+            return;
+        }
+
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return;
+        }
+
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) {
+            return;
+        }
+
+        std::string temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Failed to write pipeline cache: " << temp_path << std::endl;
+                return;
+            }
+            file.write(data.data(), size);
+        }
+
+        std::remove(path.c_str());
+        std::rename(temp_path.c_str(), path.c_str());
+    }
+
+    void PipelineCache::print_stats(std::ostream& out) const {
+        out << "Pipelines: " << pipelines.size() << " cached, " << stats.hits << " hits, " << stats.misses <<
+            " misses, " << std::fixed << std::setprecision(2) << stats.creation_seconds * 1000.0 << "ms creating";
+
+        if (stats.disk_cache_rejected) {
+            out << " (disk cache rejected, different device or driver)";
+        } else {
+            out << " (" << stats.loaded_bytes << " bytes loaded from disk)";
+        }
+        out << std::endl;
+
+        for (const auto& pair : pipelines) {
+            out << "\t" << std::hex << std::setw(16) << std::setfill('0') << pair.first << std::dec <<
+                std::setfill(' ') << ": " << pair.second.creation_seconds * 1000.0 << "ms" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,359 @@
+#include "../include/Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    TimeSummary summarize(std::vector<double> values) {
+        TimeSummary summary;
+        if (values.empty()) {
+            return summary;
+        }
+
+        std::sort(values.begin(), values.end());
+
+        double total = 0.0;
+        for (double value : values) {
+            total += value;
+        }
+
+        auto percentile = [&values](double p) {
+            size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+            return values[std::min(std::max<size_t>(rank, 1), values.size()) - 1];
+        };
+
+        summary.count = values.size();
+        summary.mean  = total / values.size();
+        summary.p50   = percentile(50.0);
+        summary.p95   = percentile(95.0);
+        summary.p99   = percentile(99.0);
+        summary.max   = values.back();
+        return summary;
+    }
+
+    static std::atomic<uint64_t> next_profiler_id(1);
+
+    Profiler::Profiler(bool enabled) : enabled(enabled), instance_id(next_profiler_id++),
+        epoch(std::chrono::steady_clock::now()) {}
+
+    uint64_t Profiler::now_ns() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    /**
+     * The thread local cache makes the common case a compare and a load. It's keyed by the profiler's id rather than
+     * its address, a new profiler may well end up at the address of one that was destroyed.
+     */
+    Profiler::ThreadEvents* Profiler::get_thread_events() {
+        struct Cache {
+            uint64_t instance_id = 0;
+            ThreadEvents* events = nullptr;
+        };
+        thread_local Cache cache;
+
+        if (cache.instance_id == instance_id) {
+            return cache.events;
+        }
+
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        std::thread::id thread_id = std::this_thread::get_id();
+
+        ThreadEvents* events = nullptr;
+        for (auto& thread : threads) {
+            if (thread->thread_id == thread_id) {
+                events = thread.get();
+            }
+        }
+
+        if (events == nullptr) {
+            std::unique_ptr<ThreadEvents> thread(new ThreadEvents());
+            thread->thread_id    = thread_id;
+            thread->thread_index = static_cast<uint32_t>(threads.size());
+            thread->name         = "thread " + std::to_string(threads.size());
+            thread->events.resize(EVENTS_PER_THREAD);
+            thread->head.store(0, std::memory_order_relaxed);
+
+            events = thread.get();
+            threads.push_back(std::move(thread));
+        }
+
+        cache.instance_id = instance_id;
+        cache.events      = events;
+        return events;
+    }
+
+    void Profiler::set_thread_name(const std::string& name) {
+        ThreadEvents* events = get_thread_events();
+
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        events->name = name;
+    }
+
+    /**
+     * Only the owning thread writes its ring. The event goes in first and the head is published with release, so a
+     * reader that acquires the head sees complete events.
+     */
+    void Profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+        ThreadEvents* thread = get_thread_events();
+        uint64_t head        = thread->head.load(std::memory_order_relaxed);
+
+        ZoneEvent& event  = thread->events[head % EVENTS_PER_THREAD];
+        event.name        = name;
+        event.start_ns    = start_ns;
+        event.duration_ns = end_ns - start_ns;
+
+        thread->head.store(head + 1, std::memory_order_release);
+    }
+
+    void Profiler::end_frame() {
+        uint64_t now = now_ns();
+        if (frame_started) {
+            cpu_frame_ms.push_back((now - last_frame_ns) / 1e6);
+        }
+
+        frame_started = true;
+        last_frame_ns = now;
+    }
+
+    void Profiler::record_gpu(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+        ZoneEvent event = { name, start_ns, duration_ns };
+
+        if (gpu_events.size() < EVENTS_PER_THREAD) {
+            gpu_events.push_back(event);
+        } else {
+            gpu_events[gpu_event_count % EVENTS_PER_THREAD] = event;
+        }
+        gpu_event_count++;
+    }
+
+    void Profiler::record_gpu_frame(double milliseconds) {
+        gpu_frame_ms.push_back(milliseconds);
+    }
+
+    std::vector<ZoneEvent> Profiler::collect(const ThreadEvents& thread) const {
+        uint64_t head  = thread.head.load(std::memory_order_acquire);
+        uint64_t first = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+
+        std::vector<ZoneEvent> events;
+        events.reserve(head - first);
+        for (uint64_t i = first; i < head; i++) {
+            events.push_back(thread.events[i % EVENTS_PER_THREAD]);
+        }
+        return events;
+    }
+
+    void Profiler::print_summary(std::ostream& out) {
+        auto print_frames = [&out](const char* label, const TimeSummary& summary) {
+            if (summary.count == 0) {
+                return;
+            }
+
+            out << "Frame time (" << label << "): " << std::fixed << std::setprecision(3) << summary.p50 << "ms p50, " <<
+                summary.p95 << "ms p95, " << summary.p99 << "ms p99, " << summary.max << "ms max over " <<
+                summary.count << " frames" << std::endl;
+        };
+
+        print_frames("CPU", get_cpu_frame_summary());
+        print_frames("GPU", get_gpu_frame_summary());
+
+        // Zones of every thread are summed up by name, so parallel zones show the total CPU time spent in them.
+        std::map<std::string, std::pair<uint64_t, uint64_t>> zones;
+        {
+            std::lock_guard<std::mutex> lock(threads_mutex);
+            for (const auto& thread : threads) {
+                for (const auto& event : collect(*thread)) {
+                    auto& zone = zones[event.name];
+                    zone.first += event.duration_ns;
+                    zone.second++;
+                }
+            }
+        }
+
+        for (const auto& event : gpu_events) {
+            auto& zone = zones[std::string("gpu: ") + event.name];
+            zone.first += event.duration_ns;
+            zone.second++;
+        }
+
+        uint64_t frame_count = std::max<uint64_t>(cpu_frame_ms.size(), 1);
+        for (const auto& zone : zones) {
+            out << "\t" << zone.first << ": " << std::fixed << std::setprecision(3) <<
+                zone.second.first / 1e6 / frame_count << "ms per frame (" << zone.second.second << " calls)" <<
+                std::endl;
+        }
+    }
+
+    static std::string escape_json(const std::string& value) {
+        std::string escaped;
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    /**
+     * Complete ("X") events with the timestamps in microseconds, plus one metadata event per thread so the tracks get
+     * readable names. The GPU gets a track of its own after the CPU threads.
+     */
+    void Profiler::write_chrome_trace(const std::string& path) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open trace file! " + path);
+        }
+
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        bool first = true;
+
+        auto write_event = [&file, &first](const ZoneEvent& event, uint32_t tid) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"" << escape_json(event.name) <<
+                "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << event.start_ns / 1e3 << ",\"dur\":" <<
+                event.duration_ns / 1e3 << "}";
+            first = false;
+        };
+
+        auto write_thread_name = [&file, &first](const std::string& name, uint32_t tid) {
+            file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid <<
+                ",\"args\":{\"name\":\"" << escape_json(name) << "\"}}";
+            first = false;
+        };
+
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        for (const auto& thread : threads) {
+            write_thread_name(thread->name, thread->thread_index);
+            for (const auto& event : collect(*thread)) {
+                write_event(event, thread->thread_index);
+            }
+        }
+
+        uint32_t gpu_tid = static_cast<uint32_t>(threads.size());
+        write_thread_name("GPU", gpu_tid);
+        for (const auto& event : gpu_events) {
+            write_event(event, gpu_tid);
+        }
+
+        file << "\n]}" << std::endl;
+    }
+
+    GpuProfiler::GpuProfiler(VkDevice device, Profiler* profiler, float timestamp_period,
+        uint32_t timestamp_valid_bits, uint32_t frame_count) : device(device), profiler(profiler),
+        timestamp_period(timestamp_period) {
+
+        timestamp_mask = timestamp_valid_bits >= 64 ? ~0ull : (1ull << timestamp_valid_bits) - 1;
+        if (timestamp_valid_bits == 0) {
+            return;
+        }
+
+        VkQueryPoolCreateInfo pool_info = {};
+        pool_info.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        pool_info.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount            = MAX_ZONES * 2;
+
+        frames.resize(frame_count);
+        for (auto& frame : frames) {
+            if (vkCreateQueryPool(device, &pool_info, nullptr, &frame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create timestamp query pool!");
+            }
+            frame.zones.reserve(MAX_ZONES);
+        }
+    }
+
+    GpuProfiler::~GpuProfiler() {
+        for (auto& frame : frames) {
+            vkDestroyQueryPool(device, frame.pool, nullptr);
+        }
+    }
+
+    void GpuProfiler::begin_frame(VkCommandBuffer cmd_buffer, uint32_t frame_index) {
+        if (frames.empty()) {
+            return;
+        }
+
+        current_frame       = frame_index % frames.size();
+        FrameQueries& frame = frames[current_frame];
+
+        if (frame.active) {
+            resolve(frame);
+        }
+
+        frame.zones.clear();
+        frame.query_count = 0;
+        frame.active      = profiler->is_enabled();
+
+        if (frame.active) {
+            vkCmdResetQueryPool(cmd_buffer, frame.pool, 0, MAX_ZONES * 2);
+            frame.cpu_start_ns = profiler->now_ns();
+        }
+    }
+
+    uint32_t GpuProfiler::begin_zone(VkCommandBuffer cmd_buffer, const char* name) {
+        if (frames.empty() || !frames[current_frame].active || frames[current_frame].zones.size() == MAX_ZONES) {
+            return UINT32_MAX;
+        }
+
+        FrameQueries& frame = frames[current_frame];
+
+        Zone zone;
+        zone.name        = name;
+        zone.begin_query = frame.query_count++;
+        zone.end_query   = UINT32_MAX;
+        frame.zones.push_back(zone);
+
+        vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.pool, zone.begin_query);
+        return static_cast<uint32_t>(frame.zones.size() - 1);
+    }
+
+    void GpuProfiler::end_zone(VkCommandBuffer cmd_buffer, uint32_t zone_index) {
+        if (zone_index == UINT32_MAX) {
+            return;
+        }
+
+        FrameQueries& frame = frames[current_frame];
+        Zone& zone          = frame.zones[zone_index];
+        zone.end_query      = frame.query_count++;
+
+        vkCmdWriteTimestamp(cmd_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.pool, zone.end_query);
+    }
+
+    /**
+     * The frame's fence has signaled before its slot gets reused, so the results are normally there already. If they
+     * aren't (VK_NOT_READY) the frame is skipped instead of waiting on it.
+     */
+    void GpuProfiler::resolve(FrameQueries& frame) {
+        if (frame.query_count == 0) {
+            return;
+        }
+
+        std::vector<uint64_t> timestamps(frame.query_count);
+        if (vkGetQueryPoolResults(device, frame.pool, 0, frame.query_count, timestamps.size() * sizeof(uint64_t),
+            timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+            return;
+        }
+
+        uint64_t first = timestamps[frame.zones.front().begin_query];
+        uint64_t last  = first;
+
+        for (const auto& zone : frame.zones) {
+            if (zone.end_query == UINT32_MAX) {
+                continue;
+            }
+
+            uint64_t begin    = timestamps[zone.begin_query];
+            uint64_t duration = (timestamps[zone.end_query] - begin) & timestamp_mask;
+            uint64_t offset   = (begin - first) & timestamp_mask;
+
+            profiler->record_gpu(zone.name, frame.cpu_start_ns + static_cast<uint64_t>(offset * timestamp_period),
+                static_cast<uint64_t>(duration * timestamp_period));
+            last = std::max(last, first + ((timestamps[zone.end_query] - first) & timestamp_mask));
+        }
+
+        profiler->record_gpu_frame((last - first) * timestamp_period / 1e6);
+    }
+}
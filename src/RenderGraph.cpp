@@ -0,0 +1,804 @@
+#include "../include/RenderGraph.h"
+#include "../include/PipelineCache.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    // Only these need flushing, a barrier after a read is there to hold back the next write.
+    static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+        VK_ACCESS_MEMORY_WRITE_BIT;
+
+    static const VkPipelineStageFlags FRAGMENT_TESTS = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+    enum class UsageTarget {
+        Image,
+        Buffer,
+        Any
+    };
+
+    struct UsageInfo {
+        VkPipelineStageFlags stages;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        VkImageUsageFlags image_usage;
+        bool reads;
+        bool writes;
+        UsageTarget target;
+    };
+
+    static UsageInfo get_usage_info(ResourceUsage usage) {
+        switch (usage) {
+            case ResourceUsage::None:
+                return { 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false, false, UsageTarget::Any };
+            case ResourceUsage::ColorAttachment:
+            case ResourceUsage::ColorAttachmentLoad:
+                return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, usage == ResourceUsage::ColorAttachmentLoad, true,
+                    UsageTarget::Image };
+            case ResourceUsage::DepthAttachment:
+            case ResourceUsage::DepthAttachmentLoad:
+                return { FRAGMENT_TESTS, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, usage == ResourceUsage::DepthAttachmentLoad, true,
+                    UsageTarget::Image };
+            case ResourceUsage::DepthRead:
+                return { FRAGMENT_TESTS, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true,
+                    false, UsageTarget::Image };
+            case ResourceUsage::FragmentSampled:
+                return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false,
+                    UsageTarget::Image };
+            case ResourceUsage::ComputeSampled:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, true, false,
+                    UsageTarget::Image };
+            case ResourceUsage::ComputeRead:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT, true, false, UsageTarget::Any };
+            case ResourceUsage::ComputeWrite:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL,
+                    VK_IMAGE_USAGE_STORAGE_BIT, false, true, UsageTarget::Any };
+            case ResourceUsage::ComputeReadWrite:
+                return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true, true, UsageTarget::Any };
+            case ResourceUsage::IndirectRead:
+                return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, 0, true, false, UsageTarget::Buffer };
+            case ResourceUsage::VertexRead:
+                return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, 0, true, false, UsageTarget::Buffer };
+            case ResourceUsage::TransferSrc:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true, false,
+                    UsageTarget::Any };
+            case ResourceUsage::TransferDst:
+                return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, false, true,
+                    UsageTarget::Any };
+            case ResourceUsage::HostRead:
+                return { VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, true, false,
+                    UsageTarget::Buffer };
+            case ResourceUsage::Present:
+                return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, true, false,
+                    UsageTarget::Image };
+        }
+        throw std::runtime_error("Unknown resource usage!");
+    }
+
+    static VkImageAspectFlags get_aspect(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_X8_D24_UNORM_PACK32:
+            case VK_FORMAT_D32_SFLOAT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT;
+            case VK_FORMAT_D16_UNORM_S8_UINT:
+            case VK_FORMAT_D24_UNORM_S8_UINT:
+            case VK_FORMAT_D32_SFLOAT_S8_UINT:
+                return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+            case VK_FORMAT_S8_UINT:
+                return VK_IMAGE_ASPECT_STENCIL_BIT;
+            default:
+                return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    static VkImageSubresourceRange get_range(const ImageDesc& desc) {
+        return { get_aspect(desc.format), 0, desc.mip_levels, 0, desc.array_layers };
+    }
+
+    static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    VulkanRenderGraphBackend::VulkanRenderGraphBackend(VkDevice device, DeviceAllocator* allocator) : device(device),
+        allocator(allocator) {
+    }
+
+    VkImage VulkanRenderGraphBackend::create_image(const VkImageCreateInfo& info, VkMemoryRequirements& requirements) {
+        VkImage image;
+        if (vkCreateImage(device, &info, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render graph image!");
+        }
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        return image;
+    }
+
+    VkImageView VulkanRenderGraphBackend::create_image_view(const VkImageViewCreateInfo& info) {
+        VkImageView view;
+        if (vkCreateImageView(device, &info, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create render graph image view!");
+        }
+        return view;
+    }
+
+    void VulkanRenderGraphBackend::destroy_image(VkImage image, VkImageView view) {
+        vkDestroyImageView(device, view, nullptr);
+        vkDestroyImage(device, image, nullptr);
+    }
+
+    Allocation VulkanRenderGraphBackend::allocate(const VkMemoryRequirements& requirements) {
+        return allocator->allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Optimal);
+    }
+
+    void VulkanRenderGraphBackend::free(Allocation& allocation) {
+        allocator->free(allocation);
+    }
+
+    void VulkanRenderGraphBackend::bind_image(VkImage image, const Allocation& heap, VkDeviceSize offset) {
+        if (vkBindImageMemory(device, image, heap.memory, heap.offset + offset) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to bind render graph image memory!");
+        }
+    }
+
+    void VulkanRenderGraphBackend::pipeline_barrier(VkCommandBuffer cmd_buffer, VkPipelineStageFlags src_stages,
+        VkPipelineStageFlags dst_stages, const std::vector<VkBufferMemoryBarrier>& buffer_barriers,
+        const std::vector<VkImageMemoryBarrier>& image_barriers) {
+
+        vkCmdPipelineBarrier(cmd_buffer, src_stages, dst_stages, 0, 0, nullptr,
+            static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+            static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+    }
+
+    RenderGraph::RenderGraph(RenderGraphBackend* backend) : backend(backend) {
+    }
+
+    RenderGraph::~RenderGraph() {
+        retire(0);
+        reclaim(std::numeric_limits<uint64_t>::max());
+    }
+
+    void RenderGraph::reset() {
+        passes.clear();
+        resources.clear();
+    }
+
+    uint32_t RenderGraph::create_image(const std::string& name, const ImageDesc& desc) {
+        Resource resource;
+        resource.name  = name;
+        resource.image = true;
+        resource.desc  = desc;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    uint32_t RenderGraph::import_image(const std::string& name, const ImageDesc& desc, const ResourceState& initial,
+        ResourceUsage final_usage) {
+
+        uint32_t resource                = create_image(name, desc);
+        resources[resource].imported    = true;
+        resources[resource].initial     = initial;
+        resources[resource].final_usage = final_usage;
+        return resource;
+    }
+
+    uint32_t RenderGraph::import_buffer(const std::string& name, const ResourceState& initial,
+        ResourceUsage final_usage) {
+
+        Resource resource;
+        resource.name        = name;
+        resource.imported    = true;
+        resource.initial     = initial;
+        resource.final_usage = final_usage;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    uint32_t RenderGraph::add_pass(const std::string& name, std::function<void(VkCommandBuffer)> execute) {
+        Pass pass;
+        pass.name    = name;
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+        return static_cast<uint32_t>(passes.size() - 1);
+    }
+
+    void RenderGraph::use(uint32_t pass, uint32_t resource, ResourceUsage usage) {
+        if (pass >= passes.size() || resource >= resources.size()) {
+            throw std::runtime_error("Render graph pass or resource doesn't exist!");
+        }
+        passes[pass].uses.push_back({ resource, usage });
+    }
+
+    void RenderGraph::set_side_effects(uint32_t pass) {
+        passes.at(pass).side_effects = true;
+    }
+
+    /**
+     * Only what the compiled graph depends on: how every resource is described, where it starts and ends up, and how
+     * every pass uses them. Names, callbacks and the handles set per execute don't change anything.
+     */
+    uint64_t RenderGraph::get_key() const {
+        PipelineHasher hasher;
+        hasher.add(resources.size());
+        for (const Resource& resource : resources) {
+            hasher.add(resource.image);
+            hasher.add(resource.imported);
+            hasher.add(resource.desc.format);
+            hasher.add(resource.desc.extent.width);
+            hasher.add(resource.desc.extent.height);
+            hasher.add(resource.desc.mip_levels);
+            hasher.add(resource.desc.array_layers);
+            hasher.add(resource.desc.samples);
+            hasher.add(resource.initial.stages);
+            hasher.add(resource.initial.access);
+            hasher.add(resource.initial.layout);
+            hasher.add(resource.final_usage);
+        }
+
+        hasher.add(passes.size());
+        for (const Pass& pass : passes) {
+            hasher.add(pass.side_effects);
+            hasher.add(pass.uses.size());
+            for (const PassUse& use : pass.uses) {
+                hasher.add(use.resource);
+                hasher.add(use.usage);
+            }
+        }
+        return hasher.get();
+    }
+
+    /**
+     * Nothing here touches the device until every declaration has been checked. A graph that doesn't compile leaves
+     * nothing compiled though, execute() throws until one does.
+     */
+    void RenderGraph::compile(uint64_t retire_frame) {
+        uint64_t key = get_key();
+        if (compiled && key == compiled_key) {
+            return;
+        }
+
+        compiled = false;
+        merge_accesses();
+        cull_passes();
+        find_lifetimes();
+
+        retire(retire_frame);
+        bindings.assign(resources.size(), Binding());
+        place_images();
+        place_barriers();
+
+        stats.pass_count    = static_cast<uint32_t>(passes.size());
+        stats.culled_passes = static_cast<uint32_t>(passes.size() - order.size());
+        stats.barriers      = 0;
+        for (const BarrierBatch& batch : batches) {
+            stats.barriers += static_cast<uint32_t>(batch.barriers.size());
+        }
+        stats.barrier_calls = static_cast<uint32_t>(batches.size());
+        stats.compiles++;
+
+        compiled_key = key;
+        compiled     = true;
+    }
+
+    void RenderGraph::merge_accesses() {
+        accesses.assign(passes.size(), {});
+        for (size_t i = 0; i < passes.size(); i++) {
+            for (const PassUse& use : passes[i].uses) {
+                const Resource& resource = resources[use.resource];
+                UsageInfo info           = get_usage_info(use.usage);
+                if ((info.target == UsageTarget::Image && !resource.image) ||
+                    (info.target == UsageTarget::Buffer && resource.image)) {
+                    throw std::runtime_error("Render graph pass uses a resource in a way it can't be used! " +
+                        passes[i].name + ": " + resource.name);
+                }
+
+                auto access = std::find_if(accesses[i].begin(), accesses[i].end(), [&](const Access& other) {
+                    return other.resource == use.resource;
+                });
+                if (access == accesses[i].end()) {
+                    accesses[i].push_back({ use.resource, info.stages, info.access, info.layout, info.image_usage,
+                        info.reads, info.writes });
+                    continue;
+                }
+
+                if (resource.image && access->layout != info.layout) {
+                    throw std::runtime_error("Render graph pass uses an image in two layouts! " + passes[i].name +
+                        ": " + resource.name);
+                }
+                access->stages      |= info.stages;
+                access->access      |= info.access;
+                access->image_usage |= info.image_usage;
+                access->reads        = access->reads || info.reads;
+                access->writes       = access->writes || info.writes;
+            }
+        }
+
+        for (const Resource& resource : resources) {
+            UsageInfo info = get_usage_info(resource.final_usage);
+            if ((info.target == UsageTarget::Image && !resource.image) ||
+                (info.target == UsageTarget::Buffer && resource.image)) {
+                throw std::runtime_error("Render graph resource can't end up in its final usage! " + resource.name);
+            }
+        }
+    }
+
+    /**
+     * Walks the passes backwards keeping track of the resources whose current contents a later pass still needs. A
+     * pass that writes none of them and has no side effects goes. A pass that writes a resource without reading it is
+     * the one the readers after it need, so the passes before it that wrote the resource aren't needed for them.
+     */
+    void RenderGraph::cull_passes() {
+        std::vector<char> live(resources.size(), 0);
+        for (size_t i = 0; i < resources.size(); i++) {
+            live[i] = resources[i].imported && resources[i].final_usage != ResourceUsage::None;
+        }
+
+        culled.assign(passes.size(), 1);
+        for (size_t i = passes.size(); i-- > 0;) {
+            bool needed = passes[i].side_effects;
+            for (const Access& access : accesses[i]) {
+                needed = needed || (access.writes && live[access.resource]);
+            }
+            if (!needed) {
+                continue;
+            }
+
+            culled[i] = 0;
+            for (const Access& access : accesses[i]) {
+                if (access.writes && !access.reads) {
+                    live[access.resource] = 0;
+                }
+            }
+            for (const Access& access : accesses[i]) {
+                if (access.reads) {
+                    live[access.resource] = 1;
+                }
+            }
+        }
+
+        order.clear();
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            if (!culled[i]) {
+                order.push_back(i);
+            }
+        }
+    }
+
+    void RenderGraph::find_lifetimes() {
+        lifetimes.assign(resources.size(), Lifetime());
+        for (uint32_t position = 0; position < order.size(); position++) {
+            for (const Access& access : accesses[order[position]]) {
+                const Resource& resource = resources[access.resource];
+                Lifetime& lifetime       = lifetimes[access.resource];
+                if (lifetime.first == UINT32_MAX) {
+                    if (!resource.imported && access.reads) {
+                        throw std::runtime_error("Render graph reads an image nothing wrote! " +
+                            passes[order[position]].name + ": " + resource.name);
+                    }
+                    lifetime.first = position;
+                }
+                lifetime.last         = position;
+                lifetime.last_stages  = access.stages;
+                lifetime.last_access  = access.access;
+                lifetime.usage       |= access.image_usage;
+            }
+        }
+    }
+
+    /**
+     * Frames recorded with the old graph may still be in flight, so its transient images wait for reclaim() instead of
+     * being destroyed here.
+     */
+    void RenderGraph::retire(uint64_t retire_frame) {
+        RetiredMemory memory;
+        for (const Binding& binding : bindings) {
+            if (binding.owned) {
+                memory.images.push_back(binding);
+            }
+        }
+        memory.heaps        = std::move(heaps);
+        memory.retire_frame = retire_frame;
+        heaps.clear();
+        bindings.clear();
+
+        if (!memory.images.empty() || !memory.heaps.empty()) {
+            retired.push_back(std::move(memory));
+        }
+    }
+
+    void RenderGraph::reclaim(uint64_t completed_frames) {
+        while (!retired.empty() && retired.front().retire_frame <= completed_frames) {
+            for (const Binding& image : retired.front().images) {
+                backend->destroy_image(image.image, image.view);
+            }
+            for (Allocation& heap : retired.front().heaps) {
+                backend->free(heap);
+            }
+            retired.pop_front();
+        }
+    }
+
+    /**
+     * Biggest first, they're the hardest to fit around the others. Every image goes into the first heap its memory
+     * types allow, at the lowest offset that no image alive at the same time uses, and the heap grows to fit it.
+     */
+    void RenderGraph::place_images() {
+        std::vector<uint32_t> images;
+        for (uint32_t i = 0; i < resources.size(); i++) {
+            if (!resources[i].image || resources[i].imported || lifetimes[i].first == UINT32_MAX) {
+                continue;
+            }
+
+            const ImageDesc& desc        = resources[i].desc;
+            VkImageCreateInfo image_info = {};
+            image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType         = VK_IMAGE_TYPE_2D;
+            image_info.format            = desc.format;
+            image_info.extent            = { desc.extent.width, desc.extent.height, 1 };
+            image_info.mipLevels         = desc.mip_levels;
+            image_info.arrayLayers       = desc.array_layers;
+            image_info.samples           = desc.samples;
+            image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage             = lifetimes[i].usage;
+            image_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            bindings[i].image = backend->create_image(image_info, lifetimes[i].requirements);
+            bindings[i].owned = true;
+            images.push_back(i);
+        }
+
+        std::stable_sort(images.begin(), images.end(), [&](uint32_t a, uint32_t b) {
+            return lifetimes[a].requirements.size > lifetimes[b].requirements.size;
+        });
+
+        struct HeapLayout {
+            uint32_t memory_type_bits;
+            VkDeviceSize alignment;
+            VkDeviceSize size;
+            std::vector<uint32_t> images;
+        };
+        std::vector<HeapLayout> layouts;
+
+        stats.transient_bytes = 0;
+        for (uint32_t image : images) {
+            Lifetime& lifetime                       = lifetimes[image];
+            const VkMemoryRequirements& requirements = lifetime.requirements;
+            stats.transient_bytes                   += requirements.size;
+
+            auto layout = std::find_if(layouts.begin(), layouts.end(), [&](const HeapLayout& heap) {
+                return (heap.memory_type_bits & requirements.memoryTypeBits) != 0;
+            });
+            if (layout == layouts.end()) {
+                layouts.push_back({ requirements.memoryTypeBits, 1, 0, {} });
+                layout = layouts.end() - 1;
+            }
+
+            // Ranges of the heap taken by images alive at the same time as this one.
+            std::vector<std::pair<VkDeviceSize, VkDeviceSize>> taken;
+            for (uint32_t other : layout->images) {
+                if (lifetimes[other].first <= lifetime.last && lifetime.first <= lifetimes[other].last) {
+                    taken.push_back({ lifetimes[other].offset, lifetimes[other].offset +
+                        lifetimes[other].requirements.size });
+                }
+            }
+            std::sort(taken.begin(), taken.end());
+
+            VkDeviceSize offset = 0;
+            for (const auto& range : taken) {
+                if (align_up(offset, requirements.alignment) + requirements.size <= range.first) {
+                    break;
+                }
+                offset = std::max(offset, range.second);
+            }
+
+            lifetime.heap             = static_cast<uint32_t>(layout - layouts.begin());
+            lifetime.offset           = align_up(offset, requirements.alignment);
+            layout->memory_type_bits &= requirements.memoryTypeBits;
+            layout->alignment         = std::max(layout->alignment, requirements.alignment);
+            layout->size              = std::max(layout->size, lifetime.offset + requirements.size);
+            layout->images.push_back(image);
+        }
+
+        stats.transient_images = static_cast<uint32_t>(images.size());
+        stats.heap_count       = static_cast<uint32_t>(layouts.size());
+        stats.heap_bytes       = 0;
+        for (const HeapLayout& layout : layouts) {
+            VkMemoryRequirements requirements = { layout.size, layout.alignment, layout.memory_type_bits };
+            heaps.push_back(backend->allocate(requirements));
+            stats.heap_bytes += layout.size;
+
+            for (uint32_t image : layout.images) {
+                backend->bind_image(bindings[image].image, heaps.back(), lifetimes[image].offset);
+
+                const ImageDesc& desc           = resources[image].desc;
+                VkImageViewCreateInfo view_info = {};
+                view_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                view_info.image                 = bindings[image].image;
+                view_info.viewType              = desc.array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY :
+                    VK_IMAGE_VIEW_TYPE_2D;
+                view_info.format                = desc.format;
+                view_info.subresourceRange      = get_range(desc);
+                bindings[image].view            = backend->create_image_view(view_info);
+            }
+        }
+    }
+
+    /**
+     * Walks the passes in order tracking every resource's layout, its last write and the reads since. Reads need a
+     * barrier when the last write hasn't been made visible to their stages and accesses yet, any time after the write.
+     * Writes and layout changes need one after the last read or write, which only has to wait for those.
+     */
+    void RenderGraph::place_barriers() {
+        struct Tracker {
+            VkImageLayout layout                = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags write_stages   = 0;
+            VkAccessFlags write_access          = 0;
+            VkPipelineStageFlags read_stages    = 0;
+            VkPipelineStageFlags visible_stages = 0;
+            VkAccessFlags visible_access        = 0;
+
+            // The earliest positions a barrier after the last write or the last use can go.
+            uint32_t after_write = 0;
+            uint32_t after_use   = 0;
+        };
+
+        std::vector<Tracker> trackers(resources.size());
+        for (uint32_t i = 0; i < resources.size(); i++) {
+            Tracker& tracker = trackers[i];
+            if (resources[i].imported) {
+                tracker.layout       = resources[i].initial.layout;
+                tracker.write_stages = resources[i].initial.stages;
+                tracker.write_access = resources[i].initial.access;
+                continue;
+            }
+
+            // Whatever used the memory last, earlier in this frame or anywhere in the one before.
+            for (uint32_t other = 0; other < resources.size(); other++) {
+                const Lifetime& a = lifetimes[i];
+                const Lifetime& b = lifetimes[other];
+                if (a.heap == UINT32_MAX || a.heap != b.heap || b.offset >= a.offset + a.requirements.size ||
+                    a.offset >= b.offset + b.requirements.size) {
+                    continue;
+                }
+                tracker.write_stages |= b.last_stages;
+                tracker.write_access |= b.last_access;
+                if (b.last < a.first) {
+                    tracker.after_use = std::max(tracker.after_use, b.last + 1);
+                }
+            }
+            tracker.after_write = tracker.after_use;
+        }
+
+        std::vector<Barrier> pending;
+        auto use = [&](uint32_t position, uint32_t resource, VkPipelineStageFlags stages, VkAccessFlags access,
+            VkImageLayout layout, bool reads, bool writes) {
+
+            Tracker& tracker = trackers[resource];
+            Barrier barrier  = { resource, 0, stages, 0, access, tracker.layout, layout, 0, position };
+            bool transition  = resources[resource].image && tracker.layout != layout;
+            bool needed      = false;
+            if (transition || (writes && (tracker.write_stages | tracker.read_stages) != 0)) {
+                barrier.src_stages = tracker.write_stages | tracker.read_stages;
+                barrier.src_access = tracker.write_access & WRITE_ACCESS;
+                barrier.earliest   = tracker.after_use;
+                needed             = true;
+            } else if (reads && tracker.write_stages != 0 && ((stages & ~tracker.visible_stages) != 0 ||
+                (access & ~tracker.visible_access) != 0)) {
+                barrier.src_stages = tracker.write_stages;
+                barrier.src_access = tracker.write_access & WRITE_ACCESS;
+                barrier.earliest   = tracker.after_write;
+                needed             = true;
+            }
+
+            if (needed) {
+                pending.push_back(barrier);
+                tracker.visible_stages |= stages;
+                tracker.visible_access |= access;
+            }
+
+            tracker.layout = transition ? layout : tracker.layout;
+            if (writes) {
+                tracker.write_stages   = stages;
+                tracker.write_access   = access;
+                tracker.read_stages    = 0;
+                tracker.visible_stages = 0;
+                tracker.visible_access = 0;
+                tracker.after_write    = position + 1;
+            } else if (transition) {
+                // The transition only happens before this pass's stages, readers in other stages wait on those. What
+                // was written is already available, so they don't have to flush anything.
+                tracker.write_stages   = stages;
+                tracker.write_access   = 0;
+                tracker.read_stages    = stages;
+                tracker.visible_stages = stages;
+                tracker.visible_access = access;
+                tracker.after_write    = position + 1;
+            } else {
+                tracker.read_stages |= stages;
+            }
+            tracker.after_use = position + 1;
+        };
+
+        for (uint32_t position = 0; position < order.size(); position++) {
+            for (const Access& access : accesses[order[position]]) {
+                use(position, access.resource, access.stages, access.access, access.layout, access.reads,
+                    access.writes);
+            }
+        }
+
+        uint32_t end = static_cast<uint32_t>(order.size());
+        for (uint32_t i = 0; i < resources.size(); i++) {
+            if (resources[i].imported && resources[i].final_usage != ResourceUsage::None) {
+                UsageInfo info = get_usage_info(resources[i].final_usage);
+                use(end, i, info.stages, info.access, info.layout, info.reads, info.writes);
+            }
+        }
+
+        batch_barriers(pending);
+    }
+
+    /**
+     * Every barrier starts out in the batch right before the pass that needs it. Then each one moves to the latest
+     * earlier batch it can go in whose source stages are exactly its own. That call already waits on those stages, so
+     * the barrier only adds its destination stages to it instead of a call of its own. Batches left empty are dropped.
+     */
+    void RenderGraph::batch_barriers(std::vector<Barrier>& pending) {
+        std::stable_sort(pending.begin(), pending.end(), [](const Barrier& a, const Barrier& b) {
+            return a.latest < b.latest;
+        });
+
+        batches.clear();
+        for (const Barrier& barrier : pending) {
+            if (batches.empty() || batches.back().position != barrier.latest) {
+                batches.push_back(BarrierBatch());
+                batches.back().position = barrier.latest;
+            }
+            batches.back().src_stages |= barrier.src_stages;
+            batches.back().barriers.push_back(barrier);
+        }
+
+        for (size_t i = 1; i < batches.size(); i++) {
+            std::vector<Barrier> kept;
+            for (const Barrier& barrier : batches[i].barriers) {
+                bool moved = false;
+                for (size_t j = i; j-- > 0 && batches[j].position >= barrier.earliest;) {
+                    if (batches[j].src_stages == barrier.src_stages) {
+                        batches[j].barriers.push_back(barrier);
+                        moved = true;
+                        break;
+                    }
+                }
+                if (!moved) {
+                    kept.push_back(barrier);
+                }
+            }
+
+            batches[i].barriers   = std::move(kept);
+            batches[i].src_stages = 0;
+            for (const Barrier& barrier : batches[i].barriers) {
+                batches[i].src_stages |= barrier.src_stages;
+            }
+        }
+
+        batches.erase(std::remove_if(batches.begin(), batches.end(), [](const BarrierBatch& batch) {
+            return batch.barriers.empty();
+        }), batches.end());
+
+        for (BarrierBatch& batch : batches) {
+            batch.dst_stages = 0;
+            for (const Barrier& barrier : batch.barriers) {
+                batch.dst_stages |= barrier.dst_stages;
+            }
+        }
+    }
+
+    void RenderGraph::set_image(uint32_t resource, VkImage image) {
+        bindings.at(resource).image = image;
+    }
+
+    void RenderGraph::set_buffer(uint32_t resource, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+        Binding& binding = bindings.at(resource);
+        binding.buffer   = buffer;
+        binding.offset   = offset;
+        binding.size     = size;
+    }
+
+    void RenderGraph::execute(VkCommandBuffer cmd_buffer) {
+        if (!compiled || passes.size() != culled.size()) {
+            throw std::runtime_error("Render graph wasn't compiled!");
+        }
+
+        size_t batch = 0;
+        for (uint32_t position = 0; position <= order.size(); position++) {
+            if (batch < batches.size() && batches[batch].position == position) {
+                record_batch(cmd_buffer, batches[batch++]);
+            }
+            if (position < order.size() && passes[order[position]].execute) {
+                passes[order[position]].execute(cmd_buffer);
+            }
+        }
+    }
+
+    void RenderGraph::record_batch(VkCommandBuffer cmd_buffer, const BarrierBatch& batch) {
+        buffer_barriers.clear();
+        image_barriers.clear();
+        for (const Barrier& barrier : batch.barriers) {
+            const Resource& resource = resources[barrier.resource];
+            const Binding& binding   = bindings[barrier.resource];
+            if (resource.image && binding.image == VK_NULL_HANDLE) {
+                throw std::runtime_error("Render graph image wasn't set! " + resource.name);
+            }
+            if (!resource.image && binding.buffer == VK_NULL_HANDLE) {
+                throw std::runtime_error("Render graph buffer wasn't set! " + resource.name);
+            }
+
+            if (resource.image) {
+                VkImageMemoryBarrier image_barrier = {};
+                image_barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                image_barrier.srcAccessMask        = barrier.src_access;
+                image_barrier.dstAccessMask        = barrier.dst_access;
+                image_barrier.oldLayout            = barrier.old_layout;
+                image_barrier.newLayout            = barrier.new_layout;
+                image_barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+                image_barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+                image_barrier.image                = binding.image;
+                image_barrier.subresourceRange     = get_range(resource.desc);
+                image_barriers.push_back(image_barrier);
+            } else {
+                VkBufferMemoryBarrier buffer_barrier = {};
+                buffer_barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                buffer_barrier.srcAccessMask         = barrier.src_access;
+                buffer_barrier.dstAccessMask         = barrier.dst_access;
+                buffer_barrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+                buffer_barrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+                buffer_barrier.buffer                = binding.buffer;
+                buffer_barrier.offset                = binding.offset;
+                buffer_barrier.size                  = binding.size;
+                buffer_barriers.push_back(buffer_barrier);
+            }
+        }
+
+        // Nothing to wait on is a first use of memory nobody touched, nothing waiting is e.g. a present.
+        backend->pipeline_barrier(cmd_buffer, batch.src_stages != 0 ? batch.src_stages :
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, batch.dst_stages != 0 ? batch.dst_stages :
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, buffer_barriers, image_barriers);
+    }
+
+    VkImage RenderGraph::get_image(uint32_t resource) const {
+        return bindings.at(resource).image;
+    }
+
+    VkImageView RenderGraph::get_image_view(uint32_t resource) const {
+        return bindings.at(resource).view;
+    }
+
+    bool RenderGraph::is_culled(uint32_t pass) const {
+        return culled.at(pass) != 0;
+    }
+
+    void RenderGraph::print_stats(std::ostream& out) const {
+        out << "Render graph: " << stats.pass_count << " passes, " << stats.culled_passes << " culled, " <<
+            stats.barriers << " barriers in " << stats.barrier_calls << " calls, " << stats.transient_images <<
+            " transient images in " << stats.heap_count << " heaps, " << std::fixed << std::setprecision(2) <<
+            stats.heap_bytes / (1024.0 * 1024.0) << "MB aliased vs " << stats.transient_bytes / (1024.0 * 1024.0) <<
+            "MB, compiled " << stats.compiles << " times" << std::endl;
+    }
+}
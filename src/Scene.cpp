@@ -0,0 +1,181 @@
+#include "../include/Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    SceneGeometry make_quad_scene() {
+        SceneGeometry scene;
+        scene.vertices = vertices;
+        scene.indices  = indices;
+        scene.meshes.push_back({ 0, static_cast<uint32_t>(indices.size()), 0, VK_INDEX_TYPE_UINT16 });
+        return scene;
+    }
+
+    /**
+     * Small xorshift so the geometry doesn't depend on which standard library the distributions come from.
+     */
+    static float next_random(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return (state & 0xFFFFFF) / static_cast<float>(0x1000000);
+    }
+
+    /**
+     * Each mesh is a grid of cells split into two triangles, filled row by row until triangles_per_mesh is reached. The
+     * grid is kept as square as possible, so the vertex count is roughly half the triangle count.
+     */
+    SceneGeometry make_procedural_scene(uint32_t mesh_count, uint32_t triangles_per_mesh) {
+        if (mesh_count == 0 || triangles_per_mesh == 0) {
+            throw std::runtime_error("Procedural scenes need at least one mesh and one triangle!");
+        }
+
+        uint32_t cell_count = (triangles_per_mesh + 1) / 2;
+        uint32_t columns    = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cell_count))));
+        uint32_t rows       = (cell_count + columns - 1) / columns;
+
+        uint64_t vertex_count = static_cast<uint64_t>(columns + 1) * (rows + 1);
+        if (vertex_count > 65536) {
+            throw std::runtime_error("Too many triangles per mesh for 16 bit indices!");
+        }
+
+        SceneGeometry scene;
+        scene.vertices.reserve(vertex_count * mesh_count);
+        scene.indices.reserve(static_cast<size_t>(triangles_per_mesh) * 3 * mesh_count);
+        scene.meshes.reserve(mesh_count);
+
+        for (uint32_t mesh = 0; mesh < mesh_count; mesh++) {
+            uint32_t state = 0x9E3779B9u ^ (mesh * 0x85EBCA6Bu + 1);
+
+            MeshRange range;
+            range.first_index   = static_cast<uint32_t>(scene.indices.size());
+            range.index_count   = triangles_per_mesh * 3;
+            range.vertex_offset = static_cast<int32_t>(scene.vertices.size());
+            range.index_type    = VK_INDEX_TYPE_UINT16;
+            scene.meshes.push_back(range);
+
+            // One random number per statement, the order arguments get evaluated in isn't specified.
+            glm::vec3 colour;
+            colour.x = next_random(state);
+            colour.y = next_random(state);
+            colour.z = next_random(state);
+
+            float jitter = 0.25f / std::max(columns, rows);
+
+            for (uint32_t y = 0; y <= rows; y++) {
+                for (uint32_t x = 0; x <= columns; x++) {
+                    glm::vec2 offset;
+                    offset.x = next_random(state) - 0.5f;
+                    offset.y = next_random(state) - 0.5f;
+
+                    glm::vec2 pos = glm::vec2(x / static_cast<float>(columns), y / static_cast<float>(rows)) - 0.5f +
+                        offset * jitter;
+
+                    Vertex vertex;
+                    vertex.pos    = glm::vec3(pos, 0.0f);
+                    vertex.colour = colour * (0.75f + 0.25f * next_random(state));
+                    scene.vertices.push_back(vertex);
+                }
+            }
+
+            for (uint32_t triangle = 0; triangle < triangles_per_mesh; triangle++) {
+                uint32_t cell = triangle / 2;
+                uint16_t x    = static_cast<uint16_t>(cell % columns);
+                uint16_t y    = static_cast<uint16_t>(cell / columns);
+
+                uint16_t top_left     = static_cast<uint16_t>(y * (columns + 1) + x);
+                uint16_t top_right    = static_cast<uint16_t>(top_left + 1);
+                uint16_t bottom_left  = static_cast<uint16_t>(top_left + columns + 1);
+                uint16_t bottom_right = static_cast<uint16_t>(bottom_left + 1);
+
+                if (triangle % 2 == 0) {
+                    scene.indices.insert(scene.indices.end(), { top_left, top_right, bottom_right });
+                } else {
+                    scene.indices.insert(scene.indices.end(), { bottom_right, bottom_left, top_left });
+                }
+            }
+        }
+
+        return scene;
+    }
+
+    /**
+     * Centred on the box around the referenced vertices, which is tight enough for culling and a lot cheaper than the
+     * minimal sphere. Only the vertices the indices touch count, unused ones don't inflate it.
+     */
+    static MeshBounds compute_bounds(const Vertex* vertices, const void* indices, uint32_t index_count,
+        VkIndexType index_type) {
+
+        auto get_index = [&](uint32_t i) {
+            return index_type == VK_INDEX_TYPE_UINT32 ? static_cast<const uint32_t*>(indices)[i] :
+                static_cast<const uint16_t*>(indices)[i];
+        };
+
+        if (index_count == 0) {
+            return { glm::vec4(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) };
+        }
+
+        glm::vec3 min = vertices[get_index(0)].pos;
+        glm::vec3 max = min;
+        for (uint32_t i = 1; i < index_count; i++) {
+            min = glm::min(min, vertices[get_index(i)].pos);
+            max = glm::max(max, vertices[get_index(i)].pos);
+        }
+
+        glm::vec3 centre = (min + max) * 0.5f;
+        float radius     = 0.0f;
+        for (uint32_t i = 0; i < index_count; i++) {
+            radius = std::max(radius, glm::length(vertices[get_index(i)].pos - centre));
+        }
+        return { glm::vec4(centre, radius), min, max };
+    }
+
+    void SceneLayout::add_mesh(const Vertex* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count,
+        VkIndexType index_type) {
+
+        uint32_t index_size = get_index_size(index_type);
+        index_bytes         = (index_bytes + 3) / 4 * 4;
+
+        MeshRange range;
+        range.first_index   = static_cast<uint32_t>(index_bytes / index_size);
+        range.index_count   = index_count;
+        range.vertex_offset = static_cast<int32_t>(vertex_bytes / sizeof(Vertex));
+        range.index_type    = index_type;
+        meshes.push_back(range);
+        bounds.push_back(compute_bounds(vertices, indices, index_count, index_type));
+
+        vertex_sources.push_back({ vertices, vertex_bytes, static_cast<VkDeviceSize>(vertex_count) * sizeof(Vertex) });
+        index_sources.push_back({ indices, index_bytes, static_cast<VkDeviceSize>(index_count) * index_size });
+
+        vertex_bytes += vertex_sources.back().size;
+        index_bytes  += index_sources.back().size;
+    }
+
+    /**
+     * The scene's buffers go in as one source each, its meshes get moved by where those ended up.
+     */
+    void SceneLayout::add_scene(const SceneGeometry& scene) {
+        index_bytes = (index_bytes + 3) / 4 * 4;
+
+        uint32_t first_index = static_cast<uint32_t>(index_bytes / sizeof(uint16_t));
+        int32_t first_vertex = static_cast<int32_t>(vertex_bytes / sizeof(Vertex));
+
+        vertex_sources.push_back({ scene.vertices.data(), vertex_bytes, scene.vertices.size() * sizeof(Vertex) });
+        index_sources.push_back({ scene.indices.data(), index_bytes, scene.indices.size() * sizeof(uint16_t) });
+
+        vertex_bytes += vertex_sources.back().size;
+        index_bytes  += index_sources.back().size;
+
+        for (MeshRange range : scene.meshes) {
+            bounds.push_back(compute_bounds(scene.vertices.data() + range.vertex_offset,
+                scene.indices.data() + range.first_index, range.index_count, range.index_type));
+
+            range.first_index   += first_index;
+            range.vertex_offset += first_vertex;
+            meshes.push_back(range);
+        }
+    }
+}
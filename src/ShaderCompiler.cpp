@@ -0,0 +1,338 @@
+#include "../include/ShaderCompiler.h"
+#include "../include/PipelineCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef ENABLE_SHADERC
+#include <shaderc/shaderc.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace vulkan_rendering {
+
+    static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+    static std::string normalize_path(const std::filesystem::path& path) {
+        return path.lexically_normal().string();
+    }
+
+    ShaderCompiler::ShaderCompiler(const std::string& source_dir, const std::string& cache_dir,
+        const std::vector<std::string>& defines) : source_dir(source_dir), cache_dir(cache_dir), defines(defines) {
+
+#ifdef ENABLE_SHADERC
+        compiler = shaderc_compiler_initialize();
+        if (compiler == nullptr) {
+            throw std::runtime_error("Failed to initialize shaderc!");
+        }
+#endif
+    }
+
+    ShaderCompiler::~ShaderCompiler() {
+#ifdef ENABLE_SHADERC
+        shaderc_compiler_release(static_cast<shaderc_compiler_t>(compiler));
+#endif
+    }
+
+    bool ShaderCompiler::is_available() {
+#ifdef ENABLE_SHADERC
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * The key covers everything shaderc sees, so editing an included file changes it just like editing the shader
+     * does. The expanded source has to be built either way, which is what a warm start still pays for.
+     */
+    AssetView ShaderCompiler::compile(const std::string& name, std::vector<char>& storage) {
+        std::vector<std::string> files;
+        std::string source;
+        try {
+            expand(normalize_path(std::filesystem::path(source_dir) / name), files, source, 0);
+        } catch (...) {
+            // Still watch what was read, fixing a broken include has to trigger a reload.
+            dependencies[name] = files;
+            throw;
+        }
+        dependencies[name] = files;
+
+        std::string stage = std::filesystem::path(name).extension().string();
+
+        PipelineHasher hasher;
+        hasher.add(CACHE_VERSION);
+        hasher.add(stage.data(), stage.size());
+        hasher.add(source.data(), source.size());
+        for (const auto& define : defines) {
+            hasher.add(define.data(), define.size() + 1);
+        }
+
+        if (read_cache(hasher.get(), storage)) {
+            stats.cache_hits++;
+        } else {
+            run_compiler(name, source, files, storage);
+            write_cache(hasher.get(), storage);
+        }
+        return { storage.data(), storage.size() };
+    }
+
+    std::vector<std::string> ShaderCompiler::get_dependents(const std::vector<std::string>& files) const {
+        std::vector<std::string> dependents;
+        for (const auto& shader : dependencies) {
+            for (const auto& file : files) {
+                std::string path = normalize_path(file);
+                if (std::find(shader.second.begin(), shader.second.end(), path) != shader.second.end()) {
+                    dependents.push_back(shader.first);
+                    break;
+                }
+            }
+        }
+        return dependents;
+    }
+
+    std::vector<std::string> ShaderCompiler::get_directories() const {
+        std::vector<std::string> directories;
+        for (const auto& shader : dependencies) {
+            for (const auto& file : shader.second) {
+                std::string directory = std::filesystem::path(file).parent_path().string();
+                if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+                    directories.push_back(directory);
+                }
+            }
+        }
+        return directories;
+    }
+
+    /**
+     * Every #include line is replaced by the included file, wrapped in #line directives so the compiler's messages
+     * point at the right file and line. The file's index in files is its source string number. There's no include
+     * guard handling of our own, headers need their own #ifndef guards.
+     */
+    void ShaderCompiler::expand(const std::string& path, std::vector<std::string>& files, std::string& source,
+        uint32_t depth) const {
+
+        if (depth > MAX_INCLUDE_DEPTH) {
+            throw std::runtime_error("Shader includes nest too deep! " + path);
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open shader source! " + path);
+        }
+
+        size_t index          = files.size();
+        std::string directory = std::filesystem::path(path).parent_path().string();
+        files.push_back(path);
+
+        std::string line;
+        uint32_t line_number = 0;
+        while (std::getline(file, line)) {
+            line_number++;
+
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+                source += line;
+                source += '\n';
+                continue;
+            }
+
+            size_t open  = line.find_first_of("\"<", start + 8);
+            size_t close = open != std::string::npos ? line.find(line[open] == '"' ? '"' : '>', open + 1) :
+                std::string::npos;
+            if (close == std::string::npos) {
+                throw std::runtime_error("Malformed #include! " + path + ":" + std::to_string(line_number));
+            }
+
+            std::string name = line.substr(open + 1, close - open - 1);
+            std::string base = line[open] == '"' ? directory : source_dir;
+
+            source += "#line 1 " + std::to_string(files.size()) + "\n";
+            expand(normalize_path(std::filesystem::path(base) / name), files, source, depth + 1);
+            source += "#line " + std::to_string(line_number + 1) + " " + std::to_string(index) + "\n";
+        }
+    }
+
+    static std::string get_cache_path(const std::string& cache_dir, uint64_t key) {
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key << ".spv";
+        return normalize_path(std::filesystem::path(cache_dir) / name.str());
+    }
+
+    /**
+     * Anything that doesn't look like a SPIR-V module counts as a miss, it gets compiled and written over.
+     */
+    bool ShaderCompiler::read_cache(uint64_t key, std::vector<char>& storage) const {
+        std::ifstream file(get_cache_path(cache_dir, key), std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(file.tellg());
+        if (size < 20 || size % 4 != 0) {
+            return false;
+        }
+
+        storage.resize(size);
+        file.seekg(0);
+        file.read(storage.data(), size);
+
+        uint32_t magic;
+        memcpy(&magic, storage.data(), sizeof(magic));
+        return file.good() && magic == SPIRV_MAGIC;
+    }
+
+    /**
+     * Same as the pipeline cache, written to a temporary file and renamed so a crash never leaves half a module
+     * behind. Failing to write only costs the next run a compile, so it's not an error.
+     */
+    void ShaderCompiler::write_cache(uint64_t key, const std::vector<char>& spirv) const {
+        std::error_code error;
+        std::filesystem::create_directories(cache_dir, error);
+
+        std::string path      = get_cache_path(cache_dir, key);
+        std::string temp_path = path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "Failed to write shader cache: " << temp_path << std::endl;
+                return;
+            }
+            file.write(spirv.data(), spirv.size());
+        }
+
+        std::remove(path.c_str());
+        std::rename(temp_path.c_str(), path.c_str());
+    }
+
+    void ShaderCompiler::run_compiler(const std::string& name, const std::string& source,
+        const std::vector<std::string>& files, std::vector<char>& storage) {
+
+#ifdef ENABLE_SHADERC
+        std::string stage = std::filesystem::path(name).extension().string();
+        shaderc_shader_kind kind;
+        if (stage == ".vert") {
+            kind = shaderc_glsl_vertex_shader;
+        } else if (stage == ".frag") {
+            kind = shaderc_glsl_fragment_shader;
+        } else if (stage == ".comp") {
+            kind = shaderc_glsl_compute_shader;
+        } else {
+            throw std::runtime_error("Unknown shader stage! " + name);
+        }
+
+        shaderc_compile_options_t options = shaderc_compile_options_initialize();
+        shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+        shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+        for (const auto& define : defines) {
+            size_t equals = define.find('=');
+            size_t length = equals != std::string::npos ? equals : define.size();
+            const char* value = equals != std::string::npos ? define.c_str() + equals + 1 : "";
+            shaderc_compile_options_add_macro_definition(options, define.c_str(), length, value, strlen(value));
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(compiler),
+            source.data(), source.size(), kind, name.c_str(), "main", options);
+        stats.compile_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+            start).count();
+        shaderc_compile_options_release(options);
+
+        if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+            std::string message = "Failed to compile shader! " + name + "\n" + shaderc_result_get_error_message(result);
+            for (size_t i = 0; i < files.size(); i++) {
+                message += "source " + std::to_string(i) + ": " + files[i] + "\n";
+            }
+            shaderc_result_release(result);
+            throw std::runtime_error(message);
+        }
+
+        const char* bytes = shaderc_result_get_bytes(result);
+        storage.assign(bytes, bytes + shaderc_result_get_length(result));
+        shaderc_result_release(result);
+        stats.compiled++;
+#else
+        (void)source;
+        (void)files;
+        (void)storage;
+        throw std::runtime_error("Built without ENABLE_SHADERC, can't compile! " + name);
+#endif
+    }
+
+    void ShaderCompiler::print_stats(std::ostream& out) const {
+        out << "Shaders: " << stats.compiled << " compiled in " << std::fixed << std::setprecision(2) <<
+            stats.compile_seconds * 1000.0 << "ms, " << stats.cache_hits << " from the cache in " << cache_dir <<
+            std::endl;
+    }
+
+#ifdef __linux__
+    ShaderWatcher::ShaderWatcher() {
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to initialize inotify!");
+        }
+    }
+
+    ShaderWatcher::~ShaderWatcher() {
+        close(fd);
+    }
+
+    /**
+     * Close after write catches editors that write in place, moved to the ones that write a temporary file and rename
+     * it over the original.
+     */
+    void ShaderWatcher::watch(const std::string& directory) {
+        int descriptor = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (descriptor < 0) {
+            throw std::runtime_error("Failed to watch shader directory! " + directory);
+        }
+        directories[descriptor] = directory;
+    }
+
+    std::vector<std::string> ShaderWatcher::poll() {
+        alignas(inotify_event) char buffer[4096];
+        std::vector<std::string> files;
+
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+                auto directory             = directories.find(event->wd);
+                if (event->len > 0 && directory != directories.end()) {
+                    std::string path = normalize_path(std::filesystem::path(directory->second) / event->name);
+                    if (std::find(files.begin(), files.end(), path) == files.end()) {
+                        files.push_back(path);
+                    }
+                }
+                at += sizeof(inotify_event) + event->len;
+            }
+        }
+        return files;
+    }
+#else
+    ShaderWatcher::ShaderWatcher() {
+    }
+
+    ShaderWatcher::~ShaderWatcher() {
+    }
+
+    void ShaderWatcher::watch(const std::string& directory) {
+        (void)directory;
+    }
+
+    std::vector<std::string> ShaderWatcher::poll() {
+        return {};
+    }
+#endif
+}
@@ -0,0 +1,567 @@
+#include "../include/ShaderReflection.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace vulkan_rendering {
+
+    static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+    // The bits of the SPIR-V spec we need, the values are the spec's.
+    enum SpirvOp {
+        OP_ENTRY_POINT        = 15,
+        OP_TYPE_BOOL          = 20,
+        OP_TYPE_INT           = 21,
+        OP_TYPE_FLOAT         = 22,
+        OP_TYPE_VECTOR        = 23,
+        OP_TYPE_MATRIX        = 24,
+        OP_TYPE_IMAGE         = 25,
+        OP_TYPE_SAMPLER       = 26,
+        OP_TYPE_SAMPLED_IMAGE = 27,
+        OP_TYPE_ARRAY         = 28,
+        OP_TYPE_RUNTIME_ARRAY = 29,
+        OP_TYPE_STRUCT        = 30,
+        OP_TYPE_POINTER       = 32,
+        OP_CONSTANT           = 43,
+        OP_SPEC_CONSTANT      = 50,
+        OP_VARIABLE           = 59,
+        OP_DECORATE           = 71,
+        OP_MEMBER_DECORATE    = 72
+    };
+
+    enum SpirvDecoration {
+        DECORATION_BLOCK          = 2,
+        DECORATION_BUFFER_BLOCK   = 3,
+        DECORATION_ARRAY_STRIDE   = 6,
+        DECORATION_MATRIX_STRIDE  = 7,
+        DECORATION_BUILT_IN       = 11,
+        DECORATION_LOCATION       = 30,
+        DECORATION_BINDING        = 33,
+        DECORATION_DESCRIPTOR_SET = 34,
+        DECORATION_OFFSET         = 35
+    };
+
+    enum SpirvStorageClass {
+        STORAGE_UNIFORM_CONSTANT = 0,
+        STORAGE_INPUT            = 1,
+        STORAGE_UNIFORM          = 2,
+        STORAGE_PUSH_CONSTANT    = 9,
+        STORAGE_STORAGE_BUFFER   = 12
+    };
+
+    static const uint32_t DIM_BUFFER       = 5;
+    static const uint32_t DIM_SUBPASS_DATA = 6;
+    static const uint32_t NOT_DECORATED    = UINT32_MAX;
+
+    /**
+     * Everything we keep about an id: the instruction that defines it (types, constants and variables only) and its
+     * decorations. Decorations come before the types in a module, so they're all known by the time we look.
+     */
+    struct SpirvId {
+        const uint32_t* words = nullptr;
+        uint32_t word_count   = 0;
+
+        uint32_t set          = NOT_DECORATED;
+        uint32_t binding      = NOT_DECORATED;
+        uint32_t location     = NOT_DECORATED;
+        uint32_t array_stride = 0;
+        bool block            = false;
+        bool buffer_block     = false;
+        bool built_in         = false;
+
+        std::vector<uint32_t> member_offsets;
+        std::vector<uint32_t> member_matrix_strides;
+
+        uint32_t get_op() const { return words != nullptr ? words[0] & 0xffff : 0; }
+
+        // Operand i of the defining instruction, 0 is the first word after the opcode.
+        uint32_t get(uint32_t i) const {
+            if (i + 1 >= word_count) {
+                throw std::runtime_error("Invalid SPIR-V, instruction too short!");
+            }
+            return words[i + 1];
+        }
+    };
+
+    static const SpirvId& get_id(const std::vector<SpirvId>& ids, uint32_t id) {
+        if (id >= ids.size() || ids[id].words == nullptr) {
+            throw std::runtime_error("Invalid SPIR-V, undefined id! " + std::to_string(id));
+        }
+        return ids[id];
+    }
+
+    static void set_member(std::vector<uint32_t>& members, uint32_t member, uint32_t value) {
+        if (member >= members.size()) {
+            members.resize(member + 1, 0);
+        }
+        members[member] = value;
+    }
+
+    static uint32_t get_array_length(const std::vector<SpirvId>& ids, const SpirvId& array) {
+        const SpirvId& length = get_id(ids, array.get(2));
+        if (length.get_op() != OP_CONSTANT && length.get_op() != OP_SPEC_CONSTANT) {
+            throw std::runtime_error("Can't reflect an array whose length isn't a constant!");
+        }
+        return length.get(2);
+    }
+
+    /**
+     * Bytes the type takes in a block laid out with its Offset, ArrayStride and MatrixStride decorations. A runtime
+     * array takes none, it can only be last.
+     */
+    static uint32_t get_size(const std::vector<SpirvId>& ids, uint32_t type_id, uint32_t matrix_stride) {
+        const SpirvId& type = get_id(ids, type_id);
+        switch (type.get_op()) {
+            case OP_TYPE_BOOL:
+                return 4;
+            case OP_TYPE_INT:
+            case OP_TYPE_FLOAT:
+                return type.get(1) / 8;
+            case OP_TYPE_VECTOR:
+                return type.get(2) * get_size(ids, type.get(1), 0);
+            case OP_TYPE_MATRIX:
+                return type.get(2) * (matrix_stride != 0 ? matrix_stride : get_size(ids, type.get(1), 0));
+            case OP_TYPE_ARRAY:
+                return get_array_length(ids, type) * (type.array_stride != 0 ? type.array_stride :
+                    get_size(ids, type.get(1), matrix_stride));
+            case OP_TYPE_RUNTIME_ARRAY:
+                return 0;
+            case OP_TYPE_STRUCT: {
+                uint32_t size = 0;
+                for (uint32_t i = 0; i + 2 < type.word_count; i++) {
+                    uint32_t offset = i < type.member_offsets.size() ? type.member_offsets[i] : 0;
+                    uint32_t stride = i < type.member_matrix_strides.size() ? type.member_matrix_strides[i] : 0;
+                    size            = std::max(size, offset + get_size(ids, type.get(i + 1), stride));
+                }
+                return size;
+            }
+            default:
+                throw std::runtime_error("Can't reflect the size of SPIR-V type! " + std::to_string(type.get_op()));
+        }
+    }
+
+    static VkDescriptorType get_descriptor_type(const SpirvId& type, uint32_t storage_class) {
+        if (storage_class == STORAGE_STORAGE_BUFFER) {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+        if (storage_class == STORAGE_UNIFORM) {
+            // SPIR-V 1.0 has no StorageBuffer storage class, a BufferBlock struct in Uniform is a storage buffer.
+            return type.buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+
+        switch (type.get_op()) {
+            case OP_TYPE_SAMPLER:
+                return VK_DESCRIPTOR_TYPE_SAMPLER;
+            case OP_TYPE_SAMPLED_IMAGE:
+                return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            case OP_TYPE_IMAGE: {
+                bool storage = type.get(6) == 2;
+                if (type.get(2) == DIM_BUFFER) {
+                    return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+                }
+                if (type.get(2) == DIM_SUBPASS_DATA) {
+                    return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+                }
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            default:
+                throw std::runtime_error("Can't reflect the descriptor type of SPIR-V type! " +
+                    std::to_string(type.get_op()));
+        }
+    }
+
+    static VkFormat get_input_format(const std::vector<SpirvId>& ids, const SpirvId& type) {
+        uint32_t components = 1;
+        const SpirvId* scalar = &type;
+        if (type.get_op() == OP_TYPE_VECTOR) {
+            components = type.get(2);
+            scalar     = &get_id(ids, type.get(1));
+        }
+
+        static const VkFormat FLOAT_FORMATS[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+            VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+        static const VkFormat SINT_FORMATS[]  = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT,
+            VK_FORMAT_R32G32B32A32_SINT };
+        static const VkFormat UINT_FORMATS[]  = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT,
+            VK_FORMAT_R32G32B32A32_UINT };
+
+        uint32_t op = scalar->get_op();
+        if ((op != OP_TYPE_FLOAT && op != OP_TYPE_INT) || scalar->get(1) != 32 || components < 1 || components > 4) {
+            throw std::runtime_error("Can't reflect a vertex input that isn't 32 bit scalars or vectors!");
+        }
+        if (op == OP_TYPE_FLOAT) {
+            return FLOAT_FORMATS[components - 1];
+        }
+        return scalar->get(2) != 0 ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+    }
+
+    // Matrices and arrays take one location per column or element.
+    static void add_inputs(const std::vector<SpirvId>& ids, uint32_t type_id, uint32_t& location,
+        std::vector<ReflectedInput>& inputs) {
+
+        const SpirvId& type = get_id(ids, type_id);
+        if (type.get_op() == OP_TYPE_ARRAY) {
+            uint32_t length = get_array_length(ids, type);
+            for (uint32_t i = 0; i < length; i++) {
+                add_inputs(ids, type.get(1), location, inputs);
+            }
+        } else if (type.get_op() == OP_TYPE_MATRIX) {
+            for (uint32_t i = 0; i < type.get(2); i++) {
+                add_inputs(ids, type.get(1), location, inputs);
+            }
+        } else {
+            inputs.push_back({ location++, get_input_format(ids, type) });
+        }
+    }
+
+    static VkShaderStageFlagBits get_stage_bit(uint32_t execution_model) {
+        switch (execution_model) {
+            case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+            case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+            case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+            case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+            case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+            case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+            default:
+                throw std::runtime_error("Can't reflect execution model! " + std::to_string(execution_model));
+        }
+    }
+
+    static std::string get_stage_names(VkShaderStageFlags stages) {
+        static const std::pair<VkShaderStageFlagBits, const char*> NAMES[] = {
+            { VK_SHADER_STAGE_VERTEX_BIT, "vertex" },
+            { VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT, "tessellation control" },
+            { VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT, "tessellation evaluation" },
+            { VK_SHADER_STAGE_GEOMETRY_BIT, "geometry" },
+            { VK_SHADER_STAGE_FRAGMENT_BIT, "fragment" },
+            { VK_SHADER_STAGE_COMPUTE_BIT, "compute" }
+        };
+
+        std::string names;
+        for (const auto& name : NAMES) {
+            if (stages & name.first) {
+                names += (names.empty() ? "" : ", ") + std::string(name.second);
+            }
+        }
+        return names;
+    }
+
+    static std::string get_binding_name(uint32_t set, uint32_t binding) {
+        return "set " + std::to_string(set) + " binding " + std::to_string(binding);
+    }
+
+    /**
+     * One pass over the instructions to index the ids we care about, then the variables are looked at once everything
+     * they refer to is known. Function bodies are skipped over, nothing in them changes the interface.
+     */
+    ShaderReflection::ShaderReflection(const AssetView& code) {
+        const uint32_t* words = static_cast<const uint32_t*>(code.data);
+        size_t word_count     = static_cast<size_t>(code.size / 4);
+        if (code.size % 4 != 0 || word_count < 5 || words[0] != SPIRV_MAGIC) {
+            throw std::runtime_error("Invalid SPIR-V!");
+        }
+
+        // The id bound comes from the file, a garbage one shouldn't make us allocate gigabytes.
+        if (words[3] > word_count) {
+            throw std::runtime_error("Invalid SPIR-V, id bound too large!");
+        }
+        std::vector<SpirvId> ids(words[3]);
+        std::vector<uint32_t> variables;
+        bool found_entry_point = false;
+
+        auto get_target = [&ids](uint32_t id) -> SpirvId& {
+            if (id >= ids.size()) {
+                throw std::runtime_error("Invalid SPIR-V, id out of bounds! " + std::to_string(id));
+            }
+            return ids[id];
+        };
+
+        for (size_t at = 5; at < word_count;) {
+            const uint32_t* instruction = words + at;
+            uint32_t op                 = instruction[0] & 0xffff;
+            uint32_t length             = instruction[0] >> 16;
+            if (length == 0 || at + length > word_count) {
+                throw std::runtime_error("Invalid SPIR-V, truncated instruction!");
+            }
+            at += length;
+
+            if (op == OP_ENTRY_POINT && length >= 3 && !found_entry_point) {
+                stage             = get_stage_bit(instruction[1]);
+                found_entry_point = true;
+            } else if (op == OP_DECORATE && length >= 3) {
+                SpirvId& target = get_target(instruction[1]);
+                uint32_t value  = length >= 4 ? instruction[3] : 0;
+                switch (instruction[2]) {
+                    case DECORATION_BLOCK:          target.block        = true; break;
+                    case DECORATION_BUFFER_BLOCK:   target.buffer_block = true; break;
+                    case DECORATION_ARRAY_STRIDE:   target.array_stride = value; break;
+                    case DECORATION_BUILT_IN:       target.built_in     = true; break;
+                    case DECORATION_LOCATION:       target.location     = value; break;
+                    case DECORATION_BINDING:        target.binding      = value; break;
+                    case DECORATION_DESCRIPTOR_SET: target.set          = value; break;
+                }
+            } else if (op == OP_MEMBER_DECORATE && length >= 5) {
+                SpirvId& target = get_target(instruction[1]);
+                if (instruction[3] == DECORATION_OFFSET) {
+                    set_member(target.member_offsets, instruction[2], instruction[4]);
+                } else if (instruction[3] == DECORATION_MATRIX_STRIDE) {
+                    set_member(target.member_matrix_strides, instruction[2], instruction[4]);
+                }
+            } else if (op >= OP_TYPE_BOOL && op <= OP_TYPE_POINTER && length >= 2) {
+                SpirvId& target   = get_target(instruction[1]);
+                target.words      = instruction;
+                target.word_count = length;
+            } else if ((op == OP_CONSTANT || op == OP_SPEC_CONSTANT || op == OP_VARIABLE) && length >= 4) {
+                SpirvId& target   = get_target(instruction[2]);
+                target.words      = instruction;
+                target.word_count = length;
+                if (op == OP_VARIABLE) {
+                    variables.push_back(instruction[2]);
+                }
+            }
+        }
+
+        if (!found_entry_point) {
+            throw std::runtime_error("Invalid SPIR-V, no entry point!");
+        }
+
+        for (uint32_t id : variables) {
+            const SpirvId& variable = ids[id];
+            uint32_t storage_class  = variable.get(2);
+            const SpirvId& pointer  = get_id(ids, variable.get(0));
+            if (pointer.get_op() != OP_TYPE_POINTER) {
+                throw std::runtime_error("Invalid SPIR-V, variable isn't a pointer!");
+            }
+            uint32_t type_id = pointer.get(2);
+
+            if (storage_class == STORAGE_UNIFORM || storage_class == STORAGE_STORAGE_BUFFER ||
+                storage_class == STORAGE_UNIFORM_CONSTANT) {
+
+                if (variable.binding == NOT_DECORATED) {
+                    continue;
+                }
+
+                // Arrays of descriptors, a runtime array's size is up to the layout.
+                uint32_t count      = 1;
+                const SpirvId* type = &get_id(ids, type_id);
+                if (type->get_op() == OP_TYPE_ARRAY) {
+                    count = get_array_length(ids, *type);
+                    type  = &get_id(ids, type->get(1));
+                } else if (type->get_op() == OP_TYPE_RUNTIME_ARRAY) {
+                    count = 0;
+                    type  = &get_id(ids, type->get(1));
+                }
+
+                ReflectedBinding binding        = {};
+                binding.set                     = variable.set != NOT_DECORATED ? variable.set : 0;
+                binding.binding.binding         = variable.binding;
+                binding.binding.descriptorType  = get_descriptor_type(*type, storage_class);
+                binding.binding.descriptorCount = count;
+                binding.binding.stageFlags      = stage;
+                bindings.push_back(binding);
+            } else if (storage_class == STORAGE_PUSH_CONSTANT) {
+                const SpirvId& block = get_id(ids, type_id);
+                uint32_t offset      = UINT32_MAX;
+                for (uint32_t i = 0; i + 2 < block.word_count; i++) {
+                    offset = std::min(offset, i < block.member_offsets.size() ? block.member_offsets[i] : 0);
+                }
+                offset = offset == UINT32_MAX ? 0 : offset;
+
+                // Ranges have to be multiples of 4, a block ending in a 16 bit member would leave 2 bytes over.
+                uint32_t end              = (get_size(ids, type_id, 0) + 3) & ~3u;
+                push_constants.stageFlags = stage;
+                push_constants.offset     = offset;
+                push_constants.size       = end - offset;
+            } else if (storage_class == STORAGE_INPUT && stage == VK_SHADER_STAGE_VERTEX_BIT && !variable.built_in &&
+                variable.location != NOT_DECORATED) {
+
+                uint32_t location = variable.location;
+                add_inputs(ids, type_id, location, inputs);
+            }
+        }
+
+        std::sort(bindings.begin(), bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding.binding < b.binding.binding;
+        });
+        std::sort(inputs.begin(), inputs.end(), [](const ReflectedInput& a, const ReflectedInput& b) {
+            return a.location < b.location;
+        });
+    }
+
+    void PipelineReflection::add(const ShaderReflection& shader) {
+        for (const ReflectedBinding& binding : shader.get_bindings()) {
+            auto found = std::find_if(bindings.begin(), bindings.end(), [&binding](const ReflectedBinding& other) {
+                return other.set == binding.set && other.binding.binding == binding.binding.binding;
+            });
+            if (found == bindings.end()) {
+                bindings.push_back(binding);
+                continue;
+            }
+
+            if (found->binding.descriptorType != binding.binding.descriptorType ||
+                found->binding.descriptorCount != binding.binding.descriptorCount) {
+                throw std::runtime_error("Shader stages disagree about a descriptor! " +
+                    get_binding_name(binding.set, binding.binding.binding));
+            }
+            found->binding.stageFlags |= binding.binding.stageFlags;
+        }
+
+        if (shader.get_push_constants().size > 0) {
+            push_constants.push_back(shader.get_push_constants());
+        }
+        if (shader.get_stage() == VK_SHADER_STAGE_VERTEX_BIT) {
+            inputs = shader.get_inputs();
+        }
+    }
+
+    uint32_t PipelineReflection::get_set_count() const {
+        uint32_t count = 0;
+        for (const ReflectedBinding& binding : bindings) {
+            count = std::max(count, binding.set + 1);
+        }
+        return count;
+    }
+
+    std::vector<VkDescriptorSetLayoutBinding> PipelineReflection::get_bindings(uint32_t set) const {
+        std::vector<VkDescriptorSetLayoutBinding> set_bindings;
+        for (const ReflectedBinding& binding : bindings) {
+            if (binding.set == set) {
+                set_bindings.push_back(binding.binding);
+            }
+        }
+        std::sort(set_bindings.begin(), set_bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+                return a.binding < b.binding;
+            });
+        return set_bindings;
+    }
+
+    std::vector<VkPushConstantRange> PipelineReflection::get_push_constant_ranges() const {
+        if (push_constants.empty()) {
+            return {};
+        }
+
+        VkPushConstantRange merged = push_constants[0];
+        uint32_t end               = merged.offset + merged.size;
+        for (const VkPushConstantRange& range : push_constants) {
+            merged.stageFlags |= range.stageFlags;
+            merged.offset      = std::min(merged.offset, range.offset);
+            end                = std::max(end, range.offset + range.size);
+        }
+        merged.size = end - merged.offset;
+        return { merged };
+    }
+
+    /**
+     * A dynamic buffer in the layout fits the plain buffer the shader declares, the offset is only the CPU's business.
+     */
+    void PipelineReflection::check(const ShaderInterface& shader_interface) const {
+        for (const ReflectedBinding& binding : bindings) {
+            std::string name = get_binding_name(binding.set, binding.binding.binding);
+            if (binding.set >= shader_interface.sets.size()) {
+                throw std::runtime_error("Shader reads a descriptor set the pipeline layout doesn't have! " + name);
+            }
+
+            const auto& set = shader_interface.sets[binding.set];
+            auto provided   = std::find_if(set.begin(), set.end(), [&binding](const VkDescriptorSetLayoutBinding& b) {
+                return b.binding == binding.binding.binding;
+            });
+            if (provided == set.end()) {
+                throw std::runtime_error("Shader reads a binding the pipeline layout doesn't have! " + name);
+            }
+
+            VkDescriptorType type = provided->descriptorType;
+            if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) {
+                type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            } else if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC) {
+                type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            }
+            if (type != binding.binding.descriptorType) {
+                throw std::runtime_error("Shader reads a different descriptor type than the pipeline layout has! " +
+                    name);
+            }
+
+            uint32_t count = std::max(binding.binding.descriptorCount, 1u);
+            if (provided->descriptorCount < count) {
+                throw std::runtime_error("Shader reads more descriptors than the pipeline layout has! " + name);
+            }
+
+            VkShaderStageFlags missing = binding.binding.stageFlags & ~provided->stageFlags;
+            if (missing != 0) {
+                throw std::runtime_error("Pipeline layout doesn't make a binding visible to the " +
+                    get_stage_names(missing) + " stage! " + name);
+            }
+        }
+
+        for (const VkPushConstantRange& range : push_constants) {
+            bool covered = std::any_of(shader_interface.push_constants.begin(), shader_interface.push_constants.end(),
+                [&range](const VkPushConstantRange& provided) {
+                    return (provided.stageFlags & range.stageFlags) == range.stageFlags &&
+                        provided.offset <= range.offset && range.offset + range.size <= provided.offset + provided.size;
+                });
+            if (!covered) {
+                throw std::runtime_error("Pipeline layout doesn't cover the push constants of the " +
+                    get_stage_names(range.stageFlags) + " stage!");
+            }
+        }
+    }
+
+    enum class NumericType { Float, Sint, Uint };
+
+    // Normalized and scaled formats read as floats too.
+    static NumericType get_numeric_type(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_SINT: case VK_FORMAT_R8G8_SINT: case VK_FORMAT_R8G8B8_SINT: case VK_FORMAT_R8G8B8A8_SINT:
+            case VK_FORMAT_R16_SINT: case VK_FORMAT_R16G16_SINT: case VK_FORMAT_R16G16B16_SINT:
+            case VK_FORMAT_R16G16B16A16_SINT: case VK_FORMAT_R32_SINT: case VK_FORMAT_R32G32_SINT:
+            case VK_FORMAT_R32G32B32_SINT: case VK_FORMAT_R32G32B32A32_SINT: case VK_FORMAT_A2B10G10R10_SINT_PACK32:
+                return NumericType::Sint;
+            case VK_FORMAT_R8_UINT: case VK_FORMAT_R8G8_UINT: case VK_FORMAT_R8G8B8_UINT: case VK_FORMAT_R8G8B8A8_UINT:
+            case VK_FORMAT_R16_UINT: case VK_FORMAT_R16G16_UINT: case VK_FORMAT_R16G16B16_UINT:
+            case VK_FORMAT_R16G16B16A16_UINT: case VK_FORMAT_R32_UINT: case VK_FORMAT_R32G32_UINT:
+            case VK_FORMAT_R32G32B32_UINT: case VK_FORMAT_R32G32B32A32_UINT: case VK_FORMAT_A2B10G10R10_UINT_PACK32:
+                return NumericType::Uint;
+            default:
+                return NumericType::Float;
+        }
+    }
+
+    void PipelineReflection::check_vertex_input(const VertexInput& input) const {
+        for (const ReflectedInput& shader_input : inputs) {
+            auto attribute = std::find_if(input.attributes.begin(), input.attributes.end(),
+                [&shader_input](const VkVertexInputAttributeDescription& a) {
+                    return a.location == shader_input.location;
+                });
+            if (attribute == input.attributes.end()) {
+                throw std::runtime_error("Vertex shader reads a location no attribute feeds! location " +
+                    std::to_string(shader_input.location));
+            }
+            if (get_numeric_type(attribute->format) != get_numeric_type(shader_input.format)) {
+                throw std::runtime_error("Vertex attribute format doesn't match the shader's input type! location " +
+                    std::to_string(shader_input.location));
+            }
+        }
+    }
+
+    void PipelineReflection::narrow_stages(uint32_t set,
+        std::vector<VkDescriptorSetLayoutBinding>& set_bindings) const {
+
+        for (VkDescriptorSetLayoutBinding& binding : set_bindings) {
+            const VkDescriptorSetLayoutBinding* reflected = find(set, binding.binding);
+            if (reflected != nullptr) {
+                binding.stageFlags = reflected->stageFlags;
+            }
+        }
+    }
+
+    const VkDescriptorSetLayoutBinding* PipelineReflection::find(uint32_t set, uint32_t binding) const {
+        for (const ReflectedBinding& reflected : bindings) {
+            if (reflected.set == set && reflected.binding.binding == binding) {
+                return &reflected.binding;
+            }
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,422 @@
+#include "../include/StagingUploader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    StagingUploader::StagingUploader(VkDevice device, DeviceAllocator* allocator, uint32_t queue_family,
+        VkQueue queue, VkDeviceSize ring_size) : device(device), allocator(allocator), queue(queue),
+        ring_size(ring_size) {
+
+        /**
+         * Every batch gets re-recorded right after it retires, so the cmd buffers are transient and resettable on their
+         * own.
+         */
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+            VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex        = queue_family;
+
+        if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create the upload cmd pool!");
+        }
+
+        batches.resize(BATCH_COUNT);
+        std::vector<VkCommandBuffer> cmd_buffers(BATCH_COUNT);
+
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool                 = command_pool;
+        alloc_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount          = BATCH_COUNT;
+
+        if (vkAllocateCommandBuffers(device, &alloc_info, cmd_buffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate upload cmd buffers!");
+        }
+
+        VkFenceCreateInfo fence_info = {};
+        fence_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        for (uint32_t i = 0; i < BATCH_COUNT; i++) {
+            batches[i].cmd_buffer = cmd_buffers[i];
+            if (vkCreateFence(device, &fence_info, nullptr, &batches[i].fence) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create upload fence!");
+            }
+            idle_batches.push_back(i);
+        }
+
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size               = ring_size;
+        buffer_info.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &buffer_info, nullptr, &ring_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create staging ring buffer!");
+        }
+
+        VkMemoryRequirements mem_requirements;
+        vkGetBufferMemoryRequirements(device, ring_buffer, &mem_requirements);
+
+        ring_allocation = allocator->allocate(mem_requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ResourceKind::Linear);
+        vkBindBufferMemory(device, ring_buffer, ring_allocation.memory, ring_allocation.offset);
+
+        last_completion = clock::now();
+    }
+
+    StagingUploader::~StagingUploader() {
+        wait_idle();
+
+        for (auto& batch : batches) {
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+
+        // Destroying the pool frees the cmd buffers with it.
+        vkDestroyCommandPool(device, command_pool, nullptr);
+
+        vkDestroyBuffer(device, ring_buffer, nullptr);
+        allocator->free(ring_allocation);
+    }
+
+    bool StagingUploader::ring_empty() const {
+        return pending_copies.empty() && pending_image_copies.empty() && in_flight.empty();
+    }
+
+    /**
+     * The live part of the ring runs from the tail (oldest batch still in flight) to the head (last byte written). If
+     * the head hasn't wrapped yet we can write after it or wrap around to the front, otherwise we can only write up to
+     * the tail.
+     */
+    bool StagingUploader::try_reserve(VkDeviceSize size, VkDeviceSize& offset) {
+        if (ring_empty()) {
+            ring_head = 0;
+            ring_tail = 0;
+        }
+
+        bool wrapped         = ring_head < ring_tail || (ring_head == ring_tail && !ring_empty());
+        VkDeviceSize aligned = (ring_head + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+
+        if (!wrapped) {
+            if (aligned + size <= ring_size) {
+                offset = aligned;
+            } else if (size <= ring_tail) {
+                offset = 0;
+            } else {
+                return false;
+            }
+        } else if (aligned + size <= ring_tail) {
+            offset = aligned;
+        } else {
+            return false;
+        }
+
+        ring_head = offset + size;
+        return true;
+    }
+
+    /**
+     * If the ring is full we first submit whatever is queued (so the space we need can actually be freed) and then
+     * block on the oldest batch. That time is what shows up as stall time, if it's high the ring is too small.
+     */
+    VkDeviceSize StagingUploader::reserve(VkDeviceSize size) {
+        VkDeviceSize offset;
+        while (!try_reserve(size, offset)) {
+            if (!pending_copies.empty() || !pending_image_copies.empty()) {
+                flush();
+            }
+
+            if (in_flight.empty()) {
+                throw std::runtime_error("Upload does not fit into the staging ring!");
+            }
+
+            auto stall_start = clock::now();
+            retire_oldest();
+            stats.stall_seconds += std::chrono::duration<double>(clock::now() - stall_start).count();
+        }
+        return offset;
+    }
+
+    uint64_t StagingUploader::upload(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size) {
+        const char* src     = static_cast<const char*>(data);
+        VkDeviceSize max_chunk = ring_size / 2;
+
+        while (size > 0) {
+            VkDeviceSize chunk  = std::min(size, max_chunk);
+            VkDeviceSize offset = reserve(chunk);
+
+            memcpy(static_cast<char*>(ring_allocation.mapped) + offset, src, (size_t)chunk);
+
+            PendingCopy copy;
+            copy.dst              = dst;
+            copy.region.srcOffset = offset;
+            copy.region.dstOffset = dst_offset;
+            copy.region.size      = chunk;
+            pending_copies.push_back(copy);
+
+            stats.bytes_uploaded += chunk;
+            src        += chunk;
+            dst_offset += chunk;
+            size       -= chunk;
+        }
+
+        return next_ticket;
+    }
+
+    /**
+     * Bands are whole rows of blocks, so every one starts on a block boundary and only the last one may end on a
+     * partial block at the bottom edge of the mip, which is what the copy allows.
+     */
+    uint64_t StagingUploader::upload_image(VkImage dst, uint32_t mip, uint32_t width, uint32_t height,
+        uint32_t block_height, VkDeviceSize row_pitch, const void* data) {
+
+        const char* src        = static_cast<const char*>(data);
+        uint32_t block_rows    = (height + block_height - 1) / block_height;
+        uint32_t rows_per_band = static_cast<uint32_t>(std::max<VkDeviceSize>(ring_size / 2 / row_pitch, 1));
+
+        for (uint32_t row = 0; row < block_rows; row += rows_per_band) {
+            uint32_t rows       = std::min(rows_per_band, block_rows - row);
+            VkDeviceSize chunk  = rows * row_pitch;
+            VkDeviceSize offset = reserve(chunk);
+
+            memcpy(static_cast<char*>(ring_allocation.mapped) + offset, src, (size_t)chunk);
+
+            PendingImageCopy copy                     = {};
+            copy.dst                                  = dst;
+            copy.region.bufferOffset                  = offset;
+            copy.region.imageSubresource.aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT;
+            copy.region.imageSubresource.mipLevel     = mip;
+            copy.region.imageSubresource.layerCount   = 1;
+            copy.region.imageOffset.y                 = static_cast<int32_t>(row * block_height);
+            copy.region.imageExtent.width             = width;
+            copy.region.imageExtent.height            = std::min(rows * block_height, height - row * block_height);
+            copy.region.imageExtent.depth             = 1;
+            copy.first                                = row == 0;
+            pending_image_copies.push_back(copy);
+
+            stats.bytes_uploaded += chunk;
+            src                  += chunk;
+        }
+
+        return next_ticket;
+    }
+
+    /**
+     * Every mip touched by the batch goes to TRANSFER_DST_OPTIMAL in one barrier, from UNDEFINED when the batch holds
+     * its first band and from SHADER_READ_ONLY_OPTIMAL when an earlier batch already wrote the bands above, then back
+     * to SHADER_READ_ONLY_OPTIMAL in one barrier after the copies. The images are concurrent between the graphics and the
+     * transfer family, so the layouts can change here without any ownership transfer.
+     */
+    void StagingUploader::record_image_copies(VkCommandBuffer cmd_buffer) {
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (const auto& copy : pending_image_copies) {
+            bool seen = false;
+            for (auto& barrier : barriers) {
+                if (barrier.image == copy.dst && barrier.subresourceRange.baseMipLevel ==
+                    copy.region.imageSubresource.mipLevel) {
+                    seen = true;
+                    if (copy.first) {
+                        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                    }
+                }
+            }
+            if (seen) {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier            = {};
+            barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask                   = 0;
+            barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout                       = copy.first ? VK_IMAGE_LAYOUT_UNDEFINED :
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image                           = copy.dst;
+            barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel   = copy.region.imageSubresource.mipLevel;
+            barrier.subresourceRange.levelCount     = 1;
+            barrier.subresourceRange.layerCount     = 1;
+            barriers.push_back(barrier);
+        }
+
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+            nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        std::vector<VkBufferImageCopy> regions;
+        for (size_t i = 0; i < pending_image_copies.size(); i++) {
+            const PendingImageCopy& copy = pending_image_copies[i];
+            regions.push_back(copy.region);
+
+            if (i + 1 == pending_image_copies.size() || pending_image_copies[i + 1].dst != copy.dst) {
+                vkCmdCopyBufferToImage(cmd_buffer, ring_buffer, copy.dst,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+                regions.clear();
+            }
+        }
+
+        for (auto& barrier : barriers) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+            nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+
+    uint64_t StagingUploader::flush() {
+        if (pending_copies.empty() && pending_image_copies.empty()) {
+            return next_ticket - 1;
+        }
+
+        retire_completed();
+        if (idle_batches.empty()) {
+            auto stall_start = clock::now();
+            retire_oldest();
+            stats.stall_seconds += std::chrono::duration<double>(clock::now() - stall_start).count();
+        }
+
+        uint32_t index = idle_batches.back();
+        idle_batches.pop_back();
+        Batch& batch = batches[index];
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        vkBeginCommandBuffer(batch.cmd_buffer, &begin_info);
+
+        // Copies going to the same buffer are merged into one vkCmdCopyBuffer with several regions.
+        std::vector<VkBufferCopy> regions;
+        for (size_t i = 0; i < pending_copies.size(); i++) {
+            regions.push_back(pending_copies[i].region);
+
+            if (i + 1 == pending_copies.size() || pending_copies[i + 1].dst != pending_copies[i].dst) {
+                vkCmdCopyBuffer(batch.cmd_buffer, ring_buffer, pending_copies[i].dst,
+                    static_cast<uint32_t>(regions.size()), regions.data());
+                regions.clear();
+            }
+        }
+
+        if (!pending_image_copies.empty()) {
+            record_image_copies(batch.cmd_buffer);
+        }
+
+        /**
+         * Make the transfer writes available before the fence signals. The graphics queue only starts reading the
+         * buffers after the fence has been observed, so this is all the synchronization the uploads need.
+         */
+        VkMemoryBarrier barrier = {};
+        barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask   = 0;
+
+        vkCmdPipelineBarrier(batch.cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        if (vkEndCommandBuffer(batch.cmd_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the upload cmd buffer!");
+        }
+
+        VkSubmitInfo submit_info       = {};
+        submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &batch.cmd_buffer;
+
+        vkResetFences(device, 1, &batch.fence);
+        if (vkQueueSubmit(queue, 1, &submit_info, batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+
+        batch.ticket      = next_ticket++;
+        batch.ring_end    = ring_head;
+        batch.submit_time = clock::now();
+        in_flight.push_back(index);
+
+        stats.batch_count++;
+        stats.copy_count += pending_copies.size() + pending_image_copies.size();
+        pending_copies.clear();
+        pending_image_copies.clear();
+
+        return batch.ticket;
+    }
+
+    bool StagingUploader::is_complete(uint64_t ticket) {
+        retire_completed();
+        return completed_ticket >= ticket;
+    }
+
+    void StagingUploader::wait(uint64_t ticket) {
+        if (ticket >= next_ticket) {
+            flush();
+        }
+
+        retire_completed();
+        if (completed_ticket >= ticket) {
+            return;
+        }
+
+        auto stall_start = clock::now();
+        while (completed_ticket < ticket && !in_flight.empty()) {
+            retire_oldest();
+        }
+        stats.stall_seconds += std::chrono::duration<double>(clock::now() - stall_start).count();
+    }
+
+    void StagingUploader::wait_idle() {
+        flush();
+        while (!in_flight.empty()) {
+            retire_oldest();
+        }
+    }
+
+    /**
+     * Batches execute in submission order, so we only ever retire from the front. That keeps the ring tail moving
+     * forward one batch at a time.
+     */
+    void StagingUploader::retire_completed() {
+        while (!in_flight.empty() && vkGetFenceStatus(device, batches[in_flight.front()].fence) == VK_SUCCESS) {
+            retire(in_flight.front());
+        }
+    }
+
+    void StagingUploader::retire_oldest() {
+        uint32_t index = in_flight.front();
+        vkWaitForFences(device, 1, &batches[index].fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        retire(index);
+    }
+
+    void StagingUploader::retire(uint32_t index) {
+        const Batch& batch = batches[index];
+        in_flight.pop_front();
+
+        ring_tail        = batch.ring_end;
+        completed_ticket = batch.ticket;
+
+        // Only count the part of this batch that didn't overlap with the previous one, otherwise back to back batches
+        // would be counted twice.
+        auto now   = clock::now();
+        auto start = std::max(batch.submit_time, last_completion);
+        if (now > start) {
+            stats.busy_seconds += std::chrono::duration<double>(now - start).count();
+        }
+        last_completion = now;
+
+        idle_batches.push_back(index);
+    }
+
+    void StagingUploader::print_stats(std::ostream& out) const {
+        out << "Uploads: " << stats.bytes_uploaded << " bytes in " << stats.copy_count << " copies, " <<
+            stats.batch_count << " batches, " << std::fixed << std::setprecision(2) <<
+            stats.throughput_mb_per_second() << " MB/s, " << stats.stall_seconds * 1000.0 << "ms stalled" <<
+            std::endl;
+    }
+}
@@ -0,0 +1,251 @@
+#include "../include/TextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header has to match the KTX2 header");
+    static_assert(sizeof(Ktx2Level) == 24, "Ktx2Level has to match a KTX2 level index entry");
+    static_assert(sizeof(DdsHeader) == 124, "DdsHeader has to match DDS_HEADER");
+    static_assert(sizeof(DdsHeaderDx10) == 20, "DdsHeaderDx10 has to match DDS_HEADER_DXT10");
+
+    static const char KTX2_IDENTIFIER[12] = { '\xAB', 'K', 'T', 'X', ' ', '2', '0', '\xBB', '\r', '\n', '\x1A', '\n' };
+
+    // DDS_PIXELFORMAT flags and the DDS_HEADER caps that mark what we can't load.
+    static const uint32_t DDPF_FOURCC         = 0x4;
+    static const uint32_t DDPF_RGB            = 0x40;
+    static const uint32_t DDSD_MIPMAPCOUNT    = 0x20000;
+    static const uint32_t DDSCAPS2_CUBEMAP    = 0x200;
+    static const uint32_t DDSCAPS2_VOLUME     = 0x200000;
+    static const uint32_t DDS_DIMENSION_2D    = 3;
+    static const uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+
+    static uint32_t four_cc(const char* code) {
+        return static_cast<uint32_t>(static_cast<uint8_t>(code[0])) |
+            static_cast<uint32_t>(static_cast<uint8_t>(code[1])) << 8 |
+            static_cast<uint32_t>(static_cast<uint8_t>(code[2])) << 16 |
+            static_cast<uint32_t>(static_cast<uint8_t>(code[3])) << 24;
+    }
+
+    FormatBlock get_format_block(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8_UNORM:
+            case VK_FORMAT_R8_SRGB:
+                return { 1, 1, 1 };
+            case VK_FORMAT_R8G8_UNORM:
+            case VK_FORMAT_R16_SFLOAT:
+                return { 1, 1, 2 };
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_R32_SFLOAT:
+                return { 1, 1, 4 };
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return { 1, 1, 8 };
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return { 1, 1, 16 };
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                return { 4, 4, 8 };
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+            case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+            case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+            case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+                return { 4, 4, 16 };
+            default:
+                return { 0, 0, 0 };
+        }
+    }
+
+    /**
+     * The few DXGI_FORMATs with a FormatBlock, everything else maps to VK_FORMAT_UNDEFINED.
+     */
+    static VkFormat from_dxgi_format(uint32_t dxgi_format) {
+        switch (dxgi_format) {
+            case 2:  return VK_FORMAT_R32G32B32A32_SFLOAT;
+            case 10: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+            case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+            case 41: return VK_FORMAT_R32_SFLOAT;
+            case 49: return VK_FORMAT_R8G8_UNORM;
+            case 54: return VK_FORMAT_R16_SFLOAT;
+            case 61: return VK_FORMAT_R8_UNORM;
+            case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+            case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+            case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+            case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+            case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+            case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+            case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+            case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+            case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+            case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    TextureFile::TextureFile(const std::string& path) : file(path) {
+        if (file.get_size() >= sizeof(Ktx2Header) &&
+            memcmp(file.get_data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0) {
+            parse_ktx2();
+        } else if (file.get_size() >= 4 + sizeof(DdsHeader) && memcmp(file.get_data(), "DDS ", 4) == 0) {
+            parse_dds();
+        } else {
+            throw std::runtime_error("Texture is neither KTX2 nor DDS! " + path);
+        }
+
+        if (levels.empty()) {
+            throw std::runtime_error("Texture has no levels! " + path);
+        }
+    }
+
+    /**
+     * KTX2 stores the VkFormat as is and indexes every level, so the levels can sit anywhere in the file (they're
+     * usually smallest first, so a reader can stop early). A level count of 0 asks for the mips to be generated at
+     * load, which we don't do, so only level 0 gets loaded.
+     */
+    void TextureFile::parse_ktx2() {
+        Ktx2Header header;
+        memcpy(&header, file.get_data(), sizeof(header));
+
+        if (header.supercompression_scheme != 0) {
+            throw std::runtime_error("Supercompressed KTX2 textures aren't supported! " + file.get_path());
+        }
+        if (header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1) {
+            throw std::runtime_error("Only 2D KTX2 textures are supported! " + file.get_path());
+        }
+
+        format = static_cast<VkFormat>(header.vk_format);
+        if (get_format_block(format).size == 0) {
+            throw std::runtime_error("Unsupported KTX2 texture format " + std::to_string(header.vk_format) + "! " +
+                file.get_path());
+        }
+
+        uint32_t level_count = std::max(header.level_count, 1u);
+        if (sizeof(Ktx2Header) + level_count * sizeof(Ktx2Level) > file.get_size()) {
+            throw std::runtime_error("KTX2 level index points past the end of the file! " + file.get_path());
+        }
+
+        for (uint32_t mip = 0; mip < level_count; mip++) {
+            Ktx2Level level;
+            memcpy(&level, file.get_data() + sizeof(Ktx2Header) + mip * sizeof(Ktx2Level), sizeof(level));
+            add_level(level.byte_offset, level.byte_length, std::max(header.pixel_width >> mip, 1u),
+                std::max(header.pixel_height >> mip, 1u));
+        }
+    }
+
+    /**
+     * DDS has no level index, the levels follow the header one after the other from the largest down. The format comes
+     * from the DX10 header's DXGI_FORMAT when there is one, otherwise from the FourCC or the RGBA masks.
+     */
+    void TextureFile::parse_dds() {
+        DdsHeader header;
+        memcpy(&header, file.get_data() + 4, sizeof(header));
+        uint64_t offset = 4 + sizeof(header);
+
+        if ((header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0) {
+            throw std::runtime_error("Only 2D DDS textures are supported! " + file.get_path());
+        }
+
+        if ((header.format_flags & DDPF_FOURCC) != 0 && header.four_cc == four_cc("DX10")) {
+            if (offset + sizeof(DdsHeaderDx10) > file.get_size()) {
+                throw std::runtime_error("DDS DX10 header is cut off! " + file.get_path());
+            }
+
+            DdsHeaderDx10 dx10;
+            memcpy(&dx10, file.get_data() + offset, sizeof(dx10));
+            offset += sizeof(dx10);
+
+            if (dx10.resource_dimension != DDS_DIMENSION_2D || dx10.array_size > 1 ||
+                (dx10.misc_flag & DDS_MISC_TEXTURECUBE) != 0) {
+                throw std::runtime_error("Only 2D DDS textures are supported! " + file.get_path());
+            }
+            format = from_dxgi_format(dx10.dxgi_format);
+        } else if ((header.format_flags & DDPF_FOURCC) != 0) {
+            uint32_t code = header.four_cc;
+            if (code == four_cc("DXT1")) {
+                format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            } else if (code == four_cc("DXT3")) {
+                format = VK_FORMAT_BC2_UNORM_BLOCK;
+            } else if (code == four_cc("DXT5")) {
+                format = VK_FORMAT_BC3_UNORM_BLOCK;
+            } else if (code == four_cc("ATI1") || code == four_cc("BC4U")) {
+                format = VK_FORMAT_BC4_UNORM_BLOCK;
+            } else if (code == four_cc("BC4S")) {
+                format = VK_FORMAT_BC4_SNORM_BLOCK;
+            } else if (code == four_cc("ATI2") || code == four_cc("BC5U")) {
+                format = VK_FORMAT_BC5_UNORM_BLOCK;
+            } else if (code == four_cc("BC5S")) {
+                format = VK_FORMAT_BC5_SNORM_BLOCK;
+            } else if (code == 113) {
+                format = VK_FORMAT_R16G16B16A16_SFLOAT;
+            } else if (code == 116) {
+                format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            }
+        } else if ((header.format_flags & DDPF_RGB) != 0 && header.rgb_bit_count == 32) {
+            if (header.r_mask == 0x000000ff && header.b_mask == 0x00ff0000) {
+                format = VK_FORMAT_R8G8B8A8_UNORM;
+            } else if (header.r_mask == 0x00ff0000 && header.b_mask == 0x000000ff) {
+                format = VK_FORMAT_B8G8R8A8_UNORM;
+            }
+        }
+
+        if (format == VK_FORMAT_UNDEFINED) {
+            throw std::runtime_error("Unsupported DDS texture format! " + file.get_path());
+        }
+
+        FormatBlock block    = get_format_block(format);
+        uint32_t level_count = (header.flags & DDSD_MIPMAPCOUNT) != 0 ? std::max(header.mip_map_count, 1u) : 1;
+        for (uint32_t mip = 0; mip < level_count; mip++) {
+            uint32_t width  = std::max(header.width >> mip, 1u);
+            uint32_t height = std::max(header.height >> mip, 1u);
+            uint64_t size   = static_cast<uint64_t>((width + block.width - 1) / block.width) *
+                ((height + block.height - 1) / block.height) * block.size;
+
+            add_level(offset, size, width, height);
+            offset += size;
+        }
+    }
+
+    /**
+     * Levels have to hold at least a full block for every block of the level and lie within the file, the upload
+     * copies them as they are.
+     */
+    void TextureFile::add_level(uint64_t offset, uint64_t size, uint32_t width, uint32_t height) {
+        FormatBlock block  = get_format_block(format);
+        uint64_t row_pitch = static_cast<uint64_t>((width + block.width - 1) / block.width) * block.size;
+        uint64_t expected  = row_pitch * ((height + block.height - 1) / block.height);
+
+        if (width == 0 || size < expected || offset > file.get_size() || size > file.get_size() - offset) {
+            throw std::runtime_error("Texture level " + std::to_string(levels.size()) + " is cut off! " +
+                file.get_path());
+        }
+
+        levels.push_back({ file.get_data() + offset, expected, width, height, row_pitch });
+    }
+}
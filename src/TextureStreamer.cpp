@@ -0,0 +1,441 @@
+#include "../include/TextureStreamer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    TextureStreamer::TextureStreamer(VkPhysicalDevice physical_device, VkDevice device, DeviceAllocator* allocator,
+        StagingUploader* uploader, const std::vector<uint32_t>& queue_families, VkDeviceSize budget,
+        BindlessHeap* bindless_heap, VkDeviceSize upload_budget) : physical_device(physical_device), device(device),
+        allocator(allocator), uploader(uploader), queue_families(queue_families), bindless_heap(bindless_heap),
+        upload_budget(upload_budget) {
+
+        stats.budget_bytes = budget;
+    }
+
+    /**
+     * Only called once the device is idle, the uploads still in flight are the only thing left to wait for.
+     */
+    TextureStreamer::~TextureStreamer() {
+        uploader->wait_idle();
+
+        for (auto& texture : textures) {
+            destroy_image(texture.tail);
+            destroy_image(texture.detail);
+            destroy_image(texture.pending);
+        }
+        for (auto& image : retired) {
+            destroy_image(image.image);
+        }
+    }
+
+    uint32_t TextureStreamer::load(const std::string& path) {
+        Texture texture;
+        texture.file      = std::unique_ptr<TextureFile>(new TextureFile(path));
+        texture.load_time = clock::now();
+
+        const TextureFile& file = *texture.file;
+
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, file.get_format(), &format_properties);
+        if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+            throw std::runtime_error("Texture format can't be sampled on this device! " + path);
+        }
+
+        // The tail starts at the first level that's small enough, or is just the last level if none of them are.
+        uint32_t tail_mip = file.get_mip_count() - 1;
+        for (uint32_t mip = 0; mip < file.get_mip_count(); mip++) {
+            if (std::max(file.get_level(mip).width, file.get_level(mip).height) <= TAIL_SIZE) {
+                tail_mip = mip;
+                break;
+            }
+        }
+
+        texture.tail = create_image(file, tail_mip);
+        VkMemoryRequirements mem_requirements;
+        vkGetImageMemoryRequirements(device, texture.tail.image, &mem_requirements);
+        bind_image(texture.tail, file.get_format(), mem_requirements);
+
+        texture.tail_ticket = upload(file, texture.tail, file.get_mip_count() - 1);
+        uploader->flush();
+
+        textures.push_back(std::move(texture));
+        return static_cast<uint32_t>(textures.size() - 1);
+    }
+
+    void TextureStreamer::request(uint32_t texture, uint32_t mip, uint64_t frame) {
+        Texture& entry = textures[texture];
+        if (entry.last_used != frame) {
+            entry.last_used     = frame;
+            entry.requested_mip = mip;
+        } else {
+            entry.requested_mip = std::min(entry.requested_mip, mip);
+        }
+    }
+
+    /**
+     * Textures grow by at most one level per update, the ones showing the coarsest level go first so everything on
+     * screen gets sharper at about the same pace. Starting an image allocates it straight away, so the budget covers
+     * images that are still uploading too. Only the new level counts against the upload budget, the rest is copied.
+     */
+    void TextureStreamer::update(uint64_t frame, uint64_t completed_frames) {
+        while (!retired.empty() && retired.front().retire_frame <= completed_frames) {
+            destroy_image(retired.front().image);
+            retired.pop_front();
+        }
+
+        complete_uploads(frame, completed_frames);
+
+        std::vector<uint32_t> growing;
+        for (uint32_t i = 0; i < textures.size(); i++) {
+            const Texture& texture = textures[i];
+            if (texture.tail_ready && texture.pending.image == VK_NULL_HANDLE && texture.last_used == frame &&
+                texture.requested_mip < get_current_mip(texture)) {
+                growing.push_back(i);
+            }
+        }
+
+        std::sort(growing.begin(), growing.end(), [this](uint32_t a, uint32_t b) {
+            return get_current_mip(textures[a]) > get_current_mip(textures[b]);
+        });
+
+        VkDeviceSize started = 0;
+        for (uint32_t index : growing) {
+            if (started >= upload_budget) {
+                break;
+            }
+
+            Texture& texture   = textures[index];
+            TextureImage image = create_image(*texture.file, get_current_mip(texture) - 1);
+
+            VkMemoryRequirements mem_requirements;
+            vkGetImageMemoryRequirements(device, image.image, &mem_requirements);
+
+            if (!make_room(mem_requirements.size, frame)) {
+                destroy_image(image);
+                break;
+            }
+
+            bind_image(image, texture.file->get_format(), mem_requirements);
+            texture.pending            = image;
+            texture.pending_ticket     = upload(*texture.file, image, image.first_mip);
+            texture.pending_copy_frame = UINT64_MAX;
+            queued_copies.push_back(index);
+            started                   += texture.file->get_level(image.first_mip).size;
+        }
+
+        if (started > 0) {
+            uploader->flush();
+        }
+    }
+
+    static VkImageMemoryBarrier make_barrier(VkImage image, uint32_t first_level, uint32_t level_count,
+        VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout) {
+
+        VkImageMemoryBarrier barrier            = {};
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask                   = src_access;
+        barrier.dstAccessMask                   = dst_access;
+        barrier.oldLayout                       = old_layout;
+        barrier.newLayout                       = new_layout;
+        barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                           = image;
+        barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel   = first_level;
+        barrier.subresourceRange.levelCount     = level_count;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+        return barrier;
+    }
+
+    /**
+     * The pending image is one level finer than the one the view shows now, so its level i + 1 is the current image's
+     * level i. Earlier frames on this queue have to be done sampling the current image before it can move to
+     * TRANSFER_SRC_OPTIMAL, the uploader only ever touches the pending image's level 0.
+     */
+    void TextureStreamer::record(VkCommandBuffer cmd_buffer, uint64_t frame) {
+        if (queued_copies.empty()) {
+            return;
+        }
+
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (uint32_t index : queued_copies) {
+            const Texture& texture     = textures[index];
+            const TextureImage& source = texture.detail.image != VK_NULL_HANDLE ? texture.detail : texture.tail;
+            uint32_t levels            = texture.file->get_mip_count() - source.first_mip;
+
+            barriers.push_back(make_barrier(source.image, 0, levels, 0, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL));
+            barriers.push_back(make_barrier(texture.pending.image, 1, levels, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+        }
+
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+            nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        std::vector<VkImageCopy> regions;
+        for (uint32_t index : queued_copies) {
+            Texture& texture           = textures[index];
+            const TextureImage& source = texture.detail.image != VK_NULL_HANDLE ? texture.detail : texture.tail;
+
+            regions.clear();
+            for (uint32_t mip = source.first_mip; mip < texture.file->get_mip_count(); mip++) {
+                const TextureLevel& level = texture.file->get_level(mip);
+
+                VkImageCopy region               = {};
+                region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.srcSubresource.mipLevel   = mip - source.first_mip;
+                region.srcSubresource.layerCount = 1;
+                region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.dstSubresource.mipLevel   = mip - texture.pending.first_mip;
+                region.dstSubresource.layerCount = 1;
+                region.extent                    = { level.width, level.height, 1 };
+                regions.push_back(region);
+            }
+
+            vkCmdCopyImage(cmd_buffer, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture.pending.image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+            texture.pending_copy_frame = frame;
+            stats.copied_levels       += regions.size();
+        }
+
+        for (auto& barrier : barriers) {
+            barrier.srcAccessMask = barrier.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ?
+                VK_ACCESS_TRANSFER_WRITE_BIT : 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout     = barrier.newLayout;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+
+        vkCmdPipelineBarrier(cmd_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+            nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        queued_copies.clear();
+    }
+
+    VkImageView TextureStreamer::get_view(uint32_t texture) const {
+        const Texture& entry = textures[texture];
+        if (!entry.tail_ready) {
+            return VK_NULL_HANDLE;
+        }
+        return entry.detail.image != VK_NULL_HANDLE ? entry.detail.view : entry.tail.view;
+    }
+
+    uint32_t TextureStreamer::get_resident_mip(uint32_t texture) const {
+        return get_current_mip(textures[texture]);
+    }
+
+    uint32_t TextureStreamer::get_current_mip(const Texture& texture) const {
+        return texture.detail.image != VK_NULL_HANDLE ? texture.detail.first_mip : texture.tail.first_mip;
+    }
+
+    /**
+     * Only creates the image, the caller checks its memory requirements against the budget before binding it.
+     */
+    TextureStreamer::TextureImage TextureStreamer::create_image(const TextureFile& file, uint32_t first_mip) {
+        const TextureLevel& level = file.get_level(first_mip);
+
+        VkImageCreateInfo image_info = {};
+        image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType         = VK_IMAGE_TYPE_2D;
+        image_info.format            = file.get_format();
+        image_info.extent            = { level.width, level.height, 1 };
+        image_info.mipLevels         = file.get_mip_count() - first_mip;
+        image_info.arrayLayers       = 1;
+        image_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage             = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+            VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (queue_families.size() > 1) {
+            image_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+            image_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+            image_info.pQueueFamilyIndices   = queue_families.data();
+        } else {
+            image_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+        }
+
+        TextureImage image;
+        image.first_mip = first_mip;
+        if (vkCreateImage(device, &image_info, nullptr, &image.image) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create texture image! " + file.get_path());
+        }
+        return image;
+    }
+
+    void TextureStreamer::bind_image(TextureImage& image, VkFormat format,
+        const VkMemoryRequirements& mem_requirements) {
+
+        image.allocation = allocator->allocate(mem_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            ResourceKind::Optimal);
+        vkBindImageMemory(device, image.image, image.allocation.memory, image.allocation.offset);
+
+        stats.resident_bytes += image.allocation.size;
+        stats.peak_bytes      = std::max(stats.peak_bytes, stats.resident_bytes);
+
+        VkImageViewCreateInfo view_info           = {};
+        view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image                           = image.image;
+        view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format                          = format;
+        view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+        view_info.subresourceRange.baseMipLevel   = 0;
+        view_info.subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount     = 1;
+
+        if (vkCreateImageView(device, &view_info, nullptr, &image.view) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create texture image view!");
+        }
+    }
+
+    /**
+     * Queues the image's levels from the file's last_mip up to its first_mip, the smallest first. Returns the ticket of
+     * the last one, which completes no earlier than any of the others.
+     */
+    uint64_t TextureStreamer::upload(const TextureFile& file, const TextureImage& image, uint32_t last_mip) {
+        uint32_t block_height = get_format_block(file.get_format()).height;
+        uint64_t ticket       = 0;
+
+        for (uint32_t mip = last_mip + 1; mip-- > image.first_mip;) {
+            const TextureLevel& level = file.get_level(mip);
+            ticket = uploader->upload_image(image.image, mip - image.first_mip, level.width, level.height,
+                block_height, level.row_pitch, level.data);
+
+            stats.uploaded_levels++;
+            stats.uploaded_bytes += level.size;
+        }
+        return ticket;
+    }
+
+    void TextureStreamer::destroy_image(TextureImage& image) {
+        if (image.image == VK_NULL_HANDLE) {
+            return;
+        }
+
+        if (image.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, image.view, nullptr);
+        }
+        vkDestroyImage(device, image.image, nullptr);
+        if (image.allocation.memory != VK_NULL_HANDLE) {
+            allocator->free(image.allocation);
+        }
+        image = TextureImage();
+    }
+
+    /**
+     * Called before frame gets recorded, so the last frame that may sample the image is the one before it. The image
+     * stays allocated until then, but it no longer counts against the budget.
+     */
+    void TextureStreamer::retire(TextureImage& image, uint64_t frame) {
+        stats.resident_bytes -= image.allocation.size;
+        retired.push_back({ image, frame });
+        image = TextureImage();
+    }
+
+    void TextureStreamer::update_view(Texture& texture, uint64_t frame) {
+        if (!bindless_heap) {
+            return;
+        }
+
+        if (texture.handle != NO_HANDLE) {
+            bindless_heap->remove_image(texture.handle, frame);
+        }
+        VkImageView view = texture.detail.image != VK_NULL_HANDLE ? texture.detail.view : texture.tail.view;
+        texture.handle   = bindless_heap->add_image(view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    /**
+     * The latencies are only as fine as the frames, an upload counts as done at the first update after its fence. A
+     * pending image also needs the frame that copied its coarser levels to be done.
+     */
+    void TextureStreamer::complete_uploads(uint64_t frame, uint64_t completed_frames) {
+        auto now = clock::now();
+
+        for (auto& texture : textures) {
+            if (!texture.tail_ready && uploader->is_complete(texture.tail_ticket)) {
+                texture.tail_ready = true;
+                update_view(texture, frame);
+
+                double seconds            = std::chrono::duration<double>(now - texture.load_time).count();
+                stats.tail_loads++;
+                stats.tail_seconds_total += seconds;
+                stats.tail_seconds_max    = std::max(stats.tail_seconds_max, seconds);
+            }
+
+            if (texture.pending.image == VK_NULL_HANDLE || texture.pending_copy_frame >= completed_frames ||
+                !uploader->is_complete(texture.pending_ticket)) {
+                continue;
+            }
+
+            if (texture.detail.image != VK_NULL_HANDLE) {
+                retire(texture.detail, frame);
+            }
+            texture.detail  = texture.pending;
+            texture.pending = TextureImage();
+            update_view(texture, frame);
+
+            if (texture.detail.first_mip == 0 && !texture.reached_full) {
+                texture.reached_full      = true;
+                double seconds            = std::chrono::duration<double>(now - texture.load_time).count();
+                stats.full_loads++;
+                stats.full_seconds_total += seconds;
+                stats.full_seconds_max    = std::max(stats.full_seconds_max, seconds);
+            }
+        }
+    }
+
+    /**
+     * Evicts the detail image of whichever texture was requested the longest ago until size more bytes fit. Textures
+     * requested this frame and ones with an upload in flight are left alone, false means nothing else could go.
+     */
+    bool TextureStreamer::make_room(VkDeviceSize size, uint64_t frame) {
+        while (stats.resident_bytes + size > stats.budget_bytes) {
+            Texture* victim = nullptr;
+            for (auto& texture : textures) {
+                if (texture.detail.image == VK_NULL_HANDLE || texture.pending.image != VK_NULL_HANDLE ||
+                    texture.last_used == frame) {
+                    continue;
+                }
+                if (!victim || texture.last_used < victim->last_used) {
+                    victim = &texture;
+                }
+            }
+
+            if (!victim) {
+                return false;
+            }
+
+            stats.evictions++;
+            stats.evicted_levels += victim->tail.first_mip - victim->detail.first_mip;
+            retire(victim->detail, frame);
+            update_view(*victim, frame);
+        }
+        return true;
+    }
+
+    void TextureStreamer::print_stats(std::ostream& out) const {
+        const double mb = 1024.0 * 1024.0;
+
+        out << "Textures: " << textures.size() << ", " << std::fixed << std::setprecision(2) <<
+            stats.resident_bytes / mb << "/" << stats.budget_bytes / mb << " MB resident (" << stats.peak_bytes / mb <<
+            " MB peak), " << stats.uploaded_bytes / mb << " MB uploaded in " << stats.uploaded_levels << " levels, " <<
+            stats.copied_levels << " levels copied, " << stats.evictions << " evictions dropping " <<
+            stats.evicted_levels << " levels" << std::endl;
+
+        if (stats.tail_loads > 0) {
+            out << "Texture latency: " << stats.tail_seconds_total * 1000.0 / stats.tail_loads << "ms avg, " <<
+                stats.tail_seconds_max * 1000.0 << "ms max to the mip tail";
+            if (stats.full_loads > 0) {
+                out << ", " << stats.full_seconds_total * 1000.0 / stats.full_loads << "ms avg, " <<
+                    stats.full_seconds_max * 1000.0 << "ms max to level 0 over " << stats.full_loads << " textures";
+            }
+            out << std::endl;
+        }
+    }
+}
@@ -0,0 +1,296 @@
+#include "../include/TlsfAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vulkan_rendering {
+
+    static uint32_t find_last_set(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+        uint32_t bit = 0;
+        while (value >>= 1) {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+    static uint32_t find_first_set(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#else
+        uint32_t bit = 0;
+        while ((value & 1) == 0) {
+            value >>= 1;
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+    TlsfAllocator::TlsfAllocator(uint64_t capacity) : capacity(capacity), free_size(0) {
+        for (uint32_t fl = 0; fl < FL_COUNT; fl++) {
+            for (uint32_t sl = 0; sl < SL_COUNT; sl++) {
+                free_lists[fl][sl] = INVALID_NODE;
+            }
+        }
+
+        // The whole region starts out as one big free range.
+        if (capacity > 0) {
+            insert_free(create_node(0, capacity));
+        }
+    }
+
+    /**
+     * Sizes below SL_COUNT map linearly into the first row. Everything else goes to the row of its most significant bit
+     * and the next SL_LOG2 bits pick the column.
+     */
+    void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+        if (size < SL_COUNT) {
+            fl = 0;
+            sl = static_cast<uint32_t>(size);
+        } else {
+            uint32_t msb = find_last_set(size);
+            fl = msb - SL_LOG2 + 1;
+            sl = static_cast<uint32_t>(size >> (msb - SL_LOG2)) - SL_COUNT;
+        }
+    }
+
+    /**
+     * Round the size up to the next bucket boundary first. That way every range in the bucket we land in is guaranteed
+     * to be large enough and we can take the head of the list without walking it.
+     */
+    uint32_t TlsfAllocator::find_free_node(uint64_t size) const {
+        uint64_t rounded = size;
+        if (size >= SL_COUNT) {
+            rounded += (1ull << (find_last_set(size) - SL_LOG2)) - 1;
+        }
+
+        uint32_t fl, sl;
+        mapping(rounded, fl, sl);
+
+        if (fl >= FL_COUNT) {
+            return INVALID_NODE;
+        }
+
+        uint32_t sl_map = sl_bitmap[fl] & (~0u << sl);
+        if (sl_map == 0) {
+            uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~0ull << (fl + 1)) : 0;
+            if (fl_map == 0) {
+                return INVALID_NODE;
+            }
+
+            fl     = find_first_set(fl_map);
+            sl_map = sl_bitmap[fl];
+        }
+
+        sl = find_first_set(sl_map);
+        return free_lists[fl][sl];
+    }
+
+    uint32_t TlsfAllocator::create_node(uint64_t offset, uint64_t size) {
+        uint32_t index;
+        if (!recycled_nodes.empty()) {
+            index = recycled_nodes.back();
+            recycled_nodes.pop_back();
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+
+        nodes[index]        = Node();
+        nodes[index].offset = offset;
+        nodes[index].size   = size;
+        return index;
+    }
+
+    void TlsfAllocator::release_node(uint32_t node) {
+        recycled_nodes.push_back(node);
+    }
+
+    void TlsfAllocator::insert_free(uint32_t node) {
+        uint32_t fl, sl;
+        mapping(nodes[node].size, fl, sl);
+
+        uint32_t head          = free_lists[fl][sl];
+        nodes[node].is_free    = true;
+        nodes[node].prev_free  = INVALID_NODE;
+        nodes[node].next_free  = head;
+
+        if (head != INVALID_NODE) {
+            nodes[head].prev_free = node;
+        }
+
+        free_lists[fl][sl] = node;
+        fl_bitmap         |= 1ull << fl;
+        sl_bitmap[fl]     |= 1u << sl;
+
+        free_size += nodes[node].size;
+        free_range_count++;
+    }
+
+    void TlsfAllocator::remove_free(uint32_t node) {
+        uint32_t fl, sl;
+        mapping(nodes[node].size, fl, sl);
+
+        Node& n = nodes[node];
+        if (n.prev_free != INVALID_NODE) {
+            nodes[n.prev_free].next_free = n.next_free;
+        } else {
+            free_lists[fl][sl] = n.next_free;
+        }
+
+        if (n.next_free != INVALID_NODE) {
+            nodes[n.next_free].prev_free = n.prev_free;
+        }
+
+        if (free_lists[fl][sl] == INVALID_NODE) {
+            sl_bitmap[fl] &= ~(1u << sl);
+            if (sl_bitmap[fl] == 0) {
+                fl_bitmap &= ~(1ull << fl);
+            }
+        }
+
+        n.is_free   = false;
+        n.prev_free = INVALID_NODE;
+        n.next_free = INVALID_NODE;
+
+        free_size -= n.size;
+        free_range_count--;
+    }
+
+    /**
+     * Cuts the node down to size bytes and returns a new node covering the remainder. The remainder isn't put into any
+     * free list, the caller decides what happens to it.
+     */
+    uint32_t TlsfAllocator::split(uint32_t node, uint64_t size) {
+        uint64_t offset    = nodes[node].offset + size;
+        uint64_t remainder = nodes[node].size - size;
+
+        // create_node can reallocate the node storage, so don't hold references across it.
+        uint32_t tail = create_node(offset, remainder);
+
+        nodes[tail].prev_physical = node;
+        nodes[tail].next_physical = nodes[node].next_physical;
+        if (nodes[node].next_physical != INVALID_NODE) {
+            nodes[nodes[node].next_physical].prev_physical = tail;
+        }
+
+        nodes[node].next_physical = tail;
+        nodes[node].size          = size;
+        return tail;
+    }
+
+    bool TlsfAllocator::allocate(uint64_t size, uint64_t alignment, Range& range) {
+        size      = std::max<uint64_t>(size, 1);
+        alignment = std::max<uint64_t>(alignment, 1);
+        assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+        // Over allocate the search by the worst case padding so that any range we find can be aligned in place.
+        uint64_t search_size = size + alignment - 1;
+        if (search_size > free_size) {
+            return false;
+        }
+
+        uint32_t node = find_free_node(search_size);
+        if (node == INVALID_NODE) {
+            return false;
+        }
+
+        remove_free(node);
+
+        uint64_t aligned_offset = (nodes[node].offset + alignment - 1) & ~(alignment - 1);
+        uint64_t padding        = aligned_offset - nodes[node].offset;
+
+        // The padding in front stays free. The range before it is in use (otherwise they'd have been merged), so there's
+        // nothing to coalesce it with.
+        if (padding > 0) {
+            uint32_t rest = split(node, padding);
+            insert_free(node);
+            node = rest;
+        }
+
+        if (nodes[node].size > size) {
+            insert_free(split(node, size));
+        }
+
+        allocation_count++;
+
+        range.offset = nodes[node].offset;
+        range.size   = nodes[node].size;
+        range.node   = node;
+        return true;
+    }
+
+    bool TlsfAllocator::allocate_all(Range& range) {
+        if (allocation_count > 0 || fl_bitmap == 0) {
+            return false;
+        }
+
+        // With nothing allocated every range got merged back into a single one covering the region.
+        uint32_t fl   = find_first_set(fl_bitmap);
+        uint32_t node = free_lists[fl][find_first_set(sl_bitmap[fl])];
+        remove_free(node);
+        allocation_count++;
+
+        range.offset = nodes[node].offset;
+        range.size   = nodes[node].size;
+        range.node   = node;
+        return true;
+    }
+
+    /**
+     * Freed ranges are merged with their physical neighbours straight away so that two free ranges are never next to
+     * each other.
+     */
+    void TlsfAllocator::free(uint32_t node) {
+        assert(node < nodes.size() && !nodes[node].is_free && "Double free or invalid node");
+
+        uint32_t prev = nodes[node].prev_physical;
+        if (prev != INVALID_NODE && nodes[prev].is_free) {
+            remove_free(prev);
+            nodes[prev].size         += nodes[node].size;
+            nodes[prev].next_physical = nodes[node].next_physical;
+            if (nodes[node].next_physical != INVALID_NODE) {
+                nodes[nodes[node].next_physical].prev_physical = prev;
+            }
+            release_node(node);
+            node = prev;
+        }
+
+        uint32_t next = nodes[node].next_physical;
+        if (next != INVALID_NODE && nodes[next].is_free) {
+            remove_free(next);
+            nodes[node].size         += nodes[next].size;
+            nodes[node].next_physical = nodes[next].next_physical;
+            if (nodes[next].next_physical != INVALID_NODE) {
+                nodes[nodes[next].next_physical].prev_physical = node;
+            }
+            release_node(next);
+        }
+
+        insert_free(node);
+        allocation_count--;
+    }
+
+    /**
+     * Only used for stats. The highest non empty bucket holds the largest range, but ranges within a bucket aren't
+     * sorted so we walk that one list.
+     */
+    uint64_t TlsfAllocator::get_largest_free_range() const {
+        if (fl_bitmap == 0) {
+            return 0;
+        }
+
+        uint32_t fl = find_last_set(fl_bitmap);
+        uint32_t sl = find_last_set(sl_bitmap[fl]);
+
+        uint64_t largest = 0;
+        for (uint32_t node = free_lists[fl][sl]; node != INVALID_NODE; node = nodes[node].next_free) {
+            largest = std::max(largest, nodes[node].size);
+        }
+        return largest;
+    }
+}
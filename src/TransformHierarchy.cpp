@@ -0,0 +1,354 @@
+#include "../include/TransformHierarchy.h"
+#include "../include/Simd.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    // Past the last node, so a SIMD batch starting at any node stays inside the arrays.
+    static const uint32_t PADDING = 8;
+
+    TransformHierarchy::TransformHierarchy(bool allow_simd) : allow_simd(allow_simd) {
+    }
+
+    uint32_t TransformHierarchy::add_node(uint32_t parent, const glm::vec3& position, const glm::quat& rotation,
+        const glm::vec3& scale) {
+        uint32_t node = get_node_count();
+        if (parent != NO_PARENT && parent >= node) {
+            throw std::runtime_error("Parent transform node doesn't exist!");
+        }
+
+        // New nodes go on the end unsorted, sort_nodes pads the arrays again.
+        auto append = [node](std::vector<float>& array, float value) {
+            array.resize(node);
+            array.push_back(value);
+        };
+        append(position_x, position.x);
+        append(position_y, position.y);
+        append(position_z, position.z);
+        append(rotation_x, rotation.x);
+        append(rotation_y, rotation.y);
+        append(rotation_z, rotation.z);
+        append(rotation_w, rotation.w);
+        append(scale_x, scale.x);
+        append(scale_y, scale.y);
+        append(scale_z, scale.z);
+
+        uint32_t parent_slot = NO_PARENT;
+        uint32_t depth       = 0;
+        if (parent != NO_PARENT) {
+            parent_slot = slots[parent];
+            depth       = depths[parent_slot] + 1;
+        }
+        parents.push_back(parent_slot);
+        depths.push_back(depth);
+        handles.push_back(node);
+        slots.push_back(node);
+        sorted = false;
+        return node;
+    }
+
+    void TransformHierarchy::set_position(uint32_t node, const glm::vec3& position) {
+        uint32_t slot    = slots[node];
+        position_x[slot] = position.x;
+        position_y[slot] = position.y;
+        position_z[slot] = position.z;
+        mark_dirty(slot);
+    }
+
+    void TransformHierarchy::set_rotation(uint32_t node, const glm::quat& rotation) {
+        uint32_t slot    = slots[node];
+        rotation_x[slot] = rotation.x;
+        rotation_y[slot] = rotation.y;
+        rotation_z[slot] = rotation.z;
+        rotation_w[slot] = rotation.w;
+        mark_dirty(slot);
+    }
+
+    void TransformHierarchy::set_scale(uint32_t node, const glm::vec3& scale) {
+        uint32_t slot = slots[node];
+        scale_x[slot] = scale.x;
+        scale_y[slot] = scale.y;
+        scale_z[slot] = scale.z;
+        mark_dirty(slot);
+    }
+
+    void TransformHierarchy::mark_dirty(uint32_t slot) {
+        if (sorted && !dirty[slot]) {
+            dirty[slot] = 1;
+            dirty_slots.push_back(slot);
+        }
+    }
+
+    /**
+     * Breadth first from the roots, appending each node's children as it's reached. That sorts by depth, and since
+     * the parents of a depth get reached in order, the children of neighbouring parents end up next to each other.
+     * Siblings keep the order they were added in. Every world matrix is stale afterwards, so the roots get marked.
+     */
+    void TransformHierarchy::sort_nodes() {
+        uint32_t count = get_node_count();
+
+        std::vector<uint32_t> child_offsets(count + 1, 0);
+        for (uint32_t parent : parents) {
+            if (parent != NO_PARENT) {
+                child_offsets[parent + 1]++;
+            }
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            child_offsets[i + 1] += child_offsets[i];
+        }
+
+        std::vector<uint32_t> children(child_offsets[count]);
+        std::vector<uint32_t> filled(child_offsets.begin(), child_offsets.end() - 1);
+        std::vector<uint32_t> order;
+        order.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            if (parents[i] == NO_PARENT) {
+                order.push_back(i);
+            } else {
+                children[filled[parents[i]]++] = i;
+            }
+        }
+        uint32_t root_count = static_cast<uint32_t>(order.size());
+
+        child_begin.resize(count);
+        child_end.resize(count);
+        for (uint32_t i = 0; i < order.size(); i++) {
+            uint32_t old_slot = order[i];
+            child_begin[i]    = static_cast<uint32_t>(order.size());
+            order.insert(order.end(), children.begin() + child_offsets[old_slot],
+                children.begin() + child_offsets[old_slot + 1]);
+            child_end[i]      = static_cast<uint32_t>(order.size());
+        }
+
+        std::vector<uint32_t> new_slots(count);
+        for (uint32_t i = 0; i < count; i++) {
+            new_slots[order[i]] = i;
+        }
+
+        for (auto array : { &position_x, &position_y, &position_z, &rotation_x, &rotation_y, &rotation_z, &rotation_w,
+            &scale_x, &scale_y, &scale_z }) {
+            std::vector<float> sorted_array(count + PADDING, 0.0f);
+            for (uint32_t i = 0; i < count; i++) {
+                sorted_array[i] = (*array)[order[i]];
+            }
+            array->swap(sorted_array);
+        }
+
+        std::vector<uint32_t> sorted_parents(count);
+        std::vector<uint32_t> sorted_depths(count);
+        std::vector<uint32_t> sorted_handles(count);
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t parent   = parents[order[i]];
+            sorted_parents[i] = parent != NO_PARENT ? new_slots[parent] : parent;
+            sorted_depths[i]  = depths[order[i]];
+            sorted_handles[i] = handles[order[i]];
+            slots[sorted_handles[i]] = i;
+        }
+        parents.swap(sorted_parents);
+        depths.swap(sorted_depths);
+        handles.swap(sorted_handles);
+
+        depth_begin.clear();
+        for (uint32_t i = 0; i < count; i++) {
+            if (depths[i] == depth_begin.size()) {
+                depth_begin.push_back(i);
+            }
+        }
+
+        world.resize(count);
+        dirty.assign(count, 0);
+        dirty_slots.clear();
+        pending.assign(depth_begin.size(), std::vector<Range>());
+        sorted = true;
+
+        for (uint32_t i = 0; i < root_count; i++) {
+            mark_dirty(i);
+        }
+    }
+
+    /**
+     * Changed nodes start a run at their own depth. Each depth's runs get sorted and merged, updated, and the runs of
+     * their children passed on to the next depth, where they merge with whatever changed there.
+     */
+    uint32_t TransformHierarchy::update(WorkerPool& pool) {
+        if (!sorted) {
+            sort_nodes();
+        }
+
+        if (dirty_slots.empty()) {
+            return 0;
+        }
+
+        for (uint32_t slot : dirty_slots) {
+            dirty[slot] = 0;
+            pending[depths[slot]].push_back({ slot, slot + 1 });
+        }
+        dirty_slots.clear();
+
+        uint32_t updated = 0;
+        for (uint32_t depth = 0; depth < pending.size(); depth++) {
+            std::vector<Range>& ranges = pending[depth];
+            if (ranges.empty()) {
+                continue;
+            }
+
+            std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+            size_t merged = 0;
+            for (size_t i = 1; i < ranges.size(); i++) {
+                if (ranges[i].begin <= ranges[merged].end) {
+                    ranges[merged].end = std::max(ranges[merged].end, ranges[i].end);
+                } else {
+                    ranges[++merged] = ranges[i];
+                }
+            }
+            ranges.resize(merged + 1);
+
+            update_ranges(ranges, pool);
+
+            for (const Range& range : ranges) {
+                updated += range.end - range.begin;
+                Range children = { child_begin[range.begin], child_end[range.end - 1] };
+                if (depth + 1 < pending.size() && children.begin < children.end) {
+                    pending[depth + 1].push_back(children);
+                }
+            }
+            ranges.clear();
+        }
+
+        return updated;
+    }
+
+    void TransformHierarchy::update_ranges(std::vector<Range>& ranges, WorkerPool& pool) {
+        batches.clear();
+        uint32_t total = 0;
+        for (const Range& range : ranges) {
+            for (uint32_t begin = range.begin; begin < range.end; begin += BATCH_SIZE) {
+                batches.push_back({ begin, std::min(begin + BATCH_SIZE, range.end) });
+            }
+            total += range.end - range.begin;
+        }
+
+        auto run = [this](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+#if defined(SIMD_AVX2) || defined(SIMD_SSE2)
+                if (allow_simd) {
+                    update_slots<Simd>(batches[i].begin, batches[i].end);
+                    continue;
+                }
+#endif
+                update_slots<ScalarSimd>(batches[i].begin, batches[i].end);
+            }
+        };
+
+        if (total <= BATCH_SIZE) {
+            run(0, static_cast<uint32_t>(batches.size()));
+            return;
+        }
+
+        pool.parallel_for(static_cast<uint32_t>(batches.size()), [&](uint32_t worker, uint32_t begin, uint32_t end) {
+            run(begin, end);
+        });
+    }
+
+    const char* TransformHierarchy::get_simd_name() const {
+#if defined(SIMD_AVX2)
+        return allow_simd ? "avx2" : "scalar";
+#elif defined(SIMD_SSE2)
+        return allow_simd ? "sse2" : "scalar";
+#else
+        return "scalar";
+#endif
+    }
+
+    /**
+     * Every local is translate * rotate * scale, so only the upper 3x4 of any matrix is interesting and the bottom row
+     * stays 0 0 0 1. The locals get built from the arrays a register at a time, the parents' world matrices get
+     * gathered into the same layout and multiplied in, then the results get scattered back out into world.
+     */
+    template <typename Ops>
+    void TransformHierarchy::update_slots(uint32_t begin, uint32_t end) {
+        static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+        const uint32_t width = Ops::WIDTH;
+
+        // Column major like glm, element j * 3 + r is row r of column j.
+        alignas(32) float parent_columns[12][PADDING];
+        alignas(32) float world_columns[12][PADDING];
+
+        for (uint32_t i = begin; i < end; i += width) {
+            uint32_t lanes = std::min(width, end - i);
+
+            typename Ops::Float x = Ops::load(rotation_x.data() + i);
+            typename Ops::Float y = Ops::load(rotation_y.data() + i);
+            typename Ops::Float z = Ops::load(rotation_z.data() + i);
+            typename Ops::Float w = Ops::load(rotation_w.data() + i);
+            typename Ops::Float two = Ops::set(2.0f);
+            typename Ops::Float one = Ops::set(1.0f);
+
+            typename Ops::Float xx = Ops::mul(x, x), yy = Ops::mul(y, y), zz = Ops::mul(z, z);
+            typename Ops::Float xy = Ops::mul(x, y), xz = Ops::mul(x, z), yz = Ops::mul(y, z);
+            typename Ops::Float wx = Ops::mul(w, x), wy = Ops::mul(w, y), wz = Ops::mul(w, z);
+
+            typename Ops::Float sx = Ops::load(scale_x.data() + i);
+            typename Ops::Float sy = Ops::load(scale_y.data() + i);
+            typename Ops::Float sz = Ops::load(scale_z.data() + i);
+
+            typename Ops::Float local[12] = {
+                Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(yy, zz))), sx),
+                Ops::mul(Ops::mul(two, Ops::add(xy, wz)), sx),
+                Ops::mul(Ops::mul(two, Ops::sub(xz, wy)), sx),
+
+                Ops::mul(Ops::mul(two, Ops::sub(xy, wz)), sy),
+                Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(xx, zz))), sy),
+                Ops::mul(Ops::mul(two, Ops::add(yz, wx)), sy),
+
+                Ops::mul(Ops::mul(two, Ops::add(xz, wy)), sz),
+                Ops::mul(Ops::mul(two, Ops::sub(yz, wx)), sz),
+                Ops::mul(Ops::sub(one, Ops::mul(two, Ops::add(xx, yy))), sz),
+
+                Ops::load(position_x.data() + i),
+                Ops::load(position_y.data() + i),
+                Ops::load(position_z.data() + i)
+            };
+
+            // Roots and lanes past the end multiply with the identity.
+            for (uint32_t lane = 0; lane < width; lane++) {
+                const float* matrix = identity;
+                if (lane < lanes && parents[i + lane] != NO_PARENT) {
+                    matrix = &world[parents[i + lane]][0][0];
+                }
+                for (uint32_t j = 0; j < 4; j++) {
+                    for (uint32_t r = 0; r < 3; r++) {
+                        parent_columns[j * 3 + r][lane] = matrix[j * 4 + r];
+                    }
+                }
+            }
+
+            typename Ops::Float parent[12];
+            for (uint32_t k = 0; k < 12; k++) {
+                parent[k] = Ops::load(parent_columns[k]);
+            }
+
+            for (uint32_t j = 0; j < 4; j++) {
+                for (uint32_t r = 0; r < 3; r++) {
+                    typename Ops::Float value = Ops::add(Ops::add(Ops::mul(parent[r], local[j * 3]),
+                        Ops::mul(parent[3 + r], local[j * 3 + 1])), Ops::mul(parent[6 + r], local[j * 3 + 2]));
+                    if (j == 3) {
+                        value = Ops::add(value, parent[9 + r]);
+                    }
+                    Ops::store(world_columns[j * 3 + r], value);
+                }
+            }
+
+            for (uint32_t lane = 0; lane < lanes; lane++) {
+                glm::mat4& matrix = world[i + lane];
+                for (uint32_t j = 0; j < 4; j++) {
+                    for (uint32_t r = 0; r < 3; r++) {
+                        matrix[j][r] = world_columns[j * 3 + r][lane];
+                    }
+                    matrix[j][3] = j == 3 ? 1.0f : 0.0f;
+                }
+            }
+        }
+    }
+}
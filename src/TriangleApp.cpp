@@ -1,6 +1,5 @@
-﻿#include "/Applications/Xcode.app/Contents/Developer/Platforms/MacOSX.platform/Developer/SDKs/MacOSX.sdk/usr/include/_types/_uint32_t.h"
-#include "/usr/local/Cellar/glm/0.9.9.5/include/glm/ext/matrix_transform.hpp"
-#include "vulkan/vulkan_core.h"
+﻿#include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <stdexcept>
 #define GLFW_INCLUDE_VULKAN
@@ -10,17 +9,21 @@
 #include "../include/SwapChainSupportDetails.h"
 #include "../include/TriangleApp.h"
 #include "../include/FileHelper.h"
-#include "../include/Vertex.h"
+#include "../include/PipelineCache.h"
+#include "../include/VertexLayout.h"
 #include "../include/UniformBufferObject.h"
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <limits>
 #include <set>
 #include <string.h>
+#include <unordered_map>
 #include <vulkan/vulkan.h>
 
 namespace vulkan_rendering {
@@ -65,17 +68,183 @@ namespace vulkan_rendering {
         return VK_FALSE;
     }
 
+    /**
+     * What cull.comp reads, laid out like its MeshDraw and Culling blocks.
+     */
+    struct CullingMesh {
+        glm::vec4 sphere;
+        uint32_t index_count;
+        uint32_t first_index;
+        int32_t vertex_offset;
+        uint32_t list;
+    };
+
+    struct CullingConstants {
+        glm::vec4 planes[6];
+        uint32_t object_count;
+        uint32_t dynamic_count;
+        uint32_t list_first[2];
+    };
+
+    static_assert(sizeof(CullingMesh) == 32, "CullingMesh has to match MeshDraw in cull.comp");
+    static_assert(sizeof(CullingConstants) == 112, "CullingConstants has to match Culling in cull.comp");
+
+    /**
+     * bindless.vert's push constants, which of the heap's buffers holds this frame's transforms.
+     */
+    struct BindlessConstants {
+        glm::mat4 view_proj;
+        uint32_t transforms;
+    };
+
+    static_assert(offsetof(BindlessConstants, transforms) == 64,
+        "BindlessConstants has to match Bindless in bindless.vert");
+
     static void frame_buffer_resize_callback(GLFWwindow* window, int width, int height) {
         auto app = reinterpret_cast<TriangleApp*>(glfwGetWindowUserPointer(window));
-        app->frame_buffer_resized_flag = true;
+        app->on_frame_buffer_resized();
     }
 
-    TriangleApp::TriangleApp() {
+    TriangleApp::TriangleApp(const AppConfig& config) : config(config) {
         ext_validation = ExtensionValidation();
+
+        // The image ring has to be at least as deep as the frames in flight, otherwise we'd render into an image that
+        // the previous frame still owns.
+        if (this->config.offscreen_image_count < static_cast<uint32_t>(max_frames_per_flight)) {
+            this->config.offscreen_image_count = static_cast<uint32_t>(max_frames_per_flight);
+        }
+
+        // The culling shader writes the instance stream itself, the CPU side batches would never be drawn.
+        if (this->config.gpu_culling) {
+            this->config.instancing = false;
+        }
+
+        // Instanced draws cover every object of a mesh at once, there's no per object draw left to skip.
+        if (this->config.bvh_culling) {
+            this->config.cpu_culling = true;
+        }
+        if (this->config.instancing || this->config.gpu_culling) {
+            this->config.cpu_culling   = false;
+            this->config.per_draw_sets = false;
+            this->config.bindless      = false;
+        }
+
+        // The bindless draws don't bind a set of their own.
+        if (this->config.bindless) {
+            this->config.per_draw_sets = false;
+        }
+
+        profiler      = std::unique_ptr<Profiler>(new Profiler(this->config.profile));
+        vertex_format = &get_vertex_format(this->config.vertex_format);
+        load_scene();
+    }
+
+    /**
+     * Procedural meshes win when they're asked for, then a model given with --model, then every mesh in the asset pack.
+     * Meshes are only described here, their data stays where it was loaded (or mapped) until it's uploaded.
+     */
+    void TriangleApp::load_scene() {
+        if (!config.asset_pack_path.empty()) {
+            asset_pack = std::unique_ptr<AssetPack>(new AssetPack(config.asset_pack_path));
+        }
+
+        if (config.mesh_count > 0) {
+            generated_scene = make_procedural_scene(config.mesh_count, config.triangles_per_mesh);
+            scene.add_scene(generated_scene);
+            return;
+        }
+
+        if (!config.model_path.empty()) {
+            ImportStats stats;
+            imported_meshes = import_meshes(config.model_path, config.worker_count, &stats);
+            if (config.print_stats) {
+                stats.print(std::cout);
+            }
+
+            if (config.optimize_meshes) {
+                MeshOptimizeStats optimize_stats;
+                optimize_meshes(imported_meshes, config.worker_count, &optimize_stats);
+                if (config.print_stats) {
+                    optimize_stats.print(std::cout);
+                }
+            }
+
+            for (const auto& mesh : imported_meshes) {
+                scene.add_mesh(mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+                    mesh.index_data.data(), mesh.index_count, mesh.index_type);
+            }
+        } else if (asset_pack) {
+            for (const AssetEntry* entry : asset_pack->get_entries(AssetType::Mesh)) {
+                MeshView mesh = asset_pack->get_mesh(*entry);
+                scene.add_mesh(mesh.vertices, mesh.vertex_count, mesh.indices, mesh.index_count, mesh.index_type);
+            }
+        }
+
+        if (scene.get_meshes().empty()) {
+            generated_scene = make_quad_scene();
+            scene.add_scene(generated_scene);
+        }
+    }
+
+    uint64_t TriangleApp::get_triangles_per_frame() const {
+        uint64_t triangles = 0;
+        for (uint32_t i = 0; i < config.object_count; i++) {
+            triangles += scene.get_triangle_count(i % scene.get_meshes().size());
+        }
+        return triangles;
+    }
+
+    /**
+     * Draws recorded by the CPU. With GPU culling that's one indirect draw per index type, see get_visible_per_frame
+     * for how many objects those ended up drawing.
+     */
+    uint32_t TriangleApp::get_draws_per_frame() const {
+        if (config.gpu_culling) {
+            return (culling_list_size[0] > 0 ? 1 : 0) + (culling_list_size[1] > 0 ? 1 : 0);
+        }
+
+        // Depends on how the objects ended up split between the workers, so it's counted while recording.
+        if (config.bindless) {
+            return frame_number > 0 ? static_cast<uint32_t>(bindless_draws / frame_number) : 0;
+        }
+
+        if (config.cpu_culling) {
+            return static_cast<uint32_t>(get_visible_per_frame() + 0.5);
+        }
+
+        if (!config.instancing) {
+            return config.object_count;
+        }
+
+        uint32_t draws = 0;
+        for (const auto& batch : instance_batches) {
+            draws += (batch.dynamic_count > 0 ? 1 : 0) + (batch.static_count > 0 ? 1 : 0);
+        }
+        return draws;
+    }
+
+    double TriangleApp::get_visible_per_frame() const {
+        return culling_stats.frames > 0 ? culling_stats.visible / static_cast<double>(culling_stats.frames) : 0.0;
+    }
+
+    /**
+     * Only stamp the first event, a window being dragged fires plenty of them and we want the latency from the moment
+     * the size started changing.
+     */
+    void TriangleApp::on_frame_buffer_resized() {
+        frame_buffer_resized_flag = true;
+        if (!resize_pending) {
+            resize_pending = true;
+            resize_start   = std::chrono::high_resolution_clock::now();
+        }
     }
 
     void TriangleApp::run() {
-        init_window();
+        profiler->set_thread_name("main");
+
+        if (!config.headless) {
+            init_window();
+        }
         init_vulkan();
         main_loop();
         cleanup();
@@ -85,9 +254,10 @@ namespace vulkan_rendering {
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
-        window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
+        window = glfwCreateWindow(static_cast<int>(config.width), static_cast<int>(config.height), "Vulkan", nullptr,
+            nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, frame_buffer_resize_callback);
     }
@@ -95,18 +265,38 @@ namespace vulkan_rendering {
     void TriangleApp::init_vulkan() {
         create_instance();
         setup_debug_messenger();
-        create_surface();
+        if (!config.headless) {
+            create_surface();
+        }
         pick_physical_device();
         create_logical_device();
-        create_swap_chain();
+        create_allocator();
+        create_pipeline_cache();
+        create_shader_compiler();
+        if (config.headless) {
+            create_offscreen_images();
+        } else {
+            create_swap_chain();
+        }
         create_image_views();
+        create_render_graph();
         create_render_pass();
         create_descriptor_set_layout();
+        create_pipeline_layout();
         create_graphics_pipeline();
+        create_culling_pipeline();
+        if (shader_watcher) {
+            for (const auto& directory : shader_compiler->get_directories()) {
+                shader_watcher->watch(directory);
+            }
+        }
         create_frame_buffers();
-        create_command_pool();
-        create_vertex_buffer();
-        create_index_buffer();
+        create_command_pools();
+        create_gpu_profiler();
+        create_uploader();
+        create_textures();
+        create_transforms();
+        create_geometry_buffers();
         create_uniform_buffers();
         create_descriptor_pool();
         create_descriptor_sets();
@@ -115,9 +305,23 @@ namespace vulkan_rendering {
     }
 
     void TriangleApp::main_loop() {
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
-            draw_frame();
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        if (config.headless) {
+            // Without a window there's nothing to close, so default to a fixed number of frames.
+            uint32_t frame_count = config.frame_count > 0 ? config.frame_count : 1000;
+            for (uint32_t i = 0; i < frame_count; i++) {
+                draw_frame();
+            }
+        } else {
+            while (!glfwWindowShouldClose(window)) {
+                glfwPollEvents();
+                draw_frame();
+
+                if (config.frame_count > 0 && frame_number >= config.frame_count) {
+                    break;
+                }
+            }
         }
 
         // TODO: Check this...
@@ -127,19 +331,137 @@ namespace vulkan_rendering {
          * Wait for the seamphore to be finished in the frame buffers buffer exiting
          */
         vkDeviceWaitIdle(device);
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        if (config.print_stats) {
+            print_stats(std::chrono::duration<double>(end_time - start_time).count());
+        }
+
+        if (!config.trace_path.empty()) {
+            profiler->write_chrome_trace(config.trace_path);
+            std::cout << "Wrote trace to " << config.trace_path << std::endl;
+        }
+    }
+
+    void TriangleApp::print_stats(double seconds) {
+        if (frame_number > 0 && seconds > 0.0) {
+            std::cout << "Rendered " << frame_number << " frames in " << seconds << "s (" << 
+                frame_number / seconds << " fps)" << std::endl;
+        }
+
+        allocator->print_stats(std::cout);
+        uploader->print_stats(std::cout);
+        uniform_ring->print_stats(std::cout);
+
+        if (frame_number > 0) {
+            std::cout << "Recording: " << recording_seconds * 1000.0 / frame_number << "ms per frame, " <<
+                get_draws_per_frame() << " draws across " << worker_pool->get_worker_count() << " workers" << std::endl;
+        }
+
+        if (culling_stats.frames > 0) {
+            std::cout << (config.gpu_culling ? "GPU" : "CPU") << " culling: " << get_visible_per_frame() <<
+                " visible, " << culling_stats.culled / static_cast<double>(culling_stats.frames) <<
+                " culled per frame over " << culling_stats.frames << " frames";
+            if (culler) {
+                std::cout << " (" << culler->get_simd_name() << ")";
+            } else if (bvh) {
+                std::cout << " (bvh, " << bvh->get_nodes().size() << " nodes, depth " << bvh->get_depth() << ")";
+            }
+            std::cout << std::endl;
+        }
+
+        if (frame_number > 0) {
+            std::cout << "Transforms: " << transforms->get_node_count() << " nodes, depth " <<
+                transforms->get_depth() << ", " << transform_updates / static_cast<double>(frame_number) <<
+                " recomputed per frame (" << transforms->get_simd_name() << ")" << std::endl;
+        }
+
+        // The sets allocated while recording, plus however many pools it took to fit them, new pools should stop
+        // showing up after the first few frames.
+        DescriptorStats frame_descriptors;
+        for (const auto& frame : frame_commands) {
+            for (const auto& descriptors : frame.worker_descriptors) {
+                frame_descriptors.sets_allocated += descriptors->get_stats().sets_allocated;
+                frame_descriptors.pools_created  += descriptors->get_stats().pools_created;
+            }
+        }
+        std::cout << "Descriptors: " << layout_cache->get_size() << " set layouts, " <<
+            layout_cache->get_pipeline_layout_count() << " pipeline layouts, " <<
+            descriptor_allocator->get_stats().sets_allocated << " long lived sets, written with " <<
+            (descriptor_update_templates ? "update templates" : "vkUpdateDescriptorSets");
+        if (frame_number > 0 && config.per_draw_sets) {
+            std::cout << ", " << frame_descriptors.sets_allocated / static_cast<double>(frame_number) <<
+                " sets allocated per frame from " << frame_descriptors.pools_created << " pools";
+        }
+        std::cout << std::endl;
+
+        if (bindless_heap) {
+            std::cout << "Bindless: " << bindless_heap->get_buffers().get_used() << "/" <<
+                bindless_heap->get_buffers().get_capacity() << " buffers, " << bindless_heap->get_images().get_used() <<
+                "/" << bindless_heap->get_images().get_capacity() << " images" << std::endl;
+        }
+        if (texture_streamer) {
+            texture_streamer->print_stats(std::cout);
+        }
+        render_graph->print_stats(std::cout);
+        pipeline_cache->print_stats(std::cout);
+        if (shader_compiler) {
+            shader_compiler->print_stats(std::cout);
+        }
+
+        if (resize_count > 0) {
+            std::cout << "Resizes: " << resize_count << ", " << resize_total_seconds * 1000.0 / resize_count <<
+                "ms avg, " << resize_max_seconds * 1000.0 << "ms max from resize to present" << std::endl;
+        }
+
+        profiler->print_summary(std::cout);
     }
 
     void TriangleApp::cleanup() {
         cleanup_swap_chain();
 
-        // Release the descriptor layouts when we quit, it should stay as long as we need it to run.
-        vkDestroyDescriptorSetLayout(device, descriptor_set_layout, nullptr);
+        if (config.headless) {
+            cleanup_offscreen_images();
+        }
+
+        // The descriptor sets point into the uniform ring, neither depends on the swap chain so they live until we quit.
+        descriptor_allocator.reset();
+        uniform_template.reset();
+        culling_template.reset();
+        uniform_ring.reset();
+        instance_ring.reset();
+        culling_ring.reset();
+        bindless_ring.reset();
 
-        vkDestroyBuffer(device, index_buffer, nullptr);
-        vkFreeMemory(device, index_buffer_memory, nullptr);
+        // The render pass doesn't depend on the extent, so it outlives every swap chain.
+        vkDestroyRenderPass(device, render_pass, nullptr);
+
+        // The pipelines are owned by the cache, save what the driver compiled so the next run can skip it.
+        pipeline_cache->save();
+        pipeline_cache.reset();
+        shader_watcher.reset();
+        shader_compiler.reset();
+        if (config.gpu_culling) {
+            destroy_buffer(culling_mesh_buffer, culling_mesh_allocation);
+            destroy_buffer(culling_object_buffer, culling_object_allocation);
+            destroy_buffer(culling_transform_buffer, culling_transform_allocation);
+            destroy_buffer(culling_output, culling_output_allocation);
+            destroy_buffer(culling_readback, culling_readback_allocation);
+        }
+
+        // The textures' handles live in the bindless heap and their uploads may still be in the uploader.
+        texture_streamer.reset();
 
-        vkDestroyBuffer(device, vertex_buffer, nullptr);
-        vkFreeMemory(device, vertex_buffer_memory, nullptr);
+        // Every descriptor set and pipeline layout came from the cache, so they all go with it. The bindless set layout
+        // is the heap's own.
+        layout_cache.reset();
+        bindless_heap.reset();
+
+        destroy_buffer(index_buffer, index_buffer_allocation);
+        destroy_buffer(vertex_buffer, vertex_buffer_allocation);
+        if (instance_buffer != VK_NULL_HANDLE) {
+            destroy_buffer(instance_buffer, instance_buffer_allocation);
+        }
 
         for (int i = 0; i < max_frames_per_flight; i++) {
             vkDestroySemaphore(device, render_finished_semaphores[i], nullptr);
@@ -147,44 +469,92 @@ namespace vulkan_rendering {
             vkDestroyFence(device, flight_fences[i], nullptr);
         }
 
-        vkDestroyCommandPool(device, command_pool, nullptr);
+        for (auto& frame : frame_commands) {
+            vkDestroyCommandPool(device, frame.primary_pool, nullptr);
+            for (auto pool : frame.worker_pools) {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
+            frame.worker_descriptors.clear();
+        }
+        worker_pool.reset();
+        gpu_profiler.reset();
+
+        // The graph's transient images, retired ones included, go back to the allocator.
+        render_graph.reset();
+        render_graph_backend.reset();
+
+        uploader.reset();
+        allocator.reset();
+        memory_backend.reset();
         vkDestroyDevice(device, nullptr);
 
         if (enable_validation_layers) {
             destroy_debug_utils_messenger_ext(instance, debug_messenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (!config.headless) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
 
-        glfwDestroyWindow(window);
-        glfwTerminate();
+        if (!config.headless) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
     }
 
+    /**
+     * Only called once the device is idle, so the retired swap chains can go too regardless of their frame.
+     */
     void TriangleApp::cleanup_swap_chain() {
+        destroy_retired_swap_chains(std::numeric_limits<uint64_t>::max());
+
         for (size_t i = 0; i < swap_chain_frame_buffers.size(); i++) {
             vkDestroyFramebuffer(device, swap_chain_frame_buffers[i], nullptr);
         }
 
-        vkFreeCommandBuffers(device, command_pool, static_cast<uint32_t>(command_buffers.size()),
-            command_buffers.data());
-
-        vkDestroyPipeline(device, graphics_pipeline, nullptr);
-        vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
-        vkDestroyRenderPass(device, render_pass, nullptr);
-
         for (size_t i = 0; i < swap_chain_image_views.size(); i++) {
             vkDestroyImageView(device, swap_chain_image_views[i], nullptr);
         }
 
-        vkDestroySwapchainKHR(device, swap_chain, nullptr);
+        if (!config.headless) {
+            vkDestroySwapchainKHR(device, swap_chain, nullptr);
+        }
+    }
+
+    /**
+     * completed_frames is the number of frames the GPU is known to be done with. A retired swap chain may be used by
+     * every frame submitted before it was replaced, so it has to wait until all of those are done.
+     */
+    void TriangleApp::destroy_retired_swap_chains(uint64_t completed_frames) {
+        while (!retired_swap_chains.empty() && retired_swap_chains.front().retire_frame <= completed_frames) {
+            RetiredSwapChain& retired = retired_swap_chains.front();
+
+            for (auto frame_buffer : retired.frame_buffers) {
+                vkDestroyFramebuffer(device, frame_buffer, nullptr);
+            }
+
+            for (auto image_view : retired.image_views) {
+                vkDestroyImageView(device, image_view, nullptr);
+            }
+
+            vkDestroySwapchainKHR(device, retired.swap_chain, nullptr);
+            retired_swap_chains.pop_front();
+        }
+    }
 
+    /**
+     * The offscreen images are ours (unlike the swap chain images which belong to the swap chain), so we have to
+     * destroy them and release their memory ourselves.
+     */
+    void TriangleApp::cleanup_offscreen_images() {
         for (size_t i = 0; i < swap_chain_images.size(); i++) {
-            vkDestroyBuffer(device, uniform_buffers[i], nullptr);
-            vkFreeMemory(device, uniform_buffers_memory[i], nullptr);
+            vkDestroyImage(device, swap_chain_images[i], nullptr);
+            allocator->free(offscreen_images_allocations[i]);
         }
 
-        vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+        swap_chain_images.clear();
+        offscreen_images_allocations.clear();
     }
     
     // Vulkan functions
@@ -267,17 +637,26 @@ namespace vulkan_rendering {
      * Otherwise debugging is pretty useful. Since I'm using GLFW, I need the required GLFW extensions first.
      */
     std::vector<const char*> TriangleApp::get_required_extensions() {
-        uint32_t glfw_extension_count = 0;
-        const char** glfw_extensions;
-        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-
-        std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+        std::vector<const char*> extensions;
+
+        // Headless mode never creates a surface, so we don't need any of the window system extensions.
+        if (!config.headless) {
+            uint32_t glfw_extension_count = 0;
+            const char** glfw_extensions;
+            glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+            extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+        }
 
         if (enable_validation_layers) {
             // Macro here which is equivalent to: VK_EXT_debug_utils
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
 
+        // Descriptor indexing's features and limits can only be queried through the chained structs.
+        if (config.bindless) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
+
         return extensions;
     }
 
@@ -334,6 +713,10 @@ namespace vulkan_rendering {
         if (physical_device == VK_NULL_HANDLE) {
             throw std::runtime_error("Failed to find a suitable GPU!");
         }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+        device_name = properties.deviceName;
     }
 
     /**
@@ -345,6 +728,11 @@ namespace vulkan_rendering {
         bool extension_support = check_device_extension_support(device);
         bool swap_chain_adequate = false;
 
+        // Without a surface there's nothing to present to, any device with a graphics queue will do.
+        if (config.headless) {
+            return indices.is_complete() && extension_support;
+        }
+
         if (extension_support) {
             SwapChainSupportDetails swap_chain_support = query_swap_chain_support(device);
             swap_chain_adequate = !swap_chain_support.formats.empty() && !swap_chain_support.present_modes.empty();
@@ -373,28 +761,50 @@ namespace vulkan_rendering {
                 indices.graphics_family = i; 
             }
 
-            VkBool32 present_support = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+            if (!config.headless) {
+                VkBool32 present_support = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
 
-            if (queue_family.queueCount > 0 && present_support) {
-                indices.present_family = i;
+                if (queue_family.queueCount > 0 && present_support) {
+                    indices.present_family = i;
+                }
             }
 
-            if (indices.is_complete()) {
+            if (indices.is_complete() && (config.headless || indices.present_family.has_value())) {
                 break;
             }
 
             i++;
         }
 
+        /**
+         * A family that can transfer but not draw is usually backed by the DMA engines, so copies there run alongside
+         * rendering instead of competing with it.
+         */
+        for (uint32_t j = 0; j < queue_family_count; j++) {
+            const auto& queue_family = queue_families[j];
+            if (queue_family.queueCount > 0 && (queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.transfer_family = j;
+                break;
+            }
+        }
+
         return indices;
     }
 
     void TriangleApp::create_logical_device() {
         QueueFamilyIndices indices = find_queue_families(physical_device);
+        queue_families             = indices;
 
         std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
-        std::set<uint32_t> unique_queue_families = { indices.graphics_family.value(), indices.present_family.value() };
+        std::set<uint32_t> unique_queue_families = { indices.graphics_family.value() };
+        if (indices.present_family.has_value()) {
+            unique_queue_families.insert(indices.present_family.value());
+        }
+        if (indices.transfer_family.has_value()) {
+            unique_queue_families.insert(indices.transfer_family.value());
+        }
 
         float queue_priority = 1.0f;
         for (uint32_t queue_family : unique_queue_families) {
@@ -407,17 +817,106 @@ namespace vulkan_rendering {
         }
 
         VkPhysicalDeviceFeatures device_features = {};
+        auto extensions                          = get_device_extensions();
+
+        uint32_t extension_count;
+        vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
+        std::vector<VkExtensionProperties> available_extensions(extension_count);
+        vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data());
+
+        auto is_available = [&available_extensions](const char* name) {
+            return std::find_if(available_extensions.begin(), available_extensions.end(),
+                [name](const VkExtensionProperties& extension) {
+                    return strcmp(extension.extensionName, name) == 0; }) != available_extensions.end();
+        };
+
+        // Optional, DescriptorTemplate falls back to vkUpdateDescriptorSets without it.
+        if (is_available(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME)) {
+            extensions.push_back(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+            descriptor_update_templates = true;
+        }
+
+        /**
+         * GPU culling issues all of its draws from one indirect buffer and points each one at its own transform through
+         * firstInstance. The draw count extension is optional, see draw_indexed_indirect_count.
+         */
+        if (config.gpu_culling) {
+            VkPhysicalDeviceFeatures supported;
+            vkGetPhysicalDeviceFeatures(physical_device, &supported);
+            if (!supported.multiDrawIndirect || !supported.drawIndirectFirstInstance) {
+                throw std::runtime_error("GPU culling needs multiDrawIndirect and drawIndirectFirstInstance!");
+            }
+            device_features.multiDrawIndirect         = VK_TRUE;
+            device_features.drawIndirectFirstInstance = VK_TRUE;
+
+            if (is_available(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+                extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            }
+        }
 
         VkDeviceCreateInfo create_info = {};
         create_info.sType              = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 
+        /**
+         * The bindless set is indexed with a push constant, which is dynamically uniform, so it needs runtime sized
+         * arrays and dynamic indexing but not non uniform indexing. Its arrays get as big as the device lets an update
+         * after bind set be, up to the heap's defaults.
+         */
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabled_indexing = {};
+        enabled_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        if (config.bindless) {
+            auto get_features = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(instance,
+                "vkGetPhysicalDeviceFeatures2KHR");
+            auto get_properties = (PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(instance,
+                "vkGetPhysicalDeviceProperties2KHR");
+            if (get_features == nullptr || get_properties == nullptr) {
+                throw std::runtime_error("Failed to load the physical device properties 2 functions!");
+            }
+
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexing = {};
+            indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+            VkPhysicalDeviceFeatures2KHR features = {};
+            features.sType                        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+            features.pNext                        = &indexing;
+            get_features(physical_device, &features);
+
+            if (!features.features.shaderStorageBufferArrayDynamicIndexing || !indexing.runtimeDescriptorArray ||
+                !indexing.descriptorBindingPartiallyBound || !indexing.descriptorBindingStorageBufferUpdateAfterBind ||
+                !indexing.descriptorBindingSampledImageUpdateAfterBind) {
+                throw std::runtime_error("Bindless needs runtime descriptor arrays and update after bind buffers and "
+                    "images!");
+            }
+            device_features.shaderStorageBufferArrayDynamicIndexing        = VK_TRUE;
+            enabled_indexing.runtimeDescriptorArray                        = VK_TRUE;
+            enabled_indexing.descriptorBindingPartiallyBound               = VK_TRUE;
+            enabled_indexing.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            enabled_indexing.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+            create_info.pNext                                              = &enabled_indexing;
+
+            VkPhysicalDeviceDescriptorIndexingPropertiesEXT limits = {};
+            limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+            VkPhysicalDeviceProperties2KHR properties = {};
+            properties.sType                          = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+            properties.pNext                          = &limits;
+            get_properties(physical_device, &properties);
+
+            // Both arrays are visible to every stage, so each gets at most half of what a stage can have bound.
+            uint32_t resources    = limits.maxPerStageUpdateAfterBindResources / 2;
+            bindless_buffer_count = std::min({ bindless_buffer_count, resources,
+                limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                limits.maxDescriptorSetUpdateAfterBindStorageBuffers });
+            bindless_image_count  = std::min({ bindless_image_count, resources,
+                limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                limits.maxDescriptorSetUpdateAfterBindSampledImages });
+        }
+
         create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
         create_info.pQueueCreateInfos    = queue_create_infos.data();
 
         create_info.pEnabledFeatures = &device_features;
 
-        create_info.enabledExtensionCount   = static_cast<uint32_t>(device_extensions.size());
-        create_info.ppEnabledExtensionNames = device_extensions.data();
+        create_info.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
+        create_info.ppEnabledExtensionNames = extensions.data();
 
         if (enable_validation_layers) {
             create_info.enabledLayerCount   = static_cast<uint32_t>(validation_layers.size());
@@ -430,8 +929,119 @@ namespace vulkan_rendering {
             throw std::runtime_error("Failed to create logical device!");
         }
 
+        if (std::find_if(extensions.begin(), extensions.end(), [](const char* name) {
+            return strcmp(name, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0; }) != extensions.end()) {
+            draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(device,
+                "vkCmdDrawIndexedIndirectCountKHR");
+        }
+
         vkGetDeviceQueue(device, indices.graphics_family.value(), 0, &graphics_queue);
-        vkGetDeviceQueue(device, indices.present_family.value(), 0, &present_queue);
+        if (indices.present_family.has_value()) {
+            vkGetDeviceQueue(device, indices.present_family.value(), 0, &present_queue);
+        }
+
+        if (indices.transfer_family.has_value()) {
+            vkGetDeviceQueue(device, indices.transfer_family.value(), 0, &transfer_queue);
+        } else {
+            transfer_queue = graphics_queue;
+        }
+    }
+
+    /**
+     * All device memory goes through the allocator, which caches the memory properties and sub allocates out of big
+     * blocks instead of handing every buffer its own vkAllocateMemory.
+     */
+    void TriangleApp::create_allocator() {
+        VkPhysicalDeviceMemoryProperties mem_props;
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+
+        VkPhysicalDeviceProperties device_props;
+        vkGetPhysicalDeviceProperties(physical_device, &device_props);
+
+        memory_backend = std::unique_ptr<VulkanMemoryBackend>(new VulkanMemoryBackend(device));
+        allocator      = std::unique_ptr<DeviceAllocator>(new DeviceAllocator(memory_backend.get(), mem_props,
+            device_props.limits.bufferImageGranularity));
+    }
+
+    /**
+     * Needs the physical device properties to validate the cache file, so this has to run after the device is picked.
+     */
+    void TriangleApp::create_pipeline_cache() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+        pipeline_cache = std::unique_ptr<PipelineCache>(new PipelineCache(device, properties,
+            config.pipeline_cache_path));
+    }
+
+    /**
+     * A pack's shaders were compiled when it was built, so only loose shaders get compiled here. The watcher looks at
+     * every directory the shaders were read from, which is only known once they've all been compiled.
+     */
+    void TriangleApp::create_shader_compiler() {
+        if (asset_pack || !ShaderCompiler::is_available()) {
+            return;
+        }
+
+        shader_compiler = std::unique_ptr<ShaderCompiler>(new ShaderCompiler(SHADER_DIR, config.shader_cache_path,
+            config.shader_defines));
+        if (config.hot_reload) {
+            shader_watcher = std::unique_ptr<ShaderWatcher>(new ShaderWatcher());
+        }
+    }
+
+    /**
+     * The uploader gets its own cmd pool on whichever queue it submits to, so it never touches the graphics cmd pool.
+     */
+    void TriangleApp::create_uploader() {
+        uint32_t family = queue_families.transfer_family.value_or(queue_families.graphics_family.value());
+        uploader        = std::unique_ptr<StagingUploader>(new StagingUploader(device, allocator.get(), family,
+            transfer_queue));
+    }
+
+    /**
+     * Only the mip tails get uploaded here, the rest streams in once the objects start asking for it. The images are
+     * shared between the graphics and the transfer family like the buffers the uploader writes.
+     */
+    void TriangleApp::create_textures() {
+        if (config.texture_paths.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> families = { queue_families.graphics_family.value() };
+        if (queue_families.transfer_family.has_value()) {
+            families.push_back(queue_families.transfer_family.value());
+        }
+
+        VkDeviceSize budget = static_cast<VkDeviceSize>(config.texture_budget_mb) * 1024 * 1024;
+        texture_streamer    = std::unique_ptr<TextureStreamer>(new TextureStreamer(physical_device, device,
+            allocator.get(), uploader.get(), families, budget, bindless_heap.get()));
+
+        for (const auto& path : config.texture_paths) {
+            texture_streamer->load(path);
+        }
+    }
+
+    /**
+     * Timestamps are written into the graphics queue's cmd buffers, so its family decides whether they're supported at
+     * all. Queues without timestamps (timestampValidBits of 0) just leave the GPU side of the profile empty.
+     */
+    void TriangleApp::create_gpu_profiler() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+        uint32_t valid_bits = families[queue_families.graphics_family.value()].timestampValidBits;
+        if (!properties.limits.timestampComputeAndGraphics) {
+            valid_bits = 0;
+        }
+
+        gpu_profiler = std::unique_ptr<GpuProfiler>(new GpuProfiler(device, profiler.get(),
+            properties.limits.timestampPeriod, valid_bits, static_cast<uint32_t>(max_frames_per_flight)));
     }
 
     void TriangleApp::create_surface() {
@@ -440,6 +1050,24 @@ namespace vulkan_rendering {
         }
     }
 
+    /**
+     * The swap chain extension is only needed when we actually present, software ICDs used for headless runs don't
+     * necessarily expose it.
+     */
+    std::vector<const char*> TriangleApp::get_device_extensions() {
+        std::vector<const char*> extensions;
+        if (!config.headless) {
+            extensions = device_extensions;
+        }
+
+        // Bindless can't do without it, so devices that don't have it aren't suitable.
+        if (config.bindless) {
+            extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        }
+        return extensions;
+    }
+
     bool TriangleApp::check_device_extension_support(VkPhysicalDevice device) {
         uint32_t extension_count;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
@@ -447,7 +1075,8 @@ namespace vulkan_rendering {
         std::vector<VkExtensionProperties> available_extensions(extension_count);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
 
-        std::set<std::string> required_extensions(device_extensions.begin(), device_extensions.end());
+        auto extensions = get_device_extensions();
+        std::set<std::string> required_extensions(extensions.begin(), extensions.end());
 
         for (const auto& extension : available_extensions) {
             required_extensions.erase(extension.extensionName);
@@ -581,8 +1210,11 @@ namespace vulkan_rendering {
         create_info.presentMode    = present_mode;
         create_info.clipped        = VK_TRUE;
 
-        // We assume there's only one swap chain, but swap chains can be recreated when you resize the window.
-        create_info.oldSwapchain = VK_NULL_HANDLE;
+        /**
+         * Handing over the old swap chain lets the presentation engine keep showing its images while the new one gets
+         * built, and lets the driver reuse its resources. The old one is retired, not destroyed, by recreate_swap_chain.
+         */
+        create_info.oldSwapchain = swap_chain;
 
         if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create swap chain!");
@@ -597,6 +1229,48 @@ namespace vulkan_rendering {
         swap_chain_extent       = extent;
     }
 
+    /**
+     * Headless replacement for create_swap_chain. Instead of asking the swap chain for its images we create our own ring
+     * of device local images. They're used as colour attachments and can be copied out (TRANSFER_SRC) if we ever want
+     * to read the frames back. Everything downstream (image views, frame buffers, cmd buffers) treats them exactly like
+     * swap chain images.
+     */
+    void TriangleApp::create_offscreen_images() {
+        swap_chain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+        swap_chain_extent       = { config.width, config.height };
+
+        swap_chain_images.resize(config.offscreen_image_count);
+        offscreen_images_allocations.resize(config.offscreen_image_count);
+
+        for (size_t i = 0; i < swap_chain_images.size(); i++) {
+            VkImageCreateInfo image_info = {};
+            image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType         = VK_IMAGE_TYPE_2D;
+            image_info.format            = swap_chain_image_format;
+            image_info.extent            = { swap_chain_extent.width, swap_chain_extent.height, 1 };
+            image_info.mipLevels         = 1;
+            image_info.arrayLayers       = 1;
+            image_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+            image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage             = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            image_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(device, &image_info, nullptr, &swap_chain_images[i]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create offscreen image!");
+            }
+
+            VkMemoryRequirements mem_requirements;
+            vkGetImageMemoryRequirements(device, swap_chain_images[i], &mem_requirements);
+
+            offscreen_images_allocations[i] = allocator->allocate(mem_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                ResourceKind::Optimal);
+
+            vkBindImageMemory(device, swap_chain_images[i], offscreen_images_allocations[i].memory,
+                offscreen_images_allocations[i].offset);
+        }
+    }
+
     void TriangleApp::create_image_views() {
         swap_chain_image_views.resize(swap_chain_images.size());
 
@@ -628,24 +1302,155 @@ namespace vulkan_rendering {
         }
     }
 
-    void TriangleApp::create_graphics_pipeline() {
-        // TODO: Try to read relative directories instead or get the full path to the shaders somehow.
-        auto vert_shader_code = read_file("/Users/psuong/Documents/Projects/VulkanRendering/shaders/vert.spv");
-        auto frag_shader_code = read_file("/Users/psuong/Documents/Projects/VulkanRendering/shaders/frag.spv");
+    /**
+     * Nothing reads the depth buffer back and there's no stencil, so the smallest precise format wins. D16 is always
+     * supported as a depth attachment.
+     */
+    VkFormat TriangleApp::choose_depth_format() {
+        VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM };
+
+        for (VkFormat format : candidates) {
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+            if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0) {
+                return format;
+            }
+        }
+        throw std::runtime_error("Failed to find a depth format!");
+    }
 
-        VkShaderModule vert_shader_module = create_shader_module(vert_shader_code);
-        VkShaderModule frag_shader_module = create_shader_module(frag_shader_code);
+    /**
+     * The frame as a graph: with --gpu-culling the cull's clear, dispatch and readback, then the forward render pass
+     * that draws from what the cull wrote. The barriers between them, the swap chain image's transitions and the depth
+     * buffer all come from the graph, the render pass only ever sees its attachments in their attachment layouts.
+     * Only the depth prepass uses a depth buffer, one is enough for every frame in flight since the graph makes each
+     * frame's depth writes wait on the previous frame's. Called again on every resize, the graph retires the depth
+     * buffer with the old extent until the frames testing against it are done.
+     */
+    void TriangleApp::create_render_graph() {
+        if (!render_graph) {
+            render_graph_backend = std::make_unique<VulkanRenderGraphBackend>(device, allocator.get());
+            render_graph         = std::make_unique<RenderGraph>(render_graph_backend.get());
+        }
+        if (config.depth_prepass && depth_format == VK_FORMAT_UNDEFINED) {
+            depth_format = choose_depth_format();
+        }
+        render_graph->reset();
+
+        // The acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, so that's what the first barrier waits on.
+        ImageDesc color_desc;
+        color_desc.format = swap_chain_image_format;
+        color_desc.extent = swap_chain_extent;
+        ResourceState acquired;
+        acquired.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        color_target    = render_graph->import_image("swap_chain", color_desc, acquired,
+            config.headless ? ResourceUsage::TransferSrc : ResourceUsage::Present);
+
+        depth_target = RenderGraph::INVALID_RESOURCE;
+        if (config.depth_prepass) {
+            ImageDesc depth_desc;
+            depth_desc.format = depth_format;
+            depth_desc.extent = swap_chain_extent;
+            depth_target      = render_graph->create_image("depth", depth_desc);
+        }
 
-        VkPipelineShaderStageCreateInfo vert_shader_stage_info = {};
-        vert_shader_stage_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vert_shader_stage_info.stage                           = VK_SHADER_STAGE_VERTEX_BIT;
-        vert_shader_stage_info.module                          = vert_shader_module;
-        vert_shader_stage_info.pName                           = "main";
+        if (config.gpu_culling) {
+            culling_target  = render_graph->import_buffer("culling_output", ResourceState(), ResourceUsage::None);
+            readback_target = render_graph->import_buffer("culling_readback", ResourceState(),
+                ResourceUsage::HostRead);
+
+            uint32_t clear = render_graph->add_pass("cull_clear", [this](VkCommandBuffer cmd_buffer) {
+                record_culling_clear(cmd_buffer);
+            });
+            render_graph->use(clear, culling_target, ResourceUsage::TransferDst);
+
+            uint32_t cull = render_graph->add_pass("cull", [this](VkCommandBuffer cmd_buffer) {
+                uint32_t cull_zone = gpu_profiler->begin_zone(cmd_buffer, "cull");
+                record_culling(cmd_buffer, *graph_frame.uniforms);
+                gpu_profiler->end_zone(cmd_buffer, cull_zone);
+            });
+            render_graph->use(cull, culling_target, ResourceUsage::ComputeReadWrite);
+
+            uint32_t readback = render_graph->add_pass("cull_readback", [this](VkCommandBuffer cmd_buffer) {
+                record_culling_readback(cmd_buffer);
+            });
+            render_graph->use(readback, culling_target, ResourceUsage::TransferSrc);
+            render_graph->use(readback, readback_target, ResourceUsage::TransferDst);
+        }
+
+        uint32_t forward = render_graph->add_pass("forward", [this](VkCommandBuffer cmd_buffer) {
+            record_forward_pass(cmd_buffer);
+        });
+        render_graph->use(forward, color_target, ResourceUsage::ColorAttachment);
+        if (config.depth_prepass) {
+            render_graph->use(forward, depth_target, ResourceUsage::DepthAttachment);
+        }
+        if (config.gpu_culling) {
+            render_graph->use(forward, culling_target, ResourceUsage::IndirectRead);
+            render_graph->use(forward, culling_target, ResourceUsage::VertexRead);
+        }
+
+        render_graph->compile(frame_number);
+    }
+
+    /**
+     * The colour pipeline reads every vertex stream. With the depth prepass there's also a vertex shader only pipeline
+     * that reads just the position stream to fill the depth buffer, the colour pass after it only shades the fragments
+     * whose depth matches what's in there, so every pixel gets shaded once.
+     */
+    void TriangleApp::create_graphics_pipeline() {
+        GraphicsShaders shaders = get_graphics_shaders();
+        if (!config.depth_prepass) {
+            graphics_pipeline = create_pipeline(shaders.vertex, shaders.fragment, ALL_STREAMS, nullptr);
+            return;
+        }
+
+        VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+        depth_stencil.sType            = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth_stencil.depthTestEnable  = VK_TRUE;
+        depth_stencil.depthWriteEnable = VK_TRUE;
+        depth_stencil.depthCompareOp   = VK_COMPARE_OP_LESS;
+        depth_pipeline = create_pipeline(shaders.depth, nullptr, POSITION_STREAM, &depth_stencil);
+
+        depth_stencil.depthWriteEnable = VK_FALSE;
+        depth_stencil.depthCompareOp   = VK_COMPARE_OP_EQUAL;
+        graphics_pipeline = create_pipeline(shaders.vertex, shaders.fragment, ALL_STREAMS, &depth_stencil);
+    }
+
+    TriangleApp::GraphicsShaders TriangleApp::get_graphics_shaders() const {
+        bool instanced = config.instancing || config.gpu_culling;
+
+        GraphicsShaders shaders;
+        shaders.vertex   = instanced ? "instanced.spv" : config.bindless ? "bindless.spv" : "vert.spv";
+        shaders.depth    = instanced ? "instanced_depth.spv" : config.bindless ? "bindless_depth.spv" : "depth.spv";
+        shaders.fragment = "frag.spv";
+        return shaders;
+    }
+
+    /**
+     * stream_mask picks the vertex streams the vertex shader reads, see VertexFormat::get_vertex_input. Without a
+     * fragment shader nothing gets written to the colour attachment. The instanced and GPU culling paths add the
+     * instance rate binding right after the streams.
+     */
+    VkPipeline TriangleApp::create_pipeline(const char* vertex_shader, const char* fragment_shader,
+        uint32_t stream_mask, const VkPipelineDepthStencilStateCreateInfo* depth_stencil) {
+
+        std::vector<char> vert_storage;
+        std::vector<char> frag_storage;
+        AssetView vert_shader_code = load_shader(vertex_shader, vert_storage);
+        AssetView frag_shader_code = fragment_shader != nullptr ? load_shader(fragment_shader, frag_storage) :
+            AssetView();
+        uint32_t stage_count       = fragment_shader != nullptr ? 2 : 1;
+
+        // The modules are only created on a cache miss, further down.
+        VkPipelineShaderStageCreateInfo vert_shader_stage_info = {};
+        vert_shader_stage_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vert_shader_stage_info.stage                           = VK_SHADER_STAGE_VERTEX_BIT;
+        vert_shader_stage_info.pName                           = "main";
 
         VkPipelineShaderStageCreateInfo frag_shader_stage_info = {};
         frag_shader_stage_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
         frag_shader_stage_info.stage                           = VK_SHADER_STAGE_FRAGMENT_BIT;
-        frag_shader_stage_info.module                          = frag_shader_module;
         frag_shader_stage_info.pName                           = "main";
 
         VkPipelineShaderStageCreateInfo shader_stages[] = { vert_shader_stage_info, frag_shader_stage_info };
@@ -653,13 +1458,29 @@ namespace vulkan_rendering {
         VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
         vertex_input_info.sType                                = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-        auto binding_description = Vertex::get_binding_descriptions();
-        auto attribute_description = Vertex::get_attribute_descriptions();
+        // Both come from the streams picked with --vertex-format, see VertexLayout.h.
+        VertexInput vertex_input = vertex_format->get_vertex_input(stream_mask);
+        if (config.instancing || config.gpu_culling) {
+            uint32_t binding = static_cast<uint32_t>(vertex_format->streams.size());
+            auto attributes  = InstanceLayout::get_attribute_descriptions(binding);
+            vertex_input.bindings.push_back(InstanceLayout::get_binding_description(binding,
+                VK_VERTEX_INPUT_RATE_INSTANCE));
+            vertex_input.attributes.insert(vertex_input.attributes.end(), attributes.begin(), attributes.end());
+        }
+
+        // Checked on every create, a reloaded shader may not fit what we bind anymore.
+        PipelineReflection reflection;
+        reflection.add(ShaderReflection(vert_shader_code));
+        if (fragment_shader != nullptr) {
+            reflection.add(ShaderReflection(frag_shader_code));
+        }
+        reflection.check(graphics_interface);
+        reflection.check_vertex_input(vertex_input);
 
-        vertex_input_info.vertexBindingDescriptionCount        = 1;
-        vertex_input_info.vertexAttributeDescriptionCount      = static_cast<uint32_t>(attribute_description.size());
-        vertex_input_info.pVertexBindingDescriptions           = &binding_description;
-        vertex_input_info.pVertexAttributeDescriptions         = attribute_description.data();
+        vertex_input_info.vertexBindingDescriptionCount   = static_cast<uint32_t>(vertex_input.bindings.size());
+        vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_input.attributes.size());
+        vertex_input_info.pVertexBindingDescriptions      = vertex_input.bindings.data();
+        vertex_input_info.pVertexAttributeDescriptions    = vertex_input.attributes.data();
 
         // Below is useless when we have vertex bindings available.
         /*
@@ -674,24 +1495,16 @@ namespace vulkan_rendering {
         input_assembly.topology                               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         input_assembly.primitiveRestartEnable                 = VK_FALSE;
 
-        VkViewport view_port = {};
-        view_port.x          = 0.0f;
-        view_port.y          = 0.0f;
-        view_port.width      = (float) swap_chain_extent.width;
-        view_port.height     = (float) swap_chain_extent.height;
-        view_port.minDepth   = 0.0f;
-        view_port.maxDepth   = 1.0f;
-
-        VkRect2D scissor = {};
-        scissor.offset   = { 0, 0 };
-        scissor.extent   = swap_chain_extent;
-
+        /**
+         * The viewport and scissor are set when recording instead (see the dynamic state below), so only the counts go
+         * into the pipeline and it doesn't depend on the swap chain extent.
+         */
         VkPipelineViewportStateCreateInfo view_port_state = {};
         view_port_state.sType                             = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         view_port_state.viewportCount                     = 1;
-        view_port_state.pViewports                        = &view_port;
+        view_port_state.pViewports                        = nullptr;
         view_port_state.scissorCount                      = 1;
-        view_port_state.pScissors                         = &scissor;
+        view_port_state.pScissors                         = nullptr;
 
         /**
          * If we enable depth clamp, then any fragments beyond the near and far planes are clamped to them instead of 
@@ -727,7 +1540,7 @@ namespace vulkan_rendering {
         multi_sampling.rasterizationSamples                 = VK_SAMPLE_COUNT_1_BIT;
 
         /**
-         * Not enabling Depth/Stencil testing
+         * Depth testing is only on with the depth prepass, stencil testing is never used.
          */
 
         /**
@@ -735,8 +1548,8 @@ namespace vulkan_rendering {
          * buffer.
          */
         VkPipelineColorBlendAttachmentState color_blend_attachment = {};
-        color_blend_attachment.colorWriteMask                      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        color_blend_attachment.colorWriteMask                      = fragment_shader == nullptr ? 0 :
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
         color_blend_attachment.blendEnable                         = VK_FALSE;
         color_blend_attachment.srcColorBlendFactor                 = VK_BLEND_FACTOR_SRC_ALPHA;
         color_blend_attachment.dstColorBlendFactor                 = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
@@ -757,25 +1570,19 @@ namespace vulkan_rendering {
         color_blending.blendConstants[3]                   = 3.0f;
 
         /**
-         * Maybe add a dynamic state instead without recreating the entire pipeline. E.g viewport, line width, and blend 
-         * constants can change over time.
-         * TODO: Revisit.
+         * Dynamic state can change without recreating the entire pipeline. E.g viewport, line width, and blend
+         * constants can change over time. Making the viewport and scissor dynamic means a resize keeps the pipeline.
          */
+        VkDynamicState dynamic_states[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 
-        VkPipelineLayoutCreateInfo pipeline_layout_info = {};
-        pipeline_layout_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipeline_layout_info.setLayoutCount             = 0;
-        pipeline_layout_info.pSetLayouts                = nullptr;
-        pipeline_layout_info.pushConstantRangeCount     = 0;
-        pipeline_layout_info.pPushConstantRanges        = nullptr;
-
-        if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create pipeline layout!");
-        }
+        VkPipelineDynamicStateCreateInfo dynamic_state = {};
+        dynamic_state.sType                            = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state.dynamicStateCount                = 2;
+        dynamic_state.pDynamicStates                   = dynamic_states;
 
         VkGraphicsPipelineCreateInfo pipeline_info = {};
         pipeline_info.sType                        = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipeline_info.stageCount                   = 2;
+        pipeline_info.stageCount                   = stage_count;
         pipeline_info.pStages                      = shader_stages;
 
         pipeline_info.pVertexInputState   = &vertex_input_info;
@@ -783,31 +1590,216 @@ namespace vulkan_rendering {
         pipeline_info.pViewportState      = &view_port_state;
         pipeline_info.pRasterizationState = &rasterizer;
         pipeline_info.pMultisampleState   = &multi_sampling;
-        pipeline_info.pDepthStencilState  = nullptr;
+        pipeline_info.pDepthStencilState  = depth_stencil;
         pipeline_info.pColorBlendState    = &color_blending;
-        pipeline_info.pDynamicState       = nullptr;
+        pipeline_info.pDynamicState       = &dynamic_state;
 
         pipeline_info.layout     = pipeline_layout;
         pipeline_info.renderPass = render_pass;
         pipeline_info.subpass    = 0;
 
-        pipeline_info.basePipelineIndex = VK_NULL_HANDLE;
+        pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
         pipeline_info.basePipelineIndex = -1;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &graphics_pipeline) !=
-            VK_SUCCESS) {
-            throw std::runtime_error("Failed to create graphics pipeline");
+        /**
+         * Same shaders + state + compatible render pass means the same pipeline, so asking for it again (e.g. after the
+         * render pass got recreated) gets the existing pipeline back instead of compiling it again.
+         */
+        PipelineHasher hasher(true);
+        hasher.add_shader(VK_SHADER_STAGE_VERTEX_BIT, vert_shader_stage_info.pName, vert_shader_code.data,
+            vert_shader_code.size);
+        if (fragment_shader != nullptr) {
+            hasher.add_shader(VK_SHADER_STAGE_FRAGMENT_BIT, frag_shader_stage_info.pName, frag_shader_code.data,
+                frag_shader_code.size);
+        }
+        hasher.add_pipeline_state(pipeline_info);
+        hasher.add(render_pass_state.data(), render_pass_state.size());
+
+        VkPipeline pipeline = pipeline_cache->find(hasher);
+        if (pipeline != VK_NULL_HANDLE) {
+            return pipeline;
         }
 
-        vkDestroyShaderModule(device, frag_shader_module, nullptr);
-        vkDestroyShaderModule(device, vert_shader_module, nullptr);
+        for (uint32_t i = 0; i < stage_count; i++) {
+            shader_stages[i].module = create_shader_module(i == 0 ? vert_shader_code : frag_shader_code);
+        }
+
+        pipeline = pipeline_cache->create(hasher, pipeline_info);
+
+        for (uint32_t i = 0; i < stage_count; i++) {
+            vkDestroyShaderModule(device, shader_stages[i].module, nullptr);
+        }
+        return pipeline;
     }
 
-    VkShaderModule TriangleApp::create_shader_module(const std::vector<char>& code) {
+    /**
+     * The layout only depends on the descriptor set layouts, so it's created once instead of with every pipeline. Its
+     * handle is part of the pipeline cache key, recreating it would make every cached pipeline miss. The bindless
+     * pipelines only see the heap's set, plus the push constants that say where in it to look.
+     */
+    void TriangleApp::create_pipeline_layout() {
+        VkDescriptorSetLayout set_layout = config.bindless ? bindless_heap->get_layout() : descriptor_set_layout;
+
+        VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+        pipeline_layout_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipeline_layout_info.setLayoutCount             = 1;
+        pipeline_layout_info.pSetLayouts                = &set_layout;
+        pipeline_layout_info.pushConstantRangeCount     =
+            static_cast<uint32_t>(graphics_interface.push_constants.size());
+        pipeline_layout_info.pPushConstantRanges        = graphics_interface.push_constants.data();
+
+        pipeline_layout = layout_cache->get(pipeline_layout_info);
+    }
+
+    /**
+     * Compute pipelines don't depend on the render pass, so unlike the graphics ones this never has to be redone. The
+     * cull shader gets its frustum and counts as push constants, everything else comes from the culling set.
+     */
+    void TriangleApp::create_culling_pipeline() {
+        if (!config.gpu_culling) {
+            return;
+        }
+
+        VkPipelineLayoutCreateInfo layout_info = {};
+        layout_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_info.setLayoutCount             = 1;
+        layout_info.pSetLayouts                = &culling_set_layout;
+        layout_info.pushConstantRangeCount     = static_cast<uint32_t>(culling_interface.push_constants.size());
+        layout_info.pPushConstantRanges        = culling_interface.push_constants.data();
+
+        // Comes out of the cache again on a shader reload.
+        culling_pipeline_layout = layout_cache->get(layout_info);
+
+        std::vector<char> storage;
+        AssetView code = load_shader("cull.spv", storage);
+
+        PipelineReflection reflection;
+        reflection.add(ShaderReflection(code));
+        reflection.check(culling_interface);
+
+        VkPipelineShaderStageCreateInfo stage_info = {};
+        stage_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage_info.stage                           = VK_SHADER_STAGE_COMPUTE_BIT;
+        stage_info.pName                           = "main";
+
+        VkComputePipelineCreateInfo pipeline_info = {};
+        pipeline_info.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage                       = stage_info;
+        pipeline_info.layout                      = culling_pipeline_layout;
+        pipeline_info.basePipelineIndex           = -1;
+
+        PipelineHasher hasher(true);
+        hasher.add_shader(VK_SHADER_STAGE_COMPUTE_BIT, stage_info.pName, code.data, code.size);
+        hasher.add(pipeline_info.layout);
+
+        culling_pipeline = pipeline_cache->find(hasher);
+        if (culling_pipeline != VK_NULL_HANDLE) {
+            return;
+        }
+
+        pipeline_info.stage.module = create_shader_module(code);
+        culling_pipeline           = pipeline_cache->create(hasher, pipeline_info);
+        vkDestroyShaderModule(device, pipeline_info.stage.module, nullptr);
+    }
+
+    /**
+     * Rebuilds the pipelines of every shader whose sources changed since the last frame. The pipelines whose shaders
+     * didn't change hash the same as before and come straight out of the pipeline cache. The replaced ones are retired
+     * like a resized swap chain, the frames still in flight go on using them without waiting for the device and they're
+     * destroyed once those are done. When a shader doesn't compile we keep drawing with what we have, saving the fix
+     * triggers another reload.
+     */
+    void TriangleApp::reload_shaders() {
+        std::vector<std::string> changed = shader_watcher->poll();
+        if (changed.empty()) {
+            return;
+        }
+
+        bool graphics = false;
+        bool culling  = false;
+        for (const auto& shader : shader_compiler->get_dependents(changed)) {
+            if (shader.size() > 5 && shader.compare(shader.size() - 5, 5, ".comp") == 0) {
+                culling = true;
+            } else {
+                graphics = true;
+            }
+        }
+
+        VkPipeline previous[] = { graphics_pipeline, depth_pipeline, culling_pipeline };
+
+        try {
+            if (graphics) {
+                create_graphics_pipeline();
+            }
+            if (culling) {
+                create_culling_pipeline();
+            }
+            if (graphics || culling) {
+                std::cout << "Reloaded shaders" << std::endl;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Shader reload failed: " << e.what() << std::endl;
+        }
+
+        // Also covers a reload that failed halfway, e.g. the depth pipeline got rebuilt but the colour one didn't.
+        VkPipeline current[] = { graphics_pipeline, depth_pipeline, culling_pipeline };
+        for (size_t i = 0; i < 3; i++) {
+            if (previous[i] != VK_NULL_HANDLE && previous[i] != current[i]) {
+                pipeline_cache->retire(previous[i], frame_number);
+            }
+        }
+
+        // New includes may live in directories we haven't watched yet.
+        for (const auto& directory : shader_compiler->get_directories()) {
+            shader_watcher->watch(directory);
+        }
+    }
+
+    // The GLSL every SPIR-V file is built from, see add_shader in CMakeLists.txt.
+    static const std::unordered_map<std::string, std::string> SHADER_SOURCES = {
+        { "vert.spv", "shader.vert" },
+        { "frag.spv", "shader.frag" },
+        { "depth.spv", "depth.vert" },
+        { "instanced.spv", "instanced.vert" },
+        { "instanced_depth.spv", "instanced_depth.vert" },
+        { "cull.spv", "cull.comp" },
+        { "bindless.spv", "bindless.vert" },
+        { "bindless_depth.spv", "bindless_depth.vert" }
+    };
+
+    /**
+     * Shaders come out of the asset pack when there is one, the view then points into the mapping (blobs are 64 byte
+     * aligned, so it's fine as pCode). Without a pack the GLSL gets compiled when there's a shader compiler, otherwise
+     * the .spv file the build made is read. Either way it ends up in storage and the view points at that.
+     */
+    AssetView TriangleApp::load_shader(const std::string& name, std::vector<char>& storage) {
+        if (asset_pack) {
+            return asset_pack->get(name);
+        }
+
+        auto source = SHADER_SOURCES.find(name);
+        if (shader_compiler && source != SHADER_SOURCES.end()) {
+            return shader_compiler->compile(source->second, storage);
+        }
+
+        storage = read_file(std::string(SPIRV_DIR) + name);
+        return { storage.data(), storage.size() };
+    }
+
+    PipelineReflection TriangleApp::reflect_shaders(const std::vector<const char*>& names) {
+        PipelineReflection reflection;
+        for (const char* name : names) {
+            std::vector<char> storage;
+            reflection.add(ShaderReflection(load_shader(name, storage)));
+        }
+        return reflection;
+    }
+
+    VkShaderModule TriangleApp::create_shader_module(const AssetView& code) {
         VkShaderModuleCreateInfo create_info = {};
         create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        create_info.codeSize                 = code.size();
-        create_info.pCode                    = reinterpret_cast<const uint32_t*>(code.data());
+        create_info.codeSize                 = static_cast<size_t>(code.size);
+        create_info.pCode                    = static_cast<const uint32_t*>(code.data);
 
         VkShaderModule shader_module;
         if (vkCreateShaderModule(device, &create_info, nullptr, &shader_module) != VK_SUCCESS) {
@@ -839,57 +1831,75 @@ namespace vulkan_rendering {
 
         /**
          * Images need to be transition to specific layouts that are suitable for the operation that they're going to be
-         * involved in next.
+         * involved in next. The render graph's barriers do that around the render pass, so the attachments stay in the
+         * layout they're drawn in.
          */
-        color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        color_attachment.finalLayout   = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        color_attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.finalLayout   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
         // TODO: Reread and understand the subpass directives.
         VkAttachmentReference color_attachment_ref = {};
         color_attachment_ref.attachment            = 0;
         color_attachment_ref.layout                = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-        VkSubpassDescription subpass = {};
-        subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments    = &color_attachment_ref;
+        /**
+         * The depth prepass and the colour pass share the subpass, the depth values only have to last until it ends so
+         * they're never stored.
+         */
+        VkAttachmentDescription depth_attachment = {};
+        depth_attachment.format                  = depth_format;
+        depth_attachment.samples                 = VK_SAMPLE_COUNT_1_BIT;
+        depth_attachment.loadOp                  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth_attachment.storeOp                 = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth_attachment.stencilLoadOp           = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depth_attachment.stencilStoreOp          = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth_attachment.initialLayout           = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depth_attachment.finalLayout             = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference depth_attachment_ref = {};
+        depth_attachment_ref.attachment            = 1;
+        depth_attachment_ref.layout                = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass    = {};
+        subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount    = 1;
+        subpass.pColorAttachments       = &color_attachment_ref;
+        subpass.pDepthStencilAttachment = config.depth_prepass ? &depth_attachment_ref : nullptr;
 
         /**
-         * Subpass dependencies specifiy the mem and execution dependncies between the subpasses. 
+         * No external subpass dependencies, the render graph's barriers before the render pass wait on the acquire and
+         * on the previous frame's depth tests, and the ones after it on the colour writes.
          */
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass          = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass          = 0;
-        dependency.srcStageMask        = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask       = 0;
-        dependency.dstStageMask        = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask       = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        VkAttachmentDescription attachments[] = { color_attachment, depth_attachment };
 
         VkRenderPassCreateInfo render_pass_info = {};
         render_pass_info.sType                  = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_info.attachmentCount        = 1;
-        render_pass_info.pAttachments           = &color_attachment;
+        render_pass_info.attachmentCount        = config.depth_prepass ? 2 : 1;
+        render_pass_info.pAttachments           = attachments;
         render_pass_info.subpassCount           = 1;
         render_pass_info.pSubpasses             = &subpass;
-        render_pass_info.dependencyCount        = 1;
-        render_pass_info.pDependencies          = &dependency;
 
         if (vkCreateRenderPass(device, &render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create render pass!");
         }
+
+        PipelineHasher hasher(true);
+        hasher.add_render_pass(render_pass_info);
+        render_pass_state = hasher.get_state();
     }
 
     void TriangleApp::create_frame_buffers() {
         swap_chain_frame_buffers.resize(swap_chain_image_views.size());
         for (size_t i = 0; i < swap_chain_image_views.size(); i++) {
             VkImageView attachments[] = {
-                swap_chain_image_views[i]
+                swap_chain_image_views[i],
+                config.depth_prepass ? render_graph->get_image_view(depth_target) : VK_NULL_HANDLE
             };
 
             VkFramebufferCreateInfo frame_buffer_info = {};
             frame_buffer_info.sType                   = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
             frame_buffer_info.renderPass              = render_pass;
-            frame_buffer_info.attachmentCount         = 1;
+            frame_buffer_info.attachmentCount         = config.depth_prepass ? 2 : 1;
             frame_buffer_info.pAttachments            = attachments;
             frame_buffer_info.width                   = swap_chain_extent.width;
             frame_buffer_info.height                  = swap_chain_extent.height;
@@ -901,8 +1911,14 @@ namespace vulkan_rendering {
         }
     }
 
-    void TriangleApp::create_command_pool() {
+    /**
+     * Every frame in flight gets a pool for its primary cmd buffer and one pool per worker for the secondaries, cmd pools
+     * can't be used from two threads at once. Once a frame's fence has signaled nothing recorded from its pools is
+     * pending anymore, so they're reset wholesale with vkResetCommandPool instead of buffer by buffer.
+     */
+    void TriangleApp::create_command_pools() {
         QueueFamilyIndices queue_family_indices = find_queue_families(this->physical_device);
+        worker_pool = std::unique_ptr<WorkerPool>(new WorkerPool(config.worker_count));
 
         /**
          * Cmd buffers are executed by submitting it to a device queue and can only allocate cmd buffers that are submitted to a single
@@ -913,16 +1929,25 @@ namespace vulkan_rendering {
          */
         VkCommandPoolCreateInfo pool_info = {};
         pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
         pool_info.queueFamilyIndex = queue_family_indices.graphics_family.value();
 
-        if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create the cmd pool!");
+        frame_commands.resize(max_frames_per_flight);
+        for (auto& frame : frame_commands) {
+            if (vkCreateCommandPool(device, &pool_info, nullptr, &frame.primary_pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create the cmd pool!");
+            }
+
+            frame.worker_pools.resize(worker_pool->get_worker_count());
+            for (auto& pool : frame.worker_pools) {
+                if (vkCreateCommandPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create the cmd pool!");
+                }
+            }
         }
     }
 
     void TriangleApp::create_command_buffers() {
-        command_buffers.resize(swap_chain_frame_buffers.size());
-
         /*
          * The level param specifies if the buffer is a primary or secondary buffer.
          * Primary buffers can be submitted to a queue for execution, but cannot be called from other cmd buffers
@@ -930,83 +1955,588 @@ namespace vulkan_rendering {
          */
         VkCommandBufferAllocateInfo alloc_info = {};
         alloc_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        alloc_info.commandPool                 = command_pool;
-        alloc_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandBufferCount          = (uint32_t)command_buffers.size();
+        alloc_info.commandBufferCount          = 1;
+
+        for (auto& frame : frame_commands) {
+            alloc_info.commandPool = frame.primary_pool;
+            alloc_info.level       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
-        if (vkAllocateCommandBuffers(device, &alloc_info, command_buffers.data()) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate cmd buffers!");
+            if (vkAllocateCommandBuffers(device, &alloc_info, &frame.primary) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate cmd buffers!");
+            }
+
+            frame.secondaries.resize(frame.worker_pools.size());
+            frame.depth_secondaries.resize(config.depth_prepass ? frame.worker_pools.size() : 0);
+            for (size_t i = 0; i < frame.worker_pools.size(); i++) {
+                alloc_info.commandPool = frame.worker_pools[i];
+                alloc_info.level       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+                if (vkAllocateCommandBuffers(device, &alloc_info, &frame.secondaries[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate cmd buffers!");
+                }
+
+                if (config.depth_prepass &&
+                    vkAllocateCommandBuffers(device, &alloc_info, &frame.depth_secondaries[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate cmd buffers!");
+                }
+            }
         }
+    }
 
-        for (size_t i = 0; i < command_buffers.size(); i++) {
-            /*
-             * Flags determine how the cmd buffer is going to be used
-             * VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : the cmd buffer will be rerecorded right after executing it once
-             * VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : This is a secondary cd buffer that will be entirely within a render pass
-             * VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The cmd buffer can be resubmitted while also already pending execution
-             */
-            VkCommandBufferBeginInfo begin_info = {};
-            begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-            begin_info.pInheritanceInfo = nullptr;
+    /**
+     * Records the current frame's primary cmd buffer. The draws are split into one contiguous range per worker and each
+     * worker records its range (and writes its objects' uniforms) into its own secondary cmd buffer, the primary only
+     * executes the render graph, whose forward pass begins the render pass and executes them.
+     */
+    void TriangleApp::record_command_buffer(uint32_t img_index) {
+        auto record_start      = std::chrono::high_resolution_clock::now();
+        FrameCommands& frame   = frame_commands[current_frame];
+
+        vkResetCommandPool(device, frame.primary_pool, 0);
+        for (auto pool : frame.worker_pools) {
+            vkResetCommandPool(device, pool, 0);
+        }
+        for (auto& descriptors : frame.worker_descriptors) {
+            descriptors->reset();
+        }
 
-            if (vkBeginCommandBuffer(command_buffers[i], &begin_info) != VK_SUCCESS) {
-                throw std::runtime_error("Failed to begin recording cmd buffer!");
+        // Same frames as the retired swap chains, every one before this slot's last has finished.
+        if (frame_number >= static_cast<uint64_t>(max_frames_per_flight)) {
+            pipeline_cache->reclaim(frame_number - max_frames_per_flight + 1);
+            if (bindless_heap) {
+                bindless_heap->reclaim(frame_number - max_frames_per_flight + 1);
             }
+        }
 
-            VkRenderPassBeginInfo render_pass_info = {};
-            render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            render_pass_info.renderPass = render_pass;
-            render_pass_info.framebuffer = swap_chain_frame_buffers[i];
+        // This frame slot's fence has signaled, so the counts its last cull copied out are there to read.
+        if (config.gpu_culling) {
+            read_culling_stats();
+        }
 
-            /*
-             * Render area defines where the shaders get loaded and stored. Any pixels outside the region has undefined vals
-             */
-            render_pass_info.renderArea.offset = {0, 0};
-            render_pass_info.renderArea.extent = swap_chain_extent;
+        ObjectUniforms uniforms;
+        {
+            PROFILE_ZONE(profiler.get(), "update_uniforms");
+            uniforms = update_uniform_buffer();
+        }
 
-            VkClearValue clear_colour = { 0.0f, 0.0f, 0.0f, 1.0f };
-            render_pass_info.clearValueCount = 1;
-            render_pass_info.pClearValues = &clear_colour;
+        if (config.cpu_culling) {
+            cull_objects(uniforms);
+        }
 
-            /*
-             * VK_SUBPASS_CONTENTS_INLINE: The render pass cmds will be embedded in the primary cmd buffer itself, no secondary cmds
-             * will be executed
-             * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : The render pass cmds will be executed from the 2ndary buffers
-             */
-            vkCmdBeginRenderPass(command_buffers[i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+        if (texture_streamer) {
+            stream_textures(uniforms);
+        }
 
+        /*
+         * Flags determine how the cmd buffer is going to be used
+         * VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : the cmd buffer will be rerecorded right after executing it once
+         * VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : This is a secondary cd buffer that will be entirely within a render pass
+         * VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT: The cmd buffer can be resubmitted while also already pending execution
+         */
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        begin_info.pInheritanceInfo = nullptr;
 
-            VkBuffer vertex_buffers[] = { vertex_buffer };
-            VkDeviceSize offsets[]    = { 0 };
-            vkCmdBindVertexBuffers(command_buffers[i], 0, 1, vertex_buffers, offsets);
+        if (vkBeginCommandBuffer(frame.primary, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording cmd buffer!");
+        }
 
-            // Bind the index buffer, but we need to change the draw command
-            vkCmdBindIndexBuffer(command_buffers[i], index_buffer, 0, VK_INDEX_TYPE_UINT16);
+        // Resolves this slot's timestamps from last time around, which has to happen outside of the render pass.
+        gpu_profiler->begin_frame(frame.primary, static_cast<uint32_t>(current_frame));
 
-            // NOTE: Previously we wanted to just draw the vertices
-            // vkCmdDraw(command_buffers[i], static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-            
-            vkCmdDrawIndexed(command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-            vkCmdEndRenderPass(command_buffers[i]);
+        // Growing textures copy the levels they already have from their current image, before anything samples them.
+        if (texture_streamer) {
+            texture_streamer->record(frame.primary, frame_number);
+        }
+
+        // The instanced path splits the batches between the workers instead of the objects.
+        std::vector<uint32_t> bindless_draw_counts(frame.secondaries.size(), 0);
+        auto record = [&](uint32_t worker, VkCommandBuffer cmd_buffer, uint32_t begin, uint32_t end, bool depth_pass) {
+            if (config.instancing) {
+                record_instances(cmd_buffer, img_index, begin, end, uniforms, depth_pass);
+            } else if (config.bindless) {
+                uint32_t draws = record_bindless(cmd_buffer, img_index, begin, end, uniforms, depth_pass);
+                if (!depth_pass) {
+                    bindless_draw_counts[worker] = draws;
+                }
+            } else {
+                DescriptorAllocator* descriptors = config.per_draw_sets ? frame.worker_descriptors[worker].get() :
+                    nullptr;
+                record_objects(cmd_buffer, img_index, begin, end, uniforms, depth_pass, descriptors);
+            }
+        };
+
+        if (config.instancing || config.gpu_culling) {
+            write_instances(uniforms);
+        }
+
+        // Workers with an empty range (fewer draws than workers) leave their secondaries unrecorded.
+        std::vector<char> recorded(frame.secondaries.size(), 0);
+        uint32_t count = config.instancing ? static_cast<uint32_t>(instance_batches.size()) : config.object_count;
+        if (config.cpu_culling) {
+            count = static_cast<uint32_t>(visible_objects.size());
+        }
+
+        // Two indirect draws aren't worth waking the workers for.
+        if (config.gpu_culling) {
+            if (config.depth_prepass) {
+                record_indirect(frame.depth_secondaries[0], img_index, uniforms, true);
+            }
+            record_indirect(frame.secondaries[0], img_index, uniforms, false);
+            recorded[0] = 1;
+        } else {
+            worker_pool->parallel_for(count, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+                if (begin < end) {
+                    if (config.depth_prepass) {
+                        record(worker, frame.depth_secondaries[worker], begin, end, true);
+                    }
+                    record(worker, frame.secondaries[worker], begin, end, false);
+                    recorded[worker] = 1;
+                }
+            });
+        }
+
+        for (uint32_t draws : bindless_draw_counts) {
+            bindless_draws += draws;
+        }
+
+        // The whole depth prepass runs before any colour draw, otherwise early draws would be shaded against a depth
+        // buffer that's only partly filled.
+        std::vector<VkCommandBuffer> secondaries;
+        for (size_t i = 0; i < frame.depth_secondaries.size(); i++) {
+            if (recorded[i]) {
+                secondaries.push_back(frame.depth_secondaries[i]);
+            }
+        }
+
+        for (size_t i = 0; i < frame.secondaries.size(); i++) {
+            if (recorded[i]) {
+                secondaries.push_back(frame.secondaries[i]);
+            }
+        }
+
+        // Dispatches can't go inside a render pass, so the cull's passes come first and the graph makes the draws wait
+        // on them.
+        graph_frame.img_index   = img_index;
+        graph_frame.uniforms    = &uniforms;
+        graph_frame.secondaries = std::move(secondaries);
+        render_graph->set_image(color_target, swap_chain_images[img_index]);
+        if (config.gpu_culling) {
+            render_graph->set_buffer(culling_target, culling_output, current_frame * culling_layout.frame_size,
+                culling_layout.frame_size);
+            render_graph->set_buffer(readback_target, culling_readback, current_frame * 2 * sizeof(uint32_t),
+                2 * sizeof(uint32_t));
+        }
+        render_graph->execute(frame.primary);
+
+        if (vkEndCommandBuffer(frame.primary) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the command buffer!");
+        }
+
+        recording_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+            record_start).count();
+    }
+
+    /**
+     * The render graph's forward pass. The secondaries were recorded before the graph was executed, the depth prepass's
+     * first so every colour draw is shaded against a full depth buffer.
+     */
+    void TriangleApp::record_forward_pass(VkCommandBuffer cmd_buffer) {
+        uint32_t render_pass_zone = gpu_profiler->begin_zone(cmd_buffer, "render_pass");
+
+        VkRenderPassBeginInfo render_pass_info = {};
+        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        render_pass_info.renderPass = render_pass;
+        render_pass_info.framebuffer = swap_chain_frame_buffers[graph_frame.img_index];
+
+        /*
+         * Render area defines where the shaders get loaded and stored. Any pixels outside the region has undefined vals
+         */
+        render_pass_info.renderArea.offset = {0, 0};
+        render_pass_info.renderArea.extent = swap_chain_extent;
+
+        VkClearValue clear_values[2] = {};
+        clear_values[0].color        = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+        clear_values[1].depthStencil = { 1.0f, 0 };
+        render_pass_info.clearValueCount = config.depth_prepass ? 2 : 1;
+        render_pass_info.pClearValues = clear_values;
+
+        /*
+         * VK_SUBPASS_CONTENTS_INLINE: The render pass cmds will be embedded in the primary cmd buffer itself, no secondary cmds
+         * will be executed
+         * VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : The render pass cmds will be executed from the 2ndary buffers
+         */
+        vkCmdBeginRenderPass(cmd_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        const std::vector<VkCommandBuffer>& secondaries = graph_frame.secondaries;
+        if (!secondaries.empty()) {
+            vkCmdExecuteCommands(cmd_buffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        }
+        vkCmdEndRenderPass(cmd_buffer);
+        gpu_profiler->end_zone(cmd_buffer, render_pass_zone);
+    }
+
+    /**
+     * Secondaries don't inherit any state from the primary except the render pass, so the pipeline, dynamic state and
+     * vertex streams all have to be bound again.
+     */
+    void TriangleApp::begin_secondary(VkCommandBuffer cmd_buffer, uint32_t img_index, bool depth_pass) {
+        VkCommandBufferInheritanceInfo inheritance_info = {};
+        inheritance_info.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritance_info.renderPass                     = render_pass;
+        inheritance_info.subpass                        = 0;
+        inheritance_info.framebuffer                    = swap_chain_frame_buffers[img_index];
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        begin_info.pInheritanceInfo         = &inheritance_info;
+
+        if (vkBeginCommandBuffer(cmd_buffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin recording cmd buffer!");
+        }
+
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depth_pass ? depth_pipeline : graphics_pipeline);
+
+        VkViewport view_port = {};
+        view_port.x          = 0.0f;
+        view_port.y          = 0.0f;
+        view_port.width      = (float) swap_chain_extent.width;
+        view_port.height     = (float) swap_chain_extent.height;
+        view_port.minDepth   = 0.0f;
+        view_port.maxDepth   = 1.0f;
+        vkCmdSetViewport(cmd_buffer, 0, 1, &view_port);
+
+        VkRect2D scissor = {};
+        scissor.offset   = { 0, 0 };
+        scissor.extent   = swap_chain_extent;
+        vkCmdSetScissor(cmd_buffer, 0, 1, &scissor);
+
+        // Every stream lives in the same buffer. The depth pipeline only reads the position stream at binding 0.
+        uint32_t stream_count = depth_pass ? 1 : static_cast<uint32_t>(vertex_stream_offsets.size());
+        std::vector<VkBuffer> vertex_buffers(stream_count, vertex_buffer);
+        vkCmdBindVertexBuffers(cmd_buffer, 0, stream_count, vertex_buffers.data(), vertex_stream_offsets.data());
+    }
+
+    /**
+     * Runs on a worker thread, one draw per object. The depth pass draws the same objects with the same uniforms, the
+     * colour pass is the one that writes them. With --per-draw-sets every draw gets a set of its own out of the worker's
+     * descriptors, pointing straight at the object's uniforms, instead of the frame's set and a dynamic offset.
+     */
+    void TriangleApp::record_objects(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+        const ObjectUniforms& uniforms, bool depth_pass, DescriptorAllocator* descriptors) {
+        PROFILE_ZONE(profiler.get(), "record_objects");
+        begin_secondary(cmd_buffer, img_index, depth_pass);
+
+        // Meshes with 16 and 32 bit indices share the index buffer, it only gets rebound when the type changes.
+        const std::vector<MeshRange>& meshes = scene.get_meshes();
+        VkIndexType bound_index_type         = VK_INDEX_TYPE_MAX_ENUM;
+
+        // With --cpu-culling the range is over the visible objects, culled ones keep their uniform slot unwritten.
+        UniformBufferObject ubo = uniforms.camera;
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t object = config.cpu_culling ? visible_objects[i] : i;
+            if (!depth_pass) {
+                ubo.model = get_object_transform(object);
+                memcpy(uniforms.mapped + object * uniforms.stride, &ubo, sizeof(ubo));
+            }
+
+            // Same set every draw of the frame, only the dynamic offset picks which object's uniforms get read.
+            VkDescriptorSet set     = descriptor_sets[current_frame];
+            uint32_t uniform_offset = uniforms.base + static_cast<uint32_t>(object * uniforms.stride);
+            if (descriptors != nullptr) {
+                VkDescriptorBufferInfo buffer_info = { uniform_ring->get_buffer(),
+                    uniform_ring->get_frame_offset(static_cast<uint32_t>(current_frame)) + uniform_offset,
+                    sizeof(UniformBufferObject) };
+                set            = descriptors->allocate(descriptor_set_layout);
+                uniform_offset = 0;
+                uniform_template->update(set, &buffer_info);
+            }
+            vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &set, 1,
+                &uniform_offset);
 
-            if (vkEndCommandBuffer(command_buffers[i]) != VK_SUCCESS) {
-                throw std::runtime_error("Failed to record the command buffer!");
+            const MeshRange& mesh = meshes[object % meshes.size()];
+            if (mesh.index_type != bound_index_type) {
+                vkCmdBindIndexBuffer(cmd_buffer, index_buffer, 0, mesh.index_type);
+                bound_index_type = mesh.index_type;
             }
+            vkCmdDrawIndexed(cmd_buffer, mesh.index_count, 1, mesh.first_index, mesh.vertex_offset, 0);
+        }
+
+        if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the command buffer!");
         }
     }
 
+    /**
+     * Runs on a worker thread, one instanced draw per mesh in the range instead of one draw per object. The range gets
+     * counting sorted by mesh and each object's transform written to the slot it sorted into, slots begin to end of
+     * this frame's transforms belong to this worker. A mesh's run of slots is then one draw, bindless.vert reads slot
+     * gl_InstanceIndex, which starts at the draw's firstInstance. Nothing but the push constants and the heap's set is
+     * bound, and both only once. The depth pass sorts the same way, the colour pass is the one that writes.
+     */
+    uint32_t TriangleApp::record_bindless(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+        const ObjectUniforms& uniforms, bool depth_pass) {
+        PROFILE_ZONE(profiler.get(), "record_bindless");
+        begin_secondary(cmd_buffer, img_index, depth_pass);
+
+        VkDescriptorSet set = bindless_heap->get_set();
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &set, 0, nullptr);
+
+        BindlessConstants constants = {};
+        constants.view_proj         = uniforms.camera.proj * uniforms.camera.view;
+        constants.transforms        = bindless_transforms[current_frame];
+        vkCmdPushConstants(cmd_buffer, pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), &constants);
+
+        // first[mesh] ends up as the slot the mesh's run starts at, relative to begin.
+        const std::vector<MeshRange>& meshes = scene.get_meshes();
+        uint32_t mesh_count                  = static_cast<uint32_t>(meshes.size());
+        std::vector<uint32_t> first(mesh_count + 1, 0);
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t object = config.cpu_culling ? visible_objects[i] : i;
+            first[object % mesh_count + 1]++;
+        }
+        for (uint32_t mesh = 0; mesh < mesh_count; mesh++) {
+            first[mesh + 1] += first[mesh];
+        }
+
+        if (!depth_pass) {
+            std::vector<uint32_t> next(first.begin(), first.end() - 1);
+            for (uint32_t i = begin; i < end; i++) {
+                uint32_t object = config.cpu_culling ? visible_objects[i] : i;
+                uint32_t slot   = begin + next[object % mesh_count]++;
+                memcpy(uniforms.transforms + slot * sizeof(glm::mat4), &get_object_transform(object),
+                    sizeof(glm::mat4));
+            }
+        }
+
+        VkIndexType bound_index_type = VK_INDEX_TYPE_MAX_ENUM;
+        uint32_t draws               = 0;
+        for (uint32_t mesh = 0; mesh < mesh_count; mesh++) {
+            uint32_t count = first[mesh + 1] - first[mesh];
+            if (count == 0) {
+                continue;
+            }
+
+            const MeshRange& range = meshes[mesh];
+            if (range.index_type != bound_index_type) {
+                vkCmdBindIndexBuffer(cmd_buffer, index_buffer, 0, range.index_type);
+                bound_index_type = range.index_type;
+            }
+            vkCmdDrawIndexed(cmd_buffer, range.index_count, count, range.first_index, range.vertex_offset,
+                begin + first[mesh]);
+            draws++;
+        }
+
+        if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the command buffer!");
+        }
+        return draws;
+    }
+
+    /**
+     * Only the dynamic instances get written, spread across the workers. The static ones never change after upload,
+     * so with uniform_update_count at 0 a frame costs the same no matter how many instances there are.
+     */
+    void TriangleApp::write_instances(const ObjectUniforms& uniforms) {
+        PROFILE_ZONE(profiler.get(), "write_instances");
+
+        uint32_t count = static_cast<uint32_t>(dynamic_instance_objects.size());
+        worker_pool->parallel_for(count, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const glm::mat4& model = get_object_transform(dynamic_instance_objects[i]);
+                memcpy(uniforms.instances + i * sizeof(InstanceData), &model, sizeof(model));
+            }
+        });
+    }
+
+    /**
+     * Runs on a worker thread, one or two instanced draws per batch. Every draw reads the camera from the same uniform
+     * slot and its transforms from wherever the batch's instances live, bound at the binding after the vertex streams.
+     */
+    void TriangleApp::record_instances(VkCommandBuffer cmd_buffer, uint32_t img_index, uint32_t begin, uint32_t end,
+        const ObjectUniforms& uniforms, bool depth_pass) {
+        PROFILE_ZONE(profiler.get(), "record_instances");
+        begin_secondary(cmd_buffer, img_index, depth_pass);
+
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
+            &descriptor_sets[current_frame], 1, &uniforms.base);
+
+        const std::vector<MeshRange>& meshes = scene.get_meshes();
+        VkIndexType bound_index_type         = VK_INDEX_TYPE_MAX_ENUM;
+        uint32_t instance_binding            = static_cast<uint32_t>(vertex_format->streams.size());
+        VkBuffer dynamic_buffer              = instance_ring->get_buffer();
+
+        for (uint32_t i = begin; i < end; i++) {
+            const InstanceBatch& batch = instance_batches[i];
+            const MeshRange& mesh      = meshes[batch.mesh];
+            if (mesh.index_type != bound_index_type) {
+                vkCmdBindIndexBuffer(cmd_buffer, index_buffer, 0, mesh.index_type);
+                bound_index_type = mesh.index_type;
+            }
+
+            if (batch.dynamic_count > 0) {
+                VkDeviceSize offset = uniforms.instance_offset + batch.dynamic_first * sizeof(InstanceData);
+                vkCmdBindVertexBuffers(cmd_buffer, instance_binding, 1, &dynamic_buffer, &offset);
+                vkCmdDrawIndexed(cmd_buffer, mesh.index_count, batch.dynamic_count, mesh.first_index,
+                    mesh.vertex_offset, 0);
+            }
+
+            if (batch.static_count > 0) {
+                VkDeviceSize offset = batch.static_first * sizeof(InstanceData);
+                vkCmdBindVertexBuffers(cmd_buffer, instance_binding, 1, &instance_buffer, &offset);
+                vkCmdDrawIndexed(cmd_buffer, mesh.index_count, batch.static_count, mesh.first_index,
+                    mesh.vertex_offset, 0);
+            }
+        }
+
+        if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the command buffer!");
+        }
+    }
+
+    /**
+     * The cull is three passes of the render graph, which puts the barriers between them and before the draws. This
+     * one zeroes this frame's counts. Without VK_KHR_draw_indirect_count every slot gets drawn, so the commands are
+     * zeroed too and culled slots draw nothing.
+     */
+    void TriangleApp::record_culling_clear(VkCommandBuffer cmd_buffer) {
+        VkDeviceSize base = current_frame * culling_layout.frame_size;
+
+        vkCmdFillBuffer(cmd_buffer, culling_output, base + culling_layout.counts, 2 * sizeof(uint32_t), 0);
+        if (draw_indexed_indirect_count == nullptr) {
+            vkCmdFillBuffer(cmd_buffer, culling_output, base + culling_layout.commands,
+                config.object_count * sizeof(VkDrawIndexedIndirectCommand), 0);
+        }
+    }
+
+    // Culls every object into this frame's commands, counts and instances.
+    void TriangleApp::record_culling(VkCommandBuffer cmd_buffer, const ObjectUniforms& uniforms) {
+        CullingConstants constants = {};
+        Frustum frustum            = Frustum::from_matrix(uniforms.camera.proj * uniforms.camera.view);
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), constants.planes);
+        constants.object_count  = config.object_count;
+        constants.dynamic_count = static_cast<uint32_t>(dynamic_instance_objects.size());
+        constants.list_first[0] = culling_list_first[0];
+        constants.list_first[1] = culling_list_first[1];
+
+        uint32_t dynamic_offset = static_cast<uint32_t>(uniforms.instance_offset -
+            culling_ring->get_frame_offset(static_cast<uint32_t>(current_frame)));
+        vkCmdBindPipeline(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline);
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline_layout, 0, 1,
+            &culling_sets[current_frame], 1, &dynamic_offset);
+        vkCmdPushConstants(cmd_buffer, culling_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+            &constants);
+        vkCmdDispatch(cmd_buffer, (config.object_count + 63) / 64, 1, 1);
+    }
+
+    // Copies the counts out so read_culling_stats can report them once the frame's fence signals.
+    void TriangleApp::record_culling_readback(VkCommandBuffer cmd_buffer) {
+        VkDeviceSize base   = current_frame * culling_layout.frame_size;
+        VkBufferCopy region = {};
+        region.srcOffset    = base + culling_layout.counts;
+        region.dstOffset    = current_frame * 2 * sizeof(uint32_t);
+        region.size         = 2 * sizeof(uint32_t);
+        vkCmdCopyBuffer(cmd_buffer, culling_output, culling_readback, 1, &region);
+        culling_readback_pending[current_frame] = 1;
+    }
+
+    /**
+     * One indirect draw per index type for every visible object. The draws point firstInstance at their own slot of the
+     * instance stream, which cull.comp filled with their transforms.
+     */
+    void TriangleApp::record_indirect(VkCommandBuffer cmd_buffer, uint32_t img_index, const ObjectUniforms& uniforms,
+        bool depth_pass) {
+        PROFILE_ZONE(profiler.get(), "record_indirect");
+        begin_secondary(cmd_buffer, img_index, depth_pass);
+
+        vkCmdBindDescriptorSets(cmd_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
+            &descriptor_sets[current_frame], 1, &uniforms.base);
+
+        VkDeviceSize base            = current_frame * culling_layout.frame_size;
+        VkDeviceSize instance_offset = base + culling_layout.instances;
+        uint32_t instance_binding    = static_cast<uint32_t>(vertex_format->streams.size());
+        vkCmdBindVertexBuffers(cmd_buffer, instance_binding, 1, &culling_output, &instance_offset);
+
+        const VkIndexType index_types[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+        const uint32_t stride           = sizeof(VkDrawIndexedIndirectCommand);
+
+        for (uint32_t list = 0; list < 2; list++) {
+            if (culling_list_size[list] == 0) {
+                continue;
+            }
+
+            VkDeviceSize commands = base + culling_layout.commands + culling_list_first[list] * stride;
+            vkCmdBindIndexBuffer(cmd_buffer, index_buffer, 0, index_types[list]);
+
+            if (draw_indexed_indirect_count != nullptr) {
+                draw_indexed_indirect_count(cmd_buffer, culling_output, commands, culling_output,
+                    base + culling_layout.counts + list * sizeof(uint32_t), culling_list_size[list], stride);
+            } else {
+                vkCmdDrawIndexedIndirect(cmd_buffer, culling_output, commands, culling_list_size[list], stride);
+            }
+        }
+
+        if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record the command buffer!");
+        }
+    }
+
+    /**
+     * Only call this once the current frame's fence has signaled. The readback memory is host coherent and the render
+     * graph made the copy visible to the host, so the counts can be read straight out of the mapping.
+     */
+    void TriangleApp::read_culling_stats() {
+        if (!culling_readback_pending[current_frame]) {
+            return;
+        }
+
+        uint32_t counts[2];
+        memcpy(counts, static_cast<char*>(culling_readback_allocation.mapped) + current_frame * sizeof(counts),
+            sizeof(counts));
+
+        uint32_t visible = counts[0] + counts[1];
+        culling_stats.frames++;
+        culling_stats.visible += visible;
+        culling_stats.culled  += config.object_count - visible;
+        culling_readback_pending[current_frame] = 0;
+    }
+
     /*
      * Draw frame will grab an available img from the swap chain, execute the cmd buffer with the img, return the img to the swap chain 
      * for presentation.
      */
     void TriangleApp::draw_frame() {
-        vkWaitForFences(device, 1, &flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        if (shader_watcher) {
+            reload_shaders();
+        }
+
+        if (config.headless) {
+            draw_offscreen_frame();
+            return;
+        }
+
+        {
+            PROFILE_ZONE(profiler.get(), "wait_fence");
+            vkWaitForFences(device, 1, &flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+
+        // The fence we just waited on belongs to the frame submitted max_frames_per_flight frames ago, so that one and
+        // every frame before it are done.
+        if (frame_number >= static_cast<uint64_t>(max_frames_per_flight)) {
+            destroy_retired_swap_chains(frame_number - max_frames_per_flight + 1);
+            render_graph->reclaim(frame_number - max_frames_per_flight + 1);
+        }
 
         uint32_t img_index;
-        VkResult result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX,
-            img_available_semaphores[current_frame], VK_NULL_HANDLE, &img_index);
+        VkResult result;
+        {
+            PROFILE_ZONE(profiler.get(), "acquire");
+            result = vkAcquireNextImageKHR(device, swap_chain, UINT64_MAX, img_available_semaphores[current_frame],
+                VK_NULL_HANDLE, &img_index);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR) {
             recreate_swap_chain();
@@ -1015,8 +2545,16 @@ namespace vulkan_rendering {
             throw std::runtime_error("Failed to acquire swap chain img!");
         }
         
-        // TODO: Add the uniform buffer update
-        update_uniform_buffer(img_index);
+        // Normally a no-op, the geometry upload has long finished by the time we draw.
+        {
+            PROFILE_ZONE(profiler.get(), "upload_wait");
+            uploader->wait(geometry_upload_ticket);
+        }
+
+        {
+            PROFILE_ZONE(profiler.get(), "record");
+            record_command_buffer(img_index);
+        }
 
         VkSubmitInfo submit_info = {};
         submit_info.sType        = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1028,7 +2566,7 @@ namespace vulkan_rendering {
         submit_info.pWaitDstStageMask      = wait_stages;
 
         submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers    = &command_buffers[img_index];
+        submit_info.pCommandBuffers    = &frame_commands[current_frame].primary;
 
         VkSemaphore signal_semaphores[]  = { render_finished_semaphores[current_frame] };
         submit_info.signalSemaphoreCount = 1;
@@ -1036,8 +2574,11 @@ namespace vulkan_rendering {
 
         vkResetFences(device, 1, &flight_fences[current_frame]);
 
-        if (vkQueueSubmit(graphics_queue, 1, &submit_info, flight_fences[current_frame]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to submit draw cmd buffer!");
+        {
+            PROFILE_ZONE(profiler.get(), "submit");
+            if (vkQueueSubmit(graphics_queue, 1, &submit_info, flight_fences[current_frame]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit draw cmd buffer!");
+            }
         }
 
         VkPresentInfoKHR present_info   = {};
@@ -1050,16 +2591,69 @@ namespace vulkan_rendering {
         present_info.pSwapchains     = swap_chains;
         present_info.pImageIndices   = &img_index;
 
-        result = vkQueuePresentKHR(present_queue, &present_info);
+        {
+            PROFILE_ZONE(profiler.get(), "present");
+            result = vkQueuePresentKHR(present_queue, &present_info);
+        }
+
+        // Count the frame before recreating, it was submitted against the old swap chain and has to retire with it.
+        current_frame = (current_frame + 1) % max_frames_per_flight;
+        frame_number++;
+        profiler->end_frame();
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || frame_buffer_resized_flag) {
-            frame_buffer_resized_flag = true;
+            PROFILE_ZONE(profiler.get(), "recreate_swap_chain");
+            frame_buffer_resized_flag = false;
             recreate_swap_chain();
         } else if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to present swap chain img!");
+        } else if (resize_pending) {
+            // First frame presented with the new swap chain.
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() -
+                resize_start).count();
+
+            resize_count++;
+            resize_total_seconds += seconds;
+            resize_max_seconds    = std::max(resize_max_seconds, seconds);
+            resize_pending        = false;
+        }
+    }
+
+    /*
+     * Same as draw_frame except there's nothing to acquire or present. We walk the offscreen image ring ourselves and
+     * the in flight fences are the only thing pacing the CPU against the GPU.
+     */
+    void TriangleApp::draw_offscreen_frame() {
+        {
+            PROFILE_ZONE(profiler.get(), "wait_fence");
+            vkWaitForFences(device, 1, &flight_fences[current_frame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+
+        uint32_t img_index = static_cast<uint32_t>(frame_number % swap_chain_images.size());
+        uploader->wait(geometry_upload_ticket);
+
+        {
+            PROFILE_ZONE(profiler.get(), "record");
+            record_command_buffer(img_index);
+        }
+
+        VkSubmitInfo submit_info       = {};
+        submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &frame_commands[current_frame].primary;
+
+        vkResetFences(device, 1, &flight_fences[current_frame]);
+
+        {
+            PROFILE_ZONE(profiler.get(), "submit");
+            if (vkQueueSubmit(graphics_queue, 1, &submit_info, flight_fences[current_frame]) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit draw cmd buffer!");
+            }
         }
 
         current_frame = (current_frame + 1) % max_frames_per_flight;
+        frame_number++;
+        profiler->end_frame();
     }
 
     void TriangleApp::create_sync_objects() {
@@ -1087,98 +2681,165 @@ namespace vulkan_rendering {
         }
     }
 
+    /**
+     * Only the extent dependent objects get rebuilt: the swap chain, its image views, the render graph with its depth
+     * buffer and the frame buffers. The render pass, pipelines, uniforms and cmd buffers don't care about the extent.
+     * Frames that are still in flight keep using the old objects, so instead of idling the device they're retired and
+     * destroyed once those frames have finished.
+     */
     void TriangleApp::recreate_swap_chain() {
         int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
 
-        while (width == 0 || height == 0) {
-            glfwGetFramebufferSize(window, &width, &height);
-            glfwWaitEvents();
+        if (width == 0 || height == 0) {
+            // Minimized, nothing to render into until the window comes back. Don't count the time spent waiting.
+            while (width == 0 || height == 0) {
+                glfwWaitEvents();
+                glfwGetFramebufferSize(window, &width, &height);
+            }
+            resize_pending = false;
         }
 
-        vkDeviceWaitIdle(this->device);
+        if (!resize_pending) {
+            resize_pending = true;
+            resize_start   = std::chrono::high_resolution_clock::now();
+        }
+
+        RetiredSwapChain retired;
+        retired.swap_chain    = swap_chain;
+        retired.image_views   = std::move(swap_chain_image_views);
+        retired.frame_buffers = std::move(swap_chain_frame_buffers);
+        retired.retire_frame  = frame_number;
+
+        VkFormat previous_format = swap_chain_image_format;
 
         create_swap_chain();
+        retired_swap_chains.push_back(std::move(retired));
+
+        swap_chain_image_views.clear();
+        swap_chain_frame_buffers.clear();
         create_image_views();
-        create_render_pass();
-        create_graphics_pipeline();
+
+        // The depth buffer has the old extent too, the graph keeps it until the frames testing against it are done.
+        create_render_graph();
+
+        /**
+         * The surface format practically never changes (e.g. the window moved to an HDR monitor), so in that case we
+         * just idle the device rather than retiring the render pass as well.
+         */
+        if (swap_chain_image_format != previous_format) {
+            vkDeviceWaitIdle(device);
+            vkDestroyRenderPass(device, render_pass, nullptr);
+            create_render_pass();
+            create_graphics_pipeline();
+        }
+
         create_frame_buffers();
-        create_uniform_buffers();
-        create_descriptor_pool();
-        create_descriptor_sets();
-        create_command_buffers();
     }
 
     /**
-     * Ultimately the create_buffer_buffer is going to be changed use only a host visible and use a device local buffer 
-     * as the actual vertex buffer.
+     * The vertex buffer lives in device local memory, so the data goes through the uploader's staging ring. The copy is
+     * only queued here, create_geometry_buffers submits the vertex and index uploads together.
+     *
+     * VK_BUFFER_USAGE_TRANSFER_SRC_BIT: buffer can be used as a source for a copy.
+     * VK_BUFFER_USAGE_TRANSFER_DST_BIT: buffer can be used as a the pointer to where the copy will go to.
      */
     void TriangleApp::create_vertex_buffer() {
-        VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+        if (vertex_format->matches_vertex) {
+            vertex_stream_offsets = { 0 };
+            create_geometry_buffer(scene.get_vertex_sources(), scene.get_vertex_bytes(),
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_buffer, vertex_buffer_allocation);
+            return;
+        }
 
         /**
-         * The staging buffer and staging buffer memory allows us to fast copy the original vertbux buffer in temporary 
-         * buffer (double buffering technique).
-         *
-         * VK_BUFFER_USAGE_TRANSFER_SRC_BIT: buffer can be used as a source for a copy.
-         * VK_BUFFER_USAGE_TRANSFER_DST_BIT: buffer can be used as a the pointer to where the copy will go to.
+         * Other formats have to be encoded first. The streams are laid out one after the other, each one an array
+         * covering every vertex of the scene, and each source lands at the same vertex index it would have had.
          */
-        VkBuffer staging_buffer;
-        VkDeviceMemory staging_buffer_memory;
-        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+        uint64_t vertex_count = scene.get_vertex_bytes() / sizeof(Vertex);
+        VkDeviceSize size     = 0;
+
+        vertex_stream_offsets.clear();
+        for (const auto& stream : vertex_format->streams) {
+            size = (size + 15) & ~static_cast<VkDeviceSize>(15);
+            vertex_stream_offsets.push_back(size);
+            size += vertex_count * stream.stride;
+        }
 
-        /**
-         * Store the memory and map it to the data pointer.
-         *
-         * The mapped memory must copy to the buffer so we ensure that at any point in time the memory is the same. So
-         * this can lead to performance problems since we don't flush the memory immediately.
-         *
-         * B/c the vertex buffer is now allocated on the device instead, we can't use the vkMapMemory. Instead we can 
-         * copy from the staging buffer -> vertex buffer. We use the src/dst flags for the staging buffer -> vertex
-         * buffer.
-         */
-        void* data;
-        vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-        memcpy(data, vertices.data(), (size_t)buffer_size);
-        vkUnmapMemory(device, staging_buffer_memory);
+        std::vector<uint8_t> encoded(size);
+        QuantizationError error;
+
+        for (const auto& source : scene.get_vertex_sources()) {
+            const Vertex* vertices = static_cast<const Vertex*>(source.data);
+            uint32_t count         = static_cast<uint32_t>(source.size / sizeof(Vertex));
+            uint64_t first_vertex  = source.offset / sizeof(Vertex);
+
+            for (size_t i = 0; i < vertex_format->streams.size(); i++) {
+                const VertexStream& stream = vertex_format->streams[i];
+                uint8_t* out               = encoded.data() + vertex_stream_offsets[i] + first_vertex * stream.stride;
+                stream.encode(vertices, count, out);
+            }
 
-        // TODO: Rework the vertex buffer creation to use a staging buffer technique.
-        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertex_buffer, vertex_buffer_memory);
+            if (config.print_stats) {
+                QuantizationError source_error = vertex_format->measure_error(vertices, count);
+                error.position = std::max(error.position, source_error.position);
+                error.colour   = std::max(error.colour, source_error.colour);
+            }
+        }
+
+        if (config.print_stats) {
+            std::cout << "Vertex format " << vertex_format->name << ": " << vertex_format->streams.size() <<
+                " streams, " << vertex_format->get_stride() << " bytes per vertex instead of " << sizeof(Vertex) <<
+                " (position " << vertex_format->streams[0].stride << "), max error " << error.position <<
+                " position, " << error.colour << " colour" << std::endl;
+        }
 
-        copy_buffer(staging_buffer, vertex_buffer, buffer_size);
-        vkDestroyBuffer(device, staging_buffer, nullptr);
-        vkFreeMemory(device, staging_buffer_memory, nullptr);
+        std::vector<GeometrySource> sources = { { encoded.data(), 0, encoded.size() } };
+        create_geometry_buffer(sources, encoded.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_buffer,
+            vertex_buffer_allocation);
     }
 
     /**
-     * We iterate throughout the memory and determine what kind of memory the space is. If the filter and the bit flag
-     * is 1 and we can allow certain properties within the mem type, then we can return the index.
+     * One device local buffer with every source at the offset SceneLayout gave it. Each source is copied into the
+     * staging ring from wherever it lives, for packed meshes that's the asset pack's mapping and for imported ones the
+     * importer's own buffers, so there's no copy in between.
      */
-    uint32_t TriangleApp::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags props) {
-        VkPhysicalDeviceMemoryProperties mem_props;
-        vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_props);
+    void TriangleApp::create_geometry_buffer(const std::vector<GeometrySource>& sources, VkDeviceSize size,
+        VkBufferUsageFlags usage, VkBuffer& buffer, Allocation& allocation) {
 
-        for (uint32_t i = 0; i < mem_props.memoryTypeCount; i++) {
-            if (type_filter & (1 << i) && (mem_props.memoryTypes[i].propertyFlags & props) == props) {
-                return i;
-            }
-        }
+        create_buffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+            allocation);
 
-        throw std::runtime_error("Failed to find suitable mem types!");
+        for (const auto& source : sources) {
+            uploader->upload(buffer, source.offset, source.data, source.size);
+        }
     }
 
     /**
      * More generic function so we can create tons of buffers.
      */
     void TriangleApp::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, 
-        VkBuffer& buffer, VkDeviceMemory& buffer_mem) {
+        VkBuffer& buffer, Allocation& allocation) {
 
         VkBufferCreateInfo buffer_info = {};
         buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         buffer_info.size               = size;
         buffer_info.usage              = usage;
-        buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        /**
+         * Buffers written by the transfer queue and read by the graphics queue are shared concurrently between the two
+         * families, that way we don't need queue family ownership transfers for every upload.
+         */
+        uint32_t queue_family_indices[] = { queue_families.graphics_family.value(),
+            queue_families.transfer_family.value_or(0) };
+
+        if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && queue_families.transfer_family.has_value()) {
+            buffer_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+            buffer_info.queueFamilyIndexCount = 2;
+            buffer_info.pQueueFamilyIndices   = queue_family_indices;
+        } else {
+            buffer_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+        }
 
         if (vkCreateBuffer(device, &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create vertex buffer!");
@@ -1188,95 +2849,177 @@ namespace vulkan_rendering {
         vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
 
         /**
-         * Specify the size and the type which derives from the memory requirements of the vertex buffer.
+         * The size, alignment and type derive from the memory requirements of the buffer. The allocator hands back a
+         * range within one of its blocks, so the buffer gets bound at that offset instead of 0.
          */
-        VkMemoryAllocateInfo alloc_info = {};
-        alloc_info.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        alloc_info.allocationSize       = mem_requirements.size;
-        alloc_info.memoryTypeIndex      = find_memory_type(mem_requirements.memoryTypeBits, props);
+        allocation = allocator->allocate(mem_requirements, props, ResourceKind::Linear);
 
-        if (vkAllocateMemory(device, &alloc_info, nullptr, &buffer_mem) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate vertex buffer memory!");
-        }
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
 
-        vkBindBufferMemory(device, buffer, buffer_mem, 0);
+    void TriangleApp::destroy_buffer(VkBuffer buffer, Allocation& allocation) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(allocation);
     }
 
     /**
-     * To do memory based operations, we need to use a cmd_buffer. The buffers are temporary and we can likely handle
-     * this elsewhere. If we create a generic cmd buffer for memory cache optimizations, then we should use a 
-     * VK_COMMAND_POOL_CREATE_TRANSIENT_BIT flag.
+     * Uploads run on the dedicated transfer queue when the device has one. Submission is batched: both buffers go out
+     * in a single cmd buffer and we only hold onto the ticket. The first frame waits on it, which by then has usually
+     * completed already.
      */
-    void TriangleApp::copy_buffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
-        VkCommandBufferAllocateInfo alloc_info = {};
-        alloc_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        alloc_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        alloc_info.commandPool                 = this->command_pool;
-        alloc_info.commandBufferCount          = 1;
+    void TriangleApp::create_geometry_buffers() {
+        create_vertex_buffer();
+        create_index_buffer();
+        if (config.instancing) {
+            create_instance_buffers();
+        }
+        if (config.gpu_culling) {
+            create_culling_buffers();
+        }
+        geometry_upload_ticket = uploader->flush();
 
-        VkCommandBuffer cmd_buffer;
-        vkAllocateCommandBuffers(device, &alloc_info, &cmd_buffer);
+        // Everything's in the staging ring by now, imported models can be millions of vertices so don't hold onto them.
+        std::vector<ImportedMesh>().swap(imported_meshes);
+    }
 
-        VkCommandBufferBeginInfo begin_info = {};
-        begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-       
-        // Start recording the cmd buffer
-        vkBeginCommandBuffer(cmd_buffer, &begin_info);
-       
-        // Do the actual cmd buffer copy!
-        VkBufferCopy copy_region = {};
-        copy_region.size         = size;
-
-        vkCmdCopyBuffer(cmd_buffer, src, dst, 1, &copy_region);
-        vkEndCommandBuffer(cmd_buffer);
+    void TriangleApp::create_index_buffer() {
+        // Each mesh's indices are 16 bit unless it has more vertices than that can address, see MeshRange::index_type.
+        create_geometry_buffer(scene.get_index_sources(), scene.get_index_bytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            index_buffer, index_buffer_allocation);
+    }
 
-        VkSubmitInfo submit_info       = {};
-        submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers    = &cmd_buffer;
+    /**
+     * Groups the objects by mesh. Dynamic instances only get a slot in instance_ring, the static ones have their
+     * transform computed once here and uploaded with the geometry.
+     */
+    void TriangleApp::create_instance_buffers() {
+        uint32_t mesh_count = static_cast<uint32_t>(scene.get_meshes().size());
+        std::vector<InstanceData> static_instances;
+
+        for (uint32_t mesh = 0; mesh < std::min(mesh_count, config.object_count); mesh++) {
+            InstanceBatch batch = {};
+            batch.mesh          = mesh;
+            batch.dynamic_first = static_cast<uint32_t>(dynamic_instance_objects.size());
+            batch.static_first  = static_cast<uint32_t>(static_instances.size());
+
+            for (uint32_t object = mesh; object < config.object_count; object += mesh_count) {
+                if (object < config.uniform_update_count) {
+                    dynamic_instance_objects.push_back(object);
+                    batch.dynamic_count++;
+                } else {
+                    const glm::mat4& model = get_object_transform(object);
+                    static_instances.emplace_back();
+                    memcpy(&static_instances.back(), &model, sizeof(model));
+                    batch.static_count++;
+                }
+            }
+            instance_batches.push_back(batch);
+        }
 
-        // Execute the transfer immediately by using a wait for idle, I could use a fence here and allow waiting 
-        // for the cmd buffer to finish executing too.
-        vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphics_queue);
+        if (!static_instances.empty()) {
+            std::vector<GeometrySource> sources = { { static_instances.data(), 0,
+                static_instances.size() * sizeof(InstanceData) } };
+            create_geometry_buffer(sources, sources[0].size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, instance_buffer,
+                instance_buffer_allocation);
+        }
 
-        vkFreeCommandBuffers(device, command_pool, 1, &cmd_buffer);
+        // Vertex buffer offsets have no alignment requirement beyond the attribute's, instances are tightly packed.
+        VkDeviceSize frame_size = std::max<VkDeviceSize>(dynamic_instance_objects.size() * sizeof(InstanceData),
+            sizeof(InstanceData));
+        instance_ring = std::unique_ptr<UniformRing>(new UniformRing(device, allocator.get(), sizeof(InstanceData),
+            max_frames_per_flight, frame_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT));
     }
 
-    void TriangleApp::create_index_buffer() {
-        // So the size is the number of indices * the size of the index type, in this case we use int16_t cause
-        // we don't need 2^32 - 1 bits of values
-        VkDeviceSize buffer_size = sizeof(indices[0]) * indices.size();
-
-        VkBuffer staging_buffer;
-        VkDeviceMemory staging_buffer_memory;
+    /**
+     * Everything cull.comp reads that doesn't change gets uploaded with the geometry: the mesh table, which mesh every
+     * object draws and every object's starting transform. The first uniform_update_count objects get fresh transforms
+     * written to culling_ring every frame instead, by write_instances. The output regions are device local, only the
+     * two counts get copied back.
+     */
+    void TriangleApp::create_culling_buffers() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
 
-        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_buffer_memory);
+        if (properties.limits.maxDrawIndirectCount < config.object_count) {
+            throw std::runtime_error("Too many objects for a single indirect draw!");
+        }
 
-        void* data;
-        vkMapMemory(device, staging_buffer_memory, 0, buffer_size, 0, &data);
-        memcpy(data, indices.data(), (size_t)buffer_size);
-        vkUnmapMemory(device, staging_buffer_memory);
+        const std::vector<MeshRange>& meshes = scene.get_meshes();
+        std::vector<CullingMesh> culling_meshes(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            culling_meshes[i].sphere        = scene.get_bounds()[i].sphere;
+            culling_meshes[i].index_count   = meshes[i].index_count;
+            culling_meshes[i].first_index   = meshes[i].first_index;
+            culling_meshes[i].vertex_offset = meshes[i].vertex_offset;
+            culling_meshes[i].list          = meshes[i].index_type == VK_INDEX_TYPE_UINT32 ? 1 : 0;
+        }
 
-        create_buffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, index_buffer, index_buffer_memory);
+        std::vector<uint32_t> object_meshes(config.object_count);
+        std::vector<glm::mat4> transforms(config.object_count);
+        for (uint32_t i = 0; i < config.object_count; i++) {
+            object_meshes[i] = i % static_cast<uint32_t>(meshes.size());
+            transforms[i]    = get_object_transform(i);
+            culling_list_size[culling_meshes[object_meshes[i]].list]++;
+        }
+        culling_list_first[1] = culling_list_size[0];
 
-        copy_buffer(staging_buffer, index_buffer, buffer_size);
+        for (uint32_t i = 0; i < std::min(config.uniform_update_count, config.object_count); i++) {
+            dynamic_instance_objects.push_back(i);
+        }
 
-        vkDestroyBuffer(device, staging_buffer, nullptr);
-        vkFreeMemory(device, staging_buffer_memory, nullptr);
+        auto upload = [this](const void* data, VkDeviceSize size, VkBuffer& buffer, Allocation& allocation) {
+            std::vector<GeometrySource> sources = { { data, 0, size } };
+            create_geometry_buffer(sources, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, buffer, allocation);
+        };
+        upload(culling_meshes.data(), culling_meshes.size() * sizeof(CullingMesh), culling_mesh_buffer,
+            culling_mesh_allocation);
+        upload(object_meshes.data(), object_meshes.size() * sizeof(uint32_t), culling_object_buffer,
+            culling_object_allocation);
+        upload(transforms.data(), transforms.size() * sizeof(glm::mat4), culling_transform_buffer,
+            culling_transform_allocation);
+
+        VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 4);
+        auto align             = [alignment](VkDeviceSize offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        };
+
+        culling_layout.counts     = 0;
+        culling_layout.commands   = align(2 * sizeof(uint32_t));
+        culling_layout.instances  = align(culling_layout.commands +
+            config.object_count * sizeof(VkDrawIndexedIndirectCommand));
+        culling_layout.frame_size = align(culling_layout.instances + config.object_count * sizeof(InstanceData));
+
+        create_buffer(culling_layout.frame_size * max_frames_per_flight, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            culling_output, culling_output_allocation);
+
+        create_buffer(max_frames_per_flight * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, culling_readback,
+            culling_readback_allocation);
+        culling_readback_pending.assign(max_frames_per_flight, 0);
+
+        VkDeviceSize frame_size = std::max<VkDeviceSize>(dynamic_instance_objects.size() * sizeof(InstanceData),
+            sizeof(InstanceData));
+        culling_ring = std::unique_ptr<UniformRing>(new UniformRing(device, allocator.get(), alignment,
+            max_frames_per_flight, frame_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
     }
 
+    /**
+     * Layouts come from the cache, so they're destroyed with it instead of one by one. Every layout gets a template to
+     * write its sets with.
+     */
     void TriangleApp::create_descriptor_set_layout() {
+        layout_cache = std::unique_ptr<DescriptorLayoutCache>(new DescriptorLayoutCache(device));
+
         VkDescriptorSetLayoutBinding ubo_layout_binding = {};
 
         // What kind of binding are we using
         ubo_layout_binding.binding = 0;
 
         // What is its descriptor? It is possible to use an array of ubos (e.g. representing bones)
-        ubo_layout_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        // Dynamic so one set per frame can point at any object's uniforms in the ring by changing the bind offset.
+        ubo_layout_binding.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         ubo_layout_binding.descriptorCount = 1;
 
         // Which shader stages is the descriptor going to be referened? They can be a combination of flags
@@ -1286,65 +3029,376 @@ namespace vulkan_rendering {
         // TODO: Look at later
         ubo_layout_binding.pImmutableSamplers = nullptr;
 
+        // The shaders of the mode we run in say which stages really read it.
+        GraphicsShaders shaders        = get_graphics_shaders();
+        std::vector<const char*> names = { shaders.vertex, shaders.fragment };
+        if (config.depth_prepass) {
+            names.push_back(shaders.depth);
+        }
+        PipelineReflection reflection = reflect_shaders(names);
+
+        std::vector<VkDescriptorSetLayoutBinding> bindings = { ubo_layout_binding };
+        if (!config.bindless) {
+            reflection.narrow_stages(0, bindings);
+        }
+
         VkDescriptorSetLayoutCreateInfo layout_info = {};
         layout_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layout_info.bindingCount                    = 1;
-        layout_info.pBindings                       = &ubo_layout_binding;
+        layout_info.bindingCount                    = static_cast<uint32_t>(bindings.size());
+        layout_info.pBindings                       = bindings.data();
+
+        descriptor_set_layout = layout_cache->get(layout_info);
+        uniform_template      = std::unique_ptr<DescriptorTemplate>(new DescriptorTemplate(device,
+            descriptor_set_layout, layout_info, descriptor_update_templates));
+
+        if (config.gpu_culling) {
+            create_culling_set_layout();
+        }
+
+        if (config.bindless) {
+            bindless_heap = std::unique_ptr<BindlessHeap>(new BindlessHeap(device, bindless_buffer_count,
+                bindless_image_count));
+        }
 
-        if (!vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptor_set_layout)) {
-            throw std::runtime_error("Failed to create descriptor set layout!");
+        graphics_interface.sets = { config.bindless ? bindless_heap->get_bindings() : bindings };
+        graphics_interface.push_constants.clear();
+        if (config.bindless) {
+            graphics_interface.push_constants.push_back({ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BindlessConstants) });
         }
+        reflection.check(graphics_interface);
     }
 
+    /**
+     * Matches cull.comp's bindings. The dynamic transforms are the only ones that move every frame, so they're the one
+     * dynamic binding and the per frame sets just point at their frame's output regions.
+     */
+    void TriangleApp::create_culling_set_layout() {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(CULLING_BINDING_COUNT);
+        for (uint32_t i = 0; i < CULLING_BINDING_COUNT; i++) {
+            bindings[i].binding         = i;
+            bindings[i].descriptorType  = i == CULLING_DYNAMIC_BINDING ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC :
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        culling_interface.sets           = { bindings };
+        culling_interface.push_constants = { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingConstants) } };
+        reflect_shaders({ "cull.spv" }).check(culling_interface);
+
+        VkDescriptorSetLayoutCreateInfo layout_info = {};
+        layout_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount                    = CULLING_BINDING_COUNT;
+        layout_info.pBindings                       = bindings.data();
+
+        culling_set_layout = layout_cache->get(layout_info);
+        culling_template   = std::unique_ptr<DescriptorTemplate>(new DescriptorTemplate(device, culling_set_layout,
+            layout_info, descriptor_update_templates));
+    }
+
+    /**
+     * Uniforms only need to survive as long as the frame that reads them is in flight, so they're sized by
+     * max_frames_per_flight instead of the swap chain img count and bump allocated from a ring that's never unmapped.
+     */
     void TriangleApp::create_uniform_buffers() {
-        VkDeviceSize buffer_size = sizeof(UniformBufferObject);
-        uniform_buffers.resize(swap_chain_images.size());
-        uniform_buffers_memory.resize(swap_chain_images.size());
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+        // Every object gets its own aligned slot each frame, so make sure they all fit. Instancing, GPU culling and
+        // bindless only need the camera.
+        uint32_t slot_count     = config.instancing || config.gpu_culling || config.bindless ? 1 : config.object_count;
+        VkDeviceSize alignment  = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+        VkDeviceSize stride     = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+        VkDeviceSize frame_size = std::max(UniformRing::DEFAULT_FRAME_SIZE, stride * slot_count);
+
+        uniform_ring = std::unique_ptr<UniformRing>(new UniformRing(device, allocator.get(), alignment,
+            max_frames_per_flight, frame_size));
+
+        // The bindless transforms are tightly packed, only the frame regions have to be aligned for the heap.
+        if (config.bindless) {
+            VkDeviceSize storage_alignment = std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment,
+                4);
+            bindless_ring = std::unique_ptr<UniformRing>(new UniformRing(device, allocator.get(), storage_alignment,
+                max_frames_per_flight, std::max<uint32_t>(config.object_count, 1) * sizeof(glm::mat4),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+
+            for (uint32_t i = 0; i < static_cast<uint32_t>(max_frames_per_flight); i++) {
+                bindless_transforms.push_back(bindless_heap->add_buffer({ bindless_ring->get_buffer(),
+                    bindless_ring->get_frame_offset(i), bindless_ring->get_frame_size() }));
+            }
+        }
 
-        for (size_t i = 0; i < swap_chain_images.size(); i++) {
-            create_buffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | 
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniform_buffers[i], uniform_buffers_memory[i]);
+        if (config.cpu_culling) {
+            create_culler();
+        }
+    }
+
+    /**
+     * The objects that never move get their world bounds once here, the rest get theirs updated by cull_objects every
+     * frame. The BVH gets built over where everything starts out.
+     */
+    void TriangleApp::create_culler() {
+        const std::vector<MeshBounds>& bounds = scene.get_bounds();
+        uint32_t dynamic_count                = std::min(config.uniform_update_count, config.object_count);
+
+        if (config.bvh_culling) {
+            std::vector<glm::vec3> min(config.object_count);
+            std::vector<glm::vec3> max(config.object_count);
+            for (uint32_t i = 0; i < config.object_count; i++) {
+                const MeshBounds& mesh = bounds[i % bounds.size()];
+                transform_box(get_object_transform(i), mesh.min, mesh.max, min[i], max[i]);
+            }
+
+            bvh = std::unique_ptr<Bvh>(new Bvh());
+            bvh->build(min, max);
+            return;
         }
+
+        culler = std::unique_ptr<FrustumCuller>(new FrustumCuller());
+        culler->resize(config.object_count);
+
+        for (uint32_t i = dynamic_count; i < config.object_count; i++) {
+            const MeshBounds& mesh = bounds[i % bounds.size()];
+            culler->set_transformed(i, get_object_transform(i), mesh.sphere, mesh.min, mesh.max);
+        }
+    }
+
+    /**
+     * Runs before recording and fills visible_objects, the workers split the bounds updates and then the cull itself.
+     * The BVH's refit and walk aren't thread safe, so with --bvh-culling it all happens on this thread. The frustum
+     * comes from the camera update_uniform_buffer just wrote.
+     */
+    void TriangleApp::cull_objects(const ObjectUniforms& uniforms) {
+        PROFILE_ZONE(profiler.get(), "cull_objects");
+
+        const std::vector<MeshBounds>& bounds = scene.get_bounds();
+        uint32_t dynamic_count                = std::min(config.uniform_update_count, config.object_count);
+        Frustum frustum                       = Frustum::from_matrix(uniforms.camera.proj * uniforms.camera.view);
+        uint32_t visible;
+
+        if (bvh) {
+            for (uint32_t i = 0; i < dynamic_count; i++) {
+                const MeshBounds& mesh = bounds[i % bounds.size()];
+                glm::vec3 min;
+                glm::vec3 max;
+                transform_box(get_object_transform(i), mesh.min, mesh.max, min, max);
+                bvh->set_bounds(i, min, max);
+            }
+            bvh->refit();
+
+            visible_objects.clear();
+            bvh->cull(frustum, visible_objects);
+            visible = static_cast<uint32_t>(visible_objects.size());
+        } else {
+            worker_pool->parallel_for(dynamic_count, [&](uint32_t worker, uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    const MeshBounds& mesh = bounds[i % bounds.size()];
+                    culler->set_transformed(i, get_object_transform(i), mesh.sphere, mesh.min, mesh.max);
+                }
+            });
+            visible = culler->cull(frustum, *worker_pool, visible_objects);
+        }
+
+        culling_stats.frames++;
+        culling_stats.visible += visible;
+        culling_stats.culled  += config.object_count - visible;
     }
 
-    void TriangleApp::update_uniform_buffer(uint32_t current_img) {
+    /**
+     * Every object drawn this frame asks for the mip of its texture with about one texel per pixel of its height on
+     * screen, its scale projected at its distance from the camera. Then the streamer gets to swap in what finished and
+     * start on what's missing.
+     */
+    void TriangleApp::stream_textures(const ObjectUniforms& uniforms) {
+        PROFILE_ZONE(profiler.get(), "stream_textures");
+
+        uint32_t texture_count = texture_streamer->get_texture_count();
+        glm::mat4 view_proj    = uniforms.camera.proj * uniforms.camera.view;
+        float half_height      = 0.5f * swap_chain_extent.height * std::abs(uniforms.camera.proj[1][1]);
+
+        auto request = [&](uint32_t object) {
+            const glm::mat4& world = get_object_transform(object);
+            uint32_t texture       = object % texture_count;
+            float distance         = std::max((view_proj * world[3]).w, 0.1f);
+            float pixels           = std::max(glm::length(glm::vec3(world[1])) * half_height / distance, 1.0f);
+            float texels_per_pixel = texture_streamer->get_file(texture).get_height() / pixels;
+
+            uint32_t mip = texels_per_pixel > 1.0f ? static_cast<uint32_t>(std::log2(texels_per_pixel)) : 0;
+            texture_streamer->request(texture, mip, frame_number);
+        };
+
+        if (config.cpu_culling) {
+            for (uint32_t object : visible_objects) {
+                request(object);
+            }
+        } else {
+            for (uint32_t object = 0; object < config.object_count; object++) {
+                request(object);
+            }
+        }
+
+        uint64_t completed_frames = frame_number >= static_cast<uint64_t>(max_frames_per_flight) ?
+            frame_number - max_frames_per_flight + 1 : 0;
+        texture_streamer->update(frame_number, completed_frames);
+    }
+
+    /**
+     * Only call this after the current frame's fence has signaled, the frame's region of the ring gets rewound. Reserves
+     * the uniforms of every object, the workers fill in their model matrices while recording. The objects get moved to
+     * where they are this frame first.
+     */
+    TriangleApp::ObjectUniforms TriangleApp::update_uniform_buffer() {
         static auto start_time = std::chrono::high_resolution_clock::now();
 
         auto current_time = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
 
-        UniformBufferObject ubo = {};
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        ObjectUniforms uniforms = {};
+        uniforms.time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
+        update_transforms(uniforms.time);
+
+        UniformBufferObject& ubo = uniforms.camera;
+        ubo.model = glm::mat4(1.0f);
         ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         ubo.proj = glm::perspective(glm::radians(45.0f), swap_chain_extent.width / (float) swap_chain_extent.height,
             0.1f, 10.0f);
 
         ubo.proj[1][1] *= -1;
 
-        void* data;
-        vkMapMemory(device, uniform_buffers_memory[current_img], 0, sizeof(ubo), 0, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(device, uniform_buffers_memory[current_img]);
+        uniform_ring->begin_frame(static_cast<uint32_t>(current_frame));
+        uniforms.stride = uniform_ring->get_stride(sizeof(UniformBufferObject));
+
+        // The bindless draws take the camera as push constants, only the transforms need somewhere to go.
+        if (config.bindless) {
+            bindless_ring->begin_frame(static_cast<uint32_t>(current_frame));
+            bindless_ring->reserve(config.object_count * sizeof(glm::mat4), 1, uniforms.transforms);
+            return uniforms;
+        }
+
+        if (!config.instancing && !config.gpu_culling) {
+            uniforms.base = uniform_ring->reserve(sizeof(UniformBufferObject), config.object_count, uniforms.mapped);
+            return uniforms;
+        }
+
+        // The camera is all the instanced path keeps in the uniform ring, the transforms go to the instance ring. With
+        // GPU culling they go to the culling ring instead, where cull.comp picks them up.
+        uniforms.base = uniform_ring->push(ubo);
+
+        UniformRing* ring = config.gpu_culling ? culling_ring.get() : instance_ring.get();
+        ring->begin_frame(static_cast<uint32_t>(current_frame));
+        uint32_t offset          = ring->reserve(sizeof(InstanceData),
+            static_cast<uint32_t>(dynamic_instance_objects.size()), uniforms.instances);
+        uniforms.instance_offset = ring->get_frame_offset(static_cast<uint32_t>(current_frame)) + offset;
+
+        return uniforms;
+    }
+
+    /**
+     * Objects are laid out on a square grid that shrinks as more get added, each one spinning with its own phase. With
+     * a single object this is the original spinning quad. Every object is a child of one node for the whole grid.
+     */
+    void TriangleApp::create_transforms() {
+        uint32_t grid = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(config.object_count))));
+        float cell    = 2.0f / grid;
+
+        transforms    = std::unique_ptr<TransformHierarchy>(new TransformHierarchy());
+        uint32_t root = transforms->add_node(TransformHierarchy::NO_PARENT);
+        for (uint32_t object = 0; object < config.object_count; object++) {
+            glm::vec3 position(-1.0f + cell * (object % grid + 0.5f), -1.0f + cell * (object / grid + 0.5f), 0.0f);
+            transforms->add_node(root, position, glm::angleAxis(object * 0.1f, glm::vec3(0.0f, 0.0f, 1.0f)),
+                glm::vec3(1.0f / grid));
+        }
+        transforms->update(*worker_pool);
+    }
+
+    /**
+     * Only the first uniform_update_count objects spin, so only their world matrices get recomputed. With none of them
+     * the hierarchy has nothing to do.
+     */
+    void TriangleApp::update_transforms(float time) {
+        PROFILE_ZONE(profiler.get(), "update_transforms");
+
+        uint32_t dynamic_count = std::min(config.uniform_update_count, config.object_count);
+        for (uint32_t object = 0; object < dynamic_count; object++) {
+            float angle = time * glm::radians(90.0f) + object * 0.1f;
+            transforms->set_rotation(object + 1, glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+        transform_updates += transforms->update(*worker_pool);
     }
 
+    /**
+     * The sets that live as long as the app come out of descriptor_allocator, sized for one graphics and one culling
+     * set per frame in flight. The ones --per-draw-sets allocates every frame come out of a growable allocator per
+     * worker and frame, which gets reset along with the worker's cmd pool.
+     */
     void TriangleApp::create_descriptor_pool() {
-        VkDescriptorPoolSize pool_size = {};
-        // Create the descriptors for every frame in the swap_chain_images
-        pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        pool_size.descriptorCount = static_cast<uint32_t>(swap_chain_images.size());
+        uint32_t frames = static_cast<uint32_t>(max_frames_per_flight);
 
-        VkDescriptorPoolCreateInfo pool_info = {};
-        pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        pool_info.poolSizeCount              = 1;
-        pool_info.pPoolSizes                 = &pool_size;
-        pool_info.maxSets                    = static_cast<uint32_t>(swap_chain_images.size());
+        std::vector<DescriptorPoolRatio> ratios = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f } };
+        if (config.gpu_culling) {
+            ratios.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0.5f * (CULLING_BINDING_COUNT - 1) });
+            ratios.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f });
+        }
+        descriptor_allocator = std::unique_ptr<DescriptorAllocator>(new DescriptorAllocator(device, ratios,
+            2 * frames));
 
-        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool)) {
-            throw std::runtime_error("Failed to create descriptor pool!");
+        if (!config.per_draw_sets) {
+            return;
+        }
+
+        std::vector<DescriptorPoolRatio> draw_ratios = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f } };
+        for (auto& frame : frame_commands) {
+            frame.worker_descriptors.clear();
+            for (size_t i = 0; i < frame.worker_pools.size(); i++) {
+                frame.worker_descriptors.emplace_back(new DescriptorAllocator(device, draw_ratios));
+            }
         }
     }
 
+    /**
+     * One descriptor set per frame in flight, each pointing at the start of its frame's region in the uniform ring. The
+     * sets are freed along with their pools so we never free them individually.
+     */
     void TriangleApp::create_descriptor_sets() {
-        throw std::runtime_error("Not implemented!");
+        descriptor_sets.resize(max_frames_per_flight);
+        for (size_t i = 0; i < descriptor_sets.size(); i++) {
+            VkDescriptorBufferInfo buffer_info = {};
+            buffer_info.buffer                 = uniform_ring->get_buffer();
+            buffer_info.offset                 = uniform_ring->get_frame_offset(static_cast<uint32_t>(i));
+            buffer_info.range                  = sizeof(UniformBufferObject);
+
+            descriptor_sets[i] = descriptor_allocator->allocate(descriptor_set_layout);
+            uniform_template->update(descriptor_sets[i], &buffer_info);
+        }
+
+        if (config.gpu_culling) {
+            create_culling_sets();
+        }
+    }
+
+    /**
+     * Same idea as the graphics sets: the dynamic transforms point at the start of their frame's region in the culling
+     * ring and the inputs are shared, the outputs each point at their own frame's regions.
+     */
+    void TriangleApp::create_culling_sets() {
+        culling_sets.resize(max_frames_per_flight);
+
+        VkDeviceSize object_count = config.object_count;
+        for (size_t i = 0; i < culling_sets.size(); i++) {
+            VkDeviceSize base = i * culling_layout.frame_size;
+
+            VkDescriptorBufferInfo buffer_infos[CULLING_BINDING_COUNT] = {
+                { culling_mesh_buffer, 0, VK_WHOLE_SIZE },
+                { culling_object_buffer, 0, VK_WHOLE_SIZE },
+                { culling_transform_buffer, 0, VK_WHOLE_SIZE },
+                { culling_ring->get_buffer(), culling_ring->get_frame_offset(static_cast<uint32_t>(i)),
+                    culling_ring->get_frame_size() },
+                { culling_output, base + culling_layout.commands, object_count * sizeof(VkDrawIndexedIndirectCommand) },
+                { culling_output, base + culling_layout.counts, 2 * sizeof(uint32_t) },
+                { culling_output, base + culling_layout.instances, object_count * sizeof(InstanceData) },
+            };
+
+            culling_sets[i] = descriptor_allocator->allocate(culling_set_layout);
+            culling_template->update(culling_sets[i], buffer_infos);
+        }
     }
 }
@@ -0,0 +1,82 @@
+#include "../include/UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    /**
+     * Every offset we hand out has to be a multiple of minUniformBufferOffsetAlignment, so the frame size gets rounded
+     * up to it as well, otherwise the frame regions themselves would start misaligned.
+     */
+    UniformRing::UniformRing(VkDevice device, DeviceAllocator* allocator, VkDeviceSize min_alignment,
+        uint32_t frame_count, VkDeviceSize frame_size, VkBufferUsageFlags usage) : device(device), allocator(allocator),
+        alignment(std::max<VkDeviceSize>(min_alignment, 1)), frame_count(frame_count) {
+
+        this->frame_size = (frame_size + alignment - 1) / alignment * alignment;
+
+        VkBufferCreateInfo buffer_info = {};
+        buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size               = this->frame_size * frame_count;
+        buffer_info.usage              = usage;
+        buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create uniform ring buffer!");
+        }
+
+        VkMemoryRequirements mem_requirements;
+        vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
+
+        allocation = allocator->allocate(mem_requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ResourceKind::Linear);
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    }
+
+    UniformRing::~UniformRing() {
+        vkDestroyBuffer(device, buffer, nullptr);
+        allocator->free(allocation);
+    }
+
+    void UniformRing::begin_frame(uint32_t frame) {
+        current_frame = frame % frame_count;
+        head          = 0;
+    }
+
+    uint32_t UniformRing::push(const void* data, VkDeviceSize size) {
+        VkDeviceSize offset = head;
+        if (offset + size > frame_size) {
+            throw std::runtime_error("Uniform ring frame is full!");
+        }
+
+        memcpy(static_cast<char*>(allocation.mapped) + get_frame_offset(current_frame) + offset, data, (size_t)size);
+
+        head       = offset + get_stride(size);
+        peak_usage = std::max(peak_usage, head);
+        push_count++;
+
+        return static_cast<uint32_t>(offset);
+    }
+
+    uint32_t UniformRing::reserve(VkDeviceSize size, uint32_t count, char*& mapped) {
+        VkDeviceSize offset = head;
+        VkDeviceSize total  = get_stride(size) * count;
+        if (offset + total > frame_size) {
+            throw std::runtime_error("Uniform ring frame is full!");
+        }
+
+        mapped = static_cast<char*>(allocation.mapped) + get_frame_offset(current_frame) + offset;
+
+        head       = offset + total;
+        peak_usage = std::max(peak_usage, head);
+        push_count += count;
+
+        return static_cast<uint32_t>(offset);
+    }
+
+    void UniformRing::print_stats(std::ostream& out) const {
+        out << "Uniforms: " << push_count << " pushes, peak " << peak_usage << "/" << frame_size <<
+            " bytes per frame" << std::endl;
+    }
+}
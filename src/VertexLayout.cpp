@@ -0,0 +1,290 @@
+#include "../include/VertexLayout.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vulkan_rendering {
+
+    VkFormat get_vk_format(AttributeFormat format) {
+        switch (format) {
+            case AttributeFormat::Float32x2: return VK_FORMAT_R32G32_SFLOAT;
+            case AttributeFormat::Float32x3: return VK_FORMAT_R32G32B32_SFLOAT;
+            case AttributeFormat::Float32x4: return VK_FORMAT_R32G32B32A32_SFLOAT;
+            case AttributeFormat::Float16x2: return VK_FORMAT_R16G16_SFLOAT;
+            case AttributeFormat::Float16x4: return VK_FORMAT_R16G16B16A16_SFLOAT;
+            case AttributeFormat::Snorm16x2: return VK_FORMAT_R16G16_SNORM;
+            case AttributeFormat::Snorm16x4: return VK_FORMAT_R16G16B16A16_SNORM;
+            case AttributeFormat::Octahedral16: return VK_FORMAT_R16G16_SNORM;
+            case AttributeFormat::Unorm8x4: return VK_FORMAT_R8G8B8A8_UNORM;
+            case AttributeFormat::Unorm10x3_2: return VK_FORMAT_A2B10G10R10_UNORM_PACK32;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    /**
+     * Rounds to nearest even like the hardware does. Values past the half range become infinity and anything below
+     * the smallest subnormal becomes zero.
+     */
+    uint16_t float_to_half(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign     = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xff;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        if (exponent == 0xff) {
+            return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+        }
+
+        int32_t half_exponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if (half_exponent >= 31) {
+            return static_cast<uint16_t>(sign | 0x7c00);
+        }
+
+        if (half_exponent <= 0) {
+            if (half_exponent < -10) {
+                return static_cast<uint16_t>(sign);
+            }
+
+            mantissa |= 0x800000;
+            uint32_t shift         = static_cast<uint32_t>(14 - half_exponent);
+            uint32_t half_mantissa = mantissa >> shift;
+            uint32_t remainder     = mantissa & ((1u << shift) - 1);
+            uint32_t halfway       = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half_mantissa & 1) != 0)) {
+                half_mantissa++;
+            }
+            return static_cast<uint16_t>(sign | half_mantissa);
+        }
+
+        // A carry out of the mantissa bumps the exponent, which is exactly what rounding up should do.
+        uint32_t half      = sign | (static_cast<uint32_t>(half_exponent) << 10) | (mantissa >> 13);
+        uint32_t remainder = mantissa & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0)) {
+            half++;
+        }
+        return static_cast<uint16_t>(half);
+    }
+
+    float half_to_float(uint16_t value) {
+        uint32_t sign     = static_cast<uint32_t>(value & 0x8000) << 16;
+        uint32_t exponent = (value >> 10) & 0x1f;
+        uint32_t mantissa = value & 0x3ff;
+
+        if (exponent == 0) {
+            float magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+            return sign != 0 ? -magnitude : magnitude;
+        }
+
+        uint32_t bits = exponent == 31 ? sign | 0x7f800000 | (mantissa << 13) :
+            sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+        float result;
+        memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    static int16_t to_snorm16(float value) {
+        return static_cast<int16_t>(std::round(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    static float from_snorm16(int16_t value) {
+        return std::max(value / 32767.0f, -1.0f);
+    }
+
+    static uint32_t to_unorm(float value, uint32_t max) {
+        return static_cast<uint32_t>(std::round(std::min(std::max(value, 0.0f), 1.0f) * max));
+    }
+
+    /**
+     * Projects the unit vector onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the upper one, so
+     * it fits in two values in [-1, 1] with close to uniform precision in every direction.
+     */
+    static void encode_octahedral(const float* normal, float* encoded) {
+        float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+        float x      = length > 0.0f ? normal[0] / length : 0.0f;
+        float y      = length > 0.0f ? normal[1] / length : 0.0f;
+
+        if (length > 0.0f && normal[2] < 0.0f) {
+            float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+            float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+            x              = folded_x;
+            y              = folded_y;
+        }
+        encoded[0] = x;
+        encoded[1] = y;
+    }
+
+    static void decode_octahedral(const float* encoded, float* normal) {
+        float x = encoded[0];
+        float y = encoded[1];
+        float z = 1.0f - std::abs(x) - std::abs(y);
+        float t = std::max(-z, 0.0f);
+        x += x >= 0.0f ? -t : t;
+        y += y >= 0.0f ? -t : t;
+
+        float length = std::sqrt(x * x + y * y + z * z);
+        normal[0]    = x / length;
+        normal[1]    = y / length;
+        normal[2]    = z / length;
+    }
+
+    void encode_attribute(AttributeFormat format, const float* values, uint32_t component_count, uint8_t* out) {
+        float padded[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        std::copy(values, values + std::min(component_count, 4u), padded);
+
+        switch (format) {
+            case AttributeFormat::Float32x2:
+            case AttributeFormat::Float32x3:
+            case AttributeFormat::Float32x4:
+                memcpy(out, padded, get_format_size(format));
+                break;
+            case AttributeFormat::Float16x2:
+            case AttributeFormat::Float16x4: {
+                uint16_t halves[4];
+                for (uint32_t i = 0; i < 4; i++) {
+                    halves[i] = float_to_half(padded[i]);
+                }
+                memcpy(out, halves, get_format_size(format));
+                break;
+            }
+            case AttributeFormat::Snorm16x2:
+            case AttributeFormat::Snorm16x4:
+            case AttributeFormat::Octahedral16: {
+                if (format == AttributeFormat::Octahedral16) {
+                    encode_octahedral(values, padded);
+                }
+
+                int16_t snorms[4];
+                for (uint32_t i = 0; i < 4; i++) {
+                    snorms[i] = to_snorm16(padded[i]);
+                }
+                memcpy(out, snorms, get_format_size(format));
+                break;
+            }
+            case AttributeFormat::Unorm8x4: {
+                for (uint32_t i = 0; i < 4; i++) {
+                    out[i] = static_cast<uint8_t>(to_unorm(padded[i], 255));
+                }
+                break;
+            }
+            case AttributeFormat::Unorm10x3_2: {
+                // A2B10G10R10: x in the lowest 10 bits, the 2 bit w on top.
+                uint32_t packed = to_unorm(padded[0], 1023) | (to_unorm(padded[1], 1023) << 10) |
+                    (to_unorm(padded[2], 1023) << 20) | (to_unorm(padded[3], 3) << 30);
+                memcpy(out, &packed, sizeof(packed));
+                break;
+            }
+        }
+    }
+
+    void decode_attribute(AttributeFormat format, const uint8_t* in, float* values) {
+        values[0] = 0.0f;
+        values[1] = 0.0f;
+        values[2] = 0.0f;
+        values[3] = 1.0f;
+
+        switch (format) {
+            case AttributeFormat::Float32x2:
+            case AttributeFormat::Float32x3:
+            case AttributeFormat::Float32x4:
+                memcpy(values, in, get_format_size(format));
+                break;
+            case AttributeFormat::Float16x2:
+            case AttributeFormat::Float16x4: {
+                uint16_t halves[4];
+                memcpy(halves, in, get_format_size(format));
+                for (uint32_t i = 0; i < get_format_size(format) / sizeof(uint16_t); i++) {
+                    values[i] = half_to_float(halves[i]);
+                }
+                break;
+            }
+            case AttributeFormat::Snorm16x2:
+            case AttributeFormat::Snorm16x4:
+            case AttributeFormat::Octahedral16: {
+                int16_t snorms[4];
+                memcpy(snorms, in, get_format_size(format));
+                for (uint32_t i = 0; i < get_format_size(format) / sizeof(int16_t); i++) {
+                    values[i] = from_snorm16(snorms[i]);
+                }
+
+                if (format == AttributeFormat::Octahedral16) {
+                    float encoded[2] = { values[0], values[1] };
+                    decode_octahedral(encoded, values);
+                }
+                break;
+            }
+            case AttributeFormat::Unorm8x4:
+                for (uint32_t i = 0; i < 4; i++) {
+                    values[i] = in[i] / 255.0f;
+                }
+                break;
+            case AttributeFormat::Unorm10x3_2: {
+                uint32_t packed;
+                memcpy(&packed, in, sizeof(packed));
+                values[0] = (packed & 0x3ff) / 1023.0f;
+                values[1] = ((packed >> 10) & 0x3ff) / 1023.0f;
+                values[2] = ((packed >> 20) & 0x3ff) / 1023.0f;
+                values[3] = (packed >> 30) / 3.0f;
+                break;
+            }
+        }
+    }
+
+    uint32_t VertexFormat::get_stride() const {
+        uint32_t stride = 0;
+        for (const auto& stream : streams) {
+            stride += stream.stride;
+        }
+        return stride;
+    }
+
+    VertexInput VertexFormat::get_vertex_input(uint32_t stream_mask) const {
+        VertexInput input;
+        for (uint32_t i = 0; i < streams.size(); i++) {
+            if ((stream_mask & (1u << i)) != 0) {
+                input.bindings.push_back(streams[i].binding);
+                input.attributes.insert(input.attributes.end(), streams[i].attributes.begin(),
+                    streams[i].attributes.end());
+            }
+        }
+        return input;
+    }
+
+    QuantizationError VertexFormat::measure_error(const Vertex* vertices, uint32_t count) const {
+        QuantizationError error;
+        std::vector<uint8_t> encoded(get_stride());
+
+        for (uint32_t i = 0; i < count; i++) {
+            // Each stream only writes its own members, so decoding all of them fills in the whole vertex.
+            Vertex decoded;
+            for (const auto& stream : streams) {
+                stream.encode(&vertices[i], 1, encoded.data());
+                stream.decode(encoded.data(), 1, &decoded);
+            }
+
+            for (int32_t c = 0; c < 3; c++) {
+                error.position = std::max(error.position, std::abs(decoded.pos[c] - vertices[i].pos[c]));
+                error.colour   = std::max(error.colour, std::abs(decoded.colour[c] - vertices[i].colour[c]));
+            }
+        }
+        return error;
+    }
+
+    const VertexFormat& get_vertex_format(const std::string& name) {
+        static const std::vector<VertexFormat> formats = {
+            make_vertex_format<FloatPositionLayout, FloatColourLayout>("float"),
+            make_vertex_format<CompactPositionLayout, CompactColourLayout>("compact"),
+            make_vertex_format<FloatVertexLayout>("interleaved")
+        };
+
+        for (const auto& format : formats) {
+            if (name == format.name) {
+                return format;
+            }
+        }
+        throw std::runtime_error("Unknown vertex format! " + name);
+    }
+}
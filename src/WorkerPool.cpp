@@ -0,0 +1,105 @@
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+
+namespace vulkan_rendering {
+
+    WorkerPool::WorkerPool(uint32_t worker_count) {
+        if (worker_count == 0) {
+            worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        for (uint32_t i = 1; i < worker_count; i++) {
+            threads.emplace_back(&WorkerPool::run, this, i);
+        }
+    }
+
+    WorkerPool::~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_condition.notify_all();
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void WorkerPool::parallel_for(uint32_t count, const RangeTask& task) {
+        if (threads.empty()) {
+            task(0, 0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->task  = &task;
+            this->count = count;
+            pending     = static_cast<uint32_t>(threads.size());
+            error       = nullptr;
+            generation++;
+        }
+        start_condition.notify_all();
+
+        // The calling thread takes the first range instead of sitting idle.
+        try {
+            execute(0);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_condition.wait(lock, [this]() { return pending == 0; });
+        this->task = nullptr;
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void WorkerPool::execute(uint32_t worker) {
+        uint32_t worker_count = get_worker_count();
+        uint32_t begin        = static_cast<uint32_t>(static_cast<uint64_t>(count) * worker / worker_count);
+        uint32_t end          = static_cast<uint32_t>(static_cast<uint64_t>(count) * (worker + 1) / worker_count);
+
+        (*task)(worker, begin, end);
+    }
+
+    void WorkerPool::run(uint32_t worker) {
+        uint64_t seen_generation = 0;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_condition.wait(lock, [this, seen_generation]() {
+                    return stopping || generation != seen_generation;
+                });
+
+                if (stopping) {
+                    return;
+                }
+                seen_generation = generation;
+            }
+
+            std::exception_ptr task_error;
+            try {
+                execute(worker);
+            } catch (...) {
+                task_error = std::current_exception();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (task_error && !error) {
+                    error = task_error;
+                }
+                pending--;
+            }
+            done_condition.notify_one();
+        }
+    }
+}
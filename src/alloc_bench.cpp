@@ -0,0 +1,538 @@
+#include "../include/DeviceAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using vulkan_rendering::AllocatorStats;
+using vulkan_rendering::DeviceAllocator;
+using vulkan_rendering::ResourceKind;
+
+/**
+ * Drives DeviceAllocator against fake device memory, needs neither a GPU nor a device. Every allocation gets checked:
+ * it lies inside its VkDeviceMemory, is aligned, doesn't overlap another live one, comes from a memory type the request
+ * allows, is mapped where its memory is host visible and, unless bufferImageGranularity is 1, never shares memory with
+ * the other kind of resource. On top of that requests larger than half a block get memory of their own, freed ranges
+ * merge back together and the stats add up. Then --iterations rounds of --allocations random allocations and frees get
+ * timed.
+ */
+struct AllocBenchOptions {
+    uint32_t allocations = 10000;
+    uint32_t warmup      = 2;
+    uint32_t iterations  = 20;
+};
+
+template <typename Handle>
+static Handle make_handle(uint64_t id) {
+    return reinterpret_cast<Handle>(static_cast<uintptr_t>(id));
+}
+
+/**
+ * A discrete card: 1GB of device local memory, 256MB of host memory and the 256MB device local window the host can
+ * write to. Blocks in the small heaps get capped to an eighth of the heap.
+ */
+static VkPhysicalDeviceMemoryProperties make_memory_properties() {
+    const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+    VkPhysicalDeviceMemoryProperties properties = {};
+    properties.memoryHeapCount                  = 3;
+    properties.memoryHeaps[0].size              = 1024ull * 1024 * 1024;
+    properties.memoryHeaps[1].size              = 256ull * 1024 * 1024;
+    properties.memoryHeaps[2].size              = 256ull * 1024 * 1024;
+
+    properties.memoryTypeCount            = 3;
+    properties.memoryTypes[0]             = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0 };
+    properties.memoryTypes[1]             = { host, 1 };
+    properties.memoryTypes[2]             = { VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | host, 2 };
+    return properties;
+}
+
+/**
+ * Hands out fake VkDeviceMemory and keeps to the heap sizes, so running out of memory can be checked too. Mapped
+ * memory gets a fake address nothing ever writes through, far enough from the next one that ranges never meet.
+ */
+class MockMemory : public vulkan_rendering::DeviceMemoryBackend {
+
+    public:
+        struct Memory {
+            uint32_t memory_type;
+            VkDeviceSize size;
+            bool mapped;
+        };
+
+        bool failed = false;
+
+        explicit MockMemory(const VkPhysicalDeviceMemoryProperties& properties) : properties(properties) {}
+
+        VkResult allocate(uint32_t memory_type, VkDeviceSize size, VkDeviceMemory& memory) override {
+            check(memory_type < properties.memoryTypeCount, "memory allocated from a type that doesn't exist");
+            check(size > 0, "empty memory allocated");
+
+            uint32_t heap = properties.memoryTypes[memory_type].heapIndex;
+            if (heap_used[heap] + size > properties.memoryHeaps[heap].size) {
+                return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+            }
+
+            heap_used[heap]  += size;
+            memory            = make_handle<VkDeviceMemory>(next_handle++);
+            memories[memory]  = { memory_type, size, false };
+            return VK_SUCCESS;
+        }
+
+        void free(VkDeviceMemory memory) override {
+            auto found = memories.find(memory);
+            check(found != memories.end(), "memory freed twice or never allocated");
+            if (found != memories.end()) {
+                check(!found->second.mapped, "memory freed while still mapped");
+                heap_used[properties.memoryTypes[found->second.memory_type].heapIndex] -= found->second.size;
+                memories.erase(found);
+            }
+        }
+
+        void* map(VkDeviceMemory memory) override {
+            Memory& mapped = memories.at(memory);
+            check(!mapped.mapped, "memory mapped twice");
+            check(properties.memoryTypes[mapped.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                "memory that isn't host visible mapped");
+            mapped.mapped = true;
+            return get_address(memory);
+        }
+
+        void unmap(VkDeviceMemory memory) override {
+            Memory& mapped = memories.at(memory);
+            check(mapped.mapped, "memory unmapped without being mapped");
+            mapped.mapped = false;
+        }
+
+        // Where map() puts the memory, 1TB apart.
+        static void* get_address(VkDeviceMemory memory) {
+            return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(memory) << 40);
+        }
+
+        const std::map<VkDeviceMemory, Memory>& get_memories() const { return memories; }
+
+        VkDeviceSize get_heap_used(uint32_t heap) const {
+            auto found = heap_used.find(heap);
+            return found != heap_used.end() ? found->second : 0;
+        }
+
+        void check(bool condition, const std::string& message) {
+            if (!condition && !failed) {
+                std::cerr << "Allocator check failed: " << message << std::endl;
+                failed = true;
+            }
+        }
+
+    private:
+        VkPhysicalDeviceMemoryProperties properties;
+        uint64_t next_handle = 1;
+        std::map<VkDeviceMemory, Memory> memories;
+        std::map<uint32_t, VkDeviceSize> heap_used;
+};
+
+struct LiveAllocation {
+    vulkan_rendering::Allocation allocation;
+    VkMemoryRequirements requirements;
+    VkMemoryPropertyFlags props;
+    ResourceKind kind;
+};
+
+/**
+ * Keeps every allocation the allocator handed out and checks each new one against the memory it came from and the
+ * ones still alive.
+ */
+class AllocationChecker {
+
+    public:
+        AllocationChecker(DeviceAllocator& allocator, MockMemory& memory, VkDeviceSize buffer_image_granularity) :
+            allocator(allocator), memory(memory), buffer_image_granularity(buffer_image_granularity) {}
+
+        const LiveAllocation& allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags props,
+            ResourceKind kind) {
+            LiveAllocation added = { allocator.allocate(requirements, props, kind), requirements, props, kind };
+            allocations++;
+            check(added);
+            live.push_back(added);
+            return live.back();
+        }
+
+        void free(size_t index) {
+            allocator.free(live[index].allocation);
+            memory.check(live[index].allocation.memory == VK_NULL_HANDLE, "allocation not reset by free");
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        void free_all() {
+            while (!live.empty()) {
+                free(live.size() - 1);
+            }
+        }
+
+        const std::vector<LiveAllocation>& get_live() const { return live; }
+
+        /**
+         * Every heap's stats against what's alive: allocations and the bytes they were given, the memory the backend
+         * handed out and, as nothing can be larger than a block, the largest free range.
+         */
+        void check_stats(const std::string& when) {
+            const VkPhysicalDeviceMemoryProperties& properties = allocator.get_memory_properties();
+            AllocatorStats stats = allocator.get_stats();
+
+            memory.check(stats.heaps.size() == properties.memoryHeapCount, when + ": stats for the wrong heap count");
+            memory.check(stats.device_allocation_count == memory.get_memories().size(),
+                when + ": device allocation count doesn't match the live memory");
+            memory.check(stats.total_allocations == allocations, when + ": total allocations don't add up");
+
+            for (uint32_t heap = 0; heap < stats.heaps.size() && !memory.failed; heap++) {
+                uint32_t count    = 0;
+                VkDeviceSize used = 0;
+                for (const LiveAllocation& allocation : live) {
+                    if (properties.memoryTypes[allocation.allocation.memory_type].heapIndex == heap) {
+                        count++;
+                        used += allocation.allocation.size;
+                    }
+                }
+
+                const vulkan_rendering::HeapStats& stats_heap = stats.heaps[heap];
+                std::string name = when + ": heap " + std::to_string(heap);
+                memory.check(stats_heap.allocation_count == count, name + " allocation count doesn't match");
+                memory.check(stats_heap.used == used, name + " used bytes don't match");
+                memory.check(stats_heap.reserved == memory.get_heap_used(heap), name + " reserved bytes don't match");
+                memory.check(stats_heap.largest_free <= stats_heap.reserved - stats_heap.used,
+                    name + " largest free range larger than the free bytes");
+                memory.check(stats_heap.fragmentation() >= 0.0f && stats_heap.fragmentation() <= 1.0f,
+                    name + " fragmentation out of range");
+            }
+        }
+
+    private:
+        DeviceAllocator& allocator;
+        MockMemory& memory;
+        VkDeviceSize buffer_image_granularity;
+        std::vector<LiveAllocation> live;
+        uint64_t allocations = 0;
+
+        void check(const LiveAllocation& checked) {
+            const vulkan_rendering::Allocation& allocation = checked.allocation;
+            const VkPhysicalDeviceMemoryProperties& properties = allocator.get_memory_properties();
+
+            auto found = memory.get_memories().find(allocation.memory);
+            if (found == memory.get_memories().end()) {
+                memory.check(false, "allocation in memory the backend never handed out");
+                return;
+            }
+
+            const MockMemory::Memory& from = found->second;
+            VkDeviceSize alignment         = std::max<VkDeviceSize>(checked.requirements.alignment, 1);
+            VkMemoryPropertyFlags flags    = properties.memoryTypes[from.memory_type].propertyFlags;
+            memory.check(allocation.memory_type == from.memory_type, "allocation reports the wrong memory type");
+            memory.check(checked.requirements.memoryTypeBits & (1u << from.memory_type),
+                "allocation from a memory type the request doesn't allow");
+            memory.check((flags & checked.props) == checked.props, "allocation without the properties asked for");
+            memory.check(allocation.offset % alignment == 0, "allocation isn't aligned");
+            memory.check(allocation.size >= checked.requirements.size, "allocation smaller than asked for");
+            memory.check(allocation.offset + allocation.size <= from.size, "allocation outside its memory");
+
+            if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                memory.check(allocation.mapped == static_cast<char*>(MockMemory::get_address(allocation.memory)) +
+                    allocation.offset, "host visible allocation not mapped at its offset");
+            } else {
+                memory.check(allocation.mapped == nullptr, "allocation mapped without being host visible");
+            }
+
+            for (const LiveAllocation& other : live) {
+                if (other.allocation.memory != allocation.memory) {
+                    continue;
+                }
+                memory.check(allocation.offset >= other.allocation.offset + other.allocation.size ||
+                    other.allocation.offset >= allocation.offset + allocation.size, "allocations overlap");
+                memory.check(buffer_image_granularity == 1 || other.kind == checked.kind,
+                    "linear and optimal resources share memory");
+            }
+        }
+};
+
+static VkMemoryRequirements make_requirements(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_bits) {
+    VkMemoryRequirements requirements = {};
+    requirements.size                 = size;
+    requirements.alignment            = alignment;
+    requirements.memoryTypeBits       = memory_type_bits;
+    return requirements;
+}
+
+/**
+ * What the app asks for: mostly small vertex, index and uniform buffers, some textures, now and then a large buffer or
+ * render target. Alignments are powers of two from 1 to 64KB.
+ */
+static void random_request(std::mt19937& random, VkMemoryRequirements& requirements, VkMemoryPropertyFlags& props,
+    ResourceKind& kind) {
+    std::uniform_int_distribution<uint32_t> percent(0, 99);
+    std::uniform_int_distribution<uint32_t> alignment_log2(0, 16);
+
+    uint32_t size_class = percent(random);
+    VkDeviceSize size   = size_class < 70 ? std::uniform_int_distribution<VkDeviceSize>(1, 64 * 1024)(random) :
+        size_class < 98 ? std::uniform_int_distribution<VkDeviceSize>(64 * 1024, 2 * 1024 * 1024)(random) :
+        std::uniform_int_distribution<VkDeviceSize>(16 * 1024 * 1024, 48 * 1024 * 1024)(random);
+
+    requirements = make_requirements(size, 1ull << alignment_log2(random), percent(random) < 90 ? 0x7 : 0x5);
+    props        = percent(random) < 25 ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT :
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    kind         = percent(random) < 30 ? ResourceKind::Optimal : ResourceKind::Linear;
+}
+
+/**
+ * Random allocations and frees, with the stats checked along the way. Both granularities get a run, with 1 the two
+ * kinds of resources should end up sharing memory.
+ */
+static bool check_random(VkDeviceSize buffer_image_granularity) {
+    VkPhysicalDeviceMemoryProperties properties = make_memory_properties();
+    MockMemory memory(properties);
+    std::string name = "random (granularity " + std::to_string(buffer_image_granularity) + ")";
+
+    {
+        DeviceAllocator allocator(&memory, properties, buffer_image_granularity);
+        AllocationChecker checker(allocator, memory, buffer_image_granularity);
+        std::mt19937 random(1234);
+        std::uniform_int_distribution<uint32_t> percent(0, 99);
+
+        for (uint32_t i = 0; i < 5000 && !memory.failed; i++) {
+            if (checker.get_live().size() >= 400 || (!checker.get_live().empty() && percent(random) < 40)) {
+                checker.free(std::uniform_int_distribution<size_t>(0, checker.get_live().size() - 1)(random));
+            } else {
+                VkMemoryRequirements requirements;
+                VkMemoryPropertyFlags props;
+                ResourceKind kind;
+                random_request(random, requirements, props, kind);
+                checker.allocate(requirements, props, kind);
+            }
+
+            if (i % 500 == 0) {
+                checker.check_stats(name + " after " + std::to_string(i) + " steps");
+            }
+        }
+
+        bool mixed = false;
+        for (const LiveAllocation& a : checker.get_live()) {
+            for (const LiveAllocation& b : checker.get_live()) {
+                mixed = mixed || (a.allocation.memory == b.allocation.memory && a.kind != b.kind);
+            }
+        }
+        memory.check(buffer_image_granularity > 1 || mixed,
+            name + ": linear and optimal resources never share memory even though they could");
+
+        checker.free_all();
+        checker.check_stats(name + " after freeing everything");
+    }
+
+    memory.check(memory.get_memories().empty(), name + ": memory left over after the allocator is gone");
+    return !memory.failed;
+}
+
+/**
+ * Requests larger than half a block get memory of exactly their size at offset 0, whatever their alignment, and give
+ * it back as soon as they're freed. When the heap is out of memory they go to the next memory type that fits.
+ */
+static bool check_dedicated() {
+    VkPhysicalDeviceMemoryProperties properties = make_memory_properties();
+    MockMemory memory(properties);
+
+    {
+        const VkDeviceSize megabyte = 1024 * 1024;
+        const VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        DeviceAllocator allocator(&memory, properties, 1024);
+        AllocationChecker checker(allocator, memory, 1024);
+
+        // A 4K HDR render target, a large buffer in a 32MB block heap, a whole block and an odd size.
+        checker.allocate(make_requirements(3840 * 2160 * 8, 64 * 1024, 0x7), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            ResourceKind::Optimal);
+        checker.allocate(make_requirements(20 * megabyte, 256, 0x7), host, ResourceKind::Linear);
+        checker.allocate(make_requirements(DeviceAllocator::DEFAULT_BLOCK_SIZE, 4096, 0x7),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ResourceKind::Linear);
+        checker.allocate(make_requirements(40 * megabyte + 3, 1, 0x7), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            ResourceKind::Linear);
+
+        for (const LiveAllocation& live : checker.get_live()) {
+            const MockMemory::Memory& from = memory.get_memories().at(live.allocation.memory);
+            memory.check(live.allocation.offset == 0, "dedicated allocation not at offset 0");
+            memory.check(from.size == live.requirements.size, "dedicated memory isn't the size of its allocation");
+        }
+        memory.check(memory.get_memories().size() == checker.get_live().size(),
+            "dedicated allocations share memory");
+        checker.check_stats("dedicated");
+
+        checker.free(0);
+        memory.check(memory.get_memories().size() == checker.get_live().size(),
+            "dedicated memory kept after its allocation was freed");
+        checker.free_all();
+
+        // Host memory only has room for one of these, the second goes to the device local window.
+        checker.allocate(make_requirements(200 * megabyte, 256, 0x6), host, ResourceKind::Linear);
+        checker.allocate(make_requirements(200 * megabyte, 256, 0x6), host, ResourceKind::Linear);
+        memory.check(checker.get_live()[1].allocation.memory_type == 2,
+            "dedicated allocation didn't fall back to the next memory type");
+
+        bool threw = false;
+        try {
+            allocator.allocate(make_requirements(200 * megabyte, 256, 0x6), host, ResourceKind::Linear);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        memory.check(threw, "allocation larger than what's left of the heap didn't throw");
+        checker.check_stats("dedicated out of memory");
+        checker.free_all();
+    }
+
+    memory.check(memory.get_memories().empty(), "dedicated: memory left over after the allocator is gone");
+    return !memory.failed;
+}
+
+/**
+ * Fills a block with equal ranges and frees every other one: the free bytes are half the block but scattered, so
+ * nothing larger than one range fits. Once the rest are freed they have to merge back into the whole block, and a
+ * request of half a block goes in there instead of new memory. Only one empty block per memory type is kept around.
+ */
+static bool check_merge() {
+    VkPhysicalDeviceMemoryProperties properties = make_memory_properties();
+    MockMemory memory(properties);
+
+    {
+        const VkDeviceSize block = DeviceAllocator::DEFAULT_BLOCK_SIZE;
+        const VkDeviceSize range = block / 16;
+        DeviceAllocator allocator(&memory, properties, 1);
+        AllocationChecker checker(allocator, memory, 1);
+
+        // Anything aligned pads the search, so only alignment 1 fills a block to the last byte.
+        for (uint32_t i = 0; i < 16; i++) {
+            checker.allocate(make_requirements(range, 1, 0x1), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                ResourceKind::Linear);
+        }
+        memory.check(memory.get_memories().size() == 1, "a block's worth of ranges didn't fit in one block");
+
+        // Free the odd offsets, the live ones are kept in allocation order.
+        std::vector<LiveAllocation> live = checker.get_live();
+        for (size_t i = live.size(); i-- > 0;) {
+            if ((live[i].allocation.offset / range) % 2 == 1) {
+                checker.free(i);
+            }
+        }
+        AllocatorStats stats = allocator.get_stats();
+        memory.check(stats.heaps[0].largest_free == range, "free ranges that aren't next to each other merged");
+        memory.check(stats.heaps[0].fragmentation() > 0.4f, "scattered free ranges don't count as fragmented");
+        checker.check_stats("merge half freed");
+
+        checker.free_all();
+        stats = allocator.get_stats();
+        memory.check(stats.heaps[0].largest_free == block, "freed ranges didn't merge back into the whole block");
+        memory.check(stats.heaps[0].fragmentation() == 0.0f, "an empty block counts as fragmented");
+        memory.check(memory.get_memories().size() == 1, "the last empty block was released");
+
+        for (uint32_t i = 0; i < 3; i++) {
+            checker.allocate(make_requirements(block / 2, 1, 0x1), VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                ResourceKind::Linear);
+        }
+        memory.check(memory.get_memories().size() == 2, "two halves didn't go in the empty block");
+        checker.free_all();
+        memory.check(memory.get_memories().size() == 1, "more than one empty block kept per memory type");
+        checker.check_stats("merge");
+    }
+
+    memory.check(memory.get_memories().empty(), "merge: memory left over after the allocator is gone");
+    return !memory.failed;
+}
+
+/**
+ * Rounds of --allocations random requests, freed again in random order. Requests and free orders are made up front
+ * so only the allocator gets timed.
+ */
+static void run_timing(const AllocBenchOptions& options) {
+    VkPhysicalDeviceMemoryProperties properties = make_memory_properties();
+    MockMemory memory(properties);
+    DeviceAllocator allocator(&memory, properties, 1024);
+
+    std::mt19937 random(5678);
+    std::vector<LiveAllocation> requests(options.allocations);
+    for (LiveAllocation& request : requests) {
+        random_request(random, request.requirements, request.props, request.kind);
+
+        // Only the small ones, the large ones would mostly time vkAllocateMemory.
+        request.requirements.size = std::min<VkDeviceSize>(request.requirements.size, 256 * 1024);
+    }
+    std::vector<uint32_t> free_order(options.allocations);
+    for (uint32_t i = 0; i < options.allocations; i++) {
+        free_order[i] = i;
+    }
+    std::shuffle(free_order.begin(), free_order.end(), random);
+
+    double allocate_milliseconds = 0.0;
+    double free_milliseconds     = 0.0;
+    for (uint32_t round = 0; round < options.warmup + options.iterations; round++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (LiveAllocation& request : requests) {
+            request.allocation = allocator.allocate(request.requirements, request.props, request.kind);
+        }
+        auto allocated = std::chrono::high_resolution_clock::now();
+        for (uint32_t i : free_order) {
+            allocator.free(requests[i].allocation);
+        }
+        auto freed = std::chrono::high_resolution_clock::now();
+
+        if (round >= options.warmup) {
+            allocate_milliseconds += std::chrono::duration<double, std::milli>(allocated - start).count();
+            free_milliseconds     += std::chrono::duration<double, std::milli>(freed - allocated).count();
+        }
+    }
+
+    double count = static_cast<double>(options.allocations) * options.iterations;
+    std::cout << std::fixed << std::setprecision(1) << allocate_milliseconds * 1e6 / count << "ns per allocate, " <<
+        free_milliseconds * 1e6 / count << "ns per free, " << options.allocations << " allocations per round" <<
+        std::endl;
+
+    for (LiveAllocation& request : requests) {
+        request.allocation = allocator.allocate(request.requirements, request.props, request.kind);
+    }
+    allocator.print_stats(std::cout);
+}
+
+int main(int argc, char** argv) {
+    AllocBenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--allocations") == 0 && i + 1 < argc) {
+            options.allocations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--allocations N] [--warmup N] [--iterations N]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.allocations == 0 || options.iterations == 0) {
+        std::cerr << "Need at least one allocation and one iteration." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Running out of memory where there's room left throws, which counts as a failed check too.
+    try {
+        if (!check_random(1024) || !check_random(1) || !check_dedicated() || !check_merge()) {
+            return EXIT_FAILURE;
+        }
+    } catch (const std::runtime_error& error) {
+        std::cerr << "Allocator check failed: " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "All allocator checks passed" << std::endl;
+
+    run_timing(options);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include "../include/Profiler.h"
+#include "../include/TriangleApp.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Renders a procedural scene headless for a fixed number of frames and writes the frame time percentiles as JSON. Each
+ * of the meshes is drawn instances times, so the draw count is meshes * instances. The same arguments always build the
+ * same scene, so runs from different builds can be compared.
+ */
+struct BenchOptions {
+    uint32_t mesh_count         = 16;
+    uint32_t instance_count     = 64;
+    uint32_t triangles_per_mesh = 512;
+    uint32_t warmup_frames      = 60;
+    uint32_t measured_frames    = 600;
+    std::string output_path     = "bench.json";
+};
+
+static std::vector<double> drop_front(const std::vector<double>& values, size_t count) {
+    return std::vector<double>(values.begin() + std::min(count, values.size()), values.end());
+}
+
+static std::string escape_json(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+static void write_summary(std::ostream& out, const vulkan_rendering::TimeSummary& summary) {
+    out << "{\"count\": " << summary.count << ", \"mean\": " << summary.mean << ", \"p50\": " << summary.p50 <<
+        ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max << "}";
+}
+
+/**
+ * Throughput at the p50/p95/p99 frame time, so p99 is the slow end just like it is for the frame times.
+ */
+static void write_rate(std::ostream& out, double per_frame, const vulkan_rendering::TimeSummary& summary) {
+    auto rate = [per_frame](double milliseconds) {
+        return milliseconds > 0.0 ? per_frame * 1000.0 / milliseconds : 0.0;
+    };
+    out << "{\"p50\": " << rate(summary.p50) << ", \"p95\": " << rate(summary.p95) << ", \"p99\": " <<
+        rate(summary.p99) << "}";
+}
+
+int main(int argc, char** argv) {
+    vulkan_rendering::AppConfig config;
+    config.headless    = true;
+    config.profile     = true;
+    config.print_stats = false;
+    config.width       = 1280;
+    config.height      = 720;
+
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--meshes") == 0 && i + 1 < argc) {
+            options.mesh_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            options.instance_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc) {
+            options.triangles_per_mesh = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--uniform-updates") == 0 && i + 1 < argc) {
+            config.uniform_update_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.measured_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            config.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            config.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            config.worker_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            config.vertex_format = argv[++i];
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            config.depth_prepass = true;
+        } else if (strcmp(argv[i], "--instancing") == 0) {
+            config.instancing = true;
+        } else if (strcmp(argv[i], "--gpu-culling") == 0) {
+            config.gpu_culling = true;
+        } else if (strcmp(argv[i], "--cpu-culling") == 0) {
+            config.cpu_culling = true;
+        } else if (strcmp(argv[i], "--bvh-culling") == 0) {
+            config.bvh_culling = true;
+        } else if (strcmp(argv[i], "--per-draw-sets") == 0) {
+            config.per_draw_sets = true;
+        } else if (strcmp(argv[i], "--bindless") == 0) {
+            config.bindless = true;
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.output_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--meshes N] [--instances N] [--triangles N] " <<
+                "[--uniform-updates N] [--warmup N] [--frames N] [--width W] [--height H] [--workers N] " <<
+                "[--vertex-format float|compact|interleaved] [--depth-prepass] [--instancing] [--gpu-culling] " <<
+                "[--cpu-culling] [--bvh-culling] [--per-draw-sets] [--bindless] [--output PATH]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.mesh_count == 0 || options.instance_count == 0 || options.measured_frames < 2) {
+        std::cerr << "Need at least one mesh, one instance and two measured frames." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    config.mesh_count         = options.mesh_count;
+    config.triangles_per_mesh = options.triangles_per_mesh;
+    config.object_count       = options.mesh_count * options.instance_count;
+    config.frame_count        = options.warmup_frames + options.measured_frames;
+
+    config.uniform_update_count = std::min(config.uniform_update_count, config.object_count);
+
+    // Building the scene can throw as well, so the app is created inside the try.
+    std::unique_ptr<vulkan_rendering::TriangleApp> app;
+    try {
+        app = std::unique_ptr<vulkan_rendering::TriangleApp>(new vulkan_rendering::TriangleApp(config));
+        app->run();
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const vulkan_rendering::Profiler& profiler = app->get_profiler();
+
+    // A CPU frame time is the gap between two frame ends, so entry i belongs to frame i + 1. GPU times are per frame
+    // but the last frames in flight never get resolved.
+    size_t cpu_skip = options.warmup_frames > 0 ? options.warmup_frames - 1 : 0;
+    auto cpu_summary = vulkan_rendering::summarize(drop_front(profiler.get_cpu_frame_times(), cpu_skip));
+    auto gpu_summary = vulkan_rendering::summarize(drop_front(profiler.get_gpu_frame_times(), options.warmup_frames));
+
+    std::ofstream file(options.output_path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << options.output_path << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n";
+    file << "  \"device\": \"" << escape_json(app->get_device_name()) << "\",\n";
+    file << "  \"config\": {\"meshes\": " << options.mesh_count << ", \"instances\": " << options.instance_count <<
+        ", \"triangles_per_mesh\": " << options.triangles_per_mesh << ", \"uniform_updates\": " <<
+        config.uniform_update_count << ", \"warmup_frames\": " << options.warmup_frames << ", \"frames\": " <<
+        options.measured_frames << ", \"width\": " << config.width << ", \"height\": " << config.height <<
+        ", \"workers\": " << config.worker_count << ", \"vertex_format\": \"" << escape_json(config.vertex_format) <<
+        "\", \"depth_prepass\": " << (config.depth_prepass ? "true" : "false") << ", \"instancing\": " <<
+        (config.instancing ? "true" : "false") << ", \"gpu_culling\": " << (config.gpu_culling ? "true" : "false") <<
+        ", \"cpu_culling\": " << (config.cpu_culling ? "true" : "false") <<
+        ", \"bvh_culling\": " << (config.bvh_culling ? "true" : "false") <<
+        ", \"per_draw_sets\": " << (config.per_draw_sets ? "true" : "false") <<
+        ", \"bindless\": " << (config.bindless ? "true" : "false") << "},\n";
+    file << "  \"draws_per_frame\": " << app->get_draws_per_frame() << ",\n";
+    file << "  \"triangles_per_frame\": " << app->get_triangles_per_frame() << ",\n";
+    if (app->get_culled_frames() > 0) {
+        file << "  \"visible_per_frame\": " << app->get_visible_per_frame() << ",\n";
+    }
+
+    file << "  \"cpu_frame_ms\": ";
+    write_summary(file, cpu_summary);
+    file << ",\n  \"gpu_frame_ms\": ";
+    if (gpu_summary.count > 0) {
+        write_summary(file, gpu_summary);
+    } else {
+        // Profiler compiled out or the queue has no timestamps.
+        file << "null";
+    }
+
+    file << ",\n  \"draws_per_second\": ";
+    write_rate(file, app->get_draws_per_frame(), cpu_summary);
+    file << ",\n  \"triangles_per_second\": ";
+    write_rate(file, static_cast<double>(app->get_triangles_per_frame()), cpu_summary);
+    file << "\n}" << std::endl;
+
+    std::cout << "Wrote " << options.output_path << ": " << std::fixed << std::setprecision(3) << cpu_summary.p50 <<
+        "ms p50, " << cpu_summary.p95 << "ms p95, " << cpu_summary.p99 << "ms p99 CPU frame time" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+#include "../include/Bvh.h"
+#include "../include/Frustum.h"
+#include "../include/FrustumCuller.h"
+#include "../include/WorkerPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Microbenchmark for FrustumCuller and Bvh, needs neither Vulkan nor a GPU. Scatters --objects boxes through a cube
+ * around a camera looking down its middle, then culls them --iterations times on one worker and on --workers workers.
+ * The BVH gets built, refit, culled against the same frustum and picked into with --rays rays. The same arguments
+ * always produce the same scene.
+ */
+struct CullBenchOptions {
+    uint32_t object_count = 1000000;
+    uint32_t worker_count = 0;
+    uint32_t warmup       = 10;
+    uint32_t iterations   = 100;
+    uint32_t ray_count    = 100000;
+    bool allow_simd       = true;
+};
+
+struct BenchScene {
+    std::vector<glm::vec3> min;
+    std::vector<glm::vec3> max;
+};
+
+static BenchScene make_scene(uint32_t object_count) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+
+    BenchScene scene;
+    for (uint32_t i = 0; i < object_count; i++) {
+        glm::vec3 centre(position(random), position(random), position(random));
+        glm::vec3 half(extent(random), extent(random), extent(random));
+        scene.min.push_back(centre - half);
+        scene.max.push_back(centre + half);
+    }
+    return scene;
+}
+
+static void fill_culler(vulkan_rendering::FrustumCuller& culler, const BenchScene& scene) {
+    culler.resize(static_cast<uint32_t>(scene.min.size()));
+    for (uint32_t i = 0; i < scene.min.size(); i++) {
+        glm::vec3 centre = (scene.min[i] + scene.max[i]) * 0.5f;
+        culler.set_bounds(i, glm::vec4(centre, glm::length(scene.max[i] - centre)), scene.min[i], scene.max[i]);
+    }
+}
+
+template <typename Function>
+static double time_milliseconds(uint32_t iterations, Function function) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        function();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() /
+        iterations;
+}
+
+/**
+ * Runs the culls and prints the mean time of one, plus how many objects every core got through per millisecond.
+ */
+static void run(vulkan_rendering::FrustumCuller& culler, const vulkan_rendering::Frustum& frustum,
+    uint32_t worker_count, const CullBenchOptions& options) {
+    vulkan_rendering::WorkerPool pool(worker_count);
+    std::vector<uint32_t> visible;
+
+    for (uint32_t i = 0; i < options.warmup; i++) {
+        culler.cull(frustum, pool, visible);
+    }
+
+    double milliseconds = time_milliseconds(options.iterations, [&]() {
+        culler.cull(frustum, pool, visible);
+    });
+
+    uint32_t workers = pool.get_worker_count();
+    std::cout << culler.get_simd_name() << ", " << workers << (workers == 1 ? " worker: " : " workers: ") <<
+        std::fixed << std::setprecision(3) << milliseconds << "ms per cull, " << std::setprecision(0) <<
+        options.object_count / milliseconds / workers << " objects per ms per core, " << std::setprecision(1) <<
+        100.0 * visible.size() / options.object_count << "% visible" << std::endl;
+}
+
+/**
+ * Brute force checks first, a BVH that's fast but wrong isn't worth timing. Refit moves every tenth object, a cull
+ * and a pick only use one core.
+ */
+static bool run_bvh(const BenchScene& scene, const vulkan_rendering::Frustum& frustum,
+    const CullBenchOptions& options) {
+    vulkan_rendering::Bvh bvh;
+    double build_milliseconds = time_milliseconds(1, [&]() {
+        bvh.build(scene.min, scene.max);
+    });
+
+    std::vector<uint32_t> visible;
+    std::vector<uint32_t> expected;
+    bvh.cull(frustum, visible);
+    for (uint32_t i = 0; i < scene.min.size(); i++) {
+        if (frustum.classify_box(scene.min[i], scene.max[i]) != vulkan_rendering::Frustum::OUTSIDE) {
+            expected.push_back(i);
+        }
+    }
+    std::sort(visible.begin(), visible.end());
+    if (visible != expected) {
+        std::cerr << "BVH and brute force culling disagree: " << visible.size() << " vs " << expected.size() <<
+            " visible" << std::endl;
+        return false;
+    }
+
+    std::mt19937 random(5678);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+    std::vector<glm::vec3> directions(options.ray_count);
+    for (glm::vec3& direction : directions) {
+        direction = glm::vec3(axis(random), axis(random), axis(random));
+    }
+
+    uint32_t checked = std::min(options.ray_count, 100u);
+    for (uint32_t ray = 0; ray < checked; ray++) {
+        float distance;
+        uint32_t hit = bvh.pick(glm::vec3(0.0f), directions[ray], 1000.0f, distance);
+
+        float expected_distance = 1000.0f;
+        for (uint32_t i = 0; i < scene.min.size(); i++) {
+            glm::vec3 t0    = (scene.min[i] - glm::vec3(0.0f)) / directions[ray];
+            glm::vec3 t1    = (scene.max[i] - glm::vec3(0.0f)) / directions[ray];
+            glm::vec3 enter = glm::min(t0, t1);
+            glm::vec3 exit  = glm::max(t0, t1);
+            float first     = std::max(std::max(enter.x, enter.y), std::max(enter.z, 0.0f));
+            float last      = std::min(std::min(exit.x, exit.y), exit.z);
+            if (first <= last) {
+                expected_distance = std::min(expected_distance, first);
+            }
+        }
+
+        if ((hit == vulkan_rendering::Bvh::INVALID_OBJECT) != (expected_distance == 1000.0f) ||
+            (hit != vulkan_rendering::Bvh::INVALID_OBJECT && std::abs(distance - expected_distance) > 1e-3f)) {
+            std::cerr << "BVH and brute force picking disagree on ray " << ray << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<glm::vec3> moved_min = scene.min;
+    std::vector<glm::vec3> moved_max = scene.max;
+    std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+    for (uint32_t i = 0; i < moved_min.size(); i += 10) {
+        glm::vec3 move(offset(random), offset(random), offset(random));
+        moved_min[i] += move;
+        moved_max[i] += move;
+    }
+
+    // Alternates between the original and the moved boxes, so every refit has the same amount of work to do.
+    uint32_t refits           = 0;
+    double refit_milliseconds = time_milliseconds(options.iterations, [&]() {
+        const std::vector<glm::vec3>& min = refits % 2 == 0 ? moved_min : scene.min;
+        const std::vector<glm::vec3>& max = refits % 2 == 0 ? moved_max : scene.max;
+        for (uint32_t i = 0; i < min.size(); i += 10) {
+            bvh.set_bounds(i, min[i], max[i]);
+        }
+        bvh.refit();
+        refits++;
+    });
+
+    double cull_milliseconds = time_milliseconds(options.iterations, [&]() {
+        visible.clear();
+        bvh.cull(frustum, visible);
+    });
+
+    uint32_t hits             = 0;
+    double pick_milliseconds = time_milliseconds(1, [&]() {
+        for (const glm::vec3& direction : directions) {
+            float distance;
+            hits += bvh.pick(glm::vec3(0.0f), direction, 1000.0f, distance) != vulkan_rendering::Bvh::INVALID_OBJECT;
+        }
+    });
+
+    std::cout << std::fixed << std::setprecision(3) << "bvh: " << bvh.get_nodes().size() << " nodes, depth " <<
+        bvh.get_depth() << ", " << build_milliseconds << "ms build, " << refit_milliseconds << "ms refit of " <<
+        (scene.min.size() + 9) / 10 << " objects" << std::endl;
+    std::cout << "bvh, 1 worker: " << cull_milliseconds << "ms per cull, " << std::setprecision(0) <<
+        scene.min.size() / cull_milliseconds << " objects per ms per core, " << std::setprecision(1) <<
+        100.0 * visible.size() / scene.min.size() << "% visible" << std::endl;
+    std::cout << "bvh, 1 worker: " << std::setprecision(0) << options.ray_count / pick_milliseconds <<
+        " rays per ms, " << std::setprecision(1) << 100.0 * hits / std::max(options.ray_count, 1u) << "% hit" <<
+        std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    CullBenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            options.object_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            options.worker_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            options.ray_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--scalar") == 0) {
+            options.allow_simd = false;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--objects N] [--workers N] [--warmup N] [--iterations N] " <<
+                "[--rays N] [--scalar]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.object_count == 0 || options.iterations == 0) {
+        std::cerr << "Need at least one object and one iteration." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Same projection as the app, Vulkan's clip space has y pointing down.
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 150.0f);
+    proj[1][1]    *= -1;
+    vulkan_rendering::Frustum frustum = vulkan_rendering::Frustum::from_matrix(proj * view);
+
+    BenchScene scene = make_scene(options.object_count);
+    vulkan_rendering::FrustumCuller culler(options.allow_simd);
+    fill_culler(culler, scene);
+
+    // The SIMD kernels have to agree with the scalar one exactly, otherwise the timings mean nothing.
+    if (options.allow_simd) {
+        vulkan_rendering::FrustumCuller reference(false);
+        fill_culler(reference, scene);
+
+        vulkan_rendering::WorkerPool pool(1);
+        std::vector<uint32_t> expected;
+        std::vector<uint32_t> actual;
+        reference.cull(frustum, pool, expected);
+        culler.cull(frustum, pool, actual);
+        if (expected != actual) {
+            std::cerr << culler.get_simd_name() << " and scalar culling disagree: " << actual.size() << " vs " <<
+                expected.size() << " visible" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // 0 is one worker per hardware thread, same as WorkerPool.
+    uint32_t worker_count = options.worker_count != 0 ? options.worker_count :
+        std::max(std::thread::hardware_concurrency(), 1u);
+
+    run(culler, frustum, 1, options);
+    if (worker_count > 1) {
+        run(culler, frustum, worker_count, options);
+    }
+
+    return run_bvh(scene, frustum, options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
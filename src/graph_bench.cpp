@@ -0,0 +1,514 @@
+#include "../include/RenderGraph.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using vulkan_rendering::ImageDesc;
+using vulkan_rendering::RenderGraph;
+using vulkan_rendering::ResourceState;
+using vulkan_rendering::ResourceUsage;
+
+/**
+ * Compiles and executes render graphs against a fake backend, needs neither a GPU nor a device. Every execute gets
+ * checked the way a validation layer would: images are in the layout each pass needs, reads come after a barrier that
+ * made the last write visible to their stages, writes after a barrier that waited on the last use, and an aliased
+ * image is only used after its own first barrier took its memory over from the images it shares it with. Then
+ * --iterations compiles and executes get timed.
+ */
+struct GraphBenchOptions {
+    uint32_t width      = 1920;
+    uint32_t height     = 1080;
+    uint32_t warmup     = 10;
+    uint32_t iterations = 1000;
+};
+
+// Written out again rather than taken from the graph, so it doesn't get checked against itself.
+struct UsageCheck {
+    VkPipelineStageFlags stages;
+    VkImageLayout layout;
+    bool reads;
+    bool writes;
+};
+
+static UsageCheck get_check(ResourceUsage usage) {
+    const VkPipelineStageFlags tests = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, false,
+                true };
+        case ResourceUsage::ColorAttachmentLoad:
+            return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true,
+                true };
+        case ResourceUsage::DepthAttachment:
+            return { tests, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, false, true };
+        case ResourceUsage::DepthAttachmentLoad:
+            return { tests, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true, true };
+        case ResourceUsage::DepthRead:
+            return { tests, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, true, false };
+        case ResourceUsage::FragmentSampled:
+            return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false };
+        case ResourceUsage::ComputeSampled:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, true, false };
+        case ResourceUsage::ComputeRead:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_GENERAL, true, false };
+        case ResourceUsage::ComputeWrite:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_GENERAL, false, true };
+        case ResourceUsage::ComputeReadWrite:
+            return { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_GENERAL, true, true };
+        case ResourceUsage::IndirectRead:
+            return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false };
+        case ResourceUsage::VertexRead:
+            return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false };
+        case ResourceUsage::TransferSrc:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, true, false };
+        case ResourceUsage::TransferDst:
+            return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false, true };
+        case ResourceUsage::HostRead:
+            return { VK_PIPELINE_STAGE_HOST_BIT, VK_IMAGE_LAYOUT_UNDEFINED, true, false };
+        case ResourceUsage::Present:
+            return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, true, false };
+        default:
+            return { 0, VK_IMAGE_LAYOUT_UNDEFINED, false, false };
+    }
+}
+
+template <typename Handle>
+static Handle make_handle(uint64_t id) {
+    return reinterpret_cast<Handle>(static_cast<uintptr_t>(id));
+}
+
+/**
+ * Hands out fake handles and keeps track of what every image and buffer went through since the last barrier. Bound
+ * images keep their state from frame to frame like the transient images of a real graph do, imported ones start
+ * over every frame, the app waits on a fence or semaphore before it reuses them.
+ */
+class MockBackend : public vulkan_rendering::RenderGraphBackend {
+
+    public:
+        struct Bound {
+            VkDeviceMemory heap;
+            VkDeviceSize offset;
+            VkDeviceSize size;
+        };
+
+        bool checking  = true;
+        bool failed    = false;
+        uint64_t calls = 0;
+
+        VkImage create_image(const VkImageCreateInfo& info, VkMemoryRequirements& requirements) override {
+            VkDeviceSize texel = 4;
+            if (info.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+                texel = 8;
+            } else if (info.format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+                texel = 16;
+            } else if (info.format == VK_FORMAT_R8_UNORM) {
+                texel = 1;
+            }
+
+            // Depth only fits the first memory type on some devices, it still shares a heap with everything else.
+            const VkDeviceSize page     = 64 * 1024;
+            requirements.size           = (info.extent.width * info.extent.height * texel + page - 1) / page * page;
+            requirements.alignment      = page;
+            requirements.memoryTypeBits = info.usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT ? 0x1 : 0x3;
+
+            VkImage image = make_handle<VkImage>(next_handle++);
+            sizes[image]  = requirements.size;
+            return image;
+        }
+
+        VkImageView create_image_view(const VkImageViewCreateInfo&) override {
+            return make_handle<VkImageView>(next_handle++);
+        }
+
+        void destroy_image(VkImage image, VkImageView) override {
+            sizes.erase(image);
+            bound.erase(image);
+            states.erase(reinterpret_cast<uint64_t>(image));
+        }
+
+        vulkan_rendering::Allocation allocate(const VkMemoryRequirements& requirements) override {
+            vulkan_rendering::Allocation allocation;
+            allocation.memory             = make_handle<VkDeviceMemory>(next_handle++);
+            allocation.size               = requirements.size;
+            heap_sizes[allocation.memory] = requirements.size;
+            return allocation;
+        }
+
+        void free(vulkan_rendering::Allocation& allocation) override {
+            heap_sizes.erase(allocation.memory);
+        }
+
+        void bind_image(VkImage image, const vulkan_rendering::Allocation& heap, VkDeviceSize offset) override {
+            check(heap_sizes.count(heap.memory) != 0 && offset + sizes[image] <= heap_sizes[heap.memory],
+                "image bound outside its heap");
+            check(offset % (64 * 1024) == 0, "image bound at an offset that isn't aligned");
+            bound[image] = { heap.memory, offset, sizes[image] };
+        }
+
+        void pipeline_barrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags dst_stages,
+            const std::vector<VkBufferMemoryBarrier>& buffer_barriers,
+            const std::vector<VkImageMemoryBarrier>& image_barriers) override {
+
+            calls++;
+            if (!checking) {
+                return;
+            }
+
+            for (const VkBufferMemoryBarrier& barrier : buffer_barriers) {
+                State& state             = states[reinterpret_cast<uint64_t>(barrier.buffer)];
+                state.synced_stages     |= dst_stages;
+                state.barrier_after_use  = true;
+            }
+
+            for (const VkImageMemoryBarrier& barrier : image_barriers) {
+                State& state = states[reinterpret_cast<uint64_t>(barrier.image)];
+                check(barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED || barrier.oldLayout == state.layout,
+                    "barrier's old layout isn't the layout the image is in");
+                state.layout             = barrier.newLayout;
+                state.synced_stages     |= dst_stages;
+                state.barrier_after_use  = true;
+
+                // Discarding the contents is how an aliased image takes its memory over.
+                auto image = bound.find(barrier.image);
+                if (barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && image != bound.end()) {
+                    for (const auto& other : bound) {
+                        if (other.first != barrier.image && overlaps(image->second, other.second)) {
+                            states[reinterpret_cast<uint64_t>(other.first)].valid = false;
+                        }
+                    }
+                    state.valid = true;
+                }
+            }
+        }
+
+        // Imported resources were waited on by the app before the frame.
+        void begin_frame() {
+            for (auto& state : states) {
+                if (bound.count(make_handle<VkImage>(state.first)) == 0) {
+                    state.second = State();
+                }
+            }
+        }
+
+        void use(uint64_t handle, bool image, const UsageCheck& usage, const std::string& what) {
+            if (!checking) {
+                return;
+            }
+
+            State& state = states[handle];
+            if (image) {
+                check(state.valid, what + " used while an image aliasing it owns the memory");
+                check(state.layout == usage.layout, what + " isn't in the layout it's used in");
+            }
+            if (usage.reads && state.written) {
+                check((usage.stages & ~state.synced_stages) == 0, what + " read without a barrier after the write");
+            }
+            if (usage.writes && state.used) {
+                check(state.barrier_after_use, what + " written without a barrier after the last use");
+            }
+
+            if (usage.writes) {
+                state.written       = true;
+                state.synced_stages = 0;
+            }
+            state.used              = true;
+            state.barrier_after_use = false;
+        }
+
+        const std::map<VkImage, Bound>& get_bound() const { return bound; }
+
+        static bool overlaps(const Bound& a, const Bound& b) {
+            return a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+        }
+
+    private:
+        struct State {
+            VkImageLayout layout               = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags synced_stages = 0;
+            bool valid                         = true;
+            bool written                       = false;
+            bool used                          = false;
+            bool barrier_after_use             = false;
+        };
+
+        uint64_t next_handle = 1;
+        std::map<VkImage, VkDeviceSize> sizes;
+        std::map<VkDeviceMemory, VkDeviceSize> heap_sizes;
+        std::map<VkImage, Bound> bound;
+        std::map<uint64_t, State> states;
+
+        void check(bool condition, const std::string& message) {
+            if (!condition && !failed) {
+                std::cerr << "Render graph check failed: " << message << std::endl;
+                failed = true;
+            }
+        }
+};
+
+struct BenchPass {
+    std::string name;
+    std::vector<std::pair<uint32_t, ResourceUsage>> uses;
+    bool side_effects = false;
+};
+
+struct BenchGraph {
+    std::string name;
+    std::vector<BenchPass> passes;
+    std::vector<std::string> expected_culled;
+    uint32_t swap_chain = RenderGraph::INVALID_RESOURCE;
+    std::vector<uint32_t> buffers;
+};
+
+/**
+ * Declares the graph again, which is what the app does every frame. Resources get declared in a fixed order so the
+ * indices in BenchPass line up.
+ */
+static void declare(RenderGraph& graph, MockBackend& backend, BenchGraph& bench, const GraphBenchOptions& options,
+    std::vector<uint32_t>& executed) {
+    graph.reset();
+    VkExtent2D full = { options.width, options.height };
+    VkExtent2D half = { options.width / 2, options.height / 2 };
+    ResourceState acquired;
+    acquired.stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    ImageDesc swap_chain_desc;
+    swap_chain_desc.format = VK_FORMAT_B8G8R8A8_SRGB;
+    swap_chain_desc.extent = full;
+
+    if (bench.name == "deferred") {
+        auto image = [&](const char* name, VkFormat format, VkExtent2D extent) {
+            ImageDesc desc;
+            desc.format = format;
+            desc.extent = extent;
+            return graph.create_image(name, desc);
+        };
+        bench.swap_chain = graph.import_image("swap_chain", swap_chain_desc, acquired, ResourceUsage::Present);
+        image("albedo", VK_FORMAT_R8G8B8A8_UNORM, full);
+        image("normal", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+        image("depth", VK_FORMAT_D32_SFLOAT, full);
+        image("ao", VK_FORMAT_R8_UNORM, full);
+        image("hdr", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+        image("bloom_down", VK_FORMAT_R16G16B16A16_SFLOAT, half);
+        image("bloom_blur", VK_FORMAT_R16G16B16A16_SFLOAT, half);
+        image("debug", VK_FORMAT_R8G8B8A8_UNORM, full);
+    } else {
+        bench.swap_chain = graph.import_image("swap_chain", swap_chain_desc, acquired, ResourceUsage::Present);
+        ImageDesc depth;
+        depth.format = VK_FORMAT_D32_SFLOAT;
+        depth.extent = full;
+        graph.create_image("depth", depth);
+        bench.buffers = { graph.import_buffer("culling_output", ResourceState(), ResourceUsage::None),
+            graph.import_buffer("culling_readback", ResourceState(), ResourceUsage::HostRead) };
+    }
+
+    for (uint32_t i = 0; i < bench.passes.size(); i++) {
+        const BenchPass& pass = bench.passes[i];
+        uint32_t index        = graph.add_pass(pass.name, [&backend, &graph, &bench, &executed, i](VkCommandBuffer) {
+            executed.push_back(i);
+            for (const auto& use : bench.passes[i].uses) {
+                const std::string& name = bench.passes[i].name;
+                bool buffer = std::find(bench.buffers.begin(), bench.buffers.end(), use.first) != bench.buffers.end();
+                uint64_t handle = buffer ? 1000000 + use.first : reinterpret_cast<uint64_t>(graph.get_image(use.first));
+                backend.use(handle, !buffer, get_check(use.second), name + " resource " + std::to_string(use.first));
+            }
+        });
+        for (const auto& use : pass.uses) {
+            graph.use(index, use.first, use.second);
+        }
+        if (pass.side_effects) {
+            graph.set_side_effects(index);
+        }
+    }
+}
+
+static std::vector<BenchGraph> make_graphs() {
+    // Resource indices in the order declare() creates them.
+    enum { SWAP_CHAIN, ALBEDO, NORMAL, DEPTH, AO, HDR, BLOOM_DOWN, BLOOM_BLUR, DEBUG };
+    BenchGraph deferred;
+    deferred.name   = "deferred";
+    deferred.passes = {
+        { "gbuffer", { { ALBEDO, ResourceUsage::ColorAttachment }, { NORMAL, ResourceUsage::ColorAttachment },
+            { DEPTH, ResourceUsage::DepthAttachment } } },
+        { "ssao", { { DEPTH, ResourceUsage::ComputeSampled }, { NORMAL, ResourceUsage::ComputeSampled },
+            { AO, ResourceUsage::ComputeWrite } } },
+        { "lighting", { { ALBEDO, ResourceUsage::FragmentSampled }, { NORMAL, ResourceUsage::FragmentSampled },
+            { AO, ResourceUsage::FragmentSampled }, { DEPTH, ResourceUsage::DepthRead },
+            { HDR, ResourceUsage::ColorAttachment } } },
+        { "debug_normals", { { NORMAL, ResourceUsage::FragmentSampled }, { DEBUG, ResourceUsage::ColorAttachment } } },
+        { "bloom_down", { { HDR, ResourceUsage::ComputeSampled }, { BLOOM_DOWN, ResourceUsage::ComputeWrite } } },
+        { "bloom_blur", { { BLOOM_DOWN, ResourceUsage::ComputeSampled },
+            { BLOOM_BLUR, ResourceUsage::ComputeWrite } } },
+        { "tonemap", { { HDR, ResourceUsage::FragmentSampled }, { BLOOM_BLUR, ResourceUsage::FragmentSampled },
+            { SWAP_CHAIN, ResourceUsage::ColorAttachment } } },
+        { "ui", { { SWAP_CHAIN, ResourceUsage::ColorAttachmentLoad } } }
+    };
+    deferred.expected_culled = { "debug_normals" };
+
+    // The app's frame with GPU culling and a depth prepass, see TriangleApp::create_render_graph.
+    enum { FRAME_SWAP_CHAIN, FRAME_DEPTH, CULLING_OUTPUT, CULLING_READBACK };
+    BenchGraph frame;
+    frame.name   = "frame";
+    frame.passes = {
+        { "cull_clear", { { CULLING_OUTPUT, ResourceUsage::TransferDst } } },
+        { "cull", { { CULLING_OUTPUT, ResourceUsage::ComputeReadWrite } } },
+        { "cull_readback", { { CULLING_OUTPUT, ResourceUsage::TransferSrc },
+            { CULLING_READBACK, ResourceUsage::TransferDst } } },
+        { "forward", { { FRAME_SWAP_CHAIN, ResourceUsage::ColorAttachment },
+            { FRAME_DEPTH, ResourceUsage::DepthAttachment }, { CULLING_OUTPUT, ResourceUsage::IndirectRead },
+            { CULLING_OUTPUT, ResourceUsage::VertexRead } } }
+    };
+    return { deferred, frame };
+}
+
+template <typename Function>
+static double time_milliseconds(uint32_t iterations, Function function) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < iterations; i++) {
+        function();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() /
+        iterations;
+}
+
+static void execute(RenderGraph& graph, MockBackend& backend, const BenchGraph& bench, uint64_t frame) {
+    backend.begin_frame();
+    graph.set_image(bench.swap_chain, make_handle<VkImage>(2000000 + frame % 3));
+    for (uint32_t buffer : bench.buffers) {
+        graph.set_buffer(buffer, make_handle<VkBuffer>(1000000 + buffer), 0, VK_WHOLE_SIZE);
+    }
+    graph.execute(VK_NULL_HANDLE);
+}
+
+/**
+ * Checks first: which passes got culled, that images sharing memory are never alive at the same time, and a few
+ * frames of the mock's checks. Then times a compile that has to redo everything, one that hits the cache, and an
+ * execute.
+ */
+static bool run(BenchGraph& bench, const GraphBenchOptions& options) {
+    MockBackend backend;
+    std::vector<uint32_t> executed;
+    RenderGraph graph(&backend);
+
+    declare(graph, backend, bench, options, executed);
+    graph.compile(1);
+    for (uint32_t i = 0; i < bench.passes.size(); i++) {
+        bool expected = std::find(bench.expected_culled.begin(), bench.expected_culled.end(), bench.passes[i].name) !=
+            bench.expected_culled.end();
+        if (graph.is_culled(i) != expected) {
+            std::cerr << bench.name << ": " << bench.passes[i].name << (expected ? " wasn't culled" : " was culled") <<
+                std::endl;
+            return false;
+        }
+    }
+
+    for (uint64_t frame = 0; frame < 3 && !backend.failed; frame++) {
+        executed.clear();
+        execute(graph, backend, bench, frame);
+    }
+
+    // First and last position every image was used at in the last frame.
+    std::map<VkImage, std::pair<uint32_t, uint32_t>> lifetimes;
+    for (uint32_t position = 0; position < executed.size(); position++) {
+        for (const auto& use : bench.passes[executed[position]].uses) {
+            VkImage image = graph.get_image(use.first);
+            if (backend.get_bound().count(image) != 0) {
+                auto lifetime = lifetimes.insert({ image, { position, position } }).first;
+                lifetime->second.second = position;
+            }
+        }
+    }
+    for (const auto& a : lifetimes) {
+        for (const auto& b : lifetimes) {
+            if (a.first != b.first && MockBackend::overlaps(backend.get_bound().at(a.first),
+                backend.get_bound().at(b.first)) && a.second.first <= b.second.second &&
+                b.second.first <= a.second.second) {
+                std::cerr << bench.name << ": images alive at the same time share memory" << std::endl;
+                return false;
+            }
+        }
+    }
+    if (backend.failed) {
+        return false;
+    }
+
+    // Only the cost of the graph from here on.
+    backend.checking = false;
+    uint64_t frame   = 3;
+    for (uint32_t i = 0; i < options.warmup; i++) {
+        declare(graph, backend, bench, options, executed);
+        graph.compile(frame);
+        execute(graph, backend, bench, frame++);
+    }
+
+    // Every other compile changes the size, so every one of them starts from scratch.
+    GraphBenchOptions resized = options;
+    resized.height            = options.height + 2;
+    uint32_t compiles         = 0;
+    double compile_milliseconds = time_milliseconds(options.iterations, [&]() {
+        declare(graph, backend, bench, compiles++ % 2 == 0 ? resized : options, executed);
+        graph.compile(frame);
+        graph.reclaim(frame++);
+    });
+
+    double cached_milliseconds = time_milliseconds(options.iterations, [&]() {
+        declare(graph, backend, bench, options, executed);
+        graph.compile(frame);
+    });
+
+    uint64_t calls                = backend.calls;
+    double execute_milliseconds = time_milliseconds(options.iterations, [&]() {
+        executed.clear();
+        execute(graph, backend, bench, frame++);
+    });
+
+    const vulkan_rendering::RenderGraphStats& stats = graph.get_stats();
+    std::cout << bench.name << ": " << std::fixed << std::setprecision(4) << compile_milliseconds << "ms compile, " <<
+        cached_milliseconds << "ms cached compile, " << execute_milliseconds << "ms execute, " <<
+        (backend.calls - calls) / options.iterations << " barrier calls per execute" << std::endl;
+    graph.print_stats(std::cout);
+    std::cout << bench.name << ": " << stats.barriers - stats.barrier_calls << " vkCmdPipelineBarrier calls saved " <<
+        "by batching, " << std::setprecision(1) << 100.0 * (1.0 - static_cast<double>(stats.heap_bytes) /
+        std::max<VkDeviceSize>(stats.transient_bytes, 1)) << "% of the transient memory saved by aliasing" << std::endl;
+
+    graph.reclaim(frame);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    GraphBenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            options.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            options.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--width N] [--height N] [--warmup N] [--iterations N]" <<
+                std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.width < 2 || options.height < 2 || options.iterations == 0) {
+        std::cerr << "Need at least a 2x2 frame and one iteration." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (BenchGraph& bench : make_graphs()) {
+        if (!run(bench, options)) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,13 +1,78 @@
 #include "../include/TriangleApp.h"
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <string>
 
-int main() {
-    
-    vulkan_rendering::TriangleApp app;
+int main(int argc, char** argv) {
+    vulkan_rendering::AppConfig config;
 
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            config.headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            config.frame_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            config.width = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            config.height = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            config.object_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            config.worker_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc) {
+            config.pipeline_cache_path = argv[++i];
+        } else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc) {
+            config.shader_cache_path = argv[++i];
+        } else if (strcmp(argv[i], "--define") == 0 && i + 1 < argc) {
+            config.shader_defines.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--hot-reload") == 0) {
+            config.hot_reload = true;
+        } else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc) {
+            config.asset_pack_path = argv[++i];
+        } else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            config.model_path = argv[++i];
+        } else if (strcmp(argv[i], "--no-optimize") == 0) {
+            config.optimize_meshes = false;
+        } else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            config.vertex_format = argv[++i];
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            config.depth_prepass = true;
+        } else if (strcmp(argv[i], "--instancing") == 0) {
+            config.instancing = true;
+        } else if (strcmp(argv[i], "--gpu-culling") == 0) {
+            config.gpu_culling = true;
+        } else if (strcmp(argv[i], "--cpu-culling") == 0) {
+            config.cpu_culling = true;
+        } else if (strcmp(argv[i], "--bvh-culling") == 0) {
+            config.bvh_culling = true;
+        } else if (strcmp(argv[i], "--per-draw-sets") == 0) {
+            config.per_draw_sets = true;
+        } else if (strcmp(argv[i], "--bindless") == 0) {
+            config.bindless = true;
+        } else if (strcmp(argv[i], "--texture") == 0 && i + 1 < argc) {
+            config.texture_paths.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+            config.texture_budget_mb = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            config.profile = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            config.trace_path = argv[++i];
+            config.profile    = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--headless] [--frames N] [--width W] [--height H] " <<
+                "[--objects N] [--workers N] [--pipeline-cache PATH] [--shader-cache PATH] " <<
+                "[--define NAME[=VALUE]]... [--hot-reload] [--assets PATH] [--model PATH] [--no-optimize] " <<
+                "[--vertex-format float|compact|interleaved] [--depth-prepass] [--instancing] [--gpu-culling] " <<
+                "[--cpu-culling] [--bvh-culling] [--per-draw-sets] [--bindless] [--texture PATH]... " <<
+                "[--texture-budget MB] [--profile] [--trace PATH]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    
     try {
+        vulkan_rendering::TriangleApp app(config);
         app.run();
     }
     catch (const std::exception& e) {
@@ -0,0 +1,115 @@
+#include "../include/AssetPack.h"
+#include "../include/MeshImporter.h"
+#include "../include/MeshOptimizer.h"
+#include "../include/Scene.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static std::string get_file_name(const std::string& path) {
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+static bool ends_with(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void add_scene_mesh(vulkan_rendering::AssetPackWriter& writer, const std::string& name,
+    const vulkan_rendering::SceneGeometry& scene) {
+
+    const vulkan_rendering::MeshRange& mesh = scene.meshes[0];
+    writer.add_mesh(name, scene.vertices.data(), static_cast<uint32_t>(scene.vertices.size()),
+        scene.indices.data() + mesh.first_index, mesh.index_count, VK_INDEX_TYPE_UINT16);
+}
+
+/**
+ * Each imported mesh is stored under its own name, e.g. bunny for bunny.obj and scene/chair for a glTF mesh. Meshes are
+ * optimized before they're packed unless --no-optimize came earlier on the command line, so loading them costs nothing.
+ */
+static void add_model(vulkan_rendering::AssetPackWriter& writer, const std::string& path, bool optimize) {
+    vulkan_rendering::ImportStats stats;
+    std::vector<vulkan_rendering::ImportedMesh> meshes = vulkan_rendering::import_meshes(path, 0, &stats);
+    stats.print(std::cout);
+
+    if (optimize) {
+        vulkan_rendering::MeshOptimizeStats optimize_stats;
+        vulkan_rendering::optimize_meshes(meshes, 0, &optimize_stats);
+        optimize_stats.print(std::cout);
+    }
+
+    for (const auto& mesh : meshes) {
+        writer.add_mesh(mesh.name, mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+            mesh.index_data.data(), mesh.index_count, mesh.index_type);
+    }
+
+#ifndef _WIN32
+    // Linux reports ru_maxrss in KiB, macOS in bytes.
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        long peak_kib = usage.ru_maxrss / 1024;
+#else
+        long peak_kib = usage.ru_maxrss;
+#endif
+        std::cout << "Peak memory after importing " << path << ": " << peak_kib / 1024 << " MiB" << std::endl;
+    }
+#endif
+}
+
+/**
+ * Offline packer. Loose files are stored under their file name, .spv files as shaders, .obj and .gltf files are
+ * imported as meshes and anything else is stored as a raw blob. Meshes can also be generated with --quad (the quad from
+ * Vertex.h) and --grid (a procedural grid mesh).
+ */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " OUTPUT [--quad NAME] [--grid NAME TRIANGLES] [--shader NAME PATH] " <<
+            "[--blob NAME PATH] [--no-optimize] [FILE...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    vulkan_rendering::AssetPackWriter writer;
+    std::string output_path = argv[1];
+    bool optimize           = true;
+
+    try {
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--quad") == 0 && i + 1 < argc) {
+                add_scene_mesh(writer, argv[++i], vulkan_rendering::make_quad_scene());
+            } else if (strcmp(argv[i], "--grid") == 0 && i + 2 < argc) {
+                std::string name   = argv[++i];
+                uint32_t triangles = static_cast<uint32_t>(std::stoul(argv[++i]));
+                add_scene_mesh(writer, name, vulkan_rendering::make_procedural_scene(1, triangles));
+            } else if (strcmp(argv[i], "--shader") == 0 && i + 2 < argc) {
+                std::string name = argv[++i];
+                writer.add_file(name, vulkan_rendering::AssetType::Shader, argv[++i]);
+            } else if (strcmp(argv[i], "--blob") == 0 && i + 2 < argc) {
+                std::string name = argv[++i];
+                writer.add_file(name, vulkan_rendering::AssetType::Blob, argv[++i]);
+            } else if (strcmp(argv[i], "--no-optimize") == 0) {
+                optimize = false;
+            } else if (ends_with(argv[i], ".obj") || ends_with(argv[i], ".gltf")) {
+                add_model(writer, argv[i], optimize);
+            } else {
+                std::string path = argv[i];
+                writer.add_file(get_file_name(path), ends_with(path, ".spv") ? vulkan_rendering::AssetType::Shader :
+                    vulkan_rendering::AssetType::Blob, path);
+            }
+        }
+
+        writer.write(output_path);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Packed " << writer.get_asset_count() << " assets into " << output_path << std::endl;
+    return EXIT_SUCCESS;
+}
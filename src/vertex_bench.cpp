@@ -0,0 +1,358 @@
+#include "../include/VertexLayout.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using vulkan_rendering::AttributeFormat;
+using vulkan_rendering::QuantizationError;
+using vulkan_rendering::Vertex;
+using vulkan_rendering::VertexFormat;
+
+/**
+ * Round trip checks for the vertex formats, needs neither Vulkan nor a GPU. Every AttributeFormat gets values encoded
+ * and decoded again, and the largest error has to stay within what the format can store: nothing for floats, half a
+ * step for the normalized ones, the rounding of a half for halves. Unit vectors through Octahedral16 have to come back
+ * unit length and close in angle. The runtime formats get the same through measure_error, then the encoding of
+ * --vertices vertices gets timed for each of them.
+ */
+struct VertexBenchOptions {
+    uint32_t vertex_count = 1000000;
+    uint32_t warmup       = 2;
+    uint32_t iterations   = 20;
+};
+
+struct FormatCheck {
+    const char* name;
+    AttributeFormat format;
+    uint32_t component_count;
+
+    // Range the values are drawn from and the largest error allowed, absolute or relative to the value.
+    float min;
+    float max;
+    float bound;
+    bool relative;
+};
+
+static bool failed = false;
+
+static void check(bool condition, const std::string& message) {
+    if (!condition && !failed) {
+        std::cerr << "Vertex format check failed: " << message << std::endl;
+        failed = true;
+    }
+}
+
+/**
+ * Random values in range plus the edges and 0, which the normalized formats have to hit exactly. The missing
+ * components have to come back as 0 and w as 1.
+ */
+static void check_format(const FormatCheck& format, std::mt19937& random) {
+    std::uniform_real_distribution<float> value(format.min, format.max);
+    float largest_error = 0.0f;
+
+    for (uint32_t i = 0; i < 100000 + 3; i++) {
+        float values[4];
+        for (uint32_t c = 0; c < format.component_count; c++) {
+            values[c] = i == 0 ? format.min : i == 1 ? format.max : i == 2 ? 0.0f : value(random);
+        }
+
+        uint8_t encoded[16];
+        float decoded[4];
+        vulkan_rendering::encode_attribute(format.format, values, format.component_count, encoded);
+        vulkan_rendering::decode_attribute(format.format, encoded, decoded);
+
+        for (uint32_t c = 0; c < 4; c++) {
+            if (c >= format.component_count) {
+                check(decoded[c] == (c == 3 ? 1.0f : 0.0f),
+                    std::string(format.name) + " missing component " + std::to_string(c) + " isn't " +
+                    (c == 3 ? "1" : "0"));
+                continue;
+            }
+
+            float error = std::abs(decoded[c] - values[c]);
+            // Plus the rounding of the division in the decode.
+            float bound = format.relative ? format.bound * std::abs(values[c]) :
+                format.bound + std::numeric_limits<float>::epsilon();
+            if (i < 3 && !format.relative) {
+                bound = 0.0f;
+            }
+            check(error <= bound, std::string(format.name) + " round trip of " + std::to_string(values[c]) +
+                " came back as " + std::to_string(decoded[c]));
+            largest_error = std::max(largest_error, format.relative && values[c] != 0.0f ?
+                error / std::abs(values[c]) : error);
+        }
+    }
+
+    std::cout << std::setw(14) << std::left << format.name << std::scientific << std::setprecision(2) <<
+        largest_error << (format.relative ? " largest relative error, " : " largest error, ") << format.bound <<
+        " allowed" << std::endl;
+}
+
+/**
+ * Out of range values clamp instead of wrapping around, and the normalized formats store their ends exactly.
+ */
+static void check_clamping() {
+    const float out_of_range[4] = { 2.0f, -2.0f, 1e6f, -1e6f };
+    struct Clamp {
+        AttributeFormat format;
+        const char* name;
+        float low;
+    };
+    const Clamp clamps[] = {
+        { AttributeFormat::Snorm16x4, "Snorm16x4", -1.0f },
+        { AttributeFormat::Unorm8x4, "Unorm8x4", 0.0f },
+        { AttributeFormat::Unorm10x3_2, "Unorm10x3_2", 0.0f }
+    };
+
+    for (const Clamp& clamp : clamps) {
+        uint8_t encoded[16];
+        float decoded[4];
+        vulkan_rendering::encode_attribute(clamp.format, out_of_range, 4, encoded);
+        vulkan_rendering::decode_attribute(clamp.format, encoded, decoded);
+        for (uint32_t c = 0; c < 4; c++) {
+            float expected = out_of_range[c] > 0.0f ? 1.0f : clamp.low;
+            check(decoded[c] == expected, std::string(clamp.name) + " didn't clamp " +
+                std::to_string(out_of_range[c]) + " to " + std::to_string(expected));
+        }
+    }
+
+    // The encoder never writes -32768, but it's valid data and decodes to -1 like -32767.
+    const int16_t lowest[2] = { -32768, -32767 };
+    float decoded[4];
+    vulkan_rendering::decode_attribute(AttributeFormat::Snorm16x2, reinterpret_cast<const uint8_t*>(lowest), decoded);
+    check(decoded[0] == -1.0f && decoded[1] == -1.0f, "Snorm16x2 decoded -32768 below -1");
+}
+
+/**
+ * The 2 bit w of Unorm10x3_2 only has 0, 1/3, 2/3 and 1, everything else lands on the nearest of them.
+ */
+static void check_packed_w(std::mt19937& random) {
+    std::uniform_real_distribution<float> value(0.0f, 1.0f);
+
+    for (uint32_t i = 0; i < 10000 + 4; i++) {
+        float values[4] = { 0.0f, 0.0f, 0.0f, i < 4 ? i / 3.0f : value(random) };
+
+        uint8_t encoded[4];
+        float decoded[4];
+        vulkan_rendering::encode_attribute(AttributeFormat::Unorm10x3_2, values, 4, encoded);
+        vulkan_rendering::decode_attribute(AttributeFormat::Unorm10x3_2, encoded, decoded);
+
+        float bound = i < 4 ? 0.0f : 0.5f / 3.0f + std::numeric_limits<float>::epsilon();
+        check(std::abs(decoded[3] - values[3]) <= bound, "Unorm10x3_2 round trip of w " + std::to_string(values[3]) +
+            " came back as " + std::to_string(decoded[3]));
+    }
+}
+
+/**
+ * Every half goes through float and back unchanged (NaNs stay NaN), and the conversion from float rounds to nearest
+ * even, overflows to infinity and flushes what's below the smallest subnormal to zero.
+ */
+static void check_halves() {
+    for (uint32_t bits = 0; bits < 0x10000; bits++) {
+        uint16_t half = static_cast<uint16_t>(bits);
+        float value   = vulkan_rendering::half_to_float(half);
+        if (std::isnan(value)) {
+            check((vulkan_rendering::float_to_half(value) & 0x7fff) > 0x7c00, "NaN didn't stay NaN");
+        } else {
+            check(vulkan_rendering::float_to_half(value) == half, "half " + std::to_string(bits) +
+                " didn't survive a round trip through float");
+        }
+    }
+
+    struct Rounding {
+        float value;
+        uint16_t half;
+    };
+    const Rounding roundings[] = {
+        { 1.0f + std::ldexp(1.0f, -11), 0x3c00 },           // Halfway, rounds to the even 1.0
+        { 1.0f + 3.0f * std::ldexp(1.0f, -11), 0x3c02 },    // Halfway, rounds up to even
+        { 65504.0f, 0x7bff },                               // Largest half
+        { 65520.0f, 0x7c00 },                               // Rounds past it to infinity
+        { 1e5f, 0x7c00 },                                   // Past it
+        { std::ldexp(1.0f, -24), 0x0001 },                  // Smallest subnormal
+        { std::ldexp(1.0f, -26), 0x0000 },                  // Below it
+        { -std::numeric_limits<float>::infinity(), 0xfc00 }
+    };
+    for (const Rounding& rounding : roundings) {
+        check(vulkan_rendering::float_to_half(rounding.value) == rounding.half, "float " +
+            std::to_string(rounding.value) + " didn't convert to half " + std::to_string(rounding.half));
+    }
+}
+
+/**
+ * Unit vectors all around the sphere plus the axes, which sit on the folds of the octahedron. They have to come back
+ * unit length and within a couple of steps of the encoding, which are 1/32767 wide.
+ */
+static void check_octahedral(std::mt19937& random) {
+    const float bound = 1e-4f;
+    std::normal_distribution<float> gaussian;
+    float largest_error = 0.0f;
+
+    for (uint32_t i = 0; i < 100000 + 6; i++) {
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        if (i < 6) {
+            normal[i / 2] = i % 2 == 0 ? 1.0f : -1.0f;
+        } else {
+            float length = 0.0f;
+            while (length < 1e-3f) {
+                normal[0] = gaussian(random);
+                normal[1] = gaussian(random);
+                normal[2] = gaussian(random);
+                length    = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            }
+            normal[0] /= length;
+            normal[1] /= length;
+            normal[2] /= length;
+        }
+
+        uint8_t encoded[4];
+        float decoded[4];
+        vulkan_rendering::encode_attribute(AttributeFormat::Octahedral16, normal, 3, encoded);
+        vulkan_rendering::decode_attribute(AttributeFormat::Octahedral16, encoded, decoded);
+
+        // The distance between the two, acos of the dot product loses everything below 3e-4 in floats.
+        float length = std::sqrt(decoded[0] * decoded[0] + decoded[1] * decoded[1] + decoded[2] * decoded[2]);
+        float error  = std::sqrt((decoded[0] - normal[0]) * (decoded[0] - normal[0]) +
+            (decoded[1] - normal[1]) * (decoded[1] - normal[1]) + (decoded[2] - normal[2]) * (decoded[2] - normal[2]));
+        check(std::abs(length - 1.0f) <= 1e-5f, "Octahedral16 decoded a vector that isn't unit length");
+        check(error <= bound, "Octahedral16 round trip of (" + std::to_string(normal[0]) + ", " +
+            std::to_string(normal[1]) + ", " + std::to_string(normal[2]) + ") is off by " + std::to_string(error));
+        largest_error = std::max(largest_error, error);
+    }
+
+    std::cout << std::setw(14) << std::left << "Octahedral16" << std::scientific << std::setprecision(2) <<
+        largest_error << " largest distance, " << bound << " allowed" << std::endl;
+}
+
+/**
+ * A scene like the importers produce: positions within 100 units, colours in [0, 1]. "compact" stores positions as
+ * halves, which are 1/16 apart between 64 and 128, and colours in 8 bits. The others don't lose anything.
+ */
+static std::vector<Vertex> make_vertices(uint32_t count) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> colour(0.0f, 1.0f);
+
+    std::vector<Vertex> vertices(count);
+    for (Vertex& vertex : vertices) {
+        vertex.pos    = glm::vec3(position(random), position(random), position(random));
+        vertex.colour = glm::vec3(colour(random), colour(random), colour(random));
+    }
+    return vertices;
+}
+
+static void check_vertex_formats(const std::vector<Vertex>& vertices) {
+    struct Bound {
+        const char* name;
+        QuantizationError bound;
+    };
+    const Bound bounds[] = {
+        { "float", { 0.0f, 0.0f } },
+        { "compact", { std::ldexp(128.0f, -12), 0.5f / 255.0f + std::numeric_limits<float>::epsilon() } },
+        { "interleaved", { 0.0f, 0.0f } }
+    };
+
+    for (const Bound& bound : bounds) {
+        const VertexFormat& format = vulkan_rendering::get_vertex_format(bound.name);
+        QuantizationError error    = format.measure_error(vertices.data(), static_cast<uint32_t>(vertices.size()));
+        check(error.position <= bound.bound.position, std::string(bound.name) + " position error " +
+            std::to_string(error.position) + " over " + std::to_string(bound.bound.position));
+        check(error.colour <= bound.bound.colour, std::string(bound.name) + " colour error " +
+            std::to_string(error.colour) + " over " + std::to_string(bound.bound.colour));
+
+        std::cout << std::setw(14) << std::left << bound.name << std::scientific << std::setprecision(2) <<
+            error.position << " position, " << error.colour << " colour error" << std::endl;
+    }
+}
+
+/**
+ * What the upload pays: every stream of a format encoded into its own array, like write_vertices does.
+ */
+static void time_encoding(const std::vector<Vertex>& vertices, const VertexBenchOptions& options) {
+    uint32_t count = static_cast<uint32_t>(vertices.size());
+    for (const char* name : { "float", "compact", "interleaved" }) {
+        const VertexFormat& format = vulkan_rendering::get_vertex_format(name);
+        std::vector<uint8_t> buffer(static_cast<size_t>(format.get_stride()) * count);
+
+        double milliseconds = 0.0;
+        for (uint32_t i = 0; i < options.warmup + options.iterations; i++) {
+            auto start   = std::chrono::high_resolution_clock::now();
+            uint8_t* out = buffer.data();
+            for (const auto& stream : format.streams) {
+                stream.encode(vertices.data(), count, out);
+                out += static_cast<size_t>(stream.stride) * count;
+            }
+            if (i >= options.warmup) {
+                milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() -
+                    start).count();
+            }
+        }
+
+        milliseconds /= options.iterations;
+        std::cout << std::setw(14) << std::left << name << std::fixed << std::setprecision(3) << milliseconds <<
+            "ms to encode " << count << " vertices, " << std::setprecision(0) << count / milliseconds / 1000.0 <<
+            "M vertices per second" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    VertexBenchOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--vertices") == 0 && i + 1 < argc) {
+            options.vertex_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            options.warmup = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--vertices N] [--warmup N] [--iterations N]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.vertex_count == 0 || options.iterations == 0) {
+        std::cerr << "Need at least one vertex and one iteration." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Half a step of the format, for halves the relative rounding error.
+    const FormatCheck formats[] = {
+        { "Float32x2", AttributeFormat::Float32x2, 2, -1e6f, 1e6f, 0.0f, false },
+        { "Float32x3", AttributeFormat::Float32x3, 3, -1e6f, 1e6f, 0.0f, false },
+        { "Float32x4", AttributeFormat::Float32x4, 4, -1e6f, 1e6f, 0.0f, false },
+        { "Float16x2", AttributeFormat::Float16x2, 2, -60000.0f, 60000.0f, std::ldexp(1.0f, -11), true },
+        { "Float16x4", AttributeFormat::Float16x4, 3, -60000.0f, 60000.0f, std::ldexp(1.0f, -11), true },
+        { "Snorm16x2", AttributeFormat::Snorm16x2, 2, -1.0f, 1.0f, 0.5f / 32767.0f, false },
+        { "Snorm16x4", AttributeFormat::Snorm16x4, 4, -1.0f, 1.0f, 0.5f / 32767.0f, false },
+        { "Unorm8x4", AttributeFormat::Unorm8x4, 4, 0.0f, 1.0f, 0.5f / 255.0f, false },
+        { "Unorm10x3_2", AttributeFormat::Unorm10x3_2, 3, 0.0f, 1.0f, 0.5f / 1023.0f, false }
+    };
+
+    std::mt19937 random(5678);
+    for (const FormatCheck& format : formats) {
+        check_format(format, random);
+    }
+    check_octahedral(random);
+    check_packed_w(random);
+    check_clamping();
+    check_halves();
+
+    std::vector<Vertex> vertices = make_vertices(options.vertex_count);
+    check_vertex_formats(vertices);
+    if (failed) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "All vertex format checks passed" << std::endl;
+
+    time_encoding(vertices, options);
+    return EXIT_SUCCESS;
+}